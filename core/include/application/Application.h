@@ -121,6 +121,10 @@ void validateNetworkPassphrase(std::shared_ptr<Application> app);
  * Completed "worker" tasks typically post their results back to the main thread's io_context (held in the VirtualClock),
  * or else deliver their results to the Application through std::futures or similar standard thread-synchronization
  * primitives.
+ *
+ * Blocking transfers, such as history files copied or downloaded in process, go to a third "transfer" io_context
+ * instead, served by MAX_CONCURRENT_SUBPROCESSES threads of its own, so that waiting on disks and networks never
+ * holds the worker threads.
  */
 
 class Application {
@@ -224,6 +228,10 @@ public:
     // with the calling thread, so use with caution.
     virtual asio::io_context &io_context() = 0;
 
+    // Get the IO context for blocking transfers, served by its own bounded
+    // pool of threads.
+    virtual asio::io_context &getTransferIOContext() = 0;
+
     // Perform actions necessary to transition from BOOTING_STATE to other
     // states. In particular: either reload or reinitialize the database, and
     // either restart or begin reacquiring SCP consensus (as instructed by
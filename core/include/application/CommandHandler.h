@@ -39,6 +39,8 @@ public:
 
     void checkdb(std::string const &params, std::string &retStr);
 
+    void closeTrace(std::string const &params, std::string &retStr);
+
     void connect(std::string const &params, std::string &retStr);
 
     void dropcursor(std::string const &params, std::string &retStr);
@@ -26,6 +26,10 @@ struct HistoryArchiveConfiguration {
     std::string mGetCmd;
     std::string mPutCmd;
     std::string mMkdirCmd;
+    // in-process backends used instead of the commands: a local directory
+    // that is read and written, or an http:// url that is only read
+    std::string mLocalDir;
+    std::string mUrl;
 };
 
 class Config : public std::enable_shared_from_this<Config> {
@@ -184,6 +188,21 @@ public:
     // process-management config
     size_t MAX_CONCURRENT_SUBPROCESSES;
 
+    // Number of signature verification results kept in the process-wide
+    // cache, set by the first Application of the process
+    size_t VERIFY_SIG_CACHE_SIZE;
+
+    // Limits of the pool of transactions waiting to be included in a ledger:
+    // its size in bytes, its number of operations and the number of
+    // transactions of a single source account
+    size_t PENDING_TX_MAX_BYTES;
+    size_t PENDING_TX_MAX_OPS;
+    size_t PENDING_TX_MAX_PER_ACCOUNT;
+
+    // applies the transactions of a ledger that don't conflict in parallel,
+    // on the worker threads
+    bool PARALLEL_TX_APPLY;
+
     // SCP config
     SecretKey NODE_SEED;
     bool NODE_IS_VALIDATOR;
@@ -191,11 +210,14 @@ public:
 
     // Invariants
     std::vector<std::string> INVARIANT_CHECKS;
+    bool INVARIANT_CHECKS_ASYNC;
+    size_t INVARIANT_CHECKS_MAX_LAG;
 
     std::map<std::string, std::string> VALIDATOR_NAMES;
 
     // History config
     std::map<std::string, HistoryArchiveConfiguration> HISTORY;
+    bool HISTORY_STREAMING_PUBLISH;
 
     // Database config
     SecretValue DATABASE;
@@ -0,0 +1,41 @@
+#pragma once
+
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/**
+ * Comparison of the entries of a bucket with the database, for
+ * BucketListIsConsistentWithDatabase and checkdb.
+ *
+ * The bucket is read once and its entries split by type into batches. Each
+ * type is compared on its own session from the database pool, in parallel
+ * with the reading, or batch by batch on the main session when there is no
+ * pool. The rows of a batch are loaded with a single query and sorted, and
+ * both sides are then walked in key order together instead of loading every
+ * entry on its own.
+ */
+
+namespace vixal {
+
+class Bucket;
+
+class Database;
+
+struct BucketEntryCounts {
+    uint64_t mAccounts{0};
+    uint64_t mTrustLines{0};
+    uint64_t mOffers{0};
+    uint64_t mData{0};
+};
+
+// checks that the live entries of `bucket` are in the database and that its
+// dead entries are not, and counts its live entries of each type; returns a
+// description of the first difference found, empty if there is none
+std::string compareBucketWithDatabase(std::shared_ptr<Bucket const> bucket,
+                                      Database &db, BucketEntryCounts &counts);
+}
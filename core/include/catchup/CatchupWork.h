@@ -94,6 +94,8 @@ public:
 
     std::string getStatus() const override;
 
+    ProcessClass getProcessClass() const override;
+
     void onReset() override;
 
     State onSuccess() override;
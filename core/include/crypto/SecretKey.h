@@ -4,6 +4,7 @@
 // under the Apache License, Version 2.0. See the COPYING file at the root
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
+#include "crypto/ByteSlice.h"
 #include "crypto/KeyUtils.h"
 #include "util/XDROperators.h"
 #include "xdr/types.h"
@@ -11,11 +12,10 @@
 #include <array>
 #include <functional>
 #include <ostream>
+#include <vector>
 
 namespace vixal {
 
-class ByteSlice;
-
 struct SecretValue;
 struct SignerKey;
 
@@ -104,9 +104,44 @@ namespace PubKeyUtils {
 bool verifySig(PublicKey const &key, Signature const &signature,
                ByteSlice const &bin);
 
+// One (key, signature, message) triple of a batch given to verifySigs. The
+// referenced data must outlive the call.
+struct VerifySigRequest {
+    PublicKey const &mKey;
+    Signature const &mSignature;
+    ByteSlice mBin;
+
+    VerifySigRequest(PublicKey const &key, Signature const &signature,
+                     ByteSlice const &bin)
+            : mKey(key), mSignature(signature), mBin(bin) {
+    }
+};
+
+// Verify a batch of signatures; the i-th result is what verifySig would
+// return for the i-th request. The verification cache is consulted and
+// updated once for the whole batch rather than once per signature.
+std::vector<bool> verifySigs(std::vector<VerifySigRequest> const &batch);
+
 void clearVerifySigCache();
 
-void flushVerifySigCacheCounts(uint64_t &hits, uint64_t &misses);
+// Size the verification cache to hold about `size` results. The cache is
+// shared by the whole process, so only the first call sets the size: later
+// ones leave the cache as it is and return false if they ask for another
+// size.
+bool setVerifySigCacheSize(size_t size);
+
+// Hits and misses of the verification cache.
+struct VerifySigCacheCounts {
+    uint64_t mHits;
+    uint64_t mMisses;
+};
+
+// by shard, since the process started
+std::vector<VerifySigCacheCounts> getVerifySigCacheCounts();
+
+// in the whole process since the last call, so that every hit and miss is
+// reported once however many Applications share the process
+VerifySigCacheCounts takeVerifySigCacheCounts();
 
 PublicKey random();
 }
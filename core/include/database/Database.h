@@ -4,14 +4,17 @@
 // under the Apache License, Version 2.0. See the COPYING file at the root
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
+#include "crypto/ByteSlice.h"
 #include "xdr/xdr.h"
 #include <util/noncopyable.h>
 #include <util/lrucache.hpp>
 #include <util/Timer.h>
 #include <medida/timer_context.h>
+#include <memory>
 #include <set>
 #include <string>
 #include <utility>
+#include <vector>
 #include <soci/soci.h>
 
 namespace medida {
@@ -135,6 +138,19 @@ public:
     // when the statement context is destroyed.
     StatementContext getPreparedStatement(std::string const &query);
 
+    // Return a statement context for a one-off `query` on `sess`, which may
+    // be a session from the pool; the statement is not cached.
+    static StatementContext prepareStatement(soci::session &sess,
+                                             std::string const &query);
+
+    // Return `values` quoted and separated by commas, for an SQL "IN" list.
+    // The values must not contain quotes (keys in strkey form, for example).
+    static std::string toInList(std::vector<std::string> const &values);
+
+    // Return the SQL type of columns holding binary data: BLOB on SQLite,
+    // BYTEA on PostgreSQL. Their values are bound through BlobValue.
+    std::string getBlobType() const;
+
     // Purge all cached prepared statements, closing their handles with the
     // database.
     void clearPreparedStatementCache();
@@ -178,7 +194,9 @@ public:
     // Check schema version and apply any upgrades if necessary.
     void upgradeToCurrentSchema();
 
-    // Access the underlying SOCI session object
+    // Access the underlying SOCI session object. Throws EntryOverlay::Miss
+    // while an overlay is current, as do getPreparedStatement and
+    // getEntryCache.
     soci::session &getSession();
 
     // Access the optional SOCI connection pool available for worker
@@ -193,6 +211,31 @@ public:
     EntryCache &getEntryCache();
 };
 
+/**
+ * Value of a column of the blob type, to bind to a statement as a parameter
+ * or as a column of its result. The bytes go through a soci::blob on SQLite,
+ * where strings are bound and read as NUL terminated text, and through the
+ * hex escaped text form of BYTEA on PostgreSQL, where a soci::blob is a large
+ * object instead. The column holds the bytes either way.
+ */
+class BlobValue : noncopyable {
+    std::unique_ptr<soci::blob> mBlob;
+    std::string mHex;
+
+public:
+    BlobValue(Database &db, soci::session &sess);
+
+    void set(ByteSlice const &bin);
+
+    std::vector<uint8_t> get();
+
+    // binds the value as the next parameter of `st`
+    void use(soci::statement &st);
+
+    // binds the value to the next column of the result of `st`
+    void into(soci::statement &st);
+};
+
 class DBTimeExcluder : noncopyable {
     Application &mApp;
     std::chrono::nanoseconds mStartQueryTime;
@@ -68,6 +68,7 @@ public:
         TX_STATUS_PENDING = 0,
         TX_STATUS_DUPLICATE,
         TX_STATUS_ERROR,
+        TX_STATUS_TRY_AGAIN_LATER,
         TX_STATUS_COUNT
     };
 
@@ -148,5 +149,10 @@ public:
 
     virtual Json::Value getJsonQuorumInfo(NodeID const& id, bool summary,
                                           uint64 index = 0) = 0;
+
+    // starts a check of the quorum intersection of the network made of this
+    // node and the nodes heard from on the latest slot, unless one is running,
+    // and returns the result of the last check that completed
+    virtual Json::Value getJsonQuorumIntersectionInfo() = 0;
 };
 }
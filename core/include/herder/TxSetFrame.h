@@ -21,6 +21,10 @@ class TxSetFrame {
 
     Hash mPreviousLedgerHash;
 
+    // result of sortForApply, valid while the contents hash is mApplyOrderHash
+    std::vector<TransactionFramePtr> mApplyOrder;
+    Hash mApplyOrderHash;
+
     bool
     checkOrTrim(Application &app,
                 std::function<bool(TransactionFramePtr, SequenceNumber)> processInvalidTxLambda,
@@ -0,0 +1,78 @@
+#pragma once
+
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/TmpDir.h"
+#include "util/XDRStream.h"
+#include "xdr/ledger.h"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+/**
+ * CheckpointBuilder writes the ledger headers, transactions and results of a
+ * checkpoint to files as its ledgers close, so that StateSnapshot can take
+ * these files instead of reading the same records back from the database.
+ *
+ * A checkpoint is only written from its first ledger on, one ledger after the
+ * other: a node joining in the middle of a checkpoint, or missing a ledger,
+ * doesn't write that checkpoint and publishes it from the database as before.
+ * Files of complete checkpoints are kept until a snapshot takes them.
+ */
+
+namespace vixal {
+
+class Application;
+
+class TxSetFrame;
+
+class CheckpointBuilder {
+    struct Files {
+        std::string mLedgerPath;
+        std::string mTransactionPath;
+        std::string mTransactionResultPath;
+        size_t mHeaders;
+    };
+
+    Application &mApp;
+    std::unique_ptr<TmpDir> mDir;
+
+    // checkpoint being written, 0 if none
+    uint32_t mCheckpoint;
+    uint32_t mLastLedger;
+    Files mFiles;
+    XDROutputFileStream mLedgerOut;
+    XDROutputFileStream mTransactionOut;
+    XDROutputFileStream mTransactionResultOut;
+
+    // complete checkpoints, snapshots take them from worker threads
+    std::mutex mCompleteMutex;
+    std::map<uint32_t, Files> mComplete;
+
+    void start(uint32_t checkpoint);
+
+    // drops the checkpoint being written
+    void discard();
+
+    static void remove(Files const &files);
+
+public:
+    explicit CheckpointBuilder(Application &app);
+
+    // appends the ledger that just closed, with the transaction set applied
+    // and its results in apply order
+    void appendLedger(LedgerHeaderHistoryEntry const &header,
+                      TxSetFrame &txSet, TransactionResultSet const &results);
+
+    // moves the files of the checkpoint ending at `checkpoint` to the given
+    // paths, false if it wasn't written; older checkpoints are dropped
+    bool takeCheckpoint(uint32_t checkpoint, std::string const &ledgerPath,
+                        std::string const &transactionPath,
+                        std::string const &transactionResultPath,
+                        size_t &nHeaders);
+};
+}
@@ -29,6 +29,8 @@ class BucketList;
 
 class Bucket;
 
+class HistoryArchiveBackend;
+
 struct HistoryStateBucket {
     std::string curr;
     FutureBucket next;
@@ -156,6 +158,11 @@ public:
 
     std::string mkdirCmd(std::string const &remoteDir) const;
 
+    // the in-process backend of the archive, nullptr if it only has commands;
+    // when it has one, it is used instead of the get command, and instead of
+    // the put and mkdir commands if it can put
+    std::shared_ptr<HistoryArchiveBackend> getBackend() const;
+
     void markSuccess();
 
     void markFailure();
@@ -164,6 +171,7 @@ public:
 
 private:
     HistoryArchiveConfiguration mConfig;
+    std::shared_ptr<HistoryArchiveBackend> mBackend;
     uint32_t mSuccess{0};
     uint32_t mFailure{0};
 };
@@ -0,0 +1,47 @@
+#pragma once
+
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include <memory>
+#include <string>
+
+namespace vixal {
+
+struct HistoryArchiveConfiguration;
+
+/**
+ * A HistoryArchiveBackend transfers history files within the process, instead
+ * of running the get / put / mkdir commands of the archive once per file.
+ *
+ * Two backends exist, selected in the [HISTORY.name] block of the config:
+ * `local` for an archive in a directory of the local filesystem, which is read
+ * and written, and `url` for an archive served over http://, which is only
+ * read and keeps its connections open from one file to the next. An archive
+ * with a `url` can still be written with a `put` command.
+ *
+ * Transfers block and are run on the application's transfer threads, so a
+ * backend must be safe to use from several threads at once. Http requests
+ * give up when the server makes no progress for a while.
+ */
+class HistoryArchiveBackend {
+public:
+    // the backend selected by `config`, nullptr if the archive only has
+    // commands; throws std::invalid_argument on a malformed url
+    static std::shared_ptr<HistoryArchiveBackend>
+    create(HistoryArchiveConfiguration const &config);
+
+    virtual ~HistoryArchiveBackend() {
+    }
+
+    virtual bool canPut() const = 0;
+
+    // the transfers return false on failure, after logging why
+    virtual bool getFile(std::string const &remote, std::string const &local) = 0;
+
+    virtual bool putFile(std::string const &local, std::string const &remote) = 0;
+
+    virtual bool makeDir(std::string const &remoteDir) = 0;
+};
+}
@@ -185,6 +185,8 @@ class HistoryArchive;
 
 struct StateSnapshot;
 
+class TxSetFrame;
+
 class HistoryManager {
 public:
     /// Status code returned from LedgerManager::verifyCatchupCandidate. Look there for additional documentation.
@@ -258,6 +260,24 @@ public:
     // returns 0 if the publish queue has nothing in it.
     virtual uint32_t getMaxLedgerQueuedToPublish() = 0;
 
+    // With HISTORY_STREAMING_PUBLISH, append the ledger that just closed to
+    // the files of the checkpoint it belongs to, so that publishing it doesn't
+    // read them back from the database. Does nothing otherwise.
+    virtual void
+    appendLedgerToCheckpoint(LedgerHeaderHistoryEntry const &header,
+                             TxSetFrame &txSet,
+                             TransactionResultSet const &results) = 0;
+
+    // Move the ledger, transaction and result files written by
+    // appendLedgerToCheckpoint for the checkpoint ending at `checkpoint` to
+    // the given paths. Returns false if they weren't written, in which case
+    // they must be read from the database. Can be called from any thread.
+    virtual bool takeCheckpointFiles(uint32_t checkpoint,
+                                     std::string const &ledgerPath,
+                                     std::string const &transactionPath,
+                                     std::string const &transactionResultPath,
+                                     size_t &nHeaders) = 0;
+
     // Publish any checkpoints queued (in the database) for publication.
     // Returns the number of publishes initiated.
     virtual size_t publishQueuedHistory() = 0;
@@ -18,6 +18,8 @@ class GetRemoteFileWork : public RunCommandWork {
 
     void getCommand(std::string &cmdLine, std::string &outFile) override;
 
+    std::function<bool()> getInProcessCommand() override;
+
 public:
     // Passing `nullptr` for the archive argument will cause the work to
     // select a new readable history archive at random each time it runs /
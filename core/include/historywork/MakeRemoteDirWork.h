@@ -16,6 +16,8 @@ class MakeRemoteDirWork : public RunCommandWork {
 
     void getCommand(std::string &cmdLine, std::string &outFile) override;
 
+    std::function<bool()> getInProcessCommand() override;
+
 public:
     MakeRemoteDirWork(Application &app, AbstractWork &parent,
                       std::string const &dir,
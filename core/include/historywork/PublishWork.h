@@ -26,6 +26,8 @@ public:
 
     std::string getStatus() const override;
 
+    ProcessClass getProcessClass() const override;
+
     void onReset() override;
 
     void onFailureRaise() override;
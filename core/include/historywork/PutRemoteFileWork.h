@@ -17,6 +17,8 @@ class PutRemoteFileWork : public RunCommandWork {
 
     void getCommand(std::string &cmdLine, std::string &outFile) override;
 
+    std::function<bool()> getInProcessCommand() override;
+
 public:
     PutRemoteFileWork(Application &app, AbstractWork &parent,
                       std::string const &remote, std::string const &local,
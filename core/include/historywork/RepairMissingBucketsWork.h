@@ -22,6 +22,8 @@ public:
 
     ~RepairMissingBucketsWork();
 
+    ProcessClass getProcessClass() const override;
+
     void onReset() override;
 
     void onFailureRaise() override;
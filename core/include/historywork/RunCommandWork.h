@@ -5,6 +5,7 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "work/Work.h"
+#include <functional>
 
 namespace vixal {
 
@@ -14,9 +15,16 @@ namespace vixal {
 // method; this way we only run a command _once_ (when it's first
 // scheduled) rather than repeatedly (racing with other copies of itself)
 // when rescheduled.
+//
+// Instead of a command, a subclass can return an action from
+// getInProcessCommand, called right after getCommand: it is then run on a
+// transfer thread (see Application::getTransferIOContext), and the work
+// fails if it returns false.
 class RunCommandWork : public Work {
     virtual void getCommand(std::string &cmdLine, std::string &outFile) = 0;
 
+    virtual std::function<bool()> getInProcessCommand();
+
 public:
     RunCommandWork(Application &app, AbstractWork &parent,
                    std::string const &uniqueName,
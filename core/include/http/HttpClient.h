@@ -1,3 +1,58 @@
+#pragma once
+
+// ASIO is somewhat particular about when it gets included -- it wants to be the
+// first to include <windows.h> -- so we try to include it before everything
+// else.
+#include "util/asio.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
 
 // synchronous request
 int http_request(const std::string& domain, const std::string& path, unsigned short port, std::string &ret);
+
+// Synchronous HTTP/1.1 GET requests to a single server, keeping connections
+// open between requests instead of connecting for each one. It can be used
+// from several threads at once: each request takes an idle connection, or
+// opens a new one, and gives it back once the response has been read, keeping
+// up to `maxIdle` of them. A request fails when resolving, connecting or any
+// read or write on the connection takes longer than `timeout`.
+class HttpKeepAliveClient {
+public:
+    HttpKeepAliveClient(std::string const &host, unsigned short port, size_t maxIdle,
+                        std::chrono::milliseconds timeout);
+
+    ~HttpKeepAliveClient();
+
+    // writes the body of the response to `filename`; returns the status code,
+    // or 1 if the request could not be made
+    int getToFile(std::string const &path, std::string const &filename);
+
+    size_t getConnectionsOpened() const;
+
+private:
+    // a socket with an io_context of its own, whose operations are run with
+    // a deadline
+    struct Connection;
+
+    std::unique_ptr<Connection> takeConnection(bool &reused);
+
+    void releaseConnection(std::unique_ptr<Connection> conn);
+
+    // `gotResponse` is set once the server answered anything, `keepAlive`
+    // when the connection can be used for another request
+    int get(Connection &conn, std::string const &path, std::string const &filename,
+            bool &gotResponse, bool &keepAlive);
+
+    std::string const mHost;
+    unsigned short const mPort;
+    size_t const mMaxIdle;
+    std::chrono::milliseconds const mTimeout;
+    std::mutex mMutex;
+    std::vector<std::unique_ptr<Connection>> mIdle;
+    std::atomic<size_t> mConnectionsOpened;
+};
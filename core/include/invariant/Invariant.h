@@ -37,6 +37,13 @@ public:
         return mStrict;
     }
 
+    // true if checkOnOperationApply only reads its arguments, so that it can
+    // check a snapshot of the delta on a worker thread
+    virtual bool
+    canCheckInBackground() const {
+        return false;
+    }
+
     virtual std::string
     checkOnBucketApply(std::shared_ptr<Bucket const> bucket,
                        uint32_t oldestLedger, uint32_t newestLedger) {
@@ -26,6 +26,12 @@ struct Operation;
  * When the appropriate event, such as a ledger close, triggers the
  * InvariantManager it will check each of the enabled invariants and
  * throw InvariantDoesNotHold if any are violated.
+ *
+ * With INVARIANT_CHECKS_ASYNC, the invariants checking only the changes made
+ * by an operation run on the worker threads, on a snapshot of these changes,
+ * so that operations are applied without waiting for them. Their failures are
+ * reported on the main thread, at the latest before the ledger
+ * INVARIANT_CHECKS_MAX_LAG ledgers after theirs is committed.
  */
 class InvariantManager {
 public:
@@ -41,9 +47,26 @@ public:
                                     uint32_t ledger, uint32_t level,
                                     bool isCurr) = 0;
 
+    // checks the changes `delta` made by `operation`, the operation at
+    // `opIndex` in the transaction `txHash`; with INVARIANT_CHECKS_ASYNC the
+    // invariants that can are checked later on a snapshot of `delta`
     virtual void checkOnOperationApply(Operation const &operation,
                                        OperationResult const &opres,
-                                       LedgerDelta const &delta) = 0;
+                                       LedgerDelta const &delta,
+                                       Hash const &txHash,
+                                       size_t opIndex) = 0;
+
+    void
+    checkOnOperationApply(Operation const &operation,
+                          OperationResult const &opres,
+                          LedgerDelta const &delta) {
+        checkOnOperationApply(operation, opres, delta, Hash{}, 0);
+    }
+
+    // called before `ledger` is committed: waits for the background checks
+    // of the ledgers more than INVARIANT_CHECKS_MAX_LAG before it and
+    // reports the failures found so far
+    virtual void checkOnLedgerCommit(uint32_t ledger) = 0;
 
     virtual void registerInvariant(std::shared_ptr<Invariant> invariant) = 0;
 
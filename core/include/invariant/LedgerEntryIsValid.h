@@ -28,6 +28,8 @@ public:
 
     std::string getName() const override;
 
+    bool canCheckInBackground() const override;
+
     std::string
     checkOnOperationApply(Operation const &operation,
                           OperationResult const &result,
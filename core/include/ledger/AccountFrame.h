@@ -149,6 +149,12 @@ public:
 
     static AccountFrame::pointer loadAccount(AccountID const &accountID, Database &db);
 
+    // loads the accounts `actIDStrKeys` with one query on `sess`, which may
+    // be a session from the pool, bypassing the entry cache
+    static void loadAccounts(soci::session &sess,
+                             std::vector<std::string> const &actIDStrKeys,
+                             LedgerEntryProcessor accountProcessor);
+
     // compare signers, ignores weight
     static bool signerCompare(Signer const &s1, Signer const &s2);
 
@@ -82,6 +82,12 @@ public:
     static pointer loadData(AccountID const &accountID, std::string dataName,
                             Database &db);
 
+    // loads the data entries of the accounts `actIDStrKeys` with one query on
+    // `sess`, which may be a session from the pool
+    static void loadData(soci::session &sess,
+                         std::vector<std::string> const &actIDStrKeys,
+                         LedgerEntryProcessor dataProcessor);
+
     // load all data entries from the database (very slow)
     static std::unordered_map<AccountID, std::vector<DataFrame::pointer>>
     loadAllData(Database &db);
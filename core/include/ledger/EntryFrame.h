@@ -31,6 +31,12 @@ protected:
         mKeyCalculated = false;
     }
 
+    // if an overlay is current on the calling thread, stores the entry in it
+    // instead of the database, records it in `delta` and returns true
+    bool storeInOverlay(LedgerDelta &delta, bool insert);
+
+    static bool storeDeleteInOverlay(LedgerDelta &delta, LedgerKey const &key);
+
 public:
     typedef std::shared_ptr<EntryFrame> pointer;
 
@@ -0,0 +1,132 @@
+#pragma once
+
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "bucket/LedgerCmp.h"
+#include "util/noncopyable.h"
+#include "xdr/ledger.h"
+
+#include <exception>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace soci {
+class transaction;
+}
+
+/**
+ * EntryOverlay holds, in memory, the ledger entries a cluster of transactions
+ * may use, so that the cluster can be applied on any thread, without the
+ * session of the database.
+ *
+ * An overlay is made current on a thread by a Scope. While it is, the entry
+ * frames load accounts, trust lines and data from it and store them in it,
+ * instead of using the database and its entry cache. Anything else needing
+ * the session, such as an entry that isn't in the overlay or one that is only
+ * readable being stored, throws Miss: the overlay is then missed and the
+ * cluster must be applied again without it.
+ *
+ * Once the cluster is applied, the entries it changed are written in the
+ * session of the database by write(), on the main thread.
+ */
+
+namespace vixal {
+
+class Database;
+
+class LedgerDelta;
+
+class EntryOverlay : public nonmovableorcopyable {
+public:
+    class Miss : public std::exception {
+    public:
+        char const *what() const noexcept override;
+    };
+
+    // makes `overlay` current on the calling thread until destroyed
+    class Scope : public nonmovableorcopyable {
+        EntryOverlay *const mPrevious;
+
+    public:
+        explicit Scope(EntryOverlay &overlay);
+
+        ~Scope();
+    };
+
+    EntryOverlay() = default;
+
+    // the overlay current on the calling thread, nullptr if there is none
+    static EntryOverlay *current();
+
+    // throws Miss if an overlay is current on the calling thread, for
+    // anything that needs the database
+    static void requireDatabase();
+
+    // adds the entry `key` with its value before the cluster is applied,
+    // nullptr if it doesn't exist; only `writable` entries can be stored
+    void add(LedgerKey const &key, std::shared_ptr<LedgerEntry const> entry,
+             bool writable);
+
+    // the entry `key`, nullptr if it doesn't exist
+    std::shared_ptr<LedgerEntry const> load(LedgerKey const &key);
+
+    // stores `entry`, which must exist already unless `insert`
+    void store(LedgerEntry const &entry, bool insert);
+
+    void storeDelete(LedgerKey const &key);
+
+    // changes made after begin() are kept by commit() and dropped by
+    // rollback(), these can be nested like the transactions of a session
+    void begin();
+
+    void commit();
+
+    void rollback();
+
+    bool isMissed() const;
+
+    // writes the entries changed since they were added in the session of
+    // `db`; the changes themselves are recorded in the deltas the cluster
+    // was applied to, `outer` only serves the entry frames to write them
+    void write(LedgerDelta &outer, Database &db) const;
+
+private:
+    typedef std::map<LedgerKey, std::shared_ptr<LedgerEntry const>,
+                     LedgerEntryIdCmp>
+            Changes;
+
+    struct Entry {
+        std::shared_ptr<LedgerEntry const> mOriginal;
+        std::shared_ptr<LedgerEntry const> mCurrent;
+        bool mWritable{false};
+    };
+
+    std::map<LedgerKey, Entry, LedgerEntryIdCmp> mEntries;
+    std::vector<Changes> mSavepoints;
+    bool mMissed{false};
+
+    [[noreturn]] void miss();
+
+    void set(LedgerKey const &key, std::shared_ptr<LedgerEntry const> entry);
+};
+
+// changes to ledger entries that are rolled back unless committed: a
+// transaction of the session of the database or, if there is one, of the
+// current overlay
+class EntryTransaction : public nonmovableorcopyable {
+    std::unique_ptr<soci::transaction> mSqlTx;
+    EntryOverlay *mOverlay;
+
+public:
+    explicit EntryTransaction(Database &db);
+
+    ~EntryTransaction();
+
+    void commit();
+
+    void rollback();
+};
+}
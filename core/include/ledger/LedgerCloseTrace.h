@@ -0,0 +1,113 @@
+#pragma once
+
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "xdr/transaction.h"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace Json {
+class Value;
+}
+
+/**
+ * LedgerCloseTrace breaks down the time spent closing each ledger: the time of
+ * each phase of closeLedger, and the time spent applying each type of
+ * operation, for the last CAPACITY ledgers closed.
+ *
+ * Ledgers are kept in a ring of fixed size, one column per measure, so that
+ * tracing allocates nothing once the trace is built and costs a couple of
+ * clock reads per phase and per operation: it is always on. The columns are
+ * returned as is by the /closetrace endpoint.
+ */
+
+namespace vixal {
+
+class LedgerCloseTrace {
+public:
+    enum Phase {
+        PHASE_PREFETCH,
+        PHASE_FEES,
+        PHASE_APPLY,
+        PHASE_HISTORY,
+        PHASE_UPGRADES,
+        PHASE_INVARIANTS,
+        PHASE_BUCKETS,
+        PHASE_STORE,
+        PHASE_CHECKPOINT,
+        PHASE_COMMIT,
+        PHASE_PUBLISH,
+        PHASE_COUNT
+    };
+
+    static size_t const CAPACITY;
+
+    // adds the time from its construction to its destruction to a phase of
+    // the ledger being closed, if any
+    class Span {
+        LedgerCloseTrace &mTrace;
+        Phase const mPhase;
+        std::chrono::steady_clock::time_point const mStart;
+
+    public:
+        Span(LedgerCloseTrace &trace, Phase phase);
+
+        ~Span();
+    };
+
+    LedgerCloseTrace();
+
+    void beginLedger(uint32_t ledgerSeq);
+
+    void addPhase(Phase phase, std::chrono::nanoseconds duration);
+
+    // ignored outside of beginLedger / endLedger; can be called from the
+    // threads applying clusters of transactions, the times of operations
+    // applied in parallel adding up
+    void addOperation(OperationType type, std::chrono::nanoseconds duration);
+
+    // adds the ledger being closed to the trace
+    void endLedger(size_t txCount);
+
+    // number of ledgers in the trace
+    size_t size() const;
+
+    // number of ledgers added to the trace since it was built, the last
+    // min(CAPACITY, n) of them being still in it
+    uint64_t getLedgersClosed() const;
+
+    // the last `limit` ledgers, oldest first, as one array per measure,
+    // durations in microseconds
+    Json::Value getJsonInfo(size_t limit) const;
+
+    static char const *getPhaseName(Phase phase);
+
+private:
+    // columns, indexed by position in the ring
+    std::vector<uint32_t> mLedgerSeqs;
+    std::vector<uint32_t> mTxCounts;
+    std::vector<uint32_t> mOpCounts;
+    std::vector<uint64_t> mTotals;
+    std::array<std::vector<uint64_t>, PHASE_COUNT> mPhases;
+    // by operation type, then position in the ring
+    std::vector<std::vector<uint64_t>> mOpTypeTimes;
+    std::vector<std::vector<uint32_t>> mOpTypeCounts;
+    size_t mNext;
+    size_t mSize;
+    uint64_t mLedgersClosed;
+
+    // the ledger being closed
+    bool mActive;
+    std::chrono::steady_clock::time_point mStart;
+    uint32_t mLedgerSeq;
+    std::array<std::chrono::nanoseconds, PHASE_COUNT> mCurrentPhases;
+    std::mutex mCurrentOpTypesMutex;
+    std::vector<std::chrono::nanoseconds> mCurrentOpTypeTimes;
+    std::vector<uint32_t> mCurrentOpTypeCounts;
+};
+}
@@ -54,6 +54,9 @@ class LedgerDelta {
     void addCurrentMeta(LedgerEntryChanges &changes,
                         LedgerKey const &key) const;
 
+    // copy of `other` and of its entries, see snapshot()
+    LedgerDelta(LedgerDelta const &other, bool);
+
 public:
     // keeps an internal reference to the outerDelta,
     // will apply changes to the outer scope on commit
@@ -104,6 +107,11 @@ public:
 
     LedgerEntryChanges getChanges() const;
 
+    // copy of the changes and of the entries they hold, attached to no outer
+    // delta nor header: it can't be modified or committed, and as it shares
+    // nothing with this delta it can be read from another thread
+    std::shared_ptr<LedgerDelta const> snapshot() const;
+
     template<typename IterType, typename ValueType>
     class Iterator : public std::iterator<std::input_iterator_tag, ValueType> {
         LedgerDelta const &mDelta;
@@ -6,7 +6,9 @@
 
 #include "catchup/CatchupManager.h"
 #include "history/HistoryManager.h"
+#include "ledger/LedgerCloseTrace.h"
 #include <memory>
+#include <unordered_set>
 
 namespace vixal {
 
@@ -119,6 +121,11 @@ public:
     // Return the sequence number of the LCL.
     virtual uint32_t getLastClosedLedgerNum() const = 0;
 
+    // Return the accounts whose entry was created, modified or deleted when
+    // closing the LCL.
+    virtual std::unordered_set<AccountID> const &
+    getLastClosedLedgerAccounts() const = 0;
+
     // Return the minimum balance required to establish, in the current ledger,
     // a new ledger entry with `ownerCount` owned objects.  Derived from the
     // current ledger's `baseReserve` value.
@@ -197,6 +204,9 @@ public:
     // checks the database for inconsistencies between objects
     virtual void checkDbState() = 0;
 
+    // time spent closing the last ledgers, by phase and type of operation
+    virtual LedgerCloseTrace &getCloseTrace() = 0;
+
     virtual ~LedgerManager() {
     }
 };
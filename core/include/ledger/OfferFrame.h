@@ -113,6 +113,12 @@ public:
                                std::vector<OfferFrame::pointer> &retOffers,
                                Database &db);
 
+    // loads the offers `offerIDs` with one query on `sess`, which may be a
+    // session from the pool
+    static void loadOffers(soci::session &sess,
+                           std::vector<uint64_t> const &offerIDs,
+                           LedgerEntryProcessor offerProcessor);
+
     // load all offers from the database (very slow)
     static std::unordered_map<AccountID, std::vector<OfferFrame::pointer>>
     loadAllOffers(Database &db);
@@ -92,6 +92,12 @@ public:
                           std::vector<TrustFrame::pointer> &retLines,
                           Database &db);
 
+    // loads the trust lines of the accounts `actIDStrKeys` with one query on
+    // `sess`, which may be a session from the pool
+    static void loadLines(soci::session &sess,
+                          std::vector<std::string> const &actIDStrKeys,
+                          LedgerEntryProcessor trustProcessor);
+
     // loads ALL trust lines from the database (very slow!)
     static std::unordered_map<AccountID, std::vector<TrustFrame::pointer>>
     loadAllLines(Database &db);
@@ -4,9 +4,12 @@
 // under the Apache License, Version 2.0. See the COPYING file at the root
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
+#include "crypto/HashOfHash.h"
 #include "overlay/Peer.h"
 #include "xdr/xdr.h"
 #include <map>
+#include <unordered_map>
+#include <vector>
 
 /**
  * FloodGate keeps track of which peers have sent us which broadcast messages, in order to ensure that for each
@@ -17,6 +20,11 @@
  *
  * All messages are marked with the ledger sequence number to which they relate, and all flood-management information
  * for a given ledger number is purged from the FloodGate when the ledger closes.
+ *
+ * To keep the store small under heavy load, a record holds neither the message nor references to peers: it is only
+ * the message hash and a bitmap of peer slots. Each peer is given a slot the first time the FloodGate sees it; the
+ * slot is recycled only once every record that could still mention the departed peer has expired. Records are grouped
+ * in one generation per ledger, so expiring a ledger drops its whole generation at once.
  */
 
 namespace medida {
@@ -26,24 +34,57 @@ class Counter;
 namespace vixal {
 
 class Floodgate {
-    class FloodRecord {
+    // set of peer slots, the first 64 slots are stored inline
+    class PeerBitmap {
+        uint64_t mInline{0};
+        std::vector<uint64_t> mOverflow;
+
     public:
-        typedef std::shared_ptr<FloodRecord> pointer;
+        bool test(size_t slot) const;
 
-        uint32_t mLedgerSeq;
-        VixalMessage mMessage;
-        std::set<Peer::pointer> mPeersTold;
+        void set(size_t slot);
 
-        FloodRecord(VixalMessage const &msg, uint32_t ledger,
-                    Peer::pointer peer);
+        void clear();
+
+        // number of slots that could be set
+        size_t capacity() const;
     };
 
-    std::map<uint256, FloodRecord::pointer> mFloodMap;
+    struct PeerSlot {
+        std::weak_ptr<Peer> mPeer;
+        // ledger at which the peer was found gone, 0 while the slot is in use
+        uint32_t mRetiredAt{0};
+    };
+
+    typedef std::unordered_map<uint256, PeerBitmap> Generation;
+
+    // generations of flood records, keyed by the ledger they were created at
+    std::map<uint32_t, Generation> mGenerations;
+    size_t mRecordCount;
+
+    std::vector<PeerSlot> mPeerSlots;
+    std::unordered_map<Peer *, size_t> mSlotByPeer;
+    std::vector<size_t> mRetiredSlots;
+    std::vector<size_t> mFreeSlots;
+
     Application &mApp;
     medida::Counter &mFloodMapSize;
+    medida::Counter &mPeerSlotsSize;
     medida::Meter &mSendFromBroadcast;
     bool mShuttingDown;
 
+    PeerBitmap *findRecord(Hash const &h);
+
+    // returns the record for `h`, creating it in the current generation if
+    // needed; `isNew` is set when the record was created
+    PeerBitmap &getOrCreateRecord(Hash const &h, bool &isNew);
+
+    size_t getPeerSlot(Peer::pointer const &peer);
+
+    void retireSlot(size_t slot);
+
+    void recycleSlots();
+
 public:
     Floodgate(Application &app);
 
@@ -53,7 +94,9 @@ public:
     // returns true if this is a new record
     bool addRecord(VixalMessage const &msg, Peer::pointer fromPeer);
 
-    void broadcast(VixalMessage const &msg, bool force);
+    // returns the number of peers the message was sent to; with `force`, it
+    // is sent again to every peer, even those that sent it or were told
+    size_t broadcast(VixalMessage const &msg, bool force);
 
     // returns the list of peers that sent us the item with hash `h`
     std::set<Peer::pointer> getPeersKnows(Hash const &h);
@@ -46,6 +46,8 @@ class PeerAuth;
 
 class PeerBareAddress;
 
+class PeerManager;
+
 class PeerRecord;
 
 class LoadManager;
@@ -63,7 +65,9 @@ public:
     virtual void ledgerClosed(uint32_t lastClosedLedgerSeq) = 0;
 
     // Send a given message to all peers, via the FloodGate. This is called by Herder.
-    virtual void broadcastMessage(VixalMessage const &msg, bool force) = 0;
+    // Returns the number of peers the message was sent to, peers known to have it
+    // already are skipped unless `force` is set.
+    virtual size_t broadcastMessage(VixalMessage const &msg, bool force) = 0;
 
     // Make a note in the FloodGate that a given peer has provided us with a
     // given broadcast message, so that it is inhibited from being resent to
@@ -71,6 +75,16 @@ public:
     // that, call broadcastMessage, above.
     virtual void recvFloodedMsg(VixalMessage const &msg, Peer::pointer peer) = 0;
 
+    // Receive a TRANSACTION message from a peer. Decoding and signature
+    // verification happen on a worker thread; the transaction is then given to
+    // the Herder, and flooded if new, on the main thread in arrival order.
+    virtual void recvTransaction(VixalMessage const &msg, Peer::pointer peer) = 0;
+
+    // Receive a SCP_MESSAGE from a peer. Signatures are verified in batches on a
+    // worker thread; envelopes with a valid signature are then recorded in the
+    // FloodGate and given to the Herder on the main thread in arrival order.
+    virtual void recvSCPMessage(VixalMessage const &msg, Peer::pointer peer) = 0;
+
     // Return a list of random peers from the set of authenticated peers.
     virtual std::vector<Peer::pointer> getRandomAuthenticatedPeers() = 0;
 
@@ -117,7 +131,7 @@ public:
     virtual void connectTo(PeerBareAddress const& address) = 0;
 
     // Attempt to connect to a peer identified by peer record. Can modify back
-    // off value of pr and save it do database.
+    // off value of pr and save it to the PeerManager.
     virtual void connectTo(PeerRecord &pr) = 0;
 
     // returns the list of peers that sent us the item with hash `h`
@@ -129,6 +143,9 @@ public:
     // Return the persistent peer-load-accounting cache.
     virtual LoadManager &getLoadManager() = 0;
 
+    // Return the in-memory table of known peers.
+    virtual PeerManager &getPeerManager() = 0;
+
     // start up all background tasks for overlay
     virtual void start() = 0;
 
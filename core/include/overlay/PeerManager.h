@@ -0,0 +1,82 @@
+#pragma once
+
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "overlay/PeerRecord.h"
+#include "util/Timer.h"
+#include "util/optional.hpp"
+#include <functional>
+#include <set>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+
+/**
+ * PeerManager keeps the peers table in memory.
+ *
+ * The table is read from the database the first time it is needed; after that lookups, updates and candidate
+ * selection are served from memory and changed records are written back in a single transaction whenever flush()
+ * is called (the OverlayManager does it on every tick and on shutdown).
+ *
+ * Records are indexed by (nextAttempt, numFailures), which is the order in which the OverlayManager wants to try
+ * connecting to them.
+ */
+
+namespace medida {
+class Counter;
+
+class Timer;
+}
+
+namespace vixal {
+
+class Application;
+
+class PeerManager {
+    typedef std::tuple<VirtualClock::time_point, uint32, std::string> IndexKey;
+
+    Application &mApp;
+    bool mLoaded;
+
+    // known peers, keyed by address
+    std::unordered_map<std::string, PeerRecord> mPeers;
+    // same peers, ordered by next attempt then number of failures
+    std::set<IndexKey> mByNextAttempt;
+    // addresses of the records changed since the last flush
+    std::set<std::string> mDirty;
+
+    medida::Counter &mPeersSize;
+    medida::Timer &mFlushTimer;
+
+    void ensureLoaded();
+
+    static IndexKey indexKey(PeerRecord const &pr);
+
+    void put(PeerRecord const &pr);
+
+public:
+    explicit PeerManager(Application &app);
+
+    // Return the record for `address`, nullopt if it is not known.
+    nonstd::optional<PeerRecord> load(PeerBareAddress const &address);
+
+    // Add `pr` if its address is not known yet, returns true if it was added.
+    bool insertIfNew(PeerRecord const &pr);
+
+    // Add or replace the record for the address of `pr`.
+    void store(PeerRecord const &pr);
+
+    // Call `pred` on the records with nextAttempt <= `nextAttemptCutoff`, in
+    // (nextAttempt, numFailures) order; `pred` returns false to stop and must
+    // not modify the PeerManager.
+    void loadPeerRecords(VirtualClock::time_point nextAttemptCutoff,
+                         std::function<bool(PeerRecord const &pr)> pred);
+
+    // Write the records changed since the last flush to the database.
+    void flush();
+
+    size_t size();
+};
+}
@@ -10,6 +10,7 @@
 #include "util/Timer.h"
 #include "util/optional.hpp"
 #include <string>
+#include <vector>
 #include <xdr/overlay.h>
 
 namespace vixal {
@@ -49,10 +50,9 @@ public:
     static optional<PeerRecord> loadPeerRecord(Database& db,
                                                PeerBareAddress const& address);
 
-    // pred returns false if we should stop processing entries
-    static void loadPeerRecords(Database &db, int batchSize,
-                                VirtualClock::time_point nextAttemptCutoff,
-                                std::function<bool(PeerRecord const &pr)> pred);
+    // Load every record of the peers table.
+    static void loadAllPeerRecords(Database &db,
+                                   std::function<void(PeerRecord const &pr)> f);
 
 
     PeerBareAddress const&
@@ -73,7 +73,13 @@ public:
     /**
      * insert or update record from database
      */
-    void storePeerRecord(Database &db);
+    void storePeerRecord(Database &db) const;
+
+    /**
+     * insert or update all the records in a single transaction
+     */
+    static void storePeerRecords(Database &db,
+                                 std::vector<PeerRecord> const &records);
 
     void resetBackOff(VirtualClock &clock);
 
@@ -0,0 +1,83 @@
+#pragma once
+
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "overlay/Peer.h"
+#include "xdr/xdr.h"
+#include <map>
+#include <memory>
+#include <vector>
+
+/**
+ * SCPIngestQueue moves the signature verification of flooded SCP envelopes off the main thread.
+ *
+ * SCP_MESSAGE envelopes received from peers are collected into a batch until the main thread is done with what it
+ * is currently processing (or the batch is full), and the batch is handed to a worker thread, which verifies all the
+ * signatures at once, populating the signature-verification cache. The batch is then posted back to the main thread:
+ * envelopes with a bad signature are dropped, the others are recorded in the FloodGate and given to the Herder, whose
+ * own check of the signature is then a cache hit.
+ *
+ * As with TxIngestQueue, batches are handed to the Herder in the order they were received, regardless of the order
+ * in which workers complete.
+ */
+
+namespace medida {
+class Counter;
+
+class Meter;
+
+class Timer;
+}
+
+namespace vixal {
+
+class SCPIngestQueue : public std::enable_shared_from_this<SCPIngestQueue> {
+    struct Item {
+        VixalMessage mMessage;
+        std::weak_ptr<Peer> mPeer;
+        bool mValid{false};
+    };
+
+    typedef std::vector<std::shared_ptr<Item>> Batch;
+
+    static size_t const MAX_BATCH_SIZE;
+
+    Application &mApp;
+
+    // envelopes received since the last batch was handed to a worker
+    Batch mBatch;
+    // ticket given to the next batch
+    uint64_t mNextTicket;
+    // ticket of the next batch to hand to the Herder
+    uint64_t mNextDelivery;
+    // batches verified by workers, waiting for earlier tickets
+    std::map<uint64_t, Batch> mVerified;
+    // envelopes received but not yet handed to the Herder
+    size_t mSize;
+
+    medida::Counter &mQueueSize;
+    medida::Timer &mVerifyTimer;
+    medida::Meter &mInvalidSig;
+    bool mShuttingDown;
+
+    // hands the current batch to a worker
+    void flush();
+
+    void verified(uint64_t ticket, Batch batch);
+
+    void deliver(Item const &item);
+
+public:
+    explicit SCPIngestQueue(Application &app);
+
+    // queue a SCP_MESSAGE received from `peer`
+    void enqueue(VixalMessage const &msg, Peer::pointer peer);
+
+    // number of envelopes received but not yet handed to the Herder
+    size_t size() const;
+
+    void shutdown();
+};
+}
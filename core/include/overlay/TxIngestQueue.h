@@ -0,0 +1,69 @@
+#pragma once
+
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "overlay/Peer.h"
+#include "transactions/TransactionFrame.h"
+#include "xdr/xdr.h"
+#include <map>
+#include <memory>
+
+/**
+ * TxIngestQueue moves the CPU-heavy part of receiving a flooded transaction off the main thread.
+ *
+ * Every TRANSACTION message received from a peer is handed to a worker thread, which builds the TransactionFrame,
+ * computes its hashes and verifies the signatures that can be checked without loading any account (those made by
+ * the transaction and operation source accounts), populating the signature-verification cache. The pre-validated
+ * frame is then posted back to the main thread, where the Herder only has sequence number, balance and remaining
+ * signer checks left to do.
+ *
+ * Transactions are handed to the Herder in the order they were received, regardless of the order in which workers
+ * complete, so that chains of sequence numbers coming from the network are not reordered.
+ */
+
+namespace medida {
+class Counter;
+
+class Timer;
+}
+
+namespace vixal {
+
+class TxIngestQueue : public std::enable_shared_from_this<TxIngestQueue> {
+    struct Item {
+        VixalMessage mMessage;
+        std::weak_ptr<Peer> mPeer;
+        TransactionFramePtr mTransaction;
+    };
+
+    Application &mApp;
+
+    // ticket given to the next received transaction
+    uint64_t mNextTicket;
+    // ticket of the next transaction to hand to the Herder
+    uint64_t mNextDelivery;
+    // transactions verified by workers, waiting for earlier tickets
+    std::map<uint64_t, std::shared_ptr<Item>> mVerified;
+
+    medida::Counter &mQueueSize;
+    medida::Timer &mPreverifyTimer;
+    bool mShuttingDown;
+
+    void verified(uint64_t ticket, std::shared_ptr<Item> item);
+
+    void deliver(Item const &item);
+
+public:
+    explicit TxIngestQueue(Application &app);
+
+    // queue a TRANSACTION message received from `peer`
+    void enqueue(VixalMessage const &msg, Peer::pointer peer);
+
+    // number of transactions received but not yet handed to the Herder
+    size_t size() const;
+
+    void shutdown();
+};
+}
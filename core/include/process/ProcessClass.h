@@ -0,0 +1,19 @@
+#pragma once
+
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+namespace vixal {
+
+// Classes of the commands run by the ProcessManager, highest priority first:
+// when a process slot frees up it goes to the highest class with commands
+// waiting, so a large catchup download doesn't hold up publishing.
+enum ProcessClass {
+    PROCESS_PUBLISH = 0,
+    PROCESS_CATCHUP,
+    PROCESS_REPAIR,
+    PROCESS_OTHER,
+    PROCESS_CLASS_COUNT
+};
+}
@@ -5,6 +5,7 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "util/asio.h"
+#include "process/ProcessClass.h"
 #include "util/noncopyable.h"
 #include <application/Application.h>
 #include <functional>
@@ -23,6 +24,12 @@ class RealTimer;
  * No facilities exist for reading or writing to the subprocess I/O ports. This
  * is strictly for "run a command, wait to see if it worked"; a glorified
  * asynchronous version of system().
+ *
+ * At most MAX_CONCURRENT_SUBPROCESSES run at once, the others wait in a queue
+ * per ProcessClass. Besides going first, a class can't take the slots of the
+ * classes above it: together with the classes below it, each class leaves one
+ * slot free per class of higher priority. The time commands spend queued is reported per class in the
+ * process.wait.<class> timers.
  */
 
 // Wrap a platform-specific Impl strategy that monitors process-exits in a
@@ -53,7 +60,8 @@ public:
     static std::shared_ptr<ProcessManager> create(Application &app);
 
     virtual ProcessExitEvent runProcess(std::string const &cmdLine,
-                                        std::string outputFile) = 0;
+                                        std::string outputFile,
+                                        ProcessClass processClass = PROCESS_OTHER) = 0;
 
     virtual size_t getNumRunningProcesses() = 0;
 
@@ -6,6 +6,7 @@
 
 
 #include <functional>
+#include <map>
 #include <memory>
 #include <set>
 #include <string>
@@ -58,6 +59,26 @@ class BallotProtocol {
     std::shared_ptr<SCPEnvelope>
             mLastEnvelopeEmit; // last envelope emitted by this node
 
+    // counter -> number of statements in M mentioning it
+    using CounterCounts = std::map<uint32, uint32>;
+
+    // what the statements in M say about a value, kept up to date as
+    // statements are recorded so that candidates don't need a scan of M
+    struct ValueIndex {
+        // counters of b, p and p' of PREPARE statements
+        CounterCounts mPrepareBallots;
+        // nPrepared of CONFIRM statements
+        CounterCounts mConfirmPrepared;
+        // number of CONFIRM and EXTERNALIZE statements
+        uint32 mCommitting{0};
+        // commit boundaries, as in getCommitBoundariesFromStatements
+        CounterCounts mCommitBoundaries;
+    };
+
+    std::map<Value, ValueIndex> mValueIndex;
+    // ballot counters of all the statements in M, UINT32_MAX for EXTERNALIZE
+    CounterCounts mBallotCounters;
+
 public:
     explicit BallotProtocol(Slot &slot);
 
@@ -177,12 +198,16 @@ private:
     // predicate.
     // updates 'candidate' (or leave it unchanged)
     static void findExtendedInterval(Interval &candidate,
-                                     std::set<uint32> const &boundaries,
+                                     CounterCounts const &boundaries,
                                      std::function<bool(Interval const &)> pred);
 
-    // constructs the set of counters representing the
+    // the set of counters representing the
     // commit ballots compatible with the ballot
-    std::set<uint32> getCommitBoundariesFromStatements(SCPBallot const &ballot);
+    CounterCounts const &
+    getCommitBoundariesFromStatements(SCPBallot const &ballot) const;
+
+    // adds (or removes) what `st` says to the statement indexes
+    void indexStatement(SCPStatement const &st, bool add);
 
     // ** helper predicates that evaluate if a statement satisfies
     // a certain property
@@ -0,0 +1,104 @@
+#pragma once
+
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "crypto/SecretKey.h"
+#include "xdr/scp.h"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Quorum sets in a form suited to evaluating them many times.
+ *
+ * Nodes are interned by a NodeIndex to dense indices, so that a set of nodes is a bitset. A CompiledQuorumSet
+ * flattens the nested quorum set into a vector of levels, each holding its threshold, the bitset of its validators
+ * and the range of its inner sets; a slice or v-blocking check is then a popcount per level instead of a search of
+ * the node set for every validator.
+ */
+
+namespace vixal {
+
+// set of nodes, as indices given by a NodeIndex
+class NodeBitSet {
+    std::vector<uint64_t> mBits;
+
+public:
+    static size_t const npos = SIZE_MAX;
+
+    void set(size_t i);
+
+    void unset(size_t i);
+
+    bool test(size_t i) const;
+
+    bool empty() const;
+
+    size_t count() const;
+
+    // number of nodes in both sets
+    size_t countCommon(NodeBitSet const &other) const;
+
+    bool isSubsetOf(NodeBitSet const &other) const;
+
+    // first node at or after `i`, npos if there is none
+    size_t next(size_t i) const;
+
+    NodeBitSet &operator|=(NodeBitSet const &other);
+
+    NodeBitSet &operator&=(NodeBitSet const &other);
+
+    // removes the nodes of `other`
+    NodeBitSet &operator-=(NodeBitSet const &other);
+
+    bool operator==(NodeBitSet const &other) const;
+};
+
+// assigns dense indices to nodes, in the order they are first seen
+class NodeIndex {
+    std::unordered_map<NodeID, size_t> mIndices;
+    std::vector<NodeID> mNodes;
+
+public:
+    size_t intern(NodeID const &node);
+
+    NodeID const &getNode(size_t i) const;
+
+    size_t size() const;
+};
+
+class CompiledQuorumSet {
+    struct Level {
+        uint32 mThreshold;
+        // number of entries: validators and inner sets
+        size_t mSize;
+        NodeBitSet mValidators;
+        // validators listed more than once count once per occurrence
+        std::vector<size_t> mDuplicates;
+        // inner sets are the levels [mFirstInner, mFirstInner + mInnerCount)
+        size_t mFirstInner;
+        size_t mInnerCount;
+    };
+
+    // levels in breadth first order, so inner sets come after their parent
+    std::vector<Level> mLevels;
+    // smallest number of nodes that can make a slice
+    size_t mMinSliceSize;
+
+    size_t countIn(Level const &level, NodeBitSet const &nodes) const;
+
+public:
+    CompiledQuorumSet(SCPQuorumSet const &qSet, NodeIndex &index);
+
+    // true if `nodes` contains a slice of this quorum set
+    bool isQuorumSlice(NodeBitSet const &nodes) const;
+
+    // true if `nodes` intersects every slice of this quorum set
+    bool isVBlocking(NodeBitSet const &nodes) const;
+
+    // lower bound of the size of a slice, SIZE_MAX if there is no slice
+    size_t getMinSliceSize() const;
+};
+}
@@ -8,7 +8,9 @@
 #include <set>
 #include <vector>
 
+#include "scp/CompiledQuorumSet.h"
 #include "scp/SCP.h"
+#include "util/lrucache.hpp"
 #include <xdr/types.h>
 
 namespace vixal {
@@ -28,6 +30,17 @@ protected:
 
     SCP *mSCP;
 
+    // nodes seen by quorum evaluations, and the compiled form of mQSet
+    NodeIndex mNodeIndex;
+    std::unique_ptr<CompiledQuorumSet> mCompiledQSet;
+
+    // compiled quorum sets of other nodes, keyed by address; entries keep
+    // the quorum set alive so that its address cannot be reused
+    typedef std::pair<SCPQuorumSetPtr, std::shared_ptr<CompiledQuorumSet>> CompiledQSetEntry;
+    cache::lru_cache<SCPQuorumSet const *, CompiledQSetEntry> mCompiledQSets;
+
+    std::shared_ptr<CompiledQuorumSet> getCompiledQuorumSet(SCPQuorumSetPtr const &qSet);
+
 public:
     LocalNode(NodeID const& nodeID, bool isValidator, SCPQuorumSet const& qSet, SCP *scp);
 
@@ -60,20 +73,20 @@ public:
 
     static bool isVBlocking(SCPQuorumSet const &qSet, std::vector<NodeID> const &nodeSet);
 
-    // Tests this node against a map of nodeID -> T for the specified qSetHash.
+    // Tests this node against a map of nodeID -> T for the local quorum set.
 
     // `isVBlocking` tests if the filtered nodes V are a v-blocking set for this node.
-    static bool
-    isVBlocking(SCPQuorumSet const &qSet, std::map<NodeID, SCPEnvelope> const &map,
+    bool
+    isVBlocking(std::map<NodeID, SCPEnvelope> const &map,
                 std::function<bool(SCPStatement const &)> const &filter = [](SCPStatement const &) { return true; });
 
     // `isQuorum` tests if the filtered nodes V form a quorum
     // (meaning for each v \in V there is q \in Q(v)
-    // included in V and we have quorum on V for qSetHash). `qfun` extracts the
-    // SCPQuorumSetPtr from the SCPStatement for its associated node in map
-    // (required for transitivity)
-    static bool
-    isQuorum(SCPQuorumSet const &qSet, std::map<NodeID, SCPEnvelope> const &map,
+    // included in V and we have quorum on V for the local quorum set). `qfun`
+    // extracts the SCPQuorumSetPtr from the SCPStatement for its associated
+    // node in map (required for transitivity)
+    bool
+    isQuorum(std::map<NodeID, SCPEnvelope> const &map,
              std::function<SCPQuorumSetPtr(SCPStatement const &)> const &qfun,
              std::function<bool(SCPStatement const &)> const &filter = [](SCPStatement const &) { return true; });
 
@@ -95,11 +108,6 @@ protected:
     // returns a quorum set {{ nodeID }}
     static SCPQuorumSet buildSingletonQSet(NodeID const &nodeID);
 
-    // called recursively
-    static bool isQuorumSliceInternal(SCPQuorumSet const &qset, std::vector<NodeID> const &nodeSet);
-
-    static bool isVBlockingInternal(SCPQuorumSet const &qset, std::vector<NodeID> const &nodeSet);
-
     static void forAllNodesInternal(SCPQuorumSet const &qset, std::function<void(NodeID const &)> proc);
 };
 }
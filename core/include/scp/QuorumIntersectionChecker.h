@@ -0,0 +1,89 @@
+#pragma once
+
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "scp/CompiledQuorumSet.h"
+#include "scp/SCP.h"
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/**
+ * QuorumIntersectionChecker tells whether every two quorums of a network share a node.
+ *
+ * Every quorum contains a quorum that lies inside a single strongly connected component of the graph whose edges go
+ * from a node to the validators of its quorum set, so:
+ *
+ * - if two components contain a quorum, those two quorums are disjoint;
+ * - otherwise all minimal quorums lie in the one component that contains a quorum, and it is enough to check that
+ *   none of them has a quorum in its complement. As one of two disjoint quorums is at most half of the component,
+ *   only minimal quorums up to that size are enumerated.
+ *
+ * Minimal quorums are enumerated by branching on one node at a time (included or excluded), preferring the nodes
+ * listed by the committed ones. A branch is pruned as soon as:
+ *
+ * - the nodes committed so far can't be part of a quorum made of committed and remaining nodes, or already contain
+ *   a smaller quorum;
+ * - the smallest slice of a committed node is more than half of the component;
+ * - what is left of the component once the committed nodes are removed holds no quorum, as the complement of any
+ *   quorum built from here is smaller still.
+ *
+ * All set operations are done on the bitsets of CompiledQuorumSet. The search is exponential in the worst case, but
+ * these bounds cut it down to a few branches for symmetric and hierarchical topologies.
+ */
+
+namespace vixal {
+
+class QuorumIntersectionChecker {
+public:
+    // nodes mapped to a null quorum set are known but can't take part in a
+    // quorum, as we don't know their slices
+    typedef std::map<NodeID, SCPQuorumSetPtr> QuorumMap;
+
+    explicit QuorumIntersectionChecker(QuorumMap const &qmap);
+
+    bool networkEnjoysQuorumIntersection();
+
+    // two disjoint quorums, found by the last check that failed
+    std::pair<std::vector<NodeID>, std::vector<NodeID>> getPotentialSplit() const;
+
+    // nodes with a known quorum set
+    size_t getNodeCount() const;
+
+    // minimal quorums whose complement was checked by the last check
+    size_t getMinimalQuorumsChecked() const;
+
+private:
+    NodeIndex mIndex;
+    // by node index, null when the quorum set is unknown
+    std::vector<std::unique_ptr<CompiledQuorumSet>> mQSets;
+    // validators of the quorum set of each node
+    std::vector<NodeBitSet> mSuccessors;
+    NodeBitSet mKnown;
+
+    // the component being searched and the number of its nodes that list
+    // each node, used to pick the next node to branch on
+    NodeBitSet mComponent;
+    size_t mComponentSize;
+    std::vector<size_t> mInDegree;
+
+    size_t mMinimalQuorumsChecked;
+    std::pair<NodeBitSet, NodeBitSet> mSplit;
+
+    std::vector<NodeBitSet> getStronglyConnectedComponents() const;
+
+    // largest quorum contained in `nodes`, empty if there is none
+    NodeBitSet contractToMaximalQuorum(NodeBitSet nodes) const;
+
+    bool isMinimalQuorum(NodeBitSet const &quorum) const;
+
+    // search the minimal quorums made of `committed` and some of `remaining`
+    // for one whose complement holds a quorum
+    bool findSplit(NodeBitSet const &committed, NodeBitSet remaining);
+
+    std::vector<NodeID> toNodeIDs(NodeBitSet const &nodes) const;
+};
+}
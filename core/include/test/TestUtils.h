@@ -38,7 +38,7 @@ public:
 
 class TestInvariantManager : public InvariantManagerImpl {
 public:
-    explicit TestInvariantManager(medida::MetricsRegistry &registry);
+    explicit TestInvariantManager(Application &app);
 
 private:
     void
@@ -0,0 +1,78 @@
+#pragma once
+
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/asio.h"
+#include "xdr/ledger.h"
+#include <vector>
+
+/**
+ * The ledger entries a transaction may read or change, known from its
+ * operations before applying it.
+ *
+ * Footprints split a transaction set into clusters that don't conflict: no
+ * entry changed by a transaction of a cluster is read or changed by a
+ * transaction of another cluster, so clusters could be applied in any order
+ * with the same results.
+ *
+ * Crossing offers, deleting offers when revoking a trust line and inflation
+ * change entries that can only be found while applying, so a transaction
+ * doing any of these is global: it may conflict with any other one and is
+ * left out of the clusters, to be applied alone, in its place between them.
+ *
+ * The footprints are used to load the entries of a transaction set in bulk,
+ * in parallel, before applying it and, with PARALLEL_TX_APPLY, to apply the
+ * clusters found between two global transactions in parallel, each on an
+ * EntryOverlay holding its footprint.
+ */
+
+namespace vixal {
+
+class Database;
+
+class TransactionFrame;
+
+class TransactionFootprint {
+public:
+    explicit TransactionFootprint(TransactionFrame const &tx);
+
+    // entries only read, such as the issuers of assets
+    std::vector<LedgerKey> const &getReads() const;
+
+    // entries that may be created, changed or deleted
+    std::vector<LedgerKey> const &getWrites() const;
+
+    // true if the transaction may change entries that are not in its
+    // footprint
+    bool isGlobal() const;
+
+    // clusters of the transactions of `footprints` that are not global, as
+    // indices in `footprints`: each cluster is in increasing order and
+    // clusters are ordered by their first transaction
+    static std::vector<std::vector<size_t>>
+    cluster(std::vector<TransactionFootprint> const &footprints);
+
+    // loads the accounts and trust lines of `footprints` that are not in the
+    // entry cache of `db` and puts them there, at most `maxEntries` of them.
+    // When `db` has a pool, batches of entries are loaded on pooled sessions
+    // by tasks posted to `workers` as well as by the calling thread, so this
+    // must be done before anything is written in the session of `db`.
+    // Returns the number of entries loaded.
+    static size_t prefetch(std::vector<TransactionFootprint> const &footprints,
+                           Database &db, size_t maxEntries,
+                           asio::io_context &workers);
+
+private:
+    std::vector<LedgerKey> mReads;
+    std::vector<LedgerKey> mWrites;
+    bool mGlobal;
+
+    void addRead(LedgerKey const &key);
+
+    void addWrite(LedgerKey const &key);
+
+    void addOperation(AccountID const &source, Operation const &op);
+};
+}
@@ -34,6 +34,12 @@ class XDROutputFileStream;
 
 class SHA256;
 
+class TransactionHistoryBuffer;
+
+namespace PubKeyUtils {
+struct VerifySigRequest;
+}
+
 class TransactionFrame;
 
 using TransactionFramePtr = std::shared_ptr<TransactionFrame>;
@@ -51,6 +57,11 @@ protected:
     mutable Hash mContentsHash; // the hash of the contents
     mutable Hash mFullHash;     // the hash of the contents and the sig.
 
+    // XDR of the envelope and the message flooding it, built once and shared
+    // by the hashes, the transaction sets, the overlay and the database
+    mutable std::shared_ptr<xdr::opaque_vec<> const> mEnvelopeXDR;
+    mutable std::shared_ptr<VixalMessage const> mMessage;
+
     std::vector<std::shared_ptr<OperationFrame>> mOperations;
 
     bool loadAccount(int ledgerProtocolVersion, LedgerDelta *delta, Database &db);
@@ -110,6 +121,9 @@ public:
 
     Hash const &getFullHash() const;
 
+    // canonical XDR encoding of the envelope
+    xdr::opaque_vec<> const &getEnvelopeXDR() const;
+
     Hash const &getContentsHash() const;
 
     std::vector<std::shared_ptr<OperationFrame>> const &
@@ -169,6 +183,19 @@ public:
 
     bool checkValid(Application &app, SequenceNumber current);
 
+    // verify, ahead of checkValid, the signatures that don't require loading
+    // any account (made by the transaction or operation source accounts) so
+    // that their results are cached. Safe to call from a worker thread.
+    void preverifySignatures() const;
+
+    // same as above, for many transactions at once
+    static void
+    preverifySignatures(std::vector<TransactionFramePtr> const &txs);
+
+    // add to `batch` the signatures preverifySignatures checks
+    void addPreverifiableSignatures(
+            std::vector<PubKeyUtils::VerifySigRequest> &batch) const;
+
     // collect fee, consume sequence number
     void processFeeSeqNum(LedgerDelta &delta, LedgerManager &ledgerManager);
 
@@ -179,18 +206,23 @@ public:
     // version without meta
     bool apply(LedgerDelta &delta, Application &app);
 
-    VixalMessage toVixalMessage() const;
+    // forgets what applying the transaction did to its results, keeping the
+    // fee charged, so that it can be applied again
+    void resetAppliedResults();
+
+    VixalMessage const &toVixalMessage() const;
 
     AccountFrame::pointer loadAccount(int ledgerProtocolVersion,
                                       LedgerDelta *delta, Database &app,
                                       AccountID const &accountID);
 
-    // transaction history
-    void storeTransaction(LedgerManager &ledgerManager, TransactionMeta &tm,
-                          int txindex, TransactionResultSet &resultSet) const;
+    // transaction history, buffered in `history` until it is flushed
+    void storeTransaction(TransactionHistoryBuffer &history,
+                          TransactionMeta &tm, int txindex,
+                          TransactionResultSet &resultSet) const;
 
-    // fee history
-    void storeTransactionFee(LedgerManager &ledgerManager,
+    // fee history, buffered in `history` until it is flushed
+    void storeTransactionFee(TransactionHistoryBuffer &history,
                              LedgerEntryChanges const &changes,
                              int txindex) const;
 
@@ -214,6 +246,11 @@ public:
 
     static void dropAll(Database &db);
 
+    // converts the history tables from base64 text to binary columns; the
+    // caller runs it in the SQL transaction that records the new schema
+    // version, so that it is done entirely or not at all
+    static void convertHistoryToBlobs(Database &db);
+
     static void deleteOldEntries(Database &db, uint32_t ledgerSeq, uint32_t count);
 };
 }
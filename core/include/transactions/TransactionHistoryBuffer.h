@@ -0,0 +1,56 @@
+#pragma once
+
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "crypto/ByteSlice.h"
+#include "xdr/types.h"
+#include <string>
+#include <vector>
+
+/**
+ * Rows of txhistory and txfeehistory for the transactions of a ledger,
+ * buffered while the ledger is applied and written by flush() with a few
+ * multi-row INSERTs instead of one statement per transaction.
+ */
+
+namespace vixal {
+
+class Database;
+
+class TransactionHistoryBuffer {
+    struct Row {
+        std::string mTxID;
+        int mTxIndex;
+        std::vector<std::vector<uint8_t>> mBlobs;
+    };
+
+    Database &mDatabase;
+    uint32 mLedgerSeq;
+    std::vector<Row> mTransactions;
+    std::vector<Row> mFees;
+
+    void insert(std::string const &table,
+                std::vector<std::string> const &columns,
+                std::vector<Row> &rows);
+
+public:
+    TransactionHistoryBuffer(Database &db, uint32 ledgerSeq);
+
+    // row of txhistory
+    void addTransaction(Hash const &contentsHash, int txindex,
+                        ByteSlice const &body, ByteSlice const &result,
+                        ByteSlice const &meta);
+
+    // row of txfeehistory
+    void addTransactionFee(Hash const &contentsHash, int txindex,
+                           ByteSlice const &changes);
+
+    // number of rows buffered
+    size_t size() const;
+
+    // writes and clears the rows buffered
+    void flush();
+};
+}
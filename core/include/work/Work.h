@@ -10,6 +10,7 @@
 #include <util/Timer.h>
 
 #include "work/AbstractWork.h"
+#include "process/ProcessClass.h"
 
 namespace vixal {
 
@@ -64,6 +65,10 @@ public:
 
     virtual size_t getMaxRetries() const;
 
+    // class of the commands run by this work and its children: the class of
+    // its parent unless overridden, PROCESS_OTHER at the top of the tree
+    virtual ProcessClass getProcessClass() const;
+
     uint64_t getRetryETA() const;
 
     // Customize work behavior via these callbacks. onReset is called
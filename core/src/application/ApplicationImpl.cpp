@@ -12,6 +12,7 @@
 #include "NtpSynchronizationChecker.h"
 #include "bucket/Bucket.h"
 #include "bucket/BucketManager.h"
+#include "crypto/SecretKey.h"
 #include "database/Database.h"
 
 #include "ledger/LedgerManager.h"
@@ -60,7 +61,10 @@ ApplicationImpl::ApplicationImpl(VirtualClock &clock, Config const &cfg)
           mConfig(cfg),
           io_context_(std::thread::hardware_concurrency()),
           work_guard_(asio::make_work_guard(io_context_)),
+          mTransferIOContext(static_cast<int>(cfg.MAX_CONCURRENT_SUBPROCESSES)),
+          mTransferWorkGuard(asio::make_work_guard(mTransferIOContext)),
           mWorkerThreads(),
+          mTransferThreads(),
           mStopSignals(clock.io_context(), SIGINT),
           mStopping(false),
           mStoppingTimer(mVirtualClock),
@@ -80,6 +84,11 @@ ApplicationImpl::ApplicationImpl(VirtualClock &clock, Config const &cfg)
 
     mNetworkID = sha256(mConfig.NETWORK_PASSPHRASE);
 
+    if (!PubKeyUtils::setVerifySigCacheSize(mConfig.VERIFY_SIG_CACHE_SIZE)) {
+        LOG(WARNING) << "VERIFY_SIG_CACHE_SIZE ignored, the signature cache "
+                     << "was already sized by another Application";
+    }
+
     unsigned t = std::thread::hardware_concurrency();
     LOG(DEBUG) << "Application constructing " << "(worker threads: " << t << ")";
 
@@ -94,6 +103,10 @@ ApplicationImpl::ApplicationImpl(VirtualClock &clock, Config const &cfg)
         mWorkerThreads.emplace_back([this, t]() { this->runWorkerThread(t); });
     }
 
+    for (size_t i = 0; i < mConfig.MAX_CONCURRENT_SUBPROCESSES; i++) {
+        mTransferThreads.emplace_back([this]() { mTransferIOContext.run(); });
+    }
+
     LOG(DEBUG) << "Application constructed";
 }
 
@@ -395,11 +408,15 @@ ApplicationImpl::joinAllThreads() {
     // that keeps the worker threads alive. This gives them the chance to finish
     // any work that the main thread queued.
     work_guard_.reset();
+    mTransferWorkGuard.reset();
     LOG(DEBUG) << "Joining " << mWorkerThreads.size() << " worker threads";
     for (auto &w : mWorkerThreads) {
         w.join();
     }
     LOG(DEBUG) << "Joined all " << mWorkerThreads.size() << " threads";
+    for (auto &w : mTransferThreads) {
+        w.join();
+    }
 }
 
 bool
@@ -509,14 +526,19 @@ ApplicationImpl::syncOwnMetrics() {
         mLastStateChange = now;
     }
 
-    // Flush crypto pure-global-cache stats. They don't belong
-    // to a single app instance but first one to flush will claim
-    // them.
-    uint64_t vhit = 0, vmiss = 0;
-    PubKeyUtils::flushVerifySigCacheCounts(vhit, vmiss);
-    mMetrics->newMeter({"crypto", "verify", "hit"}, "signature").mark(vhit);
-    mMetrics->newMeter({"crypto", "verify", "miss"}, "signature").mark(vmiss);
-    mMetrics->newMeter({"crypto", "verify", "total"}, "signature").mark(vhit + vmiss);
+    // Crypto pure-global-cache stats. They don't belong to a single app
+    // instance: the per-shard counters are the process-wide totals, and each
+    // hit or miss is marked in the meters of the one app that syncs first.
+    auto counts = PubKeyUtils::getVerifySigCacheCounts();
+    for (size_t i = 0; i < counts.size(); ++i) {
+        auto shard = "shard-" + std::to_string(i);
+        mMetrics->newCounter({"crypto", "verify-cache", shard + "-hit"}).set_count(counts[i].mHits);
+        mMetrics->newCounter({"crypto", "verify-cache", shard + "-miss"}).set_count(counts[i].mMisses);
+    }
+    auto taken = PubKeyUtils::takeVerifySigCacheCounts();
+    mMetrics->newMeter({"crypto", "verify", "hit"}, "signature").mark(taken.mHits);
+    mMetrics->newMeter({"crypto", "verify", "miss"}, "signature").mark(taken.mMisses);
+    mMetrics->newMeter({"crypto", "verify", "total"}, "signature").mark(taken.mHits + taken.mMisses);
 
     // Similarly, flush global process-table stats.
     mMetrics->newCounter({"process", "memory", "handles"}).set_count(mProcessManager->getNumRunningProcesses());
@@ -635,6 +657,11 @@ ApplicationImpl::io_context() {
     return io_context_;
 }
 
+asio::io_context &
+ApplicationImpl::getTransferIOContext() {
+    return mTransferIOContext;
+}
+
 void
 ApplicationImpl::enableInvariantsFromConfig() {
     for (const auto &name : mConfig.INVARIANT_CHECKS) {
@@ -108,6 +108,8 @@ public:
 
     asio::io_context &io_context() override;
 
+    asio::io_context &getTransferIOContext() override;
+
     void newDB() override;
 
     void start() override;
@@ -163,6 +165,8 @@ private:
     // before we start tearing down subsystems.
     asio::io_context io_context_;
     asio::executor_work_guard<asio::io_context::executor_type> work_guard_;
+    asio::io_context mTransferIOContext;
+    asio::executor_work_guard<asio::io_context::executor_type> mTransferWorkGuard;
 
     std::unique_ptr<Database> mDatabase;
     std::unique_ptr<TmpDirManager> mTmpDirManager;
@@ -184,6 +188,7 @@ private:
     std::unique_ptr<StatusManager> mStatusManager;
 
     std::vector<std::thread> mWorkerThreads;
+    std::vector<std::thread> mTransferThreads;
 
     asio::signal_set mStopSignals;
 
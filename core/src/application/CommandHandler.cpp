@@ -65,6 +65,7 @@ CommandHandler::CommandHandler(Application &app) : mApp(app) {
     addRoute("bans", &CommandHandler::bans);
     addRoute("catchup", &CommandHandler::catchup);
     addRoute("checkdb", &CommandHandler::checkdb);
+    addRoute("closetrace", &CommandHandler::closeTrace);
     addRoute("connect", &CommandHandler::connect);
     addRoute("dropcursor", &CommandHandler::dropcursor);
     addRoute("droppeer", &CommandHandler::dropPeer);
@@ -199,6 +200,9 @@ CommandHandler::testTx(std::string const &params, std::string &retStr) {
                 root["detail"] =
                         xdr::xdr_to_string(txFrame->getResult().result.code());
                 break;
+            case Herder::TX_STATUS_TRY_AGAIN_LATER:
+                root["status"] = "try again later";
+                break;
             default:
                 assert(false);
         }
@@ -222,6 +226,9 @@ CommandHandler::fileNotFound(std::string const &params, std::string &retStr) {
               "mode is either 'minimal' (the default, if omitted) or 'complete'."
               "</p><p><h1> /checkdb</h1>"
               "triggers the instance to perform an integrity check of the database."
+              "</p><p><h1> /closetrace?[limit=n]</h1>"
+              "returns the time spent closing the last n ledgers (default: all the "
+              "ledgers traced), by phase and by type of operation, in microseconds."
               "</p><p><h1> /connect?peer=NAME&port=NNN</h1>"
               "triggers the instance to connect to peer NAME at port NNN."
               "</p><p><h1> "
@@ -257,11 +264,16 @@ CommandHandler::fileNotFound(std::string const &params, std::string &retStr) {
               "clear all metrics (for testing purposes)"
               "</p><p><h1> /peers</h1>"
               "returns the list of known peers in JSON format"
-              "</p><p><h1> /quorum?[node=NODE_ID][&compact=true]</h1>"
+              "</p><p><h1> /quorum?[node=NODE_ID][&compact=true][&intersection=true]</h1>"
               "returns information about the quorum for node NODE_ID (this node by"
               " default). NODE_ID is either a full key (`GABCD...`), an alias "
               "(`$name`) or an abbreviated ID(`@GABCD`)."
               "If compact is set, only returns a summary version."
+              " If intersection is set, also starts checking in the background "
+              "whether the network made of this node and the nodes heard from on "
+              "the latest slot enjoys quorum intersection, and returns the result "
+              "of the last check (\"unknown\" before the first one completes), "
+              "with two disjoint quorums if there is no intersection."
               "</p><p><h1> /scp?[limit=n]</h1>"
               "returns a JSON object with the internal state of the SCP engine for "
               "the last n (default 2) ledgers."
@@ -664,6 +676,9 @@ CommandHandler::quorum(std::string const &params, std::string &retStr) {
 
     auto root =
             mApp.getHerder().getJsonQuorumInfo(n, retMap["compact"] == "true");
+    if (retMap["intersection"] == "true") {
+        root["intersection"] = mApp.getHerder().getJsonQuorumIntersectionInfo();
+    }
 
     retStr = root.toStyledString();
 }
@@ -682,6 +697,19 @@ CommandHandler::scpInfo(std::string const &params, std::string &retStr) {
     retStr = root.toStyledString();
 }
 
+void
+CommandHandler::closeTrace(std::string const &params, std::string &retStr) {
+    std::map<std::string, std::string> retMap;
+    http::server::server::parseParams(params, retMap);
+
+    size_t lim = LedgerCloseTrace::CAPACITY;
+    maybeParseParam(retMap, "limit", lim);
+
+    auto root = mApp.getLedgerManager().getCloseTrace().getJsonInfo(lim);
+
+    retStr = root.toStyledString();
+}
+
 // "Must specify a log level: ll?level=<level>&partition=<name>";
 void
 CommandHandler::ll(std::string const &params, std::string &retStr) {
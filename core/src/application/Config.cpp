@@ -94,6 +94,14 @@ Config::Config() : NODE_SEED(SecretKey::random()) {
     MINIMUM_IDLE_PERCENT = 0;
 
     MAX_CONCURRENT_SUBPROCESSES = 16;
+    VERIFY_SIG_CACHE_SIZE = 0xffff;
+    PENDING_TX_MAX_BYTES = 32 * 1024 * 1024;
+    PENDING_TX_MAX_OPS = 100000;
+    PENDING_TX_MAX_PER_ACCOUNT = 1000;
+    PARALLEL_TX_APPLY = false;
+    INVARIANT_CHECKS_ASYNC = false;
+    INVARIANT_CHECKS_MAX_LAG = 1;
+    HISTORY_STREAMING_PUBLISH = false;
     NODE_IS_VALIDATOR = false;
 
     DATABASE = SecretValue{"sqlite3://:memory:"};
@@ -318,8 +326,20 @@ Config::load(std::string const &filename) {
                 COMMANDS = readStringArray(item);
             } else if (item.first == "MAX_CONCURRENT_SUBPROCESSES") {
                 MAX_CONCURRENT_SUBPROCESSES = static_cast<size_t>(readInt<int>(item, 1));
+            } else if (item.first == "VERIFY_SIG_CACHE_SIZE") {
+                VERIFY_SIG_CACHE_SIZE = static_cast<size_t>(readInt<int>(item, 1));
+            } else if (item.first == "PENDING_TX_MAX_BYTES") {
+                PENDING_TX_MAX_BYTES = static_cast<size_t>(readInt<int64_t>(item, 1));
+            } else if (item.first == "PENDING_TX_MAX_OPS") {
+                PENDING_TX_MAX_OPS = static_cast<size_t>(readInt<int>(item, 1));
+            } else if (item.first == "PENDING_TX_MAX_PER_ACCOUNT") {
+                PENDING_TX_MAX_PER_ACCOUNT = static_cast<size_t>(readInt<int>(item, 1));
             } else if (item.first == "MINIMUM_IDLE_PERCENT") {
                 MINIMUM_IDLE_PERCENT = readInt<uint32_t>(item, 0, 100);
+            } else if (item.first == "HISTORY_STREAMING_PUBLISH") {
+                HISTORY_STREAMING_PUBLISH = readBool(item);
+            } else if (item.first == "PARALLEL_TX_APPLY") {
+                PARALLEL_TX_APPLY = readBool(item);
             } else if (item.first == "HISTORY") {
                 auto hist = item.second->as_group();
                 if (hist) {
@@ -330,7 +350,7 @@ Config::load(std::string const &filename) {
                             throw std::invalid_argument(
                                     "malformed HISTORY config block");
                         }
-                        std::string get, put, mkdir;
+                        std::string get, put, mkdir, local, url;
                         for (auto const &c : *tab) {
                             if (c.first == "get") {
                                 get = c.second->as<std::string>()->value();
@@ -338,6 +358,10 @@ Config::load(std::string const &filename) {
                                 put = c.second->as<std::string>()->value();
                             } else if (c.first == "mkdir") {
                                 mkdir = c.second->as<std::string>()->value();
+                            } else if (c.first == "local") {
+                                local = c.second->as<std::string>()->value();
+                            } else if (c.first == "url") {
+                                url = c.second->as<std::string>()->value();
                             } else {
                                 std::string err(
                                         "Unknown HISTORY-table entry: '");
@@ -347,7 +371,18 @@ Config::load(std::string const &filename) {
                                 throw std::invalid_argument(err);
                             }
                         }
-                        HISTORY[archive.first] = HistoryArchiveConfiguration{archive.first, get, put, mkdir};
+                        if (!local.empty() &&
+                            (!url.empty() || !get.empty() || !put.empty() || !mkdir.empty())) {
+                            throw std::invalid_argument(
+                                    "'local' can't be combined with other entries within [HISTORY." +
+                                    archive.first + "]");
+                        }
+                        if (!url.empty() && !get.empty()) {
+                            throw std::invalid_argument(
+                                    "'url' can't be combined with 'get' within [HISTORY." +
+                                    archive.first + "]");
+                        }
+                        HISTORY[archive.first] = HistoryArchiveConfiguration{archive.first, get, put, mkdir, local, url};
                     }
                 } else {
                     throw std::invalid_argument("incomplete HISTORY block");
@@ -360,6 +395,10 @@ Config::load(std::string const &filename) {
                 NTP_SERVER = readString(item);
             } else if (item.first == "INVARIANT_CHECKS") {
                 INVARIANT_CHECKS = readStringArray(item);
+            } else if (item.first == "INVARIANT_CHECKS_ASYNC") {
+                INVARIANT_CHECKS_ASYNC = readBool(item);
+            } else if (item.first == "INVARIANT_CHECKS_MAX_LAG") {
+                INVARIANT_CHECKS_MAX_LAG = static_cast<size_t>(readInt<int>(item, 0));
             } else {
                 std::string err("Unknown configuration entry: '");
                 err += item.first;
@@ -9,6 +9,7 @@
 
 #include "bucket/Bucket.h"
 #include "bucket/BucketApplicator.h"
+#include "bucket/BucketDatabaseComparison.h"
 #include "bucket/BucketList.h"
 #include "bucket/BucketManager.h"
 #include "crypto/Random.h"
@@ -202,9 +203,8 @@ compareSizes(std::string const &objType, uint64_t inDatabase, uint64_t inBucketl
     }
 }
 
-/// FIXME issue NNN: this should be refactored to run in a read-transaction on a background thread and take a
-/// soci::session& rather than Database&. For now we code it to run on main thread because there's a bunch of
-/// code to move around in the ledger frames and db layer to make that work.
+/// FIXME issue NNN: this should be refactored to run in a read-transaction on a background thread. For now it runs
+/// on main thread, only the comparison of the objects with the DB is spread over sessions from the pool.
 void
 checkDBAgainstBuckets(medida::MetricsRegistry &metrics,
                       BucketManager &bucketManager, Database &db,
@@ -245,47 +245,26 @@ checkDBAgainstBuckets(medida::MetricsRegistry &metrics,
 
     CLOG(INFO, "Bucket") << "CheckDB starting object comparison";
 
-    // Step 3: scan the superbucket, checking each object against the DB and
-    // counting objects along the way.
-    uint64_t nAccounts = 0, nTrustLines = 0, nOffers = 0, nData = 0;
+    // Step 3: compare the superbucket with the DB, counting objects along the
+    // way.
+    BucketEntryCounts counts;
     {
-        auto &meter = metrics.newMeter({"bucket", "checkdb", "object-compare"}, "comparison");
         auto compareTimer = metrics.newTimer({"bucket", "checkdb", "compare"}).timeScope();
-        for (BucketInputIterator iter(superBucket); iter; ++iter) {
-            meter.mark();
-            auto &e = *iter;
-            if (e.type() == LIVEENTRY) {
-                switch (e.liveEntry().data.type()) {
-                    case ACCOUNT:
-                        ++nAccounts;
-                        break;
-                    case TRUSTLINE:
-                        ++nTrustLines;
-                        break;
-                    case OFFER:
-                        ++nOffers;
-                        break;
-                    case DATA:
-                        ++nData;
-                        break;
-                }
-                auto s = EntryFrame::checkAgainstDatabase(e.liveEntry(), db);
-                if (!s.empty()) {
-                    throw std::runtime_error{s};
-                }
-                if (meter.count() % 100 == 0) {
-                    CLOG(INFO, "Bucket") << "CheckDB compared " << meter.count() << " objects";
-                }
-            }
+        auto s = compareBucketWithDatabase(superBucket, db, counts);
+        if (!s.empty()) {
+            throw std::runtime_error{s};
         }
+        auto compared = counts.mAccounts + counts.mTrustLines + counts.mOffers + counts.mData;
+        metrics.newMeter({"bucket", "checkdb", "object-compare"}, "comparison").mark(compared);
+        CLOG(INFO, "Bucket") << "CheckDB compared " << compared << " objects";
     }
 
     // Step 4: confirm size of datasets matches size of datasets in DB.
     soci::session &sess = db.getSession();
-    compareSizes("account", AccountFrame::countObjects(sess), nAccounts);
-    compareSizes("trustline", TrustFrame::countObjects(sess), nTrustLines);
-    compareSizes("offer", OfferFrame::countObjects(sess), nOffers);
-    compareSizes("data", DataFrame::countObjects(sess), nData);
+    compareSizes("account", AccountFrame::countObjects(sess), counts.mAccounts);
+    compareSizes("trustline", TrustFrame::countObjects(sess), counts.mTrustLines);
+    compareSizes("offer", OfferFrame::countObjects(sess), counts.mOffers);
+    compareSizes("data", DataFrame::countObjects(sess), counts.mData);
 }
 
 }
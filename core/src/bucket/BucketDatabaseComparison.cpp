@@ -0,0 +1,300 @@
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "bucket/BucketDatabaseComparison.h"
+#include "bucket/Bucket.h"
+#include "bucket/BucketInputIterator.h"
+#include "bucket/LedgerCmp.h"
+#include "crypto/KeyUtils.h"
+#include "crypto/SecretKey.h"
+#include "database/Database.h"
+#include "ledger/AccountFrame.h"
+#include "ledger/DataFrame.h"
+#include "ledger/OfferFrame.h"
+#include "ledger/TrustFrame.h"
+#include "util/XDROperators.h"
+#include "xdrpp/printer.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <map>
+#include <mutex>
+
+namespace vixal {
+
+namespace {
+size_t const BATCH_SIZE = 1000;
+
+LedgerKey
+getBucketEntryKey(BucketEntry const &e) {
+    return e.type() == LIVEENTRY ? LedgerEntryKey(e.liveEntry()) : e.deadEntry();
+}
+
+// loads the rows that may match `keys`, all of type `type`
+std::map<LedgerKey, LedgerEntry, LedgerEntryIdCmp>
+loadBatch(soci::session &sess, LedgerEntryType type,
+          std::vector<LedgerKey> const &keys) {
+    std::map<LedgerKey, LedgerEntry, LedgerEntryIdCmp> res;
+    auto keep = [&res](LedgerEntry const &le) {
+        res.emplace(LedgerEntryKey(le), le);
+    };
+
+    if (type == OFFER) {
+        std::vector<uint64_t> offerIDs;
+        for (auto const &k : keys) {
+            offerIDs.emplace_back(k.offer().offerID);
+        }
+        OfferFrame::loadOffers(sess, offerIDs, keep);
+        return res;
+    }
+
+    // the other types are loaded by account, keys being sorted the entries
+    // of an account follow each other
+    std::vector<std::string> accounts;
+    AccountID const *last = nullptr;
+    for (auto const &k : keys) {
+        AccountID const *account;
+        switch (type) {
+            case ACCOUNT:
+                account = &k.account().accountID;
+                break;
+            case TRUSTLINE:
+                account = &k.trustLine().accountID;
+                break;
+            case DATA:
+                account = &k.data().accountID;
+                break;
+            default:
+                abort();
+        }
+        if (!last || !(*last == *account)) {
+            accounts.emplace_back(KeyUtils::toStrKey(*account));
+            last = account;
+        }
+    }
+
+    switch (type) {
+        case ACCOUNT:
+            AccountFrame::loadAccounts(sess, accounts, keep);
+            break;
+        case TRUSTLINE:
+            TrustFrame::loadLines(sess, accounts, keep);
+            break;
+        case DATA:
+            DataFrame::loadData(sess, accounts, keep);
+            break;
+        default:
+            abort();
+    }
+    return res;
+}
+
+std::string
+compareBatch(soci::session &sess, LedgerEntryType type,
+             std::vector<BucketEntry> &batch) {
+    LedgerEntryIdCmp cmp;
+    std::vector<LedgerKey> keys;
+    keys.reserve(batch.size());
+    for (auto const &e : batch) {
+        keys.emplace_back(getBucketEntryKey(e));
+    }
+    // buckets are sorted, but their order is checked elsewhere
+    if (!std::is_sorted(keys.begin(), keys.end(), cmp)) {
+        std::sort(batch.begin(), batch.end(), BucketEntryIdCmp{});
+        keys.clear();
+        for (auto const &e : batch) {
+            keys.emplace_back(getBucketEntryKey(e));
+        }
+    }
+
+    auto fromDb = loadBatch(sess, type, keys);
+
+    // rows of entries that are not in the batch are skipped, the number of
+    // rows is checked separately
+    auto row = fromDb.begin();
+    for (size_t i = 0; i < batch.size(); ++i) {
+        while (row != fromDb.end() && cmp(row->first, keys[i])) {
+            ++row;
+        }
+        bool found = row != fromDb.end() && !cmp(keys[i], row->first);
+        auto const &e = batch[i];
+        if (e.type() == LIVEENTRY) {
+            if (!found) {
+                std::string s{"Inconsistent state between objects (not found in database): "};
+                s += xdr::xdr_to_string(e.liveEntry(), "live");
+                return s;
+            }
+            if (!(row->second == e.liveEntry())) {
+                std::string s{"Inconsistent state between objects: "};
+                s += xdr::xdr_to_string(row->second, "db");
+                s += xdr::xdr_to_string(e.liveEntry(), "live");
+                return s;
+            }
+        } else if (found) {
+            std::string s = "Entry with type DEADENTRY found in database ";
+            s += xdr::xdr_to_string(row->second, "db");
+            return s;
+        }
+    }
+    return {};
+}
+
+// entries of one type on their way from the bucket to the database check
+struct TypeCheck {
+    LedgerEntryType mType;
+    uint64_t &mCount;
+    // batch being filled by the bucket reader
+    std::vector<BucketEntry> mBatch;
+    // full batches waiting for the check, when checking in the background
+    std::deque<std::vector<BucketEntry>> mQueue;
+    std::string mResult;
+};
+
+size_t
+typeIndex(BucketEntry const &e) {
+    auto type = e.type() == LIVEENTRY ? e.liveEntry().data.type()
+                                      : e.deadEntry().type();
+    switch (type) {
+        case ACCOUNT:
+            return 0;
+        case TRUSTLINE:
+            return 1;
+        case OFFER:
+            return 2;
+        case DATA:
+            return 3;
+        default:
+            abort();
+    }
+}
+
+// reads the bucket once and hands each full batch to `flush`, which
+// returns false to stop reading
+template <typename F>
+void
+readBucket(std::shared_ptr<Bucket const> bucket, std::vector<TypeCheck> &checks,
+           F flush) {
+    for (BucketInputIterator iter(bucket); iter; ++iter) {
+        auto const &e = *iter;
+        auto &check = checks[typeIndex(e)];
+        if (e.type() == LIVEENTRY) {
+            ++check.mCount;
+        }
+        check.mBatch.emplace_back(e);
+        if (check.mBatch.size() == BATCH_SIZE && !flush(check)) {
+            return;
+        }
+    }
+    for (auto &check : checks) {
+        if (!check.mBatch.empty() && !flush(check)) {
+            return;
+        }
+    }
+}
+
+// each type is checked on its own session from the pool while the bucket is
+// read; the reader waits when a type has MAX_QUEUED batches pending
+void
+compareInBackground(std::shared_ptr<Bucket const> bucket,
+                    soci::connection_pool &pool,
+                    std::vector<TypeCheck> &checks) {
+    size_t const MAX_QUEUED = 2;
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool done = false;
+    bool failed = false;
+
+    std::vector<std::future<void>> checkers;
+    for (size_t i = 0; i < checks.size(); ++i) {
+        checkers.emplace_back(std::async(std::launch::async, [&, i]() {
+            auto &check = checks[i];
+            soci::session sess(pool);
+            for (;;) {
+                std::vector<BucketEntry> batch;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    changed.wait(lock, [&]() {
+                        return !check.mQueue.empty() || done || failed;
+                    });
+                    if (check.mQueue.empty() || failed) {
+                        return;
+                    }
+                    batch = std::move(check.mQueue.front());
+                    check.mQueue.pop_front();
+                }
+                changed.notify_all();
+                auto s = compareBatch(sess, check.mType, batch);
+                if (!s.empty()) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    check.mResult = s;
+                    failed = true;
+                    changed.notify_all();
+                    return;
+                }
+            }
+        }));
+    }
+
+    readBucket(bucket, checks, [&](TypeCheck &check) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&]() {
+                return check.mQueue.size() < MAX_QUEUED || failed;
+            });
+            if (failed) {
+                return false;
+            }
+            check.mQueue.emplace_back(std::move(check.mBatch));
+        }
+        changed.notify_all();
+        check.mBatch.clear();
+        check.mBatch.reserve(BATCH_SIZE);
+        return true;
+    });
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+    }
+    changed.notify_all();
+    for (auto &c : checkers) {
+        c.get();
+    }
+}
+}
+
+std::string
+compareBucketWithDatabase(std::shared_ptr<Bucket const> bucket, Database &db,
+                          BucketEntryCounts &counts) {
+    // in the order of typeIndex
+    std::vector<TypeCheck> checks;
+    checks.push_back({ACCOUNT, counts.mAccounts, {}, {}, {}});
+    checks.push_back({TRUSTLINE, counts.mTrustLines, {}, {}, {}});
+    checks.push_back({OFFER, counts.mOffers, {}, {}, {}});
+    checks.push_back({DATA, counts.mData, {}, {}, {}});
+    for (auto &check : checks) {
+        check.mBatch.reserve(BATCH_SIZE);
+    }
+
+    if (db.canUsePool()) {
+        compareInBackground(bucket, db.getPool(), checks);
+    } else {
+        readBucket(bucket, checks, [&](TypeCheck &check) {
+            check.mResult = compareBatch(db.getSession(), check.mType,
+                                         check.mBatch);
+            check.mBatch.clear();
+            return check.mResult.empty();
+        });
+    }
+
+    for (auto const &check : checks) {
+        if (!check.mResult.empty()) {
+            return check.mResult;
+        }
+    }
+    return {};
+}
+}
@@ -61,6 +61,11 @@ CatchupWork::getStatus() const {
     return BucketDownloadWork::getStatus();
 }
 
+ProcessClass
+CatchupWork::getProcessClass() const {
+    return PROCESS_CATCHUP;
+}
+
 void
 CatchupWork::onReset() {
     auto toLedger = mCatchupConfiguration.toLedger() == 0
@@ -11,6 +11,8 @@
 #include "transactions/SignatureUtils.h"
 #include "crypto/HashOfHash.h"
 #include "util/lrucache.hpp"
+#include <algorithm>
+#include <atomic>
 #include <memory>
 #include <mutex>
 #include <sodium.h>
@@ -24,23 +26,92 @@ namespace vixal {
 // to the state of the process; caching its results centrally
 // makes all signature-verification in the program faster and
 // has no effect on correctness.
+//
+// Verification runs on every worker thread, so the cache is split in
+// shards, each with its own lock, picked by the (uniformly distributed)
+// cache key; threads only contend when they hit the same shard.
+
+namespace {
+struct VerifySigCacheShard {
+    std::mutex mMutex;
+    cache::lru_cache<Hash, bool> mCache;
+    std::atomic<uint64_t> mHits{0};
+    std::atomic<uint64_t> mMisses{0};
+
+    explicit VerifySigCacheShard(size_t size) : mCache(size) {
+    }
+};
+
+size_t const VERIFY_SIG_CACHE_SHARDS = 16;
+size_t const VERIFY_SIG_CACHE_DEFAULT_SIZE = 0xffff;
+
+std::vector<std::unique_ptr<VerifySigCacheShard>>
+makeVerifySigCacheShards(size_t size) {
+    std::vector<std::unique_ptr<VerifySigCacheShard>> shards;
+    for (size_t i = 0; i < VERIFY_SIG_CACHE_SHARDS; ++i) {
+        shards.emplace_back(std::make_unique<VerifySigCacheShard>(
+                std::max<size_t>(1, size / VERIFY_SIG_CACHE_SHARDS)));
+    }
+    return shards;
+}
+
+std::vector<std::unique_ptr<VerifySigCacheShard>> gVerifySigCache =
+        makeVerifySigCacheShards(VERIFY_SIG_CACHE_DEFAULT_SIZE);
+std::mutex gVerifySigCacheSizeMutex;
+size_t gVerifySigCacheSize = VERIFY_SIG_CACHE_DEFAULT_SIZE;
+bool gVerifySigCacheSized = false;
+
+std::mutex gVerifySigCacheTakenMutex;
+PubKeyUtils::VerifySigCacheCounts gVerifySigCacheTaken{0, 0};
+
+VerifySigCacheShard &
+verifySigCacheShard(Hash const &cacheKey) {
+    // the low bytes of the key already select buckets within a shard
+    return *gVerifySigCache[cacheKey[cacheKey.size() - 1] %
+                            VERIFY_SIG_CACHE_SHARDS];
+}
+
+bool
+verifySigCacheLookup(Hash const &cacheKey, bool &result) {
+    auto &shard = verifySigCacheShard(cacheKey);
+    {
+        std::lock_guard<std::mutex> guard(shard.mMutex);
+        if (shard.mCache.exists(cacheKey)) {
+            result = shard.mCache.get(cacheKey);
+            ++shard.mHits;
+            return true;
+        }
+    }
+    ++shard.mMisses;
+    return false;
+}
 
-static std::mutex gVerifySigCacheMutex;
-static cache::lru_cache<Hash, bool> gVerifySigCache(0xffff);
-static std::unique_ptr<SHA256> gHasher = SHA256::create();
-static uint64_t gVerifyCacheHit = 0;
-static uint64_t gVerifyCacheMiss = 0;
+void
+verifySigCachePut(Hash const &cacheKey, bool result) {
+    auto &shard = verifySigCacheShard(cacheKey);
+    std::lock_guard<std::mutex> guard(shard.mMutex);
+    shard.mCache.put(cacheKey, result);
+}
+}
+
+// Signatures are verified on worker threads too, each thread hashes cache
+// keys with its own hasher, made once.
+static SHA256 &
+threadHasher() {
+    thread_local std::unique_ptr<SHA256> hasher = SHA256::create();
+    return *hasher;
+}
 
 static Hash
-verifySigCacheKey(PublicKey const &key, Signature const &signature,
-                  ByteSlice const &bin) {
+verifySigCacheKey(SHA256 &hasher, PublicKey const &key,
+                  Signature const &signature, ByteSlice const &bin) {
     assert(key.type() == PUBLIC_KEY_TYPE_ED25519);
 
-    gHasher->reset();
-    gHasher->add(key.ed25519());
-    gHasher->add(signature);
-    gHasher->add(bin);
-    return gHasher->finish();
+    hasher.reset();
+    hasher.add(key.ed25519());
+    hasher.add(signature);
+    hasher.add(bin);
+    return hasher.finish();
 }
 
 SecretKey::SecretKey() : mKeyType(PUBLIC_KEY_TYPE_ED25519) {
@@ -162,17 +233,54 @@ SecretKey::fromStrKeySeed(std::string const &strKeySeed) {
 
 void
 PubKeyUtils::clearVerifySigCache() {
-    std::lock_guard<std::mutex> guard(gVerifySigCacheMutex);
-    gVerifySigCache.clear();
+    for (auto &shard : gVerifySigCache) {
+        std::lock_guard<std::mutex> guard(shard->mMutex);
+        shard->mCache.clear();
+    }
 }
 
-void
-PubKeyUtils::flushVerifySigCacheCounts(uint64_t &hits, uint64_t &misses) {
-    std::lock_guard<std::mutex> guard(gVerifySigCacheMutex);
-    hits = gVerifyCacheHit;
-    misses = gVerifyCacheMiss;
-    gVerifyCacheHit = 0;
-    gVerifyCacheMiss = 0;
+bool
+PubKeyUtils::setVerifySigCacheSize(size_t size) {
+    // every Application sets it, only the first one resizes the cache
+    std::lock_guard<std::mutex> sizeGuard(gVerifySigCacheSizeMutex);
+    if (gVerifySigCacheSized || size == gVerifySigCacheSize) {
+        gVerifySigCacheSized = true;
+        return size == gVerifySigCacheSize;
+    }
+    gVerifySigCacheSized = true;
+    gVerifySigCacheSize = size;
+    for (auto &shard : gVerifySigCache) {
+        std::lock_guard<std::mutex> guard(shard->mMutex);
+        shard->mCache = cache::lru_cache<Hash, bool>(
+                std::max<size_t>(1, size / VERIFY_SIG_CACHE_SHARDS));
+    }
+    return true;
+}
+
+std::vector<PubKeyUtils::VerifySigCacheCounts>
+PubKeyUtils::getVerifySigCacheCounts() {
+    std::vector<VerifySigCacheCounts> counts;
+    for (auto const &shard : gVerifySigCache) {
+        counts.push_back({shard->mHits.load(), shard->mMisses.load()});
+    }
+    return counts;
+}
+
+PubKeyUtils::VerifySigCacheCounts
+PubKeyUtils::takeVerifySigCacheCounts() {
+    VerifySigCacheCounts total{0, 0};
+    for (auto const &c : getVerifySigCacheCounts()) {
+        total.mHits += c.mHits;
+        total.mMisses += c.mMisses;
+    }
+    std::lock_guard<std::mutex> guard(gVerifySigCacheTakenMutex);
+    // counts only grow, but another thread may have taken past `total`
+    VerifySigCacheCounts res{
+            total.mHits - std::min(total.mHits, gVerifySigCacheTaken.mHits),
+            total.mMisses - std::min(total.mMisses, gVerifySigCacheTaken.mMisses)};
+    gVerifySigCacheTaken.mHits = std::max(total.mHits, gVerifySigCacheTaken.mHits);
+    gVerifySigCacheTaken.mMisses = std::max(total.mMisses, gVerifySigCacheTaken.mMisses);
+    return res;
 }
 
 std::string
@@ -239,25 +347,53 @@ PubKeyUtils::verifySig(PublicKey const &key, Signature const &signature,
         return false;
     }
 
-    auto cacheKey = verifySigCacheKey(key, signature, bin);
+    auto cacheKey = verifySigCacheKey(threadHasher(), key, signature, bin);
 
-    {
-        std::lock_guard<std::mutex> guard(gVerifySigCacheMutex);
-        if (gVerifySigCache.exists(cacheKey)) {
-            ++gVerifyCacheHit;
-            return gVerifySigCache.get(cacheKey);
-        }
+    bool ok;
+    if (verifySigCacheLookup(cacheKey, ok)) {
+        return ok;
     }
 
-    ++gVerifyCacheMiss;
-    bool ok =
-            (crypto_sign_verify_detached(signature.data(), bin.data(), bin.size(),
-                                         key.ed25519().data()) == 0);
-    std::lock_guard<std::mutex> guard(gVerifySigCacheMutex);
-    gVerifySigCache.put(cacheKey, ok);
+    ok = (crypto_sign_verify_detached(signature.data(), bin.data(), bin.size(),
+                                      key.ed25519().data()) == 0);
+    verifySigCachePut(cacheKey, ok);
     return ok;
 }
 
+std::vector<bool>
+PubKeyUtils::verifySigs(std::vector<VerifySigRequest> const &batch) {
+    std::vector<bool> results(batch.size(), false);
+
+    // libsodium has no multi-signature verification, what we batch is the
+    // cache traffic: all lookups are done before any verification
+    auto &hasher = threadHasher();
+    std::vector<Hash> cacheKeys(batch.size());
+    std::vector<size_t> misses;
+    for (size_t i = 0; i < batch.size(); ++i) {
+        auto const &req = batch[i];
+        if (req.mSignature.size() != 64) {
+            continue;
+        }
+        cacheKeys[i] =
+                verifySigCacheKey(hasher, req.mKey, req.mSignature, req.mBin);
+        bool ok;
+        if (verifySigCacheLookup(cacheKeys[i], ok)) {
+            results[i] = ok;
+        } else {
+            misses.push_back(i);
+        }
+    }
+
+    for (auto i : misses) {
+        auto const &req = batch[i];
+        results[i] = (crypto_sign_verify_detached(
+                req.mSignature.data(), req.mBin.data(), req.mBin.size(),
+                req.mKey.ed25519().data()) == 0);
+        verifySigCachePut(cacheKeys[i], results[i]);
+    }
+    return results;
+}
+
 PublicKey
 PubKeyUtils::random() {
     PublicKey pk;
@@ -20,6 +20,7 @@
 #include "history/HistoryManager.h"
 #include "ledger/AccountFrame.h"
 #include "ledger/DataFrame.h"
+#include "ledger/EntryOverlay.h"
 #include "ledger/LedgerHeaderFrame.h"
 #include "ledger/OfferFrame.h"
 #include "ledger/TrustFrame.h"
@@ -46,7 +47,7 @@ using namespace std;
 
 bool Database::gDriversRegistered = false;
 
-static unsigned long const SCHEMA_VERSION = 7;
+static unsigned long const SCHEMA_VERSION = 8;
 
 static void
 setSerializable(soci::session &sess) {
@@ -133,6 +134,14 @@ Database::applySchemaUpgrade(unsigned long vers) {
                         "CHECK (sellingliabilities >= 0)";
             break;
 
+        case 8: {
+            soci::transaction tx(mSession);
+            TransactionFrame::convertHistoryToBlobs(*this);
+            putSchemaVersion(vers);
+            tx.commit();
+            break;
+        }
+
         default:
             throw std::runtime_error("Unknown DB schema version");
     }
@@ -230,6 +239,84 @@ Database::canUsePool() const {
     return !(mApp.getConfig().DATABASE.value == ("sqlite3://:memory:"));
 }
 
+StatementContext
+Database::prepareStatement(soci::session &sess, std::string const &query) {
+    auto p = std::make_shared<soci::statement>(sess);
+    p->alloc();
+    p->prepare(query);
+    return StatementContext(p);
+}
+
+std::string
+Database::toInList(std::vector<std::string> const &values) {
+    std::string res;
+    for (auto const &v : values) {
+        assert(v.find('\'') == std::string::npos);
+        if (!res.empty()) {
+            res += ",";
+        }
+        res += "'" + v + "'";
+    }
+    return res;
+}
+
+std::string
+Database::getBlobType() const {
+    return isSqlite() ? "BLOB" : "BYTEA";
+}
+
+BlobValue::BlobValue(Database &db, soci::session &sess) {
+    if (db.isSqlite()) {
+        mBlob = std::make_unique<soci::blob>(sess);
+    }
+}
+
+void
+BlobValue::set(ByteSlice const &bin) {
+    if (mBlob) {
+        mBlob->trim(0);
+        if (bin.size() != 0) {
+            mBlob->write(0, reinterpret_cast<char const *>(bin.data()),
+                         bin.size());
+        }
+    } else {
+        mHex = "\\x" + binToHex(bin);
+    }
+}
+
+std::vector<uint8_t>
+BlobValue::get() {
+    if (mBlob) {
+        std::vector<uint8_t> res(mBlob->get_len());
+        if (!res.empty()) {
+            mBlob->read(0, reinterpret_cast<char *>(res.data()), res.size());
+        }
+        return res;
+    }
+    if (mHex.compare(0, 2, "\\x") != 0) {
+        throw std::runtime_error("Unexpected BYTEA output format");
+    }
+    return hexToBin(mHex.substr(2));
+}
+
+void
+BlobValue::use(soci::statement &st) {
+    if (mBlob) {
+        st.exchange(soci::use(*mBlob));
+    } else {
+        st.exchange(soci::use(mHex));
+    }
+}
+
+void
+BlobValue::into(soci::statement &st) {
+    if (mBlob) {
+        st.exchange(soci::into(*mBlob));
+    } else {
+        st.exchange(soci::into(mHex));
+    }
+}
+
 void
 Database::clearPreparedStatementCache() {
     // Flush all prepared statements; in sqlite they represent open cursors
@@ -264,6 +351,8 @@ Database::initialize() {
 
 soci::session &
 Database::getSession() {
+    // no session while an overlay holds the entries, whatever the thread
+    EntryOverlay::requireDatabase();
     // global session can only be used from the main thread
     assertThreadIsMain();
     return mSession;
@@ -297,6 +386,7 @@ Database::getPool() {
 
 cache::lru_cache<std::string, std::shared_ptr<LedgerEntry const>> &
 Database::getEntryCache() {
+    EntryOverlay::requireDatabase();
     return mEntryCache;
 }
 
@@ -335,6 +425,7 @@ public:
 
 StatementContext
 Database::getPreparedStatement(std::string const &query) {
+    EntryOverlay::requireDatabase();
     auto i = mStatements.find(query);
     std::shared_ptr<soci::statement> p;
     if (i == mStatements.end()) {
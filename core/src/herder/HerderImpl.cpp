@@ -13,6 +13,7 @@
 #include "application/PersistentState.h"
 #include "overlay/OverlayManager.h"
 #include "scp/LocalNode.h"
+#include "scp/QuorumIntersectionChecker.h"
 #include "scp/Slot.h"
 
 #include "util/Logging.h"
@@ -20,6 +21,7 @@
 #include "util/StatusManager.h"
 #include "util/Decoder.h"
 #include "util/XDRStream.h"
+#include "xdrpp/marshal.h"
 
 using namespace std;
 
@@ -40,11 +42,18 @@ HerderImpl::SCPMetrics::SCPMetrics(Application &app)
           mHerderPendingTxs0(app.getMetrics().newCounter({"herder", "pending-txs", "age0"})),
           mHerderPendingTxs1(app.getMetrics().newCounter({"herder", "pending-txs", "age1"})),
           mHerderPendingTxs2(app.getMetrics().newCounter({"herder", "pending-txs", "age2"})),
-          mHerderPendingTxs3(app.getMetrics().newCounter({"herder", "pending-txs", "age3"})) {
+          mHerderPendingTxs3(app.getMetrics().newCounter({"herder", "pending-txs", "age3"})),
+          mHerderTxRebroadcastBytes(app.getMetrics().newCounter(
+                  {"herder", "pending-txs", "rebroadcast-bytes"})) {
 }
 
+std::chrono::milliseconds const HerderImpl::TX_REBROADCAST_PERIOD(250);
+
 HerderImpl::HerderImpl(Application &app)
-        : mPendingTransactions(4),
+        : mTransactionQueue(app),
+          mTxRebroadcastTicksLeft(0),
+          mTxBytesRebroadcast(0),
+          mTxRebroadcastTimer(app.getClock()),
           mPendingEnvelopes(app, *this),
           mHerderSCPDriver(app, *this, mUpgrades, mPendingEnvelopes),
           mLastSlotSaved(0),
@@ -52,7 +61,8 @@ HerderImpl::HerderImpl(Application &app)
           mLedgerManager(app.getLedgerManager()), mSCPMetrics(app),
           mTrackingTimer(app.getClock()),
           mTriggerTimer(app.getClock()),
-          mRebroadcastTimer(app.getClock()) {
+          mRebroadcastTimer(app.getClock()),
+          mQuorumIntersection(std::make_shared<QuorumIntersectionResult>()) {
     Hash hash = getSCP().getLocalNode()->getQuorumSetHash();
     mPendingEnvelopes.addSCPQuorumSet(hash, getSCP().getLocalNode()->getQuorumSet());
 }
@@ -101,28 +111,6 @@ HerderImpl::updateSCPCounters() {
             getSCP().getCumulativeStatemtCount());
 }
 
-static uint64_t
-countTxs(HerderImpl::AccountTxMap const &acc) {
-    uint64_t sz = 0;
-    for (auto const &a : acc) {
-        sz += a.second->mTransactions.size();
-    }
-    return sz;
-}
-
-static std::shared_ptr<HerderImpl::TxMap>
-findOrAdd(HerderImpl::AccountTxMap &acc, AccountID const &aid) {
-    std::shared_ptr<HerderImpl::TxMap> txmap = nullptr;
-    auto i = acc.find(aid);
-    if (i == acc.end()) {
-        txmap = std::make_shared<HerderImpl::TxMap>();
-        acc.insert(std::make_pair(aid, txmap));
-    } else {
-        txmap = i->second;
-    }
-    return txmap;
-}
-
 void
 HerderImpl::valueExternalized(uint64 slotIndex, VixalValue const &value) {
     // record metrics
@@ -230,70 +218,19 @@ HerderImpl::emitEnvelope(SCPEnvelope const &envelope) {
     startRebroadcastTimer();
 }
 
-void
-HerderImpl::TxMap::addTx(TransactionFramePtr tx) {
-    auto const &h = tx->getFullHash();
-    if (mTransactions.find(h) != mTransactions.end()) {
-        return;
-    }
-    mTransactions.insert(std::make_pair(h, tx));
-    mMaxSeq = std::max(tx->getSeqNum(), mMaxSeq);
-    mTotalFees += tx->getFee();
-}
-
-void
-HerderImpl::TxMap::recalculate() {
-    mMaxSeq = 0;
-    mTotalFees = 0;
-    for (auto const &pair : mTransactions) {
-        mMaxSeq = std::max(pair.second->getSeqNum(), mMaxSeq);
-        mTotalFees += pair.second->getFee();
-    }
-}
-
 Herder::TransactionSubmitStatus
 HerderImpl::recvTransaction(TransactionFramePtr tx) {
     soci::transaction sqltx(mApp.getDatabase().getSession());
     mApp.getDatabase().setCurrentTransactionReadOnly();
 
-    auto const &acc = tx->getSourceID();
-    auto const &txID = tx->getFullHash();
-
-    // determine if we have seen this tx before and if not if it has the right
-    // seq num
-    int64_t totFee = tx->getFee();
-    SequenceNumber highSeq = 0;
-
-    for (auto &map : mPendingTransactions) {
-        auto i = map.find(acc);
-        if (i != map.end()) {
-            auto &txmap = i->second;
-            auto j = txmap->mTransactions.find(txID);
-            if (j != txmap->mTransactions.end()) {
-                return TX_STATUS_DUPLICATE;
-            }
-            totFee += txmap->mTotalFees;
-            highSeq = std::max(highSeq, txmap->mMaxSeq);
-        }
-    }
+    auto res = mTransactionQueue.tryAdd(tx);
 
-    if (!tx->checkValid(mApp, highSeq)) {
-        return TX_STATUS_ERROR;
-    }
+    if (res == TX_STATUS_PENDING && Logging::logTrace("Herder"))
+        CLOG(TRACE, "Herder") << "recv transaction "
+                              << hexAbbrev(tx->getFullHash()) << " for "
+                              << KeyUtils::toShortString(tx->getSourceID());
 
-    if (tx->getSourceAccount().getAvailableBalance(mLedgerManager) < totFee) {
-        tx->getResult().result.code(txINSUFFICIENT_BALANCE);
-        return TX_STATUS_ERROR;
-    }
-
-    if (Logging::logTrace("Herder"))
-        CLOG(TRACE, "Herder") << "recv transaction " << hexAbbrev(txID)
-                              << " for " << KeyUtils::toShortString(acc);
-
-    auto txmap = findOrAdd(mPendingTransactions[0], acc);
-    txmap->addTx(tx);
-
-    return TX_STATUS_PENDING;
+    return res;
 }
 
 Herder::EnvelopeStatus
@@ -490,39 +427,6 @@ HerderImpl::ledgerClosed() {
     }
 }
 
-void
-HerderImpl::removeReceivedTxs(std::vector<TransactionFramePtr> const &dropTxs) {
-    for (auto &m : mPendingTransactions) {
-        if (m.empty()) {
-            continue;
-        }
-
-        std::set<std::shared_ptr<TxMap>> toRecalculate;
-
-        for (auto const &tx : dropTxs) {
-            auto const &acc = tx->getSourceID();
-            auto const &txID = tx->getFullHash();
-            auto i = m.find(acc);
-            if (i != m.end()) {
-                auto &txs = i->second->mTransactions;
-                auto j = txs.find(txID);
-                if (j != txs.end()) {
-                    txs.erase(j);
-                    if (txs.empty()) {
-                        m.erase(i);
-                    } else {
-                        toRecalculate.insert(i->second);
-                    }
-                }
-            }
-        }
-
-        for (auto txm : toRecalculate) {
-            txm->recalculate();
-        }
-    }
-}
-
 bool
 HerderImpl::recvSCPQuorumSet(Hash const &hash, const SCPQuorumSet &qset) {
     return mPendingEnvelopes.recvSCPQuorumSet(hash, qset);
@@ -569,15 +473,7 @@ HerderImpl::getCurrentLedgerSeq() const {
 
 SequenceNumber
 HerderImpl::getMaxSeqInPendingTxs(AccountID const &acc) {
-    SequenceNumber highSeq = 0;
-    for (auto const &m : mPendingTransactions) {
-        auto i = m.find(acc);
-        if (i == m.end()) {
-            continue;
-        }
-        highSeq = std::max(i->second->mMaxSeq, highSeq);
-    }
-    return highSeq;
+    return mTransactionQueue.getMaxSeq(acc);
 }
 
 // called to take a position during the next round
@@ -592,23 +488,10 @@ HerderImpl::triggerNextLedger(uint32_t ledgerSeqToTrigger) {
     updateSCPCounters();
 
     // our first choice for this round's set is all the tx we have collected
-    // during last ledger close
+    // during last ledger close; the queue only holds transactions that are
+    // valid on top of the last closed ledger
     auto const &lcl = mLedgerManager.getLastClosedLedgerHeader();
-    auto proposedSet = std::make_shared<TxSetFrame>(lcl.hash);
-
-    for (auto const &m : mPendingTransactions) {
-        for (auto const &pair : m) {
-            for (auto const &tx : pair.second->mTransactions) {
-                proposedSet->add(tx.second);
-            }
-        }
-    }
-
-    std::vector<TransactionFramePtr> removed;
-    proposedSet->trimInvalid(mApp, removed);
-    removeReceivedTxs(removed);
-
-    proposedSet->surgePricingFilter(mLedgerManager);
+    auto proposedSet = mTransactionQueue.toTxSet(lcl.hash);
 
     if (!proposedSet->checkValid(mApp)) {
         throw std::runtime_error("wanting to emit an invalid txSet");
@@ -733,6 +616,89 @@ HerderImpl::getJsonQuorumInfo(NodeID const &id, bool summary, uint64 index) {
     return ret;
 }
 
+Json::Value
+HerderImpl::getJsonQuorumIntersectionInfo() {
+    auto result = mQuorumIntersection;
+    bool start = false;
+    {
+        std::lock_guard<std::mutex> lock(result->mMutex);
+        if (!result->mRunning) {
+            result->mRunning = true;
+            start = true;
+        }
+    }
+
+    if (start) {
+        startQuorumIntersectionCheck(result);
+    }
+
+    Json::Value ret;
+    std::lock_guard<std::mutex> lock(result->mMutex);
+    ret["checking"] = result->mRunning;
+    if (!result->mHasResult) {
+        ret["intersection"] = "unknown";
+        return ret;
+    }
+    ret["slot"] = static_cast<Json::UInt64>(result->mSlot);
+    ret["node_count"] = static_cast<Json::UInt64>(result->mNodeCount);
+    ret["intersection"] = result->mIntersection;
+    ret["minimal_quorums_checked"] =
+            static_cast<Json::UInt64>(result->mMinimalQuorumsChecked);
+    if (!result->mIntersection) {
+        auto &jsplit = ret["potential_split"];
+        for (auto const &n : result->mSplit.first) {
+            jsplit[0].append(mApp.getConfig().toShortString(n));
+        }
+        for (auto const &n : result->mSplit.second) {
+            jsplit[1].append(mApp.getConfig().toShortString(n));
+        }
+    }
+    return ret;
+}
+
+void
+HerderImpl::startQuorumIntersectionCheck(
+        std::shared_ptr<QuorumIntersectionResult> result) {
+    QuorumIntersectionChecker::QuorumMap qmap;
+    qmap.emplace(getSCP().getLocalNodeID(),
+                 std::make_shared<SCPQuorumSet>(getSCP().getLocalQuorumSet()));
+    uint64 slot = 0;
+    if (!getSCP().empty()) {
+        slot = getSCP().getHighSlotIndex();
+        for (auto const &e : getSCP().getCurrentState(slot)) {
+            Hash qsHash =
+                    Slot::getCompanionQuorumSetHashFromStatement(e.statement);
+            auto qSet = mPendingEnvelopes.getQSet(qsHash);
+            if (qSet) {
+                qmap[e.statement.nodeID] = qSet;
+            } else {
+                qmap.emplace(e.statement.nodeID, nullptr);
+            }
+        }
+    }
+
+    // the worker only touches `result`, which outlives the herder if needed
+    asio::post(mApp.io_context(), [result, qmap, slot]() {
+        try {
+            QuorumIntersectionChecker checker(qmap);
+            bool intersection = checker.networkEnjoysQuorumIntersection();
+            std::lock_guard<std::mutex> lock(result->mMutex);
+            result->mRunning = false;
+            result->mHasResult = true;
+            result->mSlot = slot;
+            result->mNodeCount = checker.getNodeCount();
+            result->mIntersection = intersection;
+            result->mMinimalQuorumsChecked = checker.getMinimalQuorumsChecked();
+            result->mSplit = checker.getPotentialSplit();
+        }
+        catch (std::exception &e) {
+            CLOG(ERROR, "Herder") << "Quorum intersection check failed: " << e.what();
+            std::lock_guard<std::mutex> lock(result->mMutex);
+            result->mRunning = false;
+        }
+    });
+}
+
 void
 HerderImpl::persistSCPState(uint64 slot) {
     if (slot < mLastSlotSaved) {
@@ -881,37 +847,65 @@ HerderImpl::trackingHeartBeat() {
 void
 HerderImpl::updatePendingTransactions(
         std::vector<TransactionFramePtr> const &applied) {
-    // remove all these tx from mPendingTransactions
-    removeReceivedTxs(applied);
-
-    // drop the highest level
-    mPendingTransactions.erase(--mPendingTransactions.end());
+    // remove all these tx from the queue, age it and drop what the ledger
+    // made invalid
+    mTransactionQueue.ledgerClosed(applied);
+
+    // rebroadcast what is left during the next ledger; transactions of an
+    // account come in sequence number order, which is all the order peers
+    // need to accept them
+    mSCPMetrics.mHerderTxRebroadcastBytes.set_count(mTxBytesRebroadcast);
+    mTxBytesRebroadcast = 0;
+    auto txs = mTransactionQueue.getTransactions();
+    mTxsToRebroadcast.assign(txs.begin(), txs.end());
+    auto interval = std::chrono::duration_cast<std::chrono::milliseconds>(
+            mApp.getConfig().getExpectedLedgerCloseTime());
+    mTxRebroadcastTicksLeft = std::max<size_t>(
+            1, static_cast<size_t>(interval / TX_REBROADCAST_PERIOD));
+    mTxRebroadcastTimer.cancel();
+    if (!mTxsToRebroadcast.empty()) {
+        startTxRebroadcastTimer();
+    }
+
+    auto counts = mTransactionQueue.countByAge();
+    mSCPMetrics.mHerderPendingTxs0.set_count(counts[0]);
+    mSCPMetrics.mHerderPendingTxs1.set_count(counts[1]);
+    mSCPMetrics.mHerderPendingTxs2.set_count(counts[2]);
+    mSCPMetrics.mHerderPendingTxs3.set_count(counts[3]);
+}
 
-    // shift entries up
-    mPendingTransactions.emplace_front();
+void
+HerderImpl::startTxRebroadcastTimer() {
+    mTxRebroadcastTimer.expires_after(TX_REBROADCAST_PERIOD);
+    mTxRebroadcastTimer.async_wait(
+            std::bind(&HerderImpl::rebroadcastTransactions, this),
+            &VirtualTimer::onFailureNoop);
+}
 
-    // rebroadcast entries, sorted in apply-order to maximize chances of
-    // propagation
-    {
-        Hash h;
-        TxSetFrame toBroadcast(h);
-        for (auto const &l : mPendingTransactions) {
-            for (auto const &pair : l) {
-                for (auto const &tx : pair.second->mTransactions) {
-                    toBroadcast.add(tx.second);
-                }
-            }
-        }
-        for (auto tx : toBroadcast.sortForApply()) {
-            auto msg = tx->toVixalMessage();
-            mApp.getOverlayManager().broadcastMessage(msg, false);
+void
+HerderImpl::rebroadcastTransactions() {
+    auto ticks = std::max<size_t>(mTxRebroadcastTicksLeft, 1);
+    auto batch = (mTxsToRebroadcast.size() + ticks - 1) / ticks;
+    if (mTxRebroadcastTicksLeft > 0) {
+        mTxRebroadcastTicksLeft--;
+    }
+
+    for (size_t i = 0; i < batch && !mTxsToRebroadcast.empty(); ++i) {
+        auto tx = mTxsToRebroadcast.front();
+        mTxsToRebroadcast.pop_front();
+        // it may have been evicted since the ledger closed
+        if (!mTransactionQueue.contains(tx->getFullHash())) {
+            continue;
         }
+        // the flood gate skips the peers that sent or were sent it already
+        auto const &msg = tx->toVixalMessage();
+        auto told = mApp.getOverlayManager().broadcastMessage(msg, false);
+        mTxBytesRebroadcast += told * xdr::xdr_argpack_size(msg);
     }
 
-    mSCPMetrics.mHerderPendingTxs0.set_count(countTxs(mPendingTransactions[0]));
-    mSCPMetrics.mHerderPendingTxs1.set_count(countTxs(mPendingTransactions[1]));
-    mSCPMetrics.mHerderPendingTxs2.set_count(countTxs(mPendingTransactions[2]));
-    mSCPMetrics.mHerderPendingTxs3.set_count(countTxs(mPendingTransactions[3]));
+    if (!mTxsToRebroadcast.empty()) {
+        startTxRebroadcastTimer();
+    }
 }
 
 void
@@ -5,6 +5,7 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "PendingEnvelopes.h"
+#include "TransactionQueue.h"
 #include "herder/Herder.h"
 #include "herder/HerderSCPDriver.h"
 #include "herder/Upgrades.h"
@@ -13,7 +14,9 @@
 
 #include <deque>
 #include <memory>
+#include <mutex>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace medida {
@@ -103,23 +106,11 @@ public:
     Json::Value getJsonQuorumInfo(NodeID const& id, bool summary,
                                   uint64 index) override;
 
-    struct TxMap {
-        SequenceNumber mMaxSeq{0};
-        int64_t mTotalFees{0};
-        std::unordered_map<Hash, TransactionFramePtr> mTransactions;
-
-        void addTx(TransactionFramePtr);
-
-        void recalculate();
-    };
-
-    typedef std::unordered_map<AccountID, std::shared_ptr<TxMap>> AccountTxMap;
+    Json::Value getJsonQuorumIntersectionInfo() override;
 
 private:
     void ledgerClosed();
 
-    void removeReceivedTxs(std::vector<TransactionFramePtr> const &txs);
-
     void startRebroadcastTimer();
 
     void rebroadcast();
@@ -130,15 +121,31 @@ private:
 
     void processSCPQueueUpToIndex(uint64 slotIndex);
 
-    // 0- tx we got during ledger close
-    // 1- one ledger ago. rebroadcast
-    // 2- two ledgers ago. rebroadcast
-    // ...
-    std::deque<AccountTxMap> mPendingTransactions;
+    struct QuorumIntersectionResult;
+
+    // checks the quorum intersection of the network as currently known on a
+    // worker thread, storing the outcome in `result`
+    void startQuorumIntersectionCheck(
+            std::shared_ptr<QuorumIntersectionResult> result);
+
+    TransactionQueue mTransactionQueue;
 
     void
     updatePendingTransactions(std::vector<TransactionFramePtr> const &applied);
 
+    // pending transactions are rebroadcast in batches spread over the ledger
+    // interval rather than all at once when the ledger closes
+    static std::chrono::milliseconds const TX_REBROADCAST_PERIOD;
+
+    std::deque<TransactionFramePtr> mTxsToRebroadcast;
+    size_t mTxRebroadcastTicksLeft;
+    size_t mTxBytesRebroadcast;
+    VirtualTimer mTxRebroadcastTimer;
+
+    void startTxRebroadcastTimer();
+
+    void rebroadcastTransactions();
+
     PendingEnvelopes mPendingEnvelopes;
     Upgrades mUpgrades;
     HerderSCPDriver mHerderSCPDriver;
@@ -175,6 +182,20 @@ private:
     Application &mApp;
     LedgerManager &mLedgerManager;
 
+    // the quorum intersection search can take exponential time, so it runs
+    // on a worker thread and requests get the result of the last one
+    struct QuorumIntersectionResult {
+        std::mutex mMutex;
+        bool mRunning{false};
+        bool mHasResult{false};
+        uint64 mSlot{0};
+        size_t mNodeCount{0};
+        bool mIntersection{false};
+        size_t mMinimalQuorumsChecked{0};
+        std::pair<std::vector<NodeID>, std::vector<NodeID>> mSplit;
+    };
+    std::shared_ptr<QuorumIntersectionResult> mQuorumIntersection;
+
     struct SCPMetrics {
         medida::Meter &mLostSync;
 
@@ -198,6 +219,9 @@ private:
         medida::Counter &mHerderPendingTxs2;
         medida::Counter &mHerderPendingTxs3;
 
+        // bytes of pending transactions rebroadcast during the last ledger
+        medida::Counter &mHerderTxRebroadcastBytes;
+
         SCPMetrics(Application &app);
     };
 
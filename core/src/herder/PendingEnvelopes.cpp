@@ -4,6 +4,7 @@
 #include "application/Application.h"
 
 #include "crypto/Hex.h"
+#include "crypto/SHA.h"
 #include "herder/HerderUtils.h"
 
 #include "util/Logging.h"
@@ -32,8 +33,28 @@ PendingEnvelopes::PendingEnvelopes(Application &app, HerderImpl &herder)
               peer->sendGetQuorumSet(hash);
           }),
           mTxSetCache(TXSET_CACHE_SIZE),
-          mNodesInQuorum(NODES_QUORUM_CACHE_SIZE), mReadyEnvelopesSize(
-                app.getMetrics().newCounter({"scp", "memory", "pending-envelopes"})) {
+          mNodesInQuorum(NODES_QUORUM_CACHE_SIZE), mReadyCount(0),
+          mHeldCount(0), mReadyEnvelopesSize(
+                app.getMetrics().newCounter({"scp", "memory", "pending-envelopes"})),
+          mHeldEnvelopesSize(app.getMetrics().newCounter({"scp", "memory", "held-envelopes"})),
+          mEnvelopesPerSlot(app.getMetrics().newHistogram({"scp", "memory", "envelopes-per-slot"})) {
+}
+
+size_t
+SlotEnvelopes::size() const {
+    return mProcessedEnvelopes.size() + mDiscardedEnvelopes.size() +
+           mFetchingEnvelopes.size() + mReadyEnvelopes.size();
+}
+
+Hash
+PendingEnvelopes::getEnvelopeHash(SCPEnvelope const &envelope) {
+    return sha256(xdr::xdr_to_opaque(envelope));
+}
+
+void
+PendingEnvelopes::updateSizeMetrics() {
+    mHeldEnvelopesSize.set_count(mHeldCount);
+    mReadyEnvelopesSize.set_count(mReadyCount);
 }
 
 PendingEnvelopes::~PendingEnvelopes() {
@@ -155,23 +176,27 @@ PendingEnvelopes::recvSCPEnvelope(SCPEnvelope const &envelope) {
     // do we have the txset
 
     try {
-        if (isDiscarded(envelope)) {
+        auto hash = getEnvelopeHash(envelope);
+        if (isDiscarded(envelope, hash)) {
             return Herder::ENVELOPE_STATUS_DISCARDED;
         }
 
         touchFetchCache(envelope);
 
-        auto &set = mEnvelopes[envelope.statement.slotIndex].mFetchingEnvelopes;
-        auto &processedList = mEnvelopes[envelope.statement.slotIndex].mProcessedEnvelopes;
+        auto &slot = mEnvelopes[envelope.statement.slotIndex];
+        auto &set = slot.mFetchingEnvelopes;
+        auto &processedSet = slot.mProcessedEnvelopes;
 
-        auto fetching = find(set.begin(), set.end(), envelope);
+        auto fetching = set.find(hash);
 
         if (fetching == set.end()) { // we aren't fetching this envelope
-            if (find(processedList.begin(), processedList.end(), envelope) ==
-                processedList.end()) { // we haven't seen this envelope before
+            if (processedSet.find(hash) ==
+                processedSet.end()) { // we haven't seen this envelope before
                 // insert it into the fetching set
-                fetching = set.insert(envelope).first;
+                fetching = set.emplace(hash, envelope).first;
+                mHeldCount++;
                 startFetch(envelope);
+                updateSizeMetrics();
             } else {
                 // we already have this one
                 return Herder::ENVELOPE_STATUS_PROCESSED;
@@ -182,7 +207,9 @@ PendingEnvelopes::recvSCPEnvelope(SCPEnvelope const &envelope) {
         // check if we are done fetching it
         if (isFullyFetched(envelope)) {
             // move the item from fetching to processed
-            processedList.emplace_back(*fetching);
+            if (!processedSet.insert(hash).second) {
+                mHeldCount--;
+            }
             set.erase(fetching);
             envelopeReady(envelope);
             return Herder::ENVELOPE_STATUS_READY;
@@ -201,17 +228,7 @@ PendingEnvelopes::recvSCPEnvelope(SCPEnvelope const &envelope) {
 void
 PendingEnvelopes::discardSCPEnvelope(SCPEnvelope const &envelope) {
     try {
-        if (isDiscarded(envelope)) {
-            return;
-        }
-
-        auto &discardedSet = mEnvelopes[envelope.statement.slotIndex].mDiscardedEnvelopes;
-        discardedSet.insert(envelope);
-
-        auto &fetchingSet = mEnvelopes[envelope.statement.slotIndex].mFetchingEnvelopes;
-        fetchingSet.erase(envelope);
-
-        stopFetch(envelope);
+        discardSCPEnvelope(envelope, getEnvelopeHash(envelope));
     }
     catch (xdr::xdr_runtime_error &e) {
         CLOG(TRACE, "Herder")
@@ -220,16 +237,37 @@ PendingEnvelopes::discardSCPEnvelope(SCPEnvelope const &envelope) {
     }
 }
 
+void
+PendingEnvelopes::discardSCPEnvelope(SCPEnvelope const &envelope,
+                                     Hash const &hash) {
+    if (isDiscarded(envelope, hash)) {
+        return;
+    }
+
+    auto &slot = mEnvelopes[envelope.statement.slotIndex];
+    slot.mDiscardedEnvelopes.insert(hash);
+    mHeldCount++;
+    mHeldCount -= slot.mFetchingEnvelopes.erase(hash);
+
+    stopFetch(envelope);
+    updateSizeMetrics();
+}
+
 bool
 PendingEnvelopes::isDiscarded(SCPEnvelope const &envelope) const {
+    return isDiscarded(envelope, getEnvelopeHash(envelope));
+}
+
+bool
+PendingEnvelopes::isDiscarded(SCPEnvelope const &envelope,
+                              Hash const &hash) const {
     auto envelopes = mEnvelopes.find(envelope.statement.slotIndex);
     if (envelopes == mEnvelopes.end()) {
         return false;
     }
 
     auto &discardedSet = envelopes->second.mDiscardedEnvelopes;
-    auto discarded = std::find(std::begin(discardedSet), std::end(discardedSet), envelope);
-    return discarded != discardedSet.end();
+    return discardedSet.find(hash) != discardedSet.end();
 }
 
 void
@@ -240,6 +278,9 @@ PendingEnvelopes::envelopeReady(SCPEnvelope const &envelope) {
     mApp.getOverlayManager().broadcastMessage(msg, false);
 
     mEnvelopes[envelope.statement.slotIndex].mReadyEnvelopes.push_back(envelope);
+    mReadyCount++;
+    mHeldCount++;
+    updateSizeMetrics();
 
     CLOG(TRACE, "Herder") << "Envelope ready i:" << envelope.statement.slotIndex
                           << " t:" << envelope.statement.pledges.type();
@@ -313,6 +354,9 @@ PendingEnvelopes::pop(uint64 slotIndex, SCPEnvelope &ret) {
         if (v.size() != 0) {
             ret = v.back();
             v.pop_back();
+            mReadyCount--;
+            mHeldCount--;
+            updateSizeMetrics();
 
             return true;
         }
@@ -332,13 +376,21 @@ PendingEnvelopes::readySlots() {
 }
 
 void
-PendingEnvelopes::eraseBelow(uint64 slotIndex) {
-    for (auto iter = mEnvelopes.begin(); iter != mEnvelopes.end();) {
-        if (iter->first < slotIndex) {
-            iter = mEnvelopes.erase(iter);
-        } else
-            break;
+PendingEnvelopes::eraseSlots(std::map<uint64, SlotEnvelopes>::iterator begin,
+                             std::map<uint64, SlotEnvelopes>::iterator end) {
+    for (auto iter = begin; iter != end; ++iter) {
+        auto held = iter->second.size();
+        mEnvelopesPerSlot.update(held);
+        mHeldCount -= held;
+        mReadyCount -= iter->second.mReadyEnvelopes.size();
     }
+    mEnvelopes.erase(begin, end);
+    updateSizeMetrics();
+}
+
+void
+PendingEnvelopes::eraseBelow(uint64 slotIndex) {
+    eraseSlots(mEnvelopes.begin(), mEnvelopes.lower_bound(slotIndex));
 
     // 0 is special mark for data that we do not know the slot index
     // it is used for state loaded from database
@@ -357,7 +409,10 @@ PendingEnvelopes::slotClosed(uint64 slotIndex) {
     if (slotIndex > Herder::MAX_SLOTS_TO_REMEMBER) {
         slotIndex -= Herder::MAX_SLOTS_TO_REMEMBER;
 
-        mEnvelopes.erase(slotIndex);
+        auto slot = mEnvelopes.find(slotIndex);
+        if (slot != mEnvelopes.end()) {
+            eraseSlots(slot, std::next(slot));
+        }
 
         mTxSetFetcher.stopFetchingBelow(slotIndex + 1);
         mQuorumSetFetcher.stopFetchingBelow(slotIndex + 1);
@@ -396,7 +451,7 @@ PendingEnvelopes::getJsonInfo(size_t limit) {
             if (it->second.mFetchingEnvelopes.size() != 0) {
                 Json::Value &slot = ret[std::to_string(it->first)]["fetching"];
                 for (auto const &e : it->second.mFetchingEnvelopes) {
-                    slot.append(mHerder.getSCP().envToStr(e));
+                    slot.append(mHerder.getSCP().envToStr(e.second));
                 }
             }
             if (it->second.mReadyEnvelopes.size() != 0) {
@@ -1,6 +1,7 @@
 ﻿#pragma once
 
 #include "herder/Herder.h"
+#include "crypto/HashOfHash.h"
 #include "crypto/SecretKey.h"
 #include "overlay/ItemFetcher.h"
 
@@ -14,6 +15,8 @@
 #include <map>
 #include <queue>
 #include <set>
+#include <unordered_map>
+#include <unordered_set>
 
 /**
  * SCP messages that you have received but are waiting to get the info of before feeding into SCP
@@ -23,15 +26,20 @@ namespace vixal {
 
 class HerderImpl;
 
+// envelopes of a slot, known by the hash of their XDR so that checking for
+// a duplicate doesn't compare whole envelopes; everything the slot holds goes
+// away with it
 struct SlotEnvelopes {
-    // list of envelopes we have processed already
-    std::vector<SCPEnvelope> mProcessedEnvelopes;
-    // list of envelopes we have discarded already
-    std::set<SCPEnvelope> mDiscardedEnvelopes;
-    // list of envelopes we are fetching right now
-    std::set<SCPEnvelope> mFetchingEnvelopes;
+    // envelopes we have processed already
+    std::unordered_set<Hash> mProcessedEnvelopes;
+    // envelopes we have discarded already
+    std::unordered_set<Hash> mDiscardedEnvelopes;
+    // envelopes we are fetching right now
+    std::unordered_map<Hash, SCPEnvelope> mFetchingEnvelopes;
     // list of ready envelopes that haven't been sent to SCP yet
     std::vector<SCPEnvelope> mReadyEnvelopes;
+
+    size_t size() const;
 };
 
 class PendingEnvelopes {
@@ -54,7 +62,28 @@ class PendingEnvelopes {
     // NodeIDs that are in quorum
     cache::lru_cache<NodeID, bool> mNodesInQuorum;
 
+    // envelopes of all slots waiting to be sent to SCP, and envelopes held
+    // for all slots; kept up to date as slots change rather than recounted
+    size_t mReadyCount;
+    size_t mHeldCount;
+
     medida::Counter &mReadyEnvelopesSize;
+    // envelopes held for all slots
+    medida::Counter &mHeldEnvelopesSize;
+    // envelopes a slot held when it was dropped
+    medida::Histogram &mEnvelopesPerSlot;
+
+    static Hash getEnvelopeHash(SCPEnvelope const &envelope);
+
+    bool isDiscarded(SCPEnvelope const &envelope, Hash const &hash) const;
+
+    void discardSCPEnvelope(SCPEnvelope const &envelope, Hash const &hash);
+
+    // drops the envelopes of the slots in [begin, end)
+    void eraseSlots(std::map<uint64, SlotEnvelopes>::iterator begin,
+                    std::map<uint64, SlotEnvelopes>::iterator end);
+
+    void updateSizeMetrics();
 
     // returns true if we think that the node is in quorum
     bool isNodeInQuorum(NodeID const &node);
@@ -0,0 +1,376 @@
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "herder/TransactionQueue.h"
+#include "application/Application.h"
+#include "application/Config.h"
+#include "database/Database.h"
+#include "ledger/AccountFrame.h"
+#include "ledger/LedgerManager.h"
+#include "util/Logging.h"
+#include "util/XDROperators.h"
+#include "xdrpp/marshal.h"
+#include <medida/counter.h>
+#include <medida/meter.h>
+#include <medida/metrics_registry.h>
+
+namespace vixal {
+
+uint32 const TransactionQueue::AGE_LIMIT = 4;
+
+bool
+TransactionQueue::FeeRatioCmp::operator()(FeeRatioKey const &a,
+                                         FeeRatioKey const &b) const {
+    if (a.first == b.first) {
+        return a.second < b.second;
+    }
+    return a.first > b.first;
+}
+
+TransactionQueue::TransactionQueue(Application &app)
+        : mApp(app), mTotalBytes(0), mTotalOps(0),
+          mEvicted(app.getMetrics().newMeter({"herder", "pending-txs", "evicted"},
+                                             "transaction")),
+          mBytesCounter(app.getMetrics().newCounter({"herder", "pending-txs", "bytes"})),
+          mLedgerSeq(0), mLedgerVersion(0), mBaseFee(0), mBaseReserve(0) {
+}
+
+Herder::TransactionSubmitStatus
+TransactionQueue::tryAdd(TransactionFramePtr tx) {
+    if (mKnown.find(tx->getFullHash()) != mKnown.end()) {
+        return Herder::TX_STATUS_DUPLICATE;
+    }
+
+    // the chain of the account is valid, so only `tx` needs checking
+    SequenceNumber highSeq = 0;
+    int64_t totFee = tx->getFee();
+    auto it = mAccounts.find(tx->getSourceID());
+    if (it != mAccounts.end()) {
+        if (it->second.mTransactions.size() >=
+            mApp.getConfig().PENDING_TX_MAX_PER_ACCOUNT) {
+            return Herder::TX_STATUS_TRY_AGAIN_LATER;
+        }
+        highSeq = it->second.mTransactions.back().mTx->getSeqNum();
+        totFee += it->second.mTotalFees;
+    }
+
+    if (!tx->checkValid(mApp, highSeq)) {
+        return Herder::TX_STATUS_ERROR;
+    }
+
+    if (tx->getSourceAccount().getAvailableBalance(mApp.getLedgerManager()) <
+        totFee) {
+        tx->getResult().result.code(txINSUFFICIENT_BALANCE);
+        return Herder::TX_STATUS_ERROR;
+    }
+
+    auto const &account = tx->getSourceID();
+    // the chain is ranked by its cheapest transaction, so adding `tx` can't
+    // make it outrank chains paying more than the rest of it
+    auto ratio = feeRatio(tx);
+    if (it != mAccounts.end() && !it->second.mTransactions.empty()) {
+        ratio = std::min(it->second.mFeeRatio, ratio);
+    }
+    auto bytes = xdr::xdr_size(tx->getEnvelope());
+    auto ops = tx->getEnvelope().tx.operations.size();
+    if (!makeRoom(account, ratio, bytes, ops)) {
+        return Herder::TX_STATUS_TRY_AGAIN_LATER;
+    }
+
+    auto &acc = mAccounts[account];
+    mByFeeRatio.erase(std::make_pair(acc.mFeeRatio, account));
+    acc.mFeeRatio = ratio;
+    mByFeeRatio.emplace(acc.mFeeRatio, account);
+
+    acc.mTransactions.push_back({tx, 0, bytes});
+    acc.mTotalFees += tx->getFee();
+    acc.mTotalBytes += bytes;
+    acc.mTotalOps += ops;
+    mTotalBytes += bytes;
+    mTotalOps += ops;
+    mBytesCounter.set_count(mTotalBytes);
+    mKnown.insert(tx->getFullHash());
+    return Herder::TX_STATUS_PENDING;
+}
+
+bool
+TransactionQueue::makeRoom(AccountID const &account, double ratio,
+                           size_t bytes, size_t ops) {
+    auto const &cfg = mApp.getConfig();
+    auto fits = [&](size_t freedBytes, size_t freedOps) {
+        return mTotalBytes - freedBytes + bytes <= cfg.PENDING_TX_MAX_BYTES &&
+               mTotalOps - freedOps + ops <= cfg.PENDING_TX_MAX_OPS;
+    };
+    if (fits(0, 0)) {
+        return true;
+    }
+
+    // find the cheapest chains to evict before touching anything, so that
+    // nothing is evicted for a transaction that is rejected anyway
+    std::vector<AccountID> victims;
+    size_t freedBytes = 0;
+    size_t freedOps = 0;
+    for (auto it = mByFeeRatio.rbegin();
+         it != mByFeeRatio.rend() && !fits(freedBytes, freedOps); ++it) {
+        if (it->first >= ratio) {
+            break;
+        }
+        if (it->second == account) {
+            continue;
+        }
+        auto const &acc = mAccounts.at(it->second);
+        freedBytes += acc.mTotalBytes;
+        freedOps += acc.mTotalOps;
+        victims.push_back(it->second);
+    }
+    if (!fits(freedBytes, freedOps)) {
+        return false;
+    }
+
+    for (auto const &victim : victims) {
+        auto it = mAccounts.find(victim);
+        auto n = it->second.mTransactions.size();
+        erase(it->first, it->second, 0, n);
+        mAccounts.erase(it);
+        mEvicted.mark(n);
+    }
+    CLOG(DEBUG, "Herder") << "TransactionQueue: evicted " << victims.size()
+                          << " accounts, " << freedBytes << " bytes";
+    return true;
+}
+
+double
+TransactionQueue::feeRatio(TransactionFramePtr const &tx) {
+    auto ops = std::max<size_t>(tx->getEnvelope().tx.operations.size(), 1);
+    return static_cast<double>(tx->getFee()) / static_cast<double>(ops);
+}
+
+void
+TransactionQueue::erase(AccountID const &account, AccountTransactions &acc,
+                        size_t begin, size_t end) {
+    if (begin == end) {
+        return;
+    }
+    auto &txs = acc.mTransactions;
+    for (auto i = begin; i < end; ++i) {
+        auto ops = txs[i].mTx->getEnvelope().tx.operations.size();
+        acc.mTotalFees -= txs[i].mTx->getFee();
+        acc.mTotalBytes -= txs[i].mBytes;
+        acc.mTotalOps -= ops;
+        mTotalBytes -= txs[i].mBytes;
+        mTotalOps -= ops;
+        mKnown.erase(txs[i].mTx->getFullHash());
+    }
+    txs.erase(txs.begin() + begin, txs.begin() + end);
+    mBytesCounter.set_count(mTotalBytes);
+    reindex(account, acc);
+}
+
+void
+TransactionQueue::reindex(AccountID const &account, AccountTransactions &acc) {
+    mByFeeRatio.erase(std::make_pair(acc.mFeeRatio, account));
+    if (acc.mTransactions.empty()) {
+        return;
+    }
+    acc.mFeeRatio = feeRatio(acc.mTransactions.front().mTx);
+    for (auto const &qtx : acc.mTransactions) {
+        acc.mFeeRatio = std::min(acc.mFeeRatio, feeRatio(qtx.mTx));
+    }
+    mByFeeRatio.emplace(acc.mFeeRatio, account);
+}
+
+bool
+TransactionQueue::mayBeInvalid(AccountTransactions const &acc,
+                               std::unordered_set<AccountID> const &accounts,
+                               uint64 closeTime) const {
+    for (auto const &qtx : acc.mTransactions) {
+        auto const &tx = qtx.mTx->getEnvelope().tx;
+        if (accounts.find(tx.sourceAccount) != accounts.end()) {
+            return true;
+        }
+        for (auto const &op : tx.operations) {
+            if (op.sourceAccount &&
+                accounts.find(*op.sourceAccount) != accounts.end()) {
+                return true;
+            }
+        }
+        if (tx.timeBounds && tx.timeBounds->maxTime &&
+            tx.timeBounds->maxTime < closeTime) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void
+TransactionQueue::revalidate(AccountID const &account,
+                             AccountTransactions &acc) {
+    auto &txs = acc.mTransactions;
+    auto source = AccountFrame::loadAccount(account, mApp.getDatabase());
+    if (!source) {
+        erase(account, acc, 0, txs.size());
+        return;
+    }
+
+    // sequence numbers already used by other transactions
+    size_t first = 0;
+    while (first < txs.size() &&
+           txs[first].mTx->getSeqNum() <= source->getSeqNum()) {
+        first++;
+    }
+    erase(account, acc, 0, first);
+
+    // keep the longest prefix that is valid and that the account can pay for
+    SequenceNumber lastSeq = 0;
+    int64_t totFee = 0;
+    size_t valid = 0;
+    for (; valid < txs.size(); ++valid) {
+        auto &tx = txs[valid].mTx;
+        if (!tx->checkValid(mApp, lastSeq)) {
+            break;
+        }
+        totFee += tx->getFee();
+        if (tx->getSourceAccount().getAvailableBalance(
+                mApp.getLedgerManager()) < totFee) {
+            break;
+        }
+        lastSeq = tx->getSeqNum();
+    }
+    erase(account, acc, valid, txs.size());
+}
+
+void
+TransactionQueue::ledgerClosed(std::vector<TransactionFramePtr> const &applied) {
+    // applied transactions used up their sequence number and the ones before
+    for (auto const &tx : applied) {
+        auto it = mAccounts.find(tx->getSourceID());
+        if (it == mAccounts.end()) {
+            continue;
+        }
+        auto &txs = it->second.mTransactions;
+        size_t n = 0;
+        while (n < txs.size() && txs[n].mTx->getSeqNum() <= tx->getSeqNum()) {
+            n++;
+        }
+        erase(it->first, it->second, 0, n);
+    }
+
+    // transactions are appended as they are received, so the oldest one is
+    // first and the rest of the chain depends on it
+    for (auto &a : mAccounts) {
+        auto &txs = a.second.mTransactions;
+        for (auto &qtx : txs) {
+            qtx.mAge++;
+        }
+        if (!txs.empty() && txs.front().mAge >= AGE_LIMIT) {
+            erase(a.first, a.second, 0, txs.size());
+        }
+    }
+
+    auto &lm = mApp.getLedgerManager();
+    auto const &header = lm.getLastClosedLedgerHeader().header;
+    if (header.ledgerSeq != mLedgerSeq) {
+        bool all = header.ledgerSeq != mLedgerSeq + 1 ||
+                   header.ledgerVersion != mLedgerVersion ||
+                   header.baseFee != mBaseFee ||
+                   header.baseReserve != mBaseReserve;
+        auto const &accounts = lm.getLastClosedLedgerAccounts();
+        auto closeTime = lm.getCurrentLedgerHeader().scpValue.closeTime;
+
+        soci::transaction sqltx(mApp.getDatabase().getSession());
+        mApp.getDatabase().setCurrentTransactionReadOnly();
+        size_t checked = 0;
+        for (auto &a : mAccounts) {
+            if (!a.second.mTransactions.empty() &&
+                (all || mayBeInvalid(a.second, accounts, closeTime))) {
+                revalidate(a.first, a.second);
+                checked++;
+            }
+        }
+        CLOG(DEBUG, "Herder") << "TransactionQueue: checked " << checked
+                              << " of " << mAccounts.size() << " accounts"
+                              << (all ? " (all)" : "");
+
+        mLedgerSeq = header.ledgerSeq;
+        mLedgerVersion = header.ledgerVersion;
+        mBaseFee = header.baseFee;
+        mBaseReserve = header.baseReserve;
+    }
+
+    for (auto it = mAccounts.begin(); it != mAccounts.end();) {
+        if (it->second.mTransactions.empty()) {
+            it = mAccounts.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+TxSetFramePtr
+TransactionQueue::toTxSet(Hash const &previousLedgerHash) const {
+    auto txSet = std::make_shared<TxSetFrame>(previousLedgerHash);
+    size_t max = mApp.getLedgerManager().getMaxTxSetSize();
+    if (size() > max) {
+        CLOG(WARNING, "Herder") << "surge pricing in effect! " << size();
+    }
+
+    // same selection as TxSetFrame::surgePricingFilter
+    for (auto const &key : mByFeeRatio) {
+        for (auto const &qtx : mAccounts.at(key.second).mTransactions) {
+            if (txSet->size() == max) {
+                return txSet;
+            }
+            txSet->add(qtx.mTx);
+        }
+    }
+    return txSet;
+}
+
+std::vector<TransactionFramePtr>
+TransactionQueue::getTransactions() const {
+    std::vector<TransactionFramePtr> res;
+    res.reserve(mKnown.size());
+    for (auto const &a : mAccounts) {
+        for (auto const &qtx : a.second.mTransactions) {
+            res.push_back(qtx.mTx);
+        }
+    }
+    return res;
+}
+
+bool
+TransactionQueue::contains(Hash const &fullHash) const {
+    return mKnown.find(fullHash) != mKnown.end();
+}
+
+SequenceNumber
+TransactionQueue::getMaxSeq(AccountID const &account) const {
+    auto it = mAccounts.find(account);
+    if (it == mAccounts.end()) {
+        return 0;
+    }
+    return it->second.mTransactions.back().mTx->getSeqNum();
+}
+
+std::vector<size_t>
+TransactionQueue::countByAge() const {
+    std::vector<size_t> res(AGE_LIMIT, 0);
+    for (auto const &a : mAccounts) {
+        for (auto const &qtx : a.second.mTransactions) {
+            res[qtx.mAge]++;
+        }
+    }
+    return res;
+}
+
+size_t
+TransactionQueue::size() const {
+    return mKnown.size();
+}
+
+size_t
+TransactionQueue::getBytes() const {
+    return mTotalBytes;
+}
+}
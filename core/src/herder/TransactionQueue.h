@@ -0,0 +1,162 @@
+#pragma once
+
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "herder/Herder.h"
+#include "herder/TxSetFrame.h"
+#include "transactions/TransactionFrame.h"
+#include "xdr/ledger.h"
+
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * TransactionQueue holds the transactions received from the network that are
+ * waiting to be included in a ledger.
+ *
+ * Transactions are kept per source account as a chain of consecutive sequence
+ * numbers starting right after the account's sequence number in the last
+ * closed ledger, together with the total fee of the chain: every chain in the
+ * queue is valid on top of the last closed ledger, so a proposed transaction
+ * set can be built from it without checking every transaction again.
+ *
+ * When a ledger closes, only the chains that may have become invalid are
+ * checked again: those of accounts that the ledger changed, directly or
+ * through the source account of an operation, and those with a transaction
+ * past its time bounds. Everything is checked again when the ledger header
+ * changed the validity rules (fee, reserve, version) or when more than one
+ * ledger closed since the last time.
+ *
+ * A transaction that stayed in the queue for AGE_LIMIT ledgers is dropped,
+ * with the rest of its chain.
+ *
+ * Accounts are also kept ordered by the lowest fee per operation of their
+ * chain, so that when there are more transactions than fit in a ledger the
+ * proposed set is made of the chains of the accounts paying the most, without
+ * sorting the whole queue.
+ *
+ * The queue is bounded by PENDING_TX_MAX_BYTES and PENDING_TX_MAX_OPS. When
+ * it is full, a transaction evicts the chains of the accounts paying the
+ * lowest fee ratio if it pays more than them, and is rejected with
+ * TX_STATUS_TRY_AGAIN_LATER otherwise. An account can't have more than
+ * PENDING_TX_MAX_PER_ACCOUNT transactions queued.
+ */
+
+namespace medida {
+class Meter;
+
+class Counter;
+}
+
+namespace vixal {
+
+class Application;
+
+class TransactionQueue {
+public:
+    static uint32 const AGE_LIMIT;
+
+    explicit TransactionQueue(Application &app);
+
+    // checks `tx` on top of the chain of its source account and appends it,
+    // evicting cheaper chains if the queue is full
+    Herder::TransactionSubmitStatus tryAdd(TransactionFramePtr tx);
+
+    // removes `applied` and anything made invalid by their sequence numbers,
+    // ages the remaining transactions and checks again the chains that the
+    // last closed ledger may have invalidated
+    void ledgerClosed(std::vector<TransactionFramePtr> const &applied);
+
+    // builds a transaction set on top of the last closed ledger, made of the
+    // chains of the accounts paying the highest fee ratio if the queue holds
+    // more transactions than the ledger can take
+    TxSetFramePtr toTxSet(Hash const &previousLedgerHash) const;
+
+    // all the transactions, sorted by source account and sequence number
+    std::vector<TransactionFramePtr> getTransactions() const;
+
+    // true if the transaction with this full hash is queued
+    bool contains(Hash const &fullHash) const;
+
+    // highest sequence number queued for `account`, 0 if there is none
+    SequenceNumber getMaxSeq(AccountID const &account) const;
+
+    // number of transactions of each age, from 0 to AGE_LIMIT - 1
+    std::vector<size_t> countByAge() const;
+
+    size_t size() const;
+
+    // size of the queued transactions, in bytes of XDR
+    size_t getBytes() const;
+
+private:
+    struct QueuedTransaction {
+        TransactionFramePtr mTx;
+        // number of ledgers closed since it was received
+        uint32 mAge;
+        size_t mBytes;
+    };
+
+    struct AccountTransactions {
+        // consecutive sequence numbers
+        std::vector<QueuedTransaction> mTransactions;
+        int64_t mTotalFees{0};
+        size_t mTotalBytes{0};
+        size_t mTotalOps{0};
+        // lowest fee per operation of the chain, the base fee being the
+        // same for every transaction this orders accounts like the fee ratio
+        double mFeeRatio{0};
+    };
+
+    typedef std::pair<double, AccountID> FeeRatioKey;
+
+    // highest fee ratio first, then by account id
+    struct FeeRatioCmp {
+        bool operator()(FeeRatioKey const &a, FeeRatioKey const &b) const;
+    };
+
+    Application &mApp;
+    std::unordered_map<AccountID, AccountTransactions> mAccounts;
+    std::set<FeeRatioKey, FeeRatioCmp> mByFeeRatio;
+    std::unordered_set<Hash> mKnown;
+    size_t mTotalBytes;
+    size_t mTotalOps;
+
+    medida::Meter &mEvicted;
+    medida::Counter &mBytesCounter;
+
+    // last closed ledger the queue was checked against
+    uint32 mLedgerSeq;
+    uint32 mLedgerVersion;
+    uint32 mBaseFee;
+    uint32 mBaseReserve;
+
+    static double feeRatio(TransactionFramePtr const &tx);
+
+    // removes the transactions [begin, end) of the chain of `account`
+    void erase(AccountID const &account, AccountTransactions &acc,
+               size_t begin, size_t end);
+
+    // evicts chains of accounts other than `account` paying less than
+    // `ratio`, the fee ratio of the chain of `account` once it holds the new
+    // transaction, until `bytes` and `ops` fit, false if they can't
+    bool makeRoom(AccountID const &account, double ratio, size_t bytes,
+                  size_t ops);
+
+    // updates the fee ratio of `account` after its chain changed
+    void reindex(AccountID const &account, AccountTransactions &acc);
+
+    // true if a transaction of the chain involves one of `accounts` or is
+    // past its time bounds at `closeTime`
+    bool mayBeInvalid(AccountTransactions const &acc,
+                      std::unordered_set<AccountID> const &accounts,
+                      uint64 closeTime) const;
+
+    // checks the chain of `account` again, keeping its valid prefix
+    void revalidate(AccountID const &account, AccountTransactions &acc);
+};
+}
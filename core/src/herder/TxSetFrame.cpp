@@ -13,6 +13,7 @@
 #include "util/XDROperators.h"
 #include "xdrpp/marshal.h"
 #include "xdrpp/printer.h"
+#include <unordered_set>
 
 namespace vixal {
 
@@ -80,6 +81,12 @@ SeqSorter(TransactionFramePtr const &tx1, TransactionFramePtr const &tx2) {
 */
 std::vector<TransactionFramePtr>
 TxSetFrame::sortForApply() {
+    auto setHash = getContentsHash();
+    if (!mApplyOrder.empty() && mApplyOrder.size() == mTransactions.size() &&
+        mApplyOrderHash == setHash) {
+        return mApplyOrder;
+    }
+
     vector<TransactionFramePtr> retList;
 
     vector<vector<TransactionFramePtr>> txBatches(4);
@@ -106,34 +113,18 @@ TxSetFrame::sortForApply() {
     for (auto &batch : txBatches) {
         // randomize each batch using the hash of the transaction set
         // as a way to randomize even more
-        ApplyTxSorter s(getContentsHash());
+        ApplyTxSorter s(setHash);
         std::sort(batch.begin(), batch.end(), s);
         for (const auto &tx : batch) {
             retList.push_back(tx);
         }
     }
 
+    mApplyOrder = retList;
+    mApplyOrderHash = setHash;
     return retList;
 }
 
-struct SurgeSorter {
-    map<AccountID, double> &mAccountFeeMap;
-
-    explicit SurgeSorter(map<AccountID, double> &afm) : mAccountFeeMap(afm) {
-    }
-
-    bool
-    operator()(TransactionFramePtr const &tx1, TransactionFramePtr const &tx2) {
-        if (tx1->getSourceID() == tx2->getSourceID())
-            return tx1->getSeqNum() < tx2->getSeqNum();
-        double fee1 = mAccountFeeMap[tx1->getSourceID()];
-        double fee2 = mAccountFeeMap[tx2->getSourceID()];
-        if (fee1 == fee2)
-            return tx1->getSourceID() < tx2->getSourceID();
-        return fee1 > fee2;
-    }
-};
-
 void
 TxSetFrame::surgePricingFilter(LedgerManager const &lm) {
     size_t max = lm.getMaxTxSetSize();
@@ -141,25 +132,58 @@ TxSetFrame::surgePricingFilter(LedgerManager const &lm) {
         CLOG(WARNING, "Herder") << "surge pricing in effect! "
                                 << mTransactions.size();
 
-        // determine the fee ratio for each account
-        map<AccountID, double> accountFeeMap;
+        // group the transactions by account, an account pays the lowest
+        // fee ratio of its transactions
+        map<AccountID, pair<double, vector<TransactionFramePtr>>> accounts;
         for (auto &tx : mTransactions) {
             double r = tx->getFeeRatio(lm);
-            double now = accountFeeMap[tx->getSourceID()];
-            if (now == 0)
-                accountFeeMap[tx->getSourceID()] = r;
-            else if (r < now)
-                accountFeeMap[tx->getSourceID()] = r;
+            auto res = accounts.emplace(
+                    tx->getSourceID(),
+                    make_pair(r, vector<TransactionFramePtr>()));
+            auto &acc = res.first->second;
+            acc.first = std::min(acc.first, r);
+            acc.second.push_back(tx);
         }
 
-        // sort tx by amount of fee they have paid
-        // remove the bottom that aren't paying enough
-        std::vector<TransactionFramePtr> tempList = mTransactions;
-        std::sort(tempList.begin(), tempList.end(), SurgeSorter(accountFeeMap));
-
-        for (auto iter = tempList.begin() + max; iter != tempList.end(); iter++) {
-            removeTx(*iter);
+        // accounts paying the most first, then by account id
+        typedef map<AccountID, pair<double, vector<TransactionFramePtr>>>::iterator
+                AccountIt;
+        auto cmp = [](AccountIt const &a, AccountIt const &b) {
+            if (a->second.first == b->second.first) {
+                return b->first < a->first;
+            }
+            return a->second.first < b->second.first;
+        };
+        vector<AccountIt> heap;
+        heap.reserve(accounts.size());
+        for (auto it = accounts.begin(); it != accounts.end(); ++it) {
+            heap.push_back(it);
+        }
+        std::make_heap(heap.begin(), heap.end(), cmp);
+
+        // take the transactions of the best accounts, in sequence number
+        // order, until the set is full
+        unordered_set<TransactionFrame const *> kept;
+        while (kept.size() < max && !heap.empty()) {
+            std::pop_heap(heap.begin(), heap.end(), cmp);
+            auto &txs = heap.back()->second.second;
+            heap.pop_back();
+            std::sort(txs.begin(), txs.end(), SeqSorter);
+            for (auto const &tx : txs) {
+                if (kept.size() == max) {
+                    break;
+                }
+                kept.insert(tx.get());
+            }
         }
+
+        mTransactions.erase(
+                std::remove_if(mTransactions.begin(), mTransactions.end(),
+                               [&](TransactionFramePtr const &tx) {
+                                   return kept.find(tx.get()) == kept.end();
+                               }),
+                mTransactions.end());
+        mHashIsValid = false;
     }
 }
 
@@ -265,6 +289,10 @@ TxSetFrame::checkValid(Application &app) {
         return false;
     }
 
+    // check all the signatures we can up front, in one batch; checkValid
+    // will then find them in the verification cache
+    TransactionFrame::preverifySignatures(mTransactions);
+
     auto processInvalidTxLambda = [&](TransactionFramePtr tx,
                                       SequenceNumber const &lastSeq) {
         CLOG(DEBUG, "Herder")
@@ -301,7 +329,7 @@ TxSetFrame::getContentsHash() {
         auto hasher = SHA256::create();
         hasher->add(mPreviousLedgerHash);
         for (auto &mTransaction : mTransactions) {
-            hasher->add(xdr::xdr_to_opaque(mTransaction->getEnvelope()));
+            hasher->add(mTransaction->getEnvelopeXDR());
         }
         mHash = hasher->finish();
         mHashIsValid = true;
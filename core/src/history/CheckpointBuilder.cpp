@@ -0,0 +1,148 @@
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "history/CheckpointBuilder.h"
+#include "application/Application.h"
+#include "herder/TxSetFrame.h"
+#include "history/HistoryManager.h"
+#include "util/Logging.h"
+#include "util/format.h"
+
+#include <cstdio>
+
+namespace vixal {
+
+CheckpointBuilder::CheckpointBuilder(Application &app)
+        : mApp(app), mCheckpoint(0), mLastLedger(0) {
+}
+
+void
+CheckpointBuilder::start(uint32_t checkpoint) {
+    if (!mDir) {
+        mDir = std::make_unique<TmpDir>(
+                mApp.getTmpDirManager().tmpDir("checkpoint"));
+    }
+    auto prefix = fmt::format("{}/{:08x}", mDir->getName(), checkpoint);
+    mFiles = {prefix + "-ledger.xdr", prefix + "-transactions.xdr",
+              prefix + "-results.xdr", 0};
+    mLedgerOut.open(mFiles.mLedgerPath);
+    mTransactionOut.open(mFiles.mTransactionPath);
+    mTransactionResultOut.open(mFiles.mTransactionResultPath);
+    mCheckpoint = checkpoint;
+}
+
+void
+CheckpointBuilder::discard() {
+    if (mCheckpoint == 0) {
+        return;
+    }
+    mLedgerOut.close();
+    mTransactionOut.close();
+    mTransactionResultOut.close();
+    remove(mFiles);
+    mCheckpoint = 0;
+}
+
+void
+CheckpointBuilder::remove(Files const &files) {
+    std::remove(files.mLedgerPath.c_str());
+    std::remove(files.mTransactionPath.c_str());
+    std::remove(files.mTransactionResultPath.c_str());
+}
+
+void
+CheckpointBuilder::appendLedger(LedgerHeaderHistoryEntry const &header,
+                                TxSetFrame &txSet,
+                                TransactionResultSet const &results) {
+    auto &hm = mApp.getHistoryManager();
+    auto seq = header.header.ledgerSeq;
+    auto checkpoint = hm.checkpointContainingLedger(seq);
+
+    if (mCheckpoint != 0 &&
+        (checkpoint != mCheckpoint || seq != mLastLedger + 1)) {
+        CLOG(DEBUG, "History") << "Ledger " << seq << " doesn't follow "
+                               << mLastLedger << ", dropping checkpoint "
+                               << mCheckpoint << " files";
+        discard();
+    }
+    if (mCheckpoint == 0) {
+        // the first checkpoint starts with the genesis ledger, that is never
+        // closed, so it is always read from the database
+        if (seq != hm.prevCheckpointLedger(seq)) {
+            return;
+        }
+        start(checkpoint);
+    }
+
+    bool ok = mLedgerOut.writeOne(header);
+    // like copyTransactionsToStream, ledgers without transactions are left
+    // out of the transaction and result files
+    if (ok && !results.results.empty()) {
+        TransactionHistoryEntry hist;
+        hist.ledgerSeq = seq;
+        txSet.toXDR(hist.txSet);
+        TransactionHistoryResultEntry res;
+        res.ledgerSeq = seq;
+        res.txResultSet = results;
+        ok = mTransactionOut.writeOne(hist) &&
+             mTransactionResultOut.writeOne(res);
+    }
+    if (!ok) {
+        CLOG(WARNING, "History") << "Failed to write ledger " << seq
+                                 << " to the files of checkpoint "
+                                 << mCheckpoint;
+        discard();
+        return;
+    }
+    mLastLedger = seq;
+    mFiles.mHeaders++;
+
+    if (seq == mCheckpoint) {
+        mLedgerOut.close();
+        mTransactionOut.close();
+        mTransactionResultOut.close();
+        CLOG(DEBUG, "History") << "Wrote the files of checkpoint "
+                               << mCheckpoint;
+        {
+            std::lock_guard<std::mutex> lock(mCompleteMutex);
+            mComplete[mCheckpoint] = mFiles;
+        }
+        mCheckpoint = 0;
+    }
+}
+
+bool
+CheckpointBuilder::takeCheckpoint(uint32_t checkpoint,
+                                  std::string const &ledgerPath,
+                                  std::string const &transactionPath,
+                                  std::string const &transactionResultPath,
+                                  size_t &nHeaders) {
+    std::lock_guard<std::mutex> lock(mCompleteMutex);
+    // checkpoints are published in order, older ones won't be asked for
+    while (!mComplete.empty() && mComplete.begin()->first < checkpoint) {
+        remove(mComplete.begin()->second);
+        mComplete.erase(mComplete.begin());
+    }
+
+    auto it = mComplete.find(checkpoint);
+    if (it == mComplete.end()) {
+        return false;
+    }
+    auto files = it->second;
+    mComplete.erase(it);
+
+    if (std::rename(files.mLedgerPath.c_str(), ledgerPath.c_str()) != 0 ||
+        std::rename(files.mTransactionPath.c_str(), transactionPath.c_str()) !=
+        0 ||
+        std::rename(files.mTransactionResultPath.c_str(),
+                    transactionResultPath.c_str()) != 0) {
+        CLOG(WARNING, "History") << "Failed to move the files of checkpoint "
+                                 << checkpoint << ", errno " << errno;
+        remove(files);
+        return false;
+    }
+    nHeaders = files.mHeaders;
+    return true;
+}
+}
@@ -10,6 +10,7 @@
 #include "CoreVersion.h"
 #include "bucket/Bucket.h"
 #include "bucket/BucketList.h"
+#include "history/HistoryArchiveBackend.h"
 #include "history/HistoryManager.h"
 #include "util/format.h"
 #include "application/Application.h"
@@ -237,7 +238,7 @@ HistoryArchiveState::HistoryArchiveState(uint32_t ledgerSeq,
 }
 
 HistoryArchive::HistoryArchive(HistoryArchiveConfiguration const &config)
-        : mConfig(config) {
+        : mConfig(config), mBackend(HistoryArchiveBackend::create(config)) {
 }
 
 HistoryArchive::~HistoryArchive() {
@@ -245,17 +246,17 @@ HistoryArchive::~HistoryArchive() {
 
 bool
 HistoryArchive::hasGetCmd() const {
-    return !mConfig.mGetCmd.empty();
+    return !mConfig.mGetCmd.empty() || mBackend;
 }
 
 bool
 HistoryArchive::hasPutCmd() const {
-    return !mConfig.mPutCmd.empty();
+    return !mConfig.mPutCmd.empty() || (mBackend && mBackend->canPut());
 }
 
 bool
 HistoryArchive::hasMkdirCmd() const {
-    return !mConfig.mMkdirCmd.empty();
+    return !mConfig.mMkdirCmd.empty() || (mBackend && mBackend->canPut());
 }
 
 std::string const &
@@ -287,6 +288,11 @@ HistoryArchive::mkdirCmd(std::string const &remoteDir) const {
     return formatString(mConfig.mMkdirCmd, remoteDir);
 }
 
+std::shared_ptr<HistoryArchiveBackend>
+HistoryArchive::getBackend() const {
+    return mBackend;
+}
+
 void
 HistoryArchive::markSuccess() {
     mSuccess++;
@@ -0,0 +1,186 @@
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "http/HttpClient.h"
+#include "history/HistoryArchiveBackend.h"
+#include "application/Config.h"
+#include "util/Fs.h"
+#include "util/Logging.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+namespace vixal {
+
+namespace {
+
+bool
+copyFile(std::string const &from, std::string const &to) {
+    std::ifstream in(from, std::ifstream::binary);
+    if (!in) {
+        CLOG(WARNING, "History") << "Can't open " << from;
+        return false;
+    }
+    std::ofstream out(to, std::ofstream::binary | std::ofstream::trunc);
+    if (!out) {
+        CLOG(WARNING, "History") << "Can't open " << to;
+        return false;
+    }
+    char buf[4096];
+    while (in) {
+        in.read(buf, sizeof(buf));
+        out.write(buf, in.gcount());
+    }
+    out.close();
+    if (in.bad() || !out) {
+        CLOG(WARNING, "History") << "Failed copying " << from << " to " << to;
+        return false;
+    }
+    return true;
+}
+
+class LocalHistoryArchiveBackend : public HistoryArchiveBackend {
+    std::string const mRoot;
+
+    std::string
+    path(std::string const &remote) const {
+        return mRoot + "/" + remote;
+    }
+
+public:
+    explicit LocalHistoryArchiveBackend(std::string const &root) : mRoot(root) {
+    }
+
+    bool
+    canPut() const override {
+        return true;
+    }
+
+    bool
+    getFile(std::string const &remote, std::string const &local) override {
+        return copyFile(path(remote), local);
+    }
+
+    bool
+    putFile(std::string const &local, std::string const &remote) override {
+        // readers never see a partial file
+        auto dest = path(remote);
+        auto tmp = dest + ".tmp";
+        if (!copyFile(local, tmp)) {
+            std::remove(tmp.c_str());
+            return false;
+        }
+        if (std::rename(tmp.c_str(), dest.c_str()) != 0) {
+            CLOG(WARNING, "History") << "Failed renaming " << tmp << " to " << dest;
+            std::remove(tmp.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    bool
+    makeDir(std::string const &remoteDir) override {
+        if (!fs::mkpath(path(remoteDir))) {
+            CLOG(WARNING, "History") << "Failed creating " << path(remoteDir);
+            return false;
+        }
+        return true;
+    }
+};
+
+class HttpHistoryArchiveBackend : public HistoryArchiveBackend {
+    // as many as files downloaded at once, by default
+    static size_t const MAX_IDLE_CONNECTIONS = 16;
+    // a request fails when the server makes no progress for this long
+    static std::chrono::milliseconds
+    timeout() {
+        return std::chrono::seconds(30);
+    }
+
+    std::string const mPrefix;
+    HttpKeepAliveClient mClient;
+
+public:
+    HttpHistoryArchiveBackend(std::string const &host, unsigned short port, std::string const &prefix)
+            : mPrefix(prefix), mClient(host, port, MAX_IDLE_CONNECTIONS, timeout()) {
+    }
+
+    bool
+    canPut() const override {
+        return false;
+    }
+
+    bool
+    getFile(std::string const &remote, std::string const &local) override {
+        auto path = mPrefix + "/" + remote;
+        auto status = mClient.getToFile(path, local);
+        if (status != 200) {
+            CLOG(WARNING, "History") << "GET " << path << " failed with status " << status;
+            std::remove(local.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    bool
+    putFile(std::string const &local, std::string const &remote) override {
+        throw std::runtime_error("http history archives are read only");
+    }
+
+    bool
+    makeDir(std::string const &remoteDir) override {
+        throw std::runtime_error("http history archives are read only");
+    }
+};
+}
+
+std::shared_ptr<HistoryArchiveBackend>
+HistoryArchiveBackend::create(HistoryArchiveConfiguration const &config) {
+    if (!config.mLocalDir.empty()) {
+        return std::make_shared<LocalHistoryArchiveBackend>(config.mLocalDir);
+    }
+    if (config.mUrl.empty()) {
+        return nullptr;
+    }
+
+    // http://host[:port][/prefix]
+    std::string const scheme = "http://";
+    if (config.mUrl.compare(0, scheme.size(), scheme) != 0) {
+        throw std::invalid_argument("history archive '" + config.mName +
+                                    "': only http:// urls are supported");
+    }
+    auto rest = config.mUrl.substr(scheme.size());
+    auto slash = rest.find('/');
+    auto hostPort = rest.substr(0, slash);
+    auto prefix = slash == std::string::npos ? std::string() : rest.substr(slash);
+    while (!prefix.empty() && prefix.back() == '/') {
+        prefix.pop_back();
+    }
+
+    unsigned short port = 80;
+    auto host = hostPort;
+    auto colon = hostPort.find(':');
+    if (colon != std::string::npos) {
+        host = hostPort.substr(0, colon);
+        try {
+            auto p = std::stoul(hostPort.substr(colon + 1));
+            if (p == 0 || p > UINT16_MAX) {
+                throw std::out_of_range("port");
+            }
+            port = static_cast<unsigned short>(p);
+        }
+        catch (std::exception &) {
+            throw std::invalid_argument("history archive '" + config.mName +
+                                        "': bad port in url " + config.mUrl);
+        }
+    }
+    if (host.empty()) {
+        throw std::invalid_argument("history archive '" + config.mName +
+                                    "': no host in url " + config.mUrl);
+    }
+    return std::make_shared<HttpHistoryArchiveBackend>(host, port, prefix);
+}
+}
@@ -55,13 +55,14 @@ HistoryManager::create(Application &app) {
 }
 
 HistoryManagerImpl::HistoryManagerImpl(Application &app)
-        : mApp(app), mWorkDir(nullptr), mPublishWork(nullptr), mPublishSkip(
+        : mApp(app), mWorkDir(nullptr), mPublishWork(nullptr), mCheckpointBuilder(app), mPublishSkip(
         app.getMetrics().newMeter({"history", "publish", "skip"}, "event")), mPublishQueue(
         app.getMetrics().newMeter({"history", "publish", "queue"}, "event")), mPublishDelay(
         app.getMetrics().newMeter({"history", "publish", "delay"}, "event")), mPublishStart(
         app.getMetrics().newMeter({"history", "publish", "start"}, "event")), mPublishSuccess(
         app.getMetrics().newMeter({"history", "publish", "success"}, "event")), mPublishFailure(
-        app.getMetrics().newMeter({"history", "publish", "failure"}, "event")) {
+        app.getMetrics().newMeter({"history", "publish", "failure"}, "event")), mPublishStreamed(
+        app.getMetrics().newMeter({"history", "publish", "streamed"}, "event")) {
 }
 
 HistoryManagerImpl::~HistoryManagerImpl() {
@@ -253,6 +254,32 @@ HistoryManagerImpl::takeSnapshotAndPublish(HistoryArchiveState const &has) {
     mApp.getWorkManager().advanceChildren();
 }
 
+void
+HistoryManagerImpl::appendLedgerToCheckpoint(
+        LedgerHeaderHistoryEntry const &header, TxSetFrame &txSet,
+        TransactionResultSet const &results) {
+    if (!mApp.getConfig().HISTORY_STREAMING_PUBLISH ||
+        !mApp.getHistoryArchiveManager().hasAnyWritableHistoryArchive()) {
+        return;
+    }
+    mCheckpointBuilder.appendLedger(header, txSet, results);
+}
+
+bool
+HistoryManagerImpl::takeCheckpointFiles(uint32_t checkpoint,
+                                        std::string const &ledgerPath,
+                                        std::string const &transactionPath,
+                                        std::string const &transactionResultPath,
+                                        size_t &nHeaders) {
+    if (!mCheckpointBuilder.takeCheckpoint(checkpoint, ledgerPath,
+                                           transactionPath,
+                                           transactionResultPath, nHeaders)) {
+        return false;
+    }
+    mPublishStreamed.mark();
+    return true;
+}
+
 size_t
 HistoryManagerImpl::publishQueuedHistory() {
     std::string state;
@@ -5,6 +5,7 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "bucket/PublishQueueBuckets.h"
+#include "history/CheckpointBuilder.h"
 #include "history/HistoryManager.h"
 #include "util/TmpDir.h"
 #include <memory>
@@ -25,6 +26,7 @@ class HistoryManagerImpl : public HistoryManager {
     std::shared_ptr<Work> mPublishWork;
     PublishQueueBuckets mPublishQueueBuckets;
     bool mPublishQueueBucketsFilled{false};
+    CheckpointBuilder mCheckpointBuilder;
 
     medida::Meter &mPublishSkip;
     medida::Meter &mPublishQueue;
@@ -32,6 +34,7 @@ class HistoryManagerImpl : public HistoryManager {
     medida::Meter &mPublishStart;
     medida::Meter &mPublishSuccess;
     medida::Meter &mPublishFailure;
+    medida::Meter &mPublishStreamed;
 
     PublishQueueBuckets::BucketCount loadBucketsReferencedByPublishQueue();
 
@@ -62,6 +65,15 @@ public:
 
     uint32_t getMaxLedgerQueuedToPublish() override;
 
+    void appendLedgerToCheckpoint(LedgerHeaderHistoryEntry const &header,
+                                  TxSetFrame &txSet,
+                                  TransactionResultSet const &results) override;
+
+    bool takeCheckpointFiles(uint32_t checkpoint, std::string const &ledgerPath,
+                             std::string const &transactionPath,
+                             std::string const &transactionResultPath,
+                             size_t &nHeaders) override;
+
     size_t publishQueuedHistory() override;
 
     std::vector<std::string>
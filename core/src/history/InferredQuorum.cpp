@@ -1,7 +1,7 @@
 #include <xdr/xdr.h>
 #include "history/InferredQuorum.h"
 #include "crypto/SHA.h"
-#include "util/BitsetEnumerator.h"
+#include "scp/QuorumIntersectionChecker.h"
 #include "util/Logging.h"
 #include "xdrpp/marshal.h"
 #include <fstream>
@@ -66,73 +66,6 @@ InferredQuorum::notePubKey(PublicKey const &pk) {
     mPubKeys[pk]++;
 }
 
-static std::shared_ptr<BitsetEnumerator>
-makeQsetEnumerator(SCPQuorumSet const &qset,
-                   std::unordered_map<PublicKey, size_t> const &nodeNumbers) {
-    std::vector<std::shared_ptr<BitsetEnumerator>> innerEnums;
-    for (auto const &v : qset.validators) {
-        auto i = nodeNumbers.find(v);
-        assert(i != nodeNumbers.end());
-        innerEnums.push_back(ConstantEnumerator::bitNumber(i->second));
-    }
-    for (auto const &s : qset.innerSets) {
-        innerEnums.push_back(makeQsetEnumerator(s, nodeNumbers));
-    }
-    return std::make_shared<SelectionEnumerator>(
-            std::make_shared<PermutationEnumerator>(qset.threshold,
-                                                    innerEnums.size()),
-            innerEnums);
-}
-
-static std::shared_ptr<BitsetEnumerator>
-makeSliceEnumerator(InferredQuorum const &iq, PublicKey const &pk,
-                    std::unordered_map<PublicKey, size_t> const &nodeNumbers) {
-    // Enumerating a slice is the cartesian product enumeration of a
-    // constant enumerator (for the node itself) and a selection enumerator
-    // that does n-of-k for its validators and subqsets.
-    std::vector<std::shared_ptr<BitsetEnumerator>> innerEnums;
-
-    auto i = nodeNumbers.find(pk);
-    assert(i != nodeNumbers.end());
-    innerEnums.push_back(ConstantEnumerator::bitNumber(i->second));
-
-    auto qsh = iq.mQsetHashes.find(pk);
-    assert(qsh != iq.mQsetHashes.end());
-
-    auto qs = iq.mQsets.find(qsh->second);
-    assert(qs != iq.mQsets.end());
-
-    innerEnums.push_back(makeQsetEnumerator(qs->second, nodeNumbers));
-    return std::make_shared<CartesianProductEnumerator>(innerEnums);
-}
-
-static bool isQuorum(std::bitset<64> const &q, InferredQuorum const &iq,
-                     std::unordered_map<PublicKey, size_t> const &nodeNumbers,
-                     std::vector<PublicKey> const &revNodeNumbers) {
-    for (size_t i = 0; i < q.size(); ++i) {
-        if (q.test(i)) {
-            auto e = makeSliceEnumerator(iq, revNodeNumbers.at(i), nodeNumbers);
-            if (!e) {
-                return false;
-            }
-            bool containsSliceForE = false;
-            while (*e) {
-                // If we find _any_ slice in e's slices that
-                // is covered by q, we're good.
-                if ((q | **e) == q) {
-                    containsSliceForE = true;
-                    break;
-                }
-                ++(*e);
-            }
-            if (!containsSliceForE) {
-                return false;
-            }
-        }
-    }
-    return true;
-}
-
 bool
 InferredQuorum::checkQuorumIntersection(Config const &cfg) const {
     // Definition (quorum). A set of nodes U ⊆ V in FBAS ⟨V,Q⟩ is a quorum
@@ -143,100 +76,67 @@ InferredQuorum::checkQuorumIntersection(Config const &cfg) const {
     // iff any two of its quorums share a node—i.e., for all quorums U1 and
     // U2, U1 ∩ U2 =/= ∅.
 
-    // Assign a bit-number to each node
-    std::unordered_map<PublicKey, size_t> nodeNumbers;
-    std::vector<PublicKey> revNodeNumbers;
+    // We can't really tell how nodes we don't have qsets for will behave in
+    // a network; they are known to the checker but can't be in a quorum.
+    QuorumIntersectionChecker::QuorumMap qmap;
     for (auto const &n : mPubKeys) {
-        nodeNumbers.insert(std::make_pair(n.first, nodeNumbers.size()));
-        revNodeNumbers.push_back(n.first);
-    }
-
-    // We're (only) going to scan the powerset of the nodes we _have_ qsets
-    // for, which might be significantly fewer than the total set of nodes;
-    // we can't really tell how nodes we don't have qsets for will behave
-    // in a network; we exclude them.
-    std::unordered_set<size_t> nodesWithQsets;
-    std::vector<std::shared_ptr<BitsetEnumerator>> nodeEnumerators;
-    for (auto const &n : mQsetHashes) {
-        assert(mQsets.find(n.second) != mQsets.end());
-        auto i = nodeNumbers.find(n.first);
-        assert(i != nodeNumbers.end());
-        nodesWithQsets.insert(i->second);
-    }
-    for (auto nwq : nodesWithQsets) {
-        nodeEnumerators.push_back(ConstantEnumerator::bitNumber(nwq));
-    }
-
-    // Build an enumerator for the powerset of the nodes we have qsets for;
-    // this will thus return _candidate_ quorums, each of which we'll check
-    // for quorum-ness.
-    SelectionEnumerator quorumCandidateEnumerator(
-            std::make_shared<PowersetEnumerator>(nodeEnumerators.size()),
-            nodeEnumerators);
-
-    assert(nodeEnumerators.size() < 64);
-    uint64_t lim = 1ULL << nodeEnumerators.size();
-    CLOG(INFO, "History") << "Scanning: " << lim
-                          << " possible node subsets (of "
-                          << nodeEnumerators.size() << " nodes with qsets)";
-
-    // Enumerate all the quorums, de-duplicating into a hashset
-    std::unordered_set<uint64_t> allQuorums;
-    while (quorumCandidateEnumerator) {
-        auto bv = *quorumCandidateEnumerator;
-        if (isQuorum(bv, *this, nodeNumbers, revNodeNumbers)) {
-            CLOG(INFO, "History") << "Quorum: " << bv;
-            allQuorums.insert(bv.to_ullong());
-        }
-        ++quorumCandidateEnumerator;
-    }
-
-    // Report what we found.
-    for (auto const &pk : mPubKeys) {
-        if (mQsetHashes.find(pk.first) == mQsetHashes.end()) {
+        SCPQuorumSetPtr qset;
+        auto qsh = mQsetHashes.find(n.first);
+        if (qsh != mQsetHashes.end()) {
+            auto qs = mQsets.find(qsh->second);
+            assert(qs != mQsets.end());
+            qset = std::make_shared<SCPQuorumSet>(qs->second);
+        } else {
             CLOG(WARNING, "History") << "Node without qset: "
-                                     << cfg.toShortString(pk.first);
+                                     << cfg.toShortString(n.first);
         }
+        qmap.emplace(n.first, qset);
     }
-    CLOG(INFO, "History") << "Found " << nodeNumbers.size() << " nodes total";
-    CLOG(INFO, "History") << "Found " << nodeEnumerators.size()
-                          << " nodes with qsets";
-    CLOG(INFO, "History") << "Found " << allQuorums.size() << " quorums";
 
-    bool allOk = true;
-    for (auto const &q : allQuorums) {
-        for (auto const &v : allQuorums) {
-            if (q != v) {
-                if (!(q & v)) {
-                    allOk = false;
-                    CLOG(WARNING, "History")
-                            << "Warning: found pair of non-intersecting quorums";
-                    CLOG(WARNING, "History") << std::bitset<64>(q);
-                    CLOG(WARNING, "History") << "vs.";
-                    CLOG(WARNING, "History") << std::bitset<64>(v);
-                }
+    QuorumIntersectionChecker checker(qmap);
+    bool allOk = checker.networkEnjoysQuorumIntersection();
+
+    CLOG(INFO, "History") << "Found " << qmap.size() << " nodes total";
+    CLOG(INFO, "History") << "Found " << checker.getNodeCount()
+                          << " nodes with qsets";
+    CLOG(INFO, "History") << "Checked " << checker.getMinimalQuorumsChecked()
+                          << " minimal quorums";
+
+    auto logNodes = [&](std::vector<NodeID> const &nodes) {
+        for (auto const &n : nodes) {
+            auto isAlias = false;
+            auto name = cfg.toStrKey(n, isAlias);
+            if (allOk) {
+                CLOG(INFO, "History") << "  \"" << (isAlias ? "$" : "")
+                                      << name << '"';
+            } else {
+                CLOG(WARNING, "History") << "  \"" << (isAlias ? "$" : "")
+                                         << name << '"';
             }
         }
-    }
+    };
 
+    std::vector<NodeID> withQsets;
+    for (auto const &q : qmap) {
+        if (q.second) {
+            withQsets.emplace_back(q.first);
+        }
+    }
     if (allOk) {
-        CLOG(INFO, "History") << "Network of " << nodeEnumerators.size()
+        CLOG(INFO, "History") << "Network of " << withQsets.size()
                               << " nodes enjoys quorum intersection: ";
+        logNodes(withQsets);
     } else {
         CLOG(WARNING, "History")
-                << "Network of " << nodeEnumerators.size()
+                << "Network of " << withQsets.size()
                 << " nodes DOES NOT enjoy quorum intersection: ";
-    }
-    for (auto n : nodesWithQsets) {
-        auto isAlias = false;
-        auto name = cfg.toStrKey(revNodeNumbers.at(n), isAlias);
-        if (allOk) {
-            CLOG(INFO, "History") << "  \"" << (isAlias ? "$" : "") << name
-                                  << '"';
-        } else {
-            CLOG(WARNING, "History") << "  \"" << (isAlias ? "$" : "") << name
-                                     << '"';
-        }
+        logNodes(withQsets);
+        auto split = checker.getPotentialSplit();
+        CLOG(WARNING, "History")
+                << "Warning: found pair of non-intersecting quorums";
+        logNodes(split.first);
+        CLOG(WARNING, "History") << "vs.";
+        logNodes(split.second);
     }
     return allOk;
 }
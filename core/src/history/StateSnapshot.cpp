@@ -53,17 +53,12 @@ StateSnapshot::writeHistoryBlocks() const {
     // headers, one TransactionHistoryEntry (which contain txSets),
     // one TransactionHistoryResultEntry containing transaction set results and
     // one (optional) SCPHistoryEntry containing the SCP messages used to close.
-    // All files are streamed out of the database, entry-by-entry.
+    // All files are streamed out of the database, entry-by-entry, unless the
+    // first three were written as the ledgers closed (see CheckpointBuilder).
     size_t nbSCPMessages;
     uint32_t begin, count;
     size_t nHeaders;
     {
-        XDROutputFileStream ledgerOut, txOut, txResultOut, scpHistory;
-        ledgerOut.open(mLedgerSnapFile->localPath_nogz());
-        txOut.open(mTransactionSnapFile->localPath_nogz());
-        txResultOut.open(mTransactionResultSnapFile->localPath_nogz());
-        scpHistory.open(mSCPHistorySnapFile->localPath_nogz());
-
         // 'mLocalState' describes the LCL, so its currentLedger will usually be
         // 63,
         // 127, 191, etc. We want to start our snapshot at 64-before the _next_
@@ -73,21 +68,42 @@ StateSnapshot::writeHistoryBlocks() const {
                 mLocalState.currentLedger);
 
         count = (mLocalState.currentLedger - begin) + 1;
-        CLOG(DEBUG, "History") << "Streaming " << count
-                               << " ledgers worth of history, from " << begin;
 
-        nHeaders = LedgerHeaderFrame::copyLedgerHeadersToStream(
-                mApp.getDatabase(), sess, begin, count, ledgerOut);
-        size_t nTxs = TransactionFrame::copyTransactionsToStream(
-                mApp.getNetworkID(), mApp.getDatabase(), sess, begin, count, txOut,
-                txResultOut);
-        CLOG(DEBUG, "History") << "Wrote " << nHeaders << " ledger headers to "
-                               << mLedgerSnapFile->localPath_nogz();
-        CLOG(DEBUG, "History") << "Wrote " << nTxs << " transactions to "
-                               << mTransactionSnapFile->localPath_nogz()
-                               << " and "
-                               << mTransactionResultSnapFile->localPath_nogz();
+        // With HISTORY_STREAMING_PUBLISH, the ledger headers, transactions and
+        // results may have been written as the checkpoint's ledgers closed.
+        if (mApp.getHistoryManager().takeCheckpointFiles(
+                mLocalState.currentLedger, mLedgerSnapFile->localPath_nogz(),
+                mTransactionSnapFile->localPath_nogz(),
+                mTransactionResultSnapFile->localPath_nogz(), nHeaders)) {
+            CLOG(DEBUG, "History") << "Took " << count
+                                   << " ledgers worth of history, from "
+                                   << begin << ", written as they closed";
+        } else {
+            XDROutputFileStream ledgerOut, txOut, txResultOut;
+            ledgerOut.open(mLedgerSnapFile->localPath_nogz());
+            txOut.open(mTransactionSnapFile->localPath_nogz());
+            txResultOut.open(mTransactionResultSnapFile->localPath_nogz());
+
+            CLOG(DEBUG, "History") << "Streaming " << count
+                                   << " ledgers worth of history, from "
+                                   << begin;
 
+            nHeaders = LedgerHeaderFrame::copyLedgerHeadersToStream(
+                    mApp.getDatabase(), sess, begin, count, ledgerOut);
+            size_t nTxs = TransactionFrame::copyTransactionsToStream(
+                    mApp.getNetworkID(), mApp.getDatabase(), sess, begin, count,
+                    txOut, txResultOut);
+            CLOG(DEBUG, "History") << "Wrote " << nHeaders
+                                   << " ledger headers to "
+                                   << mLedgerSnapFile->localPath_nogz();
+            CLOG(DEBUG, "History") << "Wrote " << nTxs << " transactions to "
+                                   << mTransactionSnapFile->localPath_nogz()
+                                   << " and "
+                                   << mTransactionResultSnapFile->localPath_nogz();
+        }
+
+        XDROutputFileStream scpHistory;
+        scpHistory.open(mSCPHistorySnapFile->localPath_nogz());
         nbSCPMessages = HerderPersistence::copySCPHistoryToStream(
                 mApp.getDatabase(), sess, begin, count, scpHistory);
 
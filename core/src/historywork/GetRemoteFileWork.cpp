@@ -4,6 +4,7 @@
 
 #include "historywork/GetRemoteFileWork.h"
 #include "history/HistoryArchive.h"
+#include "history/HistoryArchiveBackend.h"
 #include "history/HistoryArchiveManager.h"
 #include "history/HistoryManager.h"
 #include "application/Application.h"
@@ -32,7 +33,20 @@ GetRemoteFileWork::getCommand(std::string &cmdLine, std::string &outFile) {
     }
     assert(mCurrentArchive);
     assert(mCurrentArchive->hasGetCmd());
-    cmdLine = mCurrentArchive->getFileCmd(mRemote, mLocal);
+    if (!mCurrentArchive->getBackend()) {
+        cmdLine = mCurrentArchive->getFileCmd(mRemote, mLocal);
+    }
+}
+
+std::function<bool()>
+GetRemoteFileWork::getInProcessCommand() {
+    auto backend = mCurrentArchive->getBackend();
+    if (!backend) {
+        return nullptr;
+    }
+    auto remote = mRemote;
+    auto local = mLocal;
+    return [backend, remote, local]() { return backend->getFile(remote, local); };
 }
 
 void
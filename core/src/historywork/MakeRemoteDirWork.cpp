@@ -4,6 +4,7 @@
 
 #include "historywork/MakeRemoteDirWork.h"
 #include "history/HistoryArchive.h"
+#include "history/HistoryArchiveBackend.h"
 #include "application/Application.h"
 
 namespace vixal {
@@ -21,11 +22,22 @@ MakeRemoteDirWork::~MakeRemoteDirWork() {
 
 void
 MakeRemoteDirWork::getCommand(std::string &cmdLine, std::string &outFile) {
-    if (mArchive->hasMkdirCmd()) {
+    auto backend = mArchive->getBackend();
+    if (mArchive->hasMkdirCmd() && (!backend || !backend->canPut())) {
         cmdLine = mArchive->mkdirCmd(mDir);
     }
 }
 
+std::function<bool()>
+MakeRemoteDirWork::getInProcessCommand() {
+    auto backend = mArchive->getBackend();
+    if (!backend || !backend->canPut()) {
+        return nullptr;
+    }
+    auto dir = mDir;
+    return [backend, dir]() { return backend->makeDir(dir); };
+}
+
 Work::State
 MakeRemoteDirWork::onSuccess() {
     mArchive->markSuccess();
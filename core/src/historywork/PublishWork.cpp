@@ -40,6 +40,11 @@ PublishWork::getStatus() const {
     return Work::getStatus();
 }
 
+ProcessClass
+PublishWork::getProcessClass() const {
+    return PROCESS_PUBLISH;
+}
+
 void
 PublishWork::onReset() {
     clearChildren();
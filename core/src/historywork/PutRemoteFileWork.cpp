@@ -4,6 +4,7 @@
 
 #include "historywork/PutRemoteFileWork.h"
 #include "history/HistoryArchive.h"
+#include "history/HistoryArchiveBackend.h"
 #include "application/Application.h"
 
 namespace vixal {
@@ -24,7 +25,21 @@ PutRemoteFileWork::~PutRemoteFileWork() {
 
 void
 PutRemoteFileWork::getCommand(std::string &cmdLine, std::string &outFile) {
-    cmdLine = mArchive->putFileCmd(mLocal, mRemote);
+    auto backend = mArchive->getBackend();
+    if (!backend || !backend->canPut()) {
+        cmdLine = mArchive->putFileCmd(mLocal, mRemote);
+    }
+}
+
+std::function<bool()>
+PutRemoteFileWork::getInProcessCommand() {
+    auto backend = mArchive->getBackend();
+    if (!backend || !backend->canPut()) {
+        return nullptr;
+    }
+    auto local = mLocal;
+    auto remote = mRemote;
+    return [backend, local, remote]() { return backend->putFile(local, remote); };
 }
 
 Work::State
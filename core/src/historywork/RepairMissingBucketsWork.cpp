@@ -22,6 +22,11 @@ RepairMissingBucketsWork::~RepairMissingBucketsWork() {
     clearChildren();
 }
 
+ProcessClass
+RepairMissingBucketsWork::getProcessClass() const {
+    return PROCESS_REPAIR;
+}
+
 void
 RepairMissingBucketsWork::onReset() {
     BucketDownloadWork::onReset();
@@ -17,12 +17,28 @@ RunCommandWork::~RunCommandWork() {
     clearChildren();
 }
 
+std::function<bool()>
+RunCommandWork::getInProcessCommand() {
+    return nullptr;
+}
+
 void
 RunCommandWork::onStart() {
     std::string cmd, outfile;
     getCommand(cmd, outfile);
-    if (!cmd.empty()) {
-        auto exit = mApp.getProcessManager().runProcess(cmd, outfile);
+    auto action = getInProcessCommand();
+    if (action) {
+        Application &app = mApp;
+        auto handler = callComplete();
+        asio::post(app.getTransferIOContext(), [&app, action, handler]() {
+            asio::error_code ec;
+            if (!action()) {
+                ec = std::make_error_code(std::errc::io_error);
+            }
+            asio::post(app.getClock().io_context(), [ec, handler]() { handler(ec); });
+        });
+    } else if (!cmd.empty()) {
+        auto exit = mApp.getProcessManager().runProcess(cmd, outfile, getProcessClass());
         exit.async_wait(callComplete());
     } else {
         scheduleSuccess();
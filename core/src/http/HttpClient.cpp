@@ -3,6 +3,10 @@
 // else.
 #include "util/asio.h"
 
+#include "http/HttpClient.h"
+#include <algorithm>
+#include <fstream>
+#include <functional>
 #include <iostream>
 #include "util/Logging.h"
 
@@ -87,3 +91,279 @@ http_request(const std::string &domain, const std::string &path, unsigned short
         return 1;
     }
 }
+
+struct HttpKeepAliveClient::Connection {
+    asio::io_context mIoContext;
+    asio::ip::tcp::socket mSocket;
+    std::chrono::milliseconds const mTimeout;
+
+    explicit Connection(std::chrono::milliseconds timeout)
+            : mSocket(mIoContext), mTimeout(timeout) {
+    }
+
+    // runs the asynchronous operation `start` begins with a completion
+    // handler; the socket is closed if it doesn't complete within mTimeout
+    template <typename Start>
+    asio::error_code
+    run(Start start) {
+        asio::error_code error = asio::error::would_block;
+        start([&error](asio::error_code const &ec) { error = ec; });
+        mIoContext.restart();
+        mIoContext.run_for(mTimeout);
+        if (!mIoContext.stopped()) {
+            mSocket.close();
+            mIoContext.run();
+            error = asio::error::timed_out;
+        }
+        return error;
+    }
+
+    void
+    check(asio::error_code const &ec) {
+        if (ec) {
+            throw asio::system_error(ec);
+        }
+    }
+
+    void
+    connect(std::string const &host, unsigned short port) {
+        asio::ip::tcp::resolver resolver(mIoContext);
+        asio::ip::tcp::resolver::results_type endpoints;
+        check(run([&](std::function<void(asio::error_code const &)> done) {
+            resolver.async_resolve(
+                    host, std::to_string(port),
+                    [&endpoints, done](asio::error_code const &ec,
+                                       asio::ip::tcp::resolver::results_type r) {
+                        endpoints = r;
+                        done(ec);
+                    });
+        }));
+        check(run([&](std::function<void(asio::error_code const &)> done) {
+            asio::async_connect(mSocket, endpoints,
+                                [done](asio::error_code const &ec,
+                                       asio::ip::tcp::endpoint const &) {
+                                    done(ec);
+                                });
+        }));
+    }
+
+    void
+    write(asio::streambuf &request) {
+        check(run([&](std::function<void(asio::error_code const &)> done) {
+            asio::async_write(mSocket, request,
+                              [done](asio::error_code const &ec, size_t) {
+                                  done(ec);
+                              });
+        }));
+    }
+
+    void
+    readUntil(asio::streambuf &response, std::string const &delim) {
+        check(run([&](std::function<void(asio::error_code const &)> done) {
+            asio::async_read_until(mSocket, response, delim,
+                                   [done](asio::error_code const &ec, size_t) {
+                                       done(ec);
+                                   });
+        }));
+    }
+
+    // reads at least one more byte into `response`; returns false at the
+    // end of the stream
+    bool
+    readMore(asio::streambuf &response) {
+        auto ec = run([&](std::function<void(asio::error_code const &)> done) {
+            asio::async_read(mSocket, response, asio::transfer_at_least(1),
+                             [done](asio::error_code const &ec, size_t) {
+                                 done(ec);
+                             });
+        });
+        if (ec == asio::error::eof) {
+            return false;
+        }
+        check(ec);
+        return true;
+    }
+
+    std::string
+    readLine(asio::streambuf &response) {
+        readUntil(response, "\r\n");
+        std::istream in(&response);
+        std::string line;
+        std::getline(in, line);
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        return line;
+    }
+
+    // copies `n` bytes of body, starting with what is already in `response`
+    void
+    copyBody(asio::streambuf &response, std::ostream &out, size_t n) {
+        std::istream in(&response);
+        char buf[4096];
+        while (n > 0) {
+            if (response.size() == 0 && !readMore(response)) {
+                throw asio::system_error(asio::error::eof);
+            }
+            auto k = std::min({n, response.size(), sizeof(buf)});
+            in.read(buf, k);
+            out.write(buf, k);
+            n -= k;
+        }
+    }
+};
+
+HttpKeepAliveClient::HttpKeepAliveClient(std::string const &host, unsigned short port, size_t maxIdle,
+                                         std::chrono::milliseconds timeout)
+        : mHost(host), mPort(port), mMaxIdle(maxIdle), mTimeout(timeout), mConnectionsOpened(0) {
+}
+
+HttpKeepAliveClient::~HttpKeepAliveClient() {
+}
+
+std::unique_ptr<HttpKeepAliveClient::Connection>
+HttpKeepAliveClient::takeConnection(bool &reused) {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!mIdle.empty()) {
+            auto conn = std::move(mIdle.back());
+            mIdle.pop_back();
+            reused = true;
+            return conn;
+        }
+    }
+
+    reused = false;
+    auto conn = std::make_unique<Connection>(mTimeout);
+    conn->connect(mHost, mPort);
+    ++mConnectionsOpened;
+    return conn;
+}
+
+void
+HttpKeepAliveClient::releaseConnection(std::unique_ptr<Connection> conn) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mIdle.size() < mMaxIdle) {
+        mIdle.emplace_back(std::move(conn));
+    }
+}
+
+int
+HttpKeepAliveClient::get(Connection &conn, std::string const &path, std::string const &filename,
+                         bool &gotResponse, bool &keepAlive) {
+    asio::streambuf request;
+    std::ostream request_stream(&request);
+    request_stream << "GET " << path << " HTTP/1.1\r\n";
+    request_stream << "Host: " << mHost << "\r\n";
+    request_stream << "Accept: */*\r\n";
+    request_stream << "Connection: keep-alive\r\n\r\n";
+    conn.write(request);
+
+    asio::streambuf response;
+    conn.readUntil(response, "\r\n\r\n");
+    gotResponse = true;
+
+    std::istringstream status_line(conn.readLine(response));
+    std::string http_version;
+    unsigned int status_code = 0;
+    status_line >> http_version >> status_code;
+    if (!status_line || http_version.substr(0, 5) != "HTTP/") {
+        LOG(DEBUG) << "Invalid response";
+        return 1;
+    }
+
+    bool close = http_version != "HTTP/1.1";
+    bool chunked = false;
+    bool hasLength = false;
+    size_t length = 0;
+    for (auto header = conn.readLine(response); !header.empty(); header = conn.readLine(response)) {
+        auto colon = header.find(':');
+        if (colon == std::string::npos) {
+            continue;
+        }
+        auto name = header.substr(0, colon);
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        auto value = header.substr(header.find_first_not_of(' ', colon + 1));
+        std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+        if (name == "content-length") {
+            hasLength = true;
+            length = std::stoull(value);
+        } else if (name == "transfer-encoding") {
+            chunked = value.find("chunked") != std::string::npos;
+        } else if (name == "connection") {
+            close = close || value == "close";
+        }
+    }
+
+    if (status_code != 200) {
+        LOG(DEBUG) << "Response returned with status code " << status_code;
+        return status_code;
+    }
+
+    std::ofstream out(filename, std::ofstream::binary | std::ofstream::trunc);
+    if (!out) {
+        LOG(DEBUG) << "Can't open " << filename;
+        return 1;
+    }
+    if (chunked) {
+        for (;;) {
+            auto size = std::stoull(conn.readLine(response), nullptr, 16);
+            if (size == 0) {
+                // trailers, up to an empty line
+                while (!conn.readLine(response).empty()) {
+                }
+                break;
+            }
+            conn.copyBody(response, out, size);
+            conn.readLine(response);
+        }
+    } else if (hasLength) {
+        conn.copyBody(response, out, length);
+    } else {
+        // the body ends with the connection
+        close = true;
+        out << &response;
+        while (conn.readMore(response)) {
+            out << &response;
+        }
+    }
+    out.close();
+    if (!out) {
+        LOG(DEBUG) << "Can't write " << filename;
+        return 1;
+    }
+
+    keepAlive = !close;
+    return 200;
+}
+
+int
+HttpKeepAliveClient::getToFile(std::string const &path, std::string const &filename) {
+    // a connection that was idle may have been closed by the server, in which
+    // case the request is made again on a new one
+    for (;;) {
+        bool reused = false;
+        bool gotResponse = false;
+        try {
+            auto conn = takeConnection(reused);
+            bool keepAlive = false;
+            auto status = get(*conn, path, filename, gotResponse, keepAlive);
+            if (keepAlive) {
+                releaseConnection(std::move(conn));
+            }
+            return status;
+        }
+        catch (std::exception &e) {
+            if (reused && !gotResponse) {
+                continue;
+            }
+            LOG(DEBUG) << "Exception: " << e.what();
+            return 1;
+        }
+    }
+}
+
+size_t
+HttpKeepAliveClient::getConnectionsOpened() const {
+    return mConnectionsOpened;
+}
@@ -25,6 +25,11 @@ AccountSubEntriesCountIsValid::getName() const {
     return "AccountSubEntriesCountIsValid";
 }
 
+bool
+AccountSubEntriesCountIsValid::canCheckInBackground() const {
+    return true;
+}
+
 std::string
 AccountSubEntriesCountIsValid::checkOnOperationApply(
         Operation const &operation, OperationResult const &result,
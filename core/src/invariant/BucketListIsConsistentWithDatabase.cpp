@@ -5,6 +5,7 @@
 #include <bucket/BucketInputIterator.h>
 #include "invariant/BucketListIsConsistentWithDatabase.h"
 #include "bucket/Bucket.h"
+#include "bucket/BucketDatabaseComparison.h"
 #include "database/Database.h"
 #include "invariant/InvariantManager.h"
 #include "ledger/DataFrame.h"
@@ -38,7 +39,6 @@ BucketListIsConsistentWithDatabase::checkOnBucketApply(
         std::shared_ptr<Bucket const> bucket, uint32_t oldestLedger,
         uint32_t newestLedger) {
 
-    uint64_t nAccounts = 0, nTrustLines = 0, nOffers = 0, nData = 0;
     bool hasPreviousEntry = false;
     BucketEntry previousEntry;
     for (BucketInputIterator iter(bucket); iter; ++iter) {
@@ -69,59 +69,39 @@ BucketListIsConsistentWithDatabase::checkOnBucketApply(
                 s += xdr::xdr_to_string(e.liveEntry(), "live");
                 return s;
             }
-
-            switch (e.liveEntry().data.type()) {
-                case ACCOUNT:
-                    ++nAccounts;
-                    break;
-                case TRUSTLINE:
-                    ++nTrustLines;
-                    break;
-                case OFFER:
-                    ++nOffers;
-                    break;
-                case DATA:
-                    ++nData;
-                    break;
-                default:
-                    abort();
-            }
-            auto s = EntryFrame::checkAgainstDatabase(e.liveEntry(), mDb);
-            if (!s.empty()) {
-                return s;
-            }
-        } else if (e.type() == DEADENTRY) {
-            if (EntryFrame::exists(mDb, e.deadEntry())) {
-                auto fromDb = EntryFrame::storeLoad(e.deadEntry(), mDb);
-                std::string s = "Entry with type DEADENTRY found in database ";
-                s += xdr::xdr_to_string(fromDb->mEntry, "db");
-                return s;
-            }
         }
     }
 
+    // the entries are compared with the database once we know they are in
+    // order and in the right ledger range
+    BucketEntryCounts counts;
+    auto s = compareBucketWithDatabase(bucket, mDb, counts);
+    if (!s.empty()) {
+        return s;
+    }
+
     auto &sess = mDb.getSession();
     std::string countFormat = "Incorrect {} count: Bucket = {} Database = {}";
     uint64_t nAccountsInDb =
             AccountFrame::countObjects(sess, {oldestLedger, newestLedger});
-    if (nAccountsInDb != nAccounts) {
-        return fmt::format(countFormat, "Account", nAccounts, nAccountsInDb);
+    if (nAccountsInDb != counts.mAccounts) {
+        return fmt::format(countFormat, "Account", counts.mAccounts, nAccountsInDb);
     }
     uint64_t nTrustLinesInDb =
             TrustFrame::countObjects(sess, {oldestLedger, newestLedger});
-    if (nTrustLinesInDb != nTrustLines) {
-        return fmt::format(countFormat, "TrustLine", nTrustLines,
+    if (nTrustLinesInDb != counts.mTrustLines) {
+        return fmt::format(countFormat, "TrustLine", counts.mTrustLines,
                            nTrustLinesInDb);
     }
     uint64_t nOffersInDb =
             OfferFrame::countObjects(sess, {oldestLedger, newestLedger});
-    if (nOffersInDb != nOffers) {
-        return fmt::format(countFormat, "Offer", nOffers, nOffersInDb);
+    if (nOffersInDb != counts.mOffers) {
+        return fmt::format(countFormat, "Offer", counts.mOffers, nOffersInDb);
     }
     uint64_t nDataInDb =
             DataFrame::countObjects(sess, {oldestLedger, newestLedger});
-    if (nDataInDb != nData) {
-        return fmt::format(countFormat, "Data", nData, nDataInDb);
+    if (nDataInDb != counts.mData) {
+        return fmt::format(countFormat, "Data", counts.mData, nDataInDb);
     }
     return {};
 }
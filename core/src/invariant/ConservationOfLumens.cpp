@@ -23,6 +23,11 @@ ConservationOfLumens::getName() const {
     return "ConservationOfLumens";
 }
 
+bool
+ConservationOfLumens::canCheckInBackground() const {
+    return true;
+}
+
 int64_t
 ConservationOfLumens::calculateDeltaBalance(LedgerEntry const *current,
                                             LedgerEntry const *previous) const {
@@ -2,9 +2,11 @@
 // under the Apache License, Version 2.0. See the COPYING file at the root
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
+#include "util/asio.h"
 #include "InvariantManagerImpl.h"
 #include "bucket/Bucket.h"
 #include "bucket/BucketList.h"
+#include "crypto/Hex.h"
 #include "invariant/Invariant.h"
 #include "invariant/CacheIsConsistentWithDatabase.h"
 #include "invariant/InvariantDoesNotHold.h"
@@ -12,6 +14,8 @@
 #include "util/format.h"
 #include "xdrpp/printer.h"
 #include "application/Application.h"
+#include "application/Config.h"
+#include "util/Logging.h"
 
 #include <memory>
 #include <numeric>
@@ -19,16 +23,30 @@
 
 #include "medida/counter.h"
 #include "medida/metrics_registry.h"
+#include "medida/timer.h"
 
 namespace vixal {
 
 std::unique_ptr<InvariantManager>
 InvariantManager::create(Application &app) {
-    return std::make_unique<InvariantManagerImpl>(app.getMetrics());
+    return std::make_unique<InvariantManagerImpl>(app);
 }
 
-InvariantManagerImpl::InvariantManagerImpl(medida::MetricsRegistry &registry)
-        : mMetricsRegistry(registry) {
+InvariantManagerImpl::InvariantManagerImpl(Application &app)
+        : mApp(app), mMetricsRegistry(app.getMetrics()),
+          mBackgroundCheckTimer(app.getMetrics().newTimer({"invariant", "background", "check"})),
+          mLedgerCommitWaitTimer(app.getMetrics().newTimer({"invariant", "background", "commit-wait"})) {
+    if (app.getConfig().INVARIANT_CHECKS_ASYNC) {
+        mBackgroundChecks = std::make_shared<BackgroundChecks>();
+        mBackgroundChecks->mManager = this;
+    }
+}
+
+InvariantManagerImpl::~InvariantManagerImpl() {
+    // checks still running can't report to us anymore
+    if (mBackgroundChecks) {
+        mBackgroundChecks->mManager = nullptr;
+    }
 }
 
 Json::Value
@@ -38,6 +56,7 @@ InvariantManagerImpl::getJsonInfo() {
         auto &counter = mMetricsRegistry.newCounter(
                 {"invariant", "does-not-hold", "count", invariant.first});
         if (counter.count() > 0) {
+            std::lock_guard<std::mutex> lock(mFailureInformationMutex);
             auto const &info = mFailureInformation.at(invariant.first);
 
             auto &fail = failures[invariant.first];
@@ -82,27 +101,152 @@ InvariantManagerImpl::checkOnBucketApply(std::shared_ptr<Bucket const> bucket,
     }
 }
 
+std::string
+InvariantManagerImpl::operationFailureMessage(Invariant const &invariant,
+                                              std::string const &result,
+                                              Operation const &operation,
+                                              uint32_t ledger,
+                                              Hash const &txHash,
+                                              size_t opIndex) {
+    return fmt::format(
+            R"(Invariant "{}" does not hold on operation {} of transaction {} in ledger {}: {}{}{})",
+            invariant.getName(), opIndex, hexAbbrev(txHash), ledger, result,
+            "\n", xdr::xdr_to_string(operation));
+}
+
 void
 InvariantManagerImpl::checkOnOperationApply(Operation const &operation,
                                             OperationResult const &opres,
-                                            LedgerDelta const &delta) {
+                                            LedgerDelta const &delta,
+                                            Hash const &txHash,
+                                            size_t opIndex) {
     if (delta.getHeader().ledgerVersion < 8) {
         return;
     }
 
+    auto ledger = delta.getHeader().ledgerSeq;
+    std::vector<std::shared_ptr<Invariant>> background;
     for (const auto &invariant : mEnabled) {
+        if (mBackgroundChecks && invariant->canCheckInBackground()) {
+            background.emplace_back(invariant);
+            continue;
+        }
+
         auto result = invariant->checkOnOperationApply(operation, opres, delta);
         if (result.empty()) {
             continue;
         }
 
-        auto message = fmt::format(
-                R"(Invariant "{}" does not hold on operation: {}{}{})",
-                invariant->getName(), result, "\n", xdr::xdr_to_string(operation));
-        onInvariantFailure(invariant, message, delta.getHeader().ledgerSeq);
+        auto message = operationFailureMessage(*invariant, result, operation,
+                                               ledger, txHash, opIndex);
+        onInvariantFailure(invariant, message, ledger);
+    }
+
+    if (!background.empty()) {
+        checkInBackground(std::move(background), operation, opres, delta,
+                          txHash, opIndex);
+    }
+}
+
+void
+InvariantManagerImpl::checkInBackground(
+        std::vector<std::shared_ptr<Invariant>> invariants,
+        Operation const &operation, OperationResult const &opres,
+        LedgerDelta const &delta, Hash const &txHash, size_t opIndex) {
+    auto ledger = delta.getHeader().ledgerSeq;
+    auto snapshot = delta.snapshot();
+    auto checks = mBackgroundChecks;
+    {
+        std::lock_guard<std::mutex> lock(checks->mMutex);
+        ++checks->mPending[ledger];
+    }
+
+    // the job only holds copies and the shared state, the manager may be
+    // gone by the time it is done
+    VirtualClock &clock = mApp.getClock();
+    medida::Timer &checkTimer = mBackgroundCheckTimer;
+    asio::post(mApp.io_context(), [&clock, &checkTimer, checks, invariants,
+                                   operation, opres, snapshot, txHash, opIndex,
+                                   ledger]() {
+        std::vector<Failure> failures;
+        {
+            auto timer = checkTimer.timeScope();
+            for (auto const &invariant : invariants) {
+                std::string result;
+                try {
+                    result = invariant->checkOnOperationApply(operation, opres,
+                                                              *snapshot);
+                } catch (std::exception &e) {
+                    result = fmt::format("exception while checking: {}",
+                                         e.what());
+                }
+                if (!result.empty()) {
+                    failures.push_back(
+                            {invariant,
+                             operationFailureMessage(*invariant, result,
+                                                     operation, ledger,
+                                                     txHash, opIndex),
+                             ledger});
+                }
+            }
+        }
+
+        bool failed = !failures.empty();
+        {
+            std::lock_guard<std::mutex> lock(checks->mMutex);
+            auto it = checks->mPending.find(ledger);
+            if (--it->second == 0) {
+                checks->mPending.erase(it);
+            }
+            for (auto &f : failures) {
+                checks->mFailures.emplace_back(std::move(f));
+            }
+        }
+        checks->mDone.notify_all();
+
+        if (failed) {
+            std::weak_ptr<BackgroundChecks> weak = checks;
+            asio::post(clock.io_context(), [weak]() {
+                auto c = weak.lock();
+                if (c && c->mManager) {
+                    c->mManager->reportBackgroundFailures();
+                }
+            });
+        }
+    });
+}
+
+void
+InvariantManagerImpl::checkOnLedgerCommit(uint32_t ledger) {
+    if (!mBackgroundChecks) {
+        return;
     }
+
+    auto maxLag = mApp.getConfig().INVARIANT_CHECKS_MAX_LAG;
+    if (ledger > maxLag) {
+        auto lastToCheck = ledger - static_cast<uint32_t>(maxLag);
+        auto &checks = *mBackgroundChecks;
+        auto timer = mLedgerCommitWaitTimer.timeScope();
+        std::unique_lock<std::mutex> lock(checks.mMutex);
+        checks.mDone.wait(lock, [&]() {
+            return checks.mPending.empty() ||
+                   checks.mPending.begin()->first > lastToCheck;
+        });
+    }
+    reportBackgroundFailures();
 }
 
+void
+InvariantManagerImpl::reportBackgroundFailures() {
+    std::vector<Failure> failures;
+    {
+        std::lock_guard<std::mutex> lock(mBackgroundChecks->mMutex);
+        failures.swap(mBackgroundChecks->mFailures);
+    }
+    for (auto const &f : failures) {
+        onInvariantFailure(f.mInvariant, f.mMessage, f.mLedger);
+    }
+}
 
 void
 InvariantManagerImpl::registerInvariant(std::shared_ptr<Invariant> invariant) {
@@ -168,9 +312,12 @@ void
 InvariantManagerImpl::onInvariantFailure(std::shared_ptr<Invariant> invariant,
                                          std::string const &message,
                                          uint32_t ledger) {
+    {
+        std::lock_guard<std::mutex> lock(mFailureInformationMutex);
+        mFailureInformation[invariant->getName()].lastFailedOnLedger = ledger;
+        mFailureInformation[invariant->getName()].lastFailedWithMessage = message;
+    }
     mMetricsRegistry.newCounter({"invariant", "does-not-hold", "count", invariant->getName()}).inc();
-    mFailureInformation[invariant->getName()].lastFailedOnLedger = ledger;
-    mFailureInformation[invariant->getName()].lastFailedWithMessage = message;
     handleInvariantFailure(invariant, message);
 }
 
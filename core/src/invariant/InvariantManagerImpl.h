@@ -5,16 +5,21 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "invariant/InvariantManager.h"
+#include <condition_variable>
 #include <map>
+#include <mutex>
 #include <vector>
 
 namespace medida {
 class MetricsRegistry;
+
+class Timer;
 }
 
 namespace vixal {
 
 class InvariantManagerImpl : public InvariantManager {
+    Application &mApp;
     std::map<std::string, std::shared_ptr<Invariant>> mInvariants;
     std::vector<std::shared_ptr<Invariant>> mEnabled;
     medida::MetricsRegistry &mMetricsRegistry;
@@ -23,18 +28,50 @@ class InvariantManagerImpl : public InvariantManager {
         uint32_t lastFailedOnLedger;
         std::string lastFailedWithMessage;
     };
+    // failures can be reported by the threads applying clusters of
+    // transactions
+    std::mutex mFailureInformationMutex;
     std::map<std::string, InvariantFailureInformation> mFailureInformation;
 
+    struct Failure {
+        std::shared_ptr<Invariant> mInvariant;
+        std::string mMessage;
+        uint32_t mLedger;
+    };
+
+    // state shared with the checks running on the worker threads
+    struct BackgroundChecks {
+        std::mutex mMutex;
+        std::condition_variable mDone;
+        // number of operations being checked, by ledger
+        std::map<uint32_t, size_t> mPending;
+        std::vector<Failure> mFailures;
+        // only used on the main thread, cleared when the manager goes away
+        InvariantManagerImpl *mManager;
+    };
+
+    // null unless INVARIANT_CHECKS_ASYNC
+    std::shared_ptr<BackgroundChecks> mBackgroundChecks;
+    medida::Timer &mBackgroundCheckTimer;
+    medida::Timer &mLedgerCommitWaitTimer;
+
 public:
-    explicit InvariantManagerImpl(medida::MetricsRegistry &registry);
+    explicit InvariantManagerImpl(Application &app);
+
+    ~InvariantManagerImpl() override;
 
     Json::Value getJsonInfo() override;
 
     virtual std::vector<std::string> getEnabledInvariants() const override;
 
+    using InvariantManager::checkOnOperationApply;
+
     void checkOnOperationApply(Operation const &operation,
                                OperationResult const &opres,
-                               LedgerDelta const &delta) override;
+                               LedgerDelta const &delta, Hash const &txHash,
+                               size_t opIndex) override;
+
+    void checkOnLedgerCommit(uint32_t ledger) override;
 
     void
     checkOnBucketApply(std::shared_ptr<Bucket const> bucket, uint32_t ledger, uint32_t level, bool isCurr) override;
@@ -44,6 +81,22 @@ public:
     void enableInvariant(std::string const &name) override;
 
 private:
+    static std::string
+    operationFailureMessage(Invariant const &invariant,
+                            std::string const &result,
+                            Operation const &operation, uint32_t ledger,
+                            Hash const &txHash, size_t opIndex);
+
+    // checks `invariants` on a snapshot of `delta` on a worker thread
+    void checkInBackground(std::vector<std::shared_ptr<Invariant>> invariants,
+                           Operation const &operation,
+                           OperationResult const &opres,
+                           LedgerDelta const &delta, Hash const &txHash,
+                           size_t opIndex);
+
+    // reports the failures found by the background checks done so far
+    void reportBackgroundFailures();
+
     void onInvariantFailure(std::shared_ptr<Invariant> invariant,
                             std::string const &message, uint32_t ledger);
 
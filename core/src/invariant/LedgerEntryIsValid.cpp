@@ -24,6 +24,11 @@ LedgerEntryIsValid::getName() const {
     return "LedgerEntryIsValid";
 }
 
+bool
+LedgerEntryIsValid::canCheckInBackground() const {
+    return true;
+}
+
 std::string
 LedgerEntryIsValid::checkOnOperationApply(Operation const &operation,
                                           OperationResult const &result,
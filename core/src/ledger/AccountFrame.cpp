@@ -9,6 +9,7 @@
 #include "crypto/SecretKey.h"
 #include "crypto/SignerKey.h"
 #include "database/Database.h"
+#include "ledger/EntryOverlay.h"
 #include "ledger/LedgerManager.h"
 #include "ledger/LedgerRange.h"
 #include "util/Decoder.h"
@@ -52,6 +53,59 @@ const char *AccountFrame::kSQLCreateStatement4 = "CREATE INDEX accountbalances "
                                                  "ON accounts (balance) WHERE "
                                                  "balance >= 1000000000";
 
+namespace {
+// columns of an accounts row, apart from accountid and signers
+char const *const kAccountColumns =
+        "balance, seqnum, numsubentries, inflationdest, homedomain, "
+        "thresholds, flags, lastmodified, buyingliabilities, "
+        "sellingliabilities";
+
+// the columns of kAccountColumns that can't go straight into an AccountEntry
+struct AccountRow {
+    std::string mInflationDest, mHomeDomain, mThresholds;
+    Liabilities mLiabilities;
+    soci::indicator mInflationDestInd;
+    soci::indicator mBuyingLiabilitiesInd, mSellingLiabilitiesInd;
+
+    void
+    bind(soci::statement &st, AccountEntry &account, uint32 &lastModified) {
+        st.exchange(into(account.balance));
+        st.exchange(into(account.seqNum));
+        st.exchange(into(account.numSubEntries));
+        st.exchange(into(mInflationDest, mInflationDestInd));
+        st.exchange(into(mHomeDomain));
+        st.exchange(into(mThresholds));
+        st.exchange(into(account.flags));
+        st.exchange(into(lastModified));
+        st.exchange(into(mLiabilities.buying, mBuyingLiabilitiesInd));
+        st.exchange(into(mLiabilities.selling, mSellingLiabilitiesInd));
+    }
+
+    // completes `account` once a row was fetched, signers aside
+    void
+    decode(AccountEntry &account) const {
+        account.homeDomain = mHomeDomain;
+        decoder::decode_b64(mThresholds.begin(), mThresholds.end(),
+                            account.thresholds.begin());
+
+        if (mInflationDestInd == soci::i_ok) {
+            account.inflationDest.activate() =
+                    KeyUtils::fromStrKey<PublicKey>(mInflationDest);
+        } else {
+            account.inflationDest.reset();
+        }
+
+        assert(mBuyingLiabilitiesInd == mSellingLiabilitiesInd);
+        if (mBuyingLiabilitiesInd == soci::i_ok) {
+            account.ext.v(1);
+            account.ext.v1().liabilities = mLiabilities;
+        } else {
+            account.ext.v(0);
+        }
+    }
+};
+}
+
 AccountFrame::AccountFrame()
         : EntryFrame(ACCOUNT), mAccountEntry(mEntry.data.account()) {
     mAccountEntry.thresholds[0] = 1; // by default, master key's weight is 1
@@ -290,6 +344,10 @@ AccountFrame::loadAccount(AccountID const &accountID, Database &db) {
     LedgerKey key;
     key.type(ACCOUNT);
     key.account().accountID = accountID;
+    if (auto overlay = EntryOverlay::current()) {
+        auto p = overlay->load(key);
+        return p ? std::make_shared<AccountFrame>(*p) : nullptr;
+    }
     if (cachedEntryExists(key, db)) {
         auto p = getCachedEntry(key, db);
         return p ? std::make_shared<AccountFrame>(*p) : nullptr;
@@ -297,32 +355,15 @@ AccountFrame::loadAccount(AccountID const &accountID, Database &db) {
 
     std::string actIDStrKey = KeyUtils::toStrKey(accountID);
 
-    std::string publicKey, inflationDest, creditAuthKey;
-    std::string homeDomain, thresholds;
-    Liabilities liabilities;
-    soci::indicator inflationDestInd;
-    soci::indicator buyingLiabilitiesInd, sellingLiabilitiesInd;
-
+    AccountRow row;
     AccountFrame::pointer res = make_shared<AccountFrame>(accountID);
     AccountEntry &account = res->getAccount();
 
-    auto prep =
-            db.getPreparedStatement("SELECT balance, seqnum, numsubentries, "
-                                    "inflationdest, homedomain, thresholds, "
-                                    "flags, lastmodified, buyingliabilities, "
-                                    "sellingliabilities "
-                                    "FROM accounts WHERE accountid=:v1");
+    auto prep = db.getPreparedStatement(
+            std::string("SELECT ") + kAccountColumns +
+            " FROM accounts WHERE accountid=:v1");
     auto &st = prep.statement();
-    st.exchange(into(account.balance));
-    st.exchange(into(account.seqNum));
-    st.exchange(into(account.numSubEntries));
-    st.exchange(into(inflationDest, inflationDestInd));
-    st.exchange(into(homeDomain));
-    st.exchange(into(thresholds));
-    st.exchange(into(account.flags));
-    st.exchange(into(res->getLastModified()));
-    st.exchange(into(liabilities.buying, buyingLiabilitiesInd));
-    st.exchange(into(liabilities.selling, sellingLiabilitiesInd));
+    row.bind(st, account, res->getLastModified());
     st.exchange(use(actIDStrKey));
     st.define_and_bind();
     {
@@ -334,15 +375,7 @@ AccountFrame::loadAccount(AccountID const &accountID, Database &db) {
         return nullptr;
     }
 
-    account.homeDomain = homeDomain;
-
-    decoder::decode_b64(thresholds.begin(), thresholds.end(),
-                        res->mAccountEntry.thresholds.begin());
-
-    if (inflationDestInd == soci::i_ok) {
-        account.inflationDest.activate() =
-                KeyUtils::fromStrKey<PublicKey>(inflationDest);
-    }
+    row.decode(account);
 
     account.signers.clear();
 
@@ -352,12 +385,6 @@ AccountFrame::loadAccount(AccountID const &accountID, Database &db) {
                                signers.end());
     }
 
-    assert(buyingLiabilitiesInd == sellingLiabilitiesInd);
-    if (buyingLiabilitiesInd == soci::i_ok) {
-        account.ext.v(1);
-        account.ext.v1().liabilities = liabilities;
-    }
-
     res->normalize();
     res->mUpdateSigners = false;
     res->mKeyCalculated = false;
@@ -365,6 +392,68 @@ AccountFrame::loadAccount(AccountID const &accountID, Database &db) {
     return res;
 }
 
+void
+AccountFrame::loadAccounts(soci::session &sess,
+                           std::vector<std::string> const &actIDStrKeys,
+                           LedgerEntryProcessor accountProcessor) {
+    if (actIDStrKeys.empty()) {
+        return;
+    }
+    auto inList = Database::toInList(actIDStrKeys);
+
+    std::unordered_map<std::string, std::vector<Signer>> signers;
+    {
+        std::string actIDStrKey, pubKey;
+        Signer signer;
+        auto prep = Database::prepareStatement(
+                sess, "SELECT accountid, publickey, weight FROM signers "
+                      "WHERE accountid IN (" + inList + ")");
+        auto &st = prep.statement();
+        st.exchange(into(actIDStrKey));
+        st.exchange(into(pubKey));
+        st.exchange(into(signer.weight));
+        st.define_and_bind();
+        st.execute(true);
+        while (st.got_data()) {
+            signer.key = KeyUtils::fromStrKey<SignerKey>(pubKey);
+            signers[actIDStrKey].push_back(signer);
+            st.fetch();
+        }
+    }
+
+    std::string actIDStrKey;
+    AccountRow row;
+
+    LedgerEntry le;
+    le.data.type(ACCOUNT);
+    AccountEntry &account = le.data.account();
+
+    auto prep = Database::prepareStatement(
+            sess, std::string("SELECT accountid, ") + kAccountColumns +
+                  " FROM accounts WHERE accountid IN (" + inList + ")");
+    auto &st = prep.statement();
+    st.exchange(into(actIDStrKey));
+    row.bind(st, account, le.lastModifiedLedgerSeq);
+    st.define_and_bind();
+    st.execute(true);
+    while (st.got_data()) {
+        account.accountID = KeyUtils::fromStrKey<PublicKey>(actIDStrKey);
+        row.decode(account);
+
+        account.signers.clear();
+        auto it = signers.find(actIDStrKey);
+        if (it != signers.end()) {
+            account.signers.insert(account.signers.begin(), it->second.begin(),
+                                   it->second.end());
+            std::sort(account.signers.begin(), account.signers.end(),
+                      &AccountFrame::signerCompare);
+        }
+
+        accountProcessor(le);
+        st.fetch();
+    }
+}
+
 std::vector<Signer>
 AccountFrame::loadSigners(Database &db, std::string const &actIDStrKey) {
     std::vector<Signer> res;
@@ -395,6 +484,9 @@ AccountFrame::loadSigners(Database &db, std::string const &actIDStrKey) {
 
 bool
 AccountFrame::exists(Database &db, LedgerKey const &key) {
+    if (auto overlay = EntryOverlay::current()) {
+        return overlay->load(key) != nullptr;
+    }
     if (cachedEntryExists(key, db) && getCachedEntry(key, db) != nullptr) {
         return true;
     }
@@ -466,6 +558,9 @@ AccountFrame::storeDelete(LedgerDelta &delta, Database &db) const {
 void
 AccountFrame::storeDelete(LedgerDelta &delta, Database &db,
                           LedgerKey const &key) {
+    if (storeDeleteInOverlay(delta, key)) {
+        return;
+    }
     flushCachedEntry(key, db);
 
     std::string actIDStrKey = KeyUtils::toStrKey(key.account().accountID);
@@ -493,6 +588,11 @@ AccountFrame::storeUpdate(LedgerDelta &delta, Database &db, bool insert) {
 
     touch(delta);
 
+    // the signers are in the entry
+    if (storeInOverlay(delta, insert)) {
+        return;
+    }
+
     flushCachedEntry(db);
 
     std::string actIDStrKey = KeyUtils::toStrKey(mAccountEntry.accountID);
@@ -9,6 +9,7 @@
 #include "crypto/SHA.h"
 #include "crypto/SecretKey.h"
 #include "database/Database.h"
+#include "ledger/EntryOverlay.h"
 #include "transactions/ManageDataOpFrame.h"
 #include "util/Decoder.h"
 #include "util/types.h"
@@ -69,6 +70,17 @@ DataFrame::loadData(AccountID const &accountID, std::string dataName,
                     Database &db) {
     DataFrame::pointer retData;
 
+    if (auto overlay = EntryOverlay::current()) {
+        LedgerKey key(DATA);
+        key.data().accountID = accountID;
+        key.data().dataName = dataName;
+        auto p = overlay->load(key);
+        if (p) {
+            retData = make_shared<DataFrame>(*p);
+        }
+        return retData;
+    }
+
     std::string actIDStrKey = KeyUtils::toStrKey(accountID);
 
     std::string sql = dataColumnSelector;
@@ -121,6 +133,19 @@ DataFrame::loadData(StatementContext &prep,
     }
 }
 
+void
+DataFrame::loadData(soci::session &sess,
+                    std::vector<std::string> const &actIDStrKeys,
+                    LedgerEntryProcessor dataProcessor) {
+    if (actIDStrKeys.empty()) {
+        return;
+    }
+    std::string sql = dataColumnSelector;
+    sql += " WHERE accountid IN (" + Database::toInList(actIDStrKeys) + ")";
+    auto prep = Database::prepareStatement(sess, sql);
+    loadData(prep, dataProcessor);
+}
+
 std::unordered_map<AccountID, std::vector<DataFrame::pointer>>
 DataFrame::loadAllData(Database &db) {
     std::unordered_map<AccountID, std::vector<DataFrame::pointer>> retData;
@@ -138,6 +163,9 @@ DataFrame::loadAllData(Database &db) {
 
 bool
 DataFrame::exists(Database &db, LedgerKey const &key) {
+    if (auto overlay = EntryOverlay::current()) {
+        return overlay->load(key) != nullptr;
+    }
     std::string actIDStrKey = KeyUtils::toStrKey(key.data().accountID);
     std::string dataName = key.data().dataName;
     int exists = 0;
@@ -196,6 +224,9 @@ DataFrame::storeDelete(LedgerDelta &delta, Database &db) const {
 
 void
 DataFrame::storeDelete(LedgerDelta &delta, Database &db, LedgerKey const &key) {
+    if (storeDeleteInOverlay(delta, key)) {
+        return;
+    }
     std::string actIDStrKey = KeyUtils::toStrKey(key.data().accountID);
     std::string dataName = key.data().dataName;
     auto timer = db.getDeleteTimer("data");
@@ -223,6 +254,10 @@ void
 DataFrame::storeUpdateHelper(LedgerDelta &delta, Database &db, bool insert) {
     touch(delta);
 
+    if (storeInOverlay(delta, insert)) {
+        return;
+    }
+
     std::string actIDStrKey = KeyUtils::toStrKey(mData.accountID);
     std::string dataName = mData.dataName;
     std::string dataValue = decoder::encode_b64(mData.dataValue);
@@ -8,6 +8,7 @@
 #include "database/Database.h"
 #include "ledger/AccountFrame.h"
 #include "ledger/DataFrame.h"
+#include "ledger/EntryOverlay.h"
 #include "ledger/LedgerDelta.h"
 #include "ledger/OfferFrame.h"
 #include "ledger/TrustFrame.h"
@@ -97,6 +98,10 @@ EntryFrame::touch(LedgerDelta const &delta) {
 
 void
 EntryFrame::flushCachedEntry(LedgerKey const &key, Database &db) {
+    // nothing is cached while an overlay holds the entries
+    if (EntryOverlay::current()) {
+        return;
+    }
     auto s = binToHex(xdr::xdr_to_opaque(key));
     db.getEntryCache().erase_if_exists(s);
 }
@@ -132,6 +137,7 @@ EntryFrame::putCachedEntry(Database &db) const {
 
 std::string
 EntryFrame::checkAgainstDatabase(LedgerEntry const &entry, Database &db) {
+    EntryOverlay::requireDatabase();
     auto key = LedgerEntryKey(entry);
     flushCachedEntry(key, db);
     auto const &fromDb = EntryFrame::storeLoad(key, db);
@@ -167,6 +173,32 @@ EntryFrame::getKey() const {
     return mKey;
 }
 
+bool
+EntryFrame::storeInOverlay(LedgerDelta &delta, bool insert) {
+    auto overlay = EntryOverlay::current();
+    if (!overlay) {
+        return false;
+    }
+    overlay->store(mEntry, insert);
+    if (insert) {
+        delta.addEntry(*this);
+    } else {
+        delta.modEntry(*this);
+    }
+    return true;
+}
+
+bool
+EntryFrame::storeDeleteInOverlay(LedgerDelta &delta, LedgerKey const &key) {
+    auto overlay = EntryOverlay::current();
+    if (!overlay) {
+        return false;
+    }
+    overlay->storeDelete(key);
+    delta.deleteEntry(key);
+    return true;
+}
+
 void
 EntryFrame::storeAddOrChange(LedgerDelta &delta, Database &db) {
     if (exists(db, getKey())) {
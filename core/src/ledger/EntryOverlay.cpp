@@ -0,0 +1,188 @@
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "ledger/EntryOverlay.h"
+#include "database/Database.h"
+#include "ledger/EntryFrame.h"
+#include "ledger/LedgerDelta.h"
+#include "util/XDROperators.h"
+
+#include <cassert>
+
+namespace vixal {
+
+namespace {
+thread_local EntryOverlay *gCurrentOverlay = nullptr;
+}
+
+char const *
+EntryOverlay::Miss::what() const noexcept {
+    return "ledger entry used outside of the overlay";
+}
+
+EntryOverlay::Scope::Scope(EntryOverlay &overlay)
+        : mPrevious(gCurrentOverlay) {
+    gCurrentOverlay = &overlay;
+}
+
+EntryOverlay::Scope::~Scope() {
+    gCurrentOverlay = mPrevious;
+}
+
+EntryOverlay *
+EntryOverlay::current() {
+    return gCurrentOverlay;
+}
+
+void
+EntryOverlay::requireDatabase() {
+    if (gCurrentOverlay) {
+        gCurrentOverlay->miss();
+    }
+}
+
+void
+EntryOverlay::miss() {
+    mMissed = true;
+    throw Miss();
+}
+
+void
+EntryOverlay::add(LedgerKey const &key, std::shared_ptr<LedgerEntry const> entry,
+                  bool writable) {
+    assert(mSavepoints.empty());
+    auto &e = mEntries[key];
+    e.mOriginal = entry;
+    e.mCurrent = std::move(entry);
+    e.mWritable = e.mWritable || writable;
+}
+
+std::shared_ptr<LedgerEntry const>
+EntryOverlay::load(LedgerKey const &key) {
+    for (auto it = mSavepoints.rbegin(); it != mSavepoints.rend(); ++it) {
+        auto found = it->find(key);
+        if (found != it->end()) {
+            return found->second;
+        }
+    }
+    auto found = mEntries.find(key);
+    if (found == mEntries.end()) {
+        miss();
+    }
+    return found->second.mCurrent;
+}
+
+void
+EntryOverlay::store(LedgerEntry const &entry, bool insert) {
+    auto key = LedgerEntryKey(entry);
+    auto found = mEntries.find(key);
+    // the database would reject the statement, let it
+    if (found == mEntries.end() || !found->second.mWritable ||
+        !!load(key) == insert) {
+        miss();
+    }
+    set(key, std::make_shared<LedgerEntry const>(entry));
+}
+
+void
+EntryOverlay::storeDelete(LedgerKey const &key) {
+    auto found = mEntries.find(key);
+    if (found == mEntries.end() || !found->second.mWritable) {
+        miss();
+    }
+    set(key, nullptr);
+}
+
+void
+EntryOverlay::set(LedgerKey const &key, std::shared_ptr<LedgerEntry const> entry) {
+    if (mSavepoints.empty()) {
+        mEntries[key].mCurrent = std::move(entry);
+    } else {
+        mSavepoints.back()[key] = std::move(entry);
+    }
+}
+
+void
+EntryOverlay::begin() {
+    mSavepoints.emplace_back();
+}
+
+void
+EntryOverlay::commit() {
+    assert(!mSavepoints.empty());
+    auto changes = std::move(mSavepoints.back());
+    mSavepoints.pop_back();
+    for (auto &c : changes) {
+        set(c.first, std::move(c.second));
+    }
+}
+
+void
+EntryOverlay::rollback() {
+    assert(!mSavepoints.empty());
+    mSavepoints.pop_back();
+}
+
+bool
+EntryOverlay::isMissed() const {
+    return mMissed;
+}
+
+void
+EntryOverlay::write(LedgerDelta &outer, Database &db) const {
+    assert(mSavepoints.empty());
+    // the frames record what they store in a delta, this one is dropped
+    LedgerDelta writes(outer);
+    for (auto const &e : mEntries) {
+        auto const &original = e.second.mOriginal;
+        auto const &current = e.second.mCurrent;
+        if (original == current ||
+            (original && current && *original == *current)) {
+            continue;
+        }
+        if (!current) {
+            EntryFrame::storeDelete(writes, db, e.first);
+        } else if (!original) {
+            EntryFrame::fromXDR(*current)->storeAdd(writes, db);
+        } else {
+            EntryFrame::fromXDR(*current)->storeChange(writes, db);
+        }
+    }
+}
+
+EntryTransaction::EntryTransaction(Database &db)
+        : mOverlay(EntryOverlay::current()) {
+    if (mOverlay) {
+        mOverlay->begin();
+    } else {
+        mSqlTx = std::make_unique<soci::transaction>(db.getSession());
+    }
+}
+
+EntryTransaction::~EntryTransaction() {
+    if (mOverlay) {
+        mOverlay->rollback();
+    }
+}
+
+void
+EntryTransaction::commit() {
+    if (mOverlay) {
+        mOverlay->commit();
+        mOverlay = nullptr;
+    } else {
+        mSqlTx->commit();
+    }
+}
+
+void
+EntryTransaction::rollback() {
+    if (mOverlay) {
+        mOverlay->rollback();
+        mOverlay = nullptr;
+    } else {
+        mSqlTx->rollback();
+    }
+}
+}
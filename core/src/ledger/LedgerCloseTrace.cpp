@@ -0,0 +1,177 @@
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "ledger/LedgerCloseTrace.h"
+#include <json/json.h>
+#include <algorithm>
+
+namespace vixal {
+
+size_t const LedgerCloseTrace::CAPACITY = 256;
+
+namespace {
+size_t
+getOpTypeCount() {
+    return xdr::xdr_traits<OperationType>::enum_values().size();
+}
+
+uint64_t
+toMicroseconds(std::chrono::nanoseconds duration) {
+    return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+}
+}
+
+LedgerCloseTrace::Span::Span(LedgerCloseTrace &trace, Phase phase)
+        : mTrace(trace), mPhase(phase), mStart(std::chrono::steady_clock::now()) {
+}
+
+LedgerCloseTrace::Span::~Span() {
+    mTrace.addPhase(mPhase, std::chrono::steady_clock::now() - mStart);
+}
+
+LedgerCloseTrace::LedgerCloseTrace()
+        : mLedgerSeqs(CAPACITY), mTxCounts(CAPACITY), mOpCounts(CAPACITY), mTotals(CAPACITY),
+          mOpTypeTimes(getOpTypeCount(), std::vector<uint64_t>(CAPACITY)),
+          mOpTypeCounts(getOpTypeCount(), std::vector<uint32_t>(CAPACITY)), mNext(0), mSize(0),
+          mLedgersClosed(0), mActive(false), mLedgerSeq(0),
+          mCurrentOpTypeTimes(getOpTypeCount()), mCurrentOpTypeCounts(getOpTypeCount()) {
+    for (auto &phase : mPhases) {
+        phase.resize(CAPACITY);
+    }
+}
+
+void
+LedgerCloseTrace::beginLedger(uint32_t ledgerSeq) {
+    mActive = true;
+    mStart = std::chrono::steady_clock::now();
+    mLedgerSeq = ledgerSeq;
+    mCurrentPhases.fill(std::chrono::nanoseconds::zero());
+    std::fill(mCurrentOpTypeTimes.begin(), mCurrentOpTypeTimes.end(), std::chrono::nanoseconds::zero());
+    std::fill(mCurrentOpTypeCounts.begin(), mCurrentOpTypeCounts.end(), 0);
+}
+
+void
+LedgerCloseTrace::addPhase(Phase phase, std::chrono::nanoseconds duration) {
+    if (mActive) {
+        mCurrentPhases[phase] += duration;
+    }
+}
+
+void
+LedgerCloseTrace::addOperation(OperationType type, std::chrono::nanoseconds duration) {
+    auto i = static_cast<size_t>(type);
+    if (mActive && i < mCurrentOpTypeTimes.size()) {
+        std::lock_guard<std::mutex> lock(mCurrentOpTypesMutex);
+        mCurrentOpTypeTimes[i] += duration;
+        ++mCurrentOpTypeCounts[i];
+    }
+}
+
+void
+LedgerCloseTrace::endLedger(size_t txCount) {
+    if (!mActive) {
+        return;
+    }
+    mActive = false;
+
+    auto i = mNext;
+    mLedgerSeqs[i] = mLedgerSeq;
+    mTxCounts[i] = static_cast<uint32_t>(txCount);
+    mTotals[i] = toMicroseconds(std::chrono::steady_clock::now() - mStart);
+    for (size_t p = 0; p < PHASE_COUNT; p++) {
+        mPhases[p][i] = toMicroseconds(mCurrentPhases[p]);
+    }
+    uint32_t ops = 0;
+    for (size_t t = 0; t < mOpTypeTimes.size(); t++) {
+        mOpTypeTimes[t][i] = toMicroseconds(mCurrentOpTypeTimes[t]);
+        mOpTypeCounts[t][i] = mCurrentOpTypeCounts[t];
+        ops += mCurrentOpTypeCounts[t];
+    }
+    mOpCounts[i] = ops;
+
+    mNext = (mNext + 1) % CAPACITY;
+    mSize = std::min(mSize + 1, CAPACITY);
+    ++mLedgersClosed;
+}
+
+size_t
+LedgerCloseTrace::size() const {
+    return mSize;
+}
+
+uint64_t
+LedgerCloseTrace::getLedgersClosed() const {
+    return mLedgersClosed;
+}
+
+char const *
+LedgerCloseTrace::getPhaseName(Phase phase) {
+    switch (phase) {
+        case PHASE_PREFETCH:
+            return "prefetch";
+        case PHASE_FEES:
+            return "fees";
+        case PHASE_APPLY:
+            return "apply";
+        case PHASE_HISTORY:
+            return "history";
+        case PHASE_UPGRADES:
+            return "upgrades";
+        case PHASE_INVARIANTS:
+            return "invariants";
+        case PHASE_BUCKETS:
+            return "buckets";
+        case PHASE_STORE:
+            return "store";
+        case PHASE_CHECKPOINT:
+            return "checkpoint";
+        case PHASE_COMMIT:
+            return "commit";
+        case PHASE_PUBLISH:
+            return "publish";
+        default:
+            return "unknown";
+    }
+}
+
+Json::Value
+LedgerCloseTrace::getJsonInfo(size_t limit) const {
+    Json::Value res;
+    auto n = std::min(limit, mSize);
+    auto first = (mNext + CAPACITY - n) % CAPACITY;
+
+    auto column = [&](Json::Value &dest, auto const &values) {
+        dest = Json::Value(Json::arrayValue);
+        for (size_t k = 0; k < n; k++) {
+            dest.append(Json::UInt64(values[(first + k) % CAPACITY]));
+        }
+    };
+
+    column(res["ledger"], mLedgerSeqs);
+    column(res["txs"], mTxCounts);
+    column(res["ops"], mOpCounts);
+    column(res["total"], mTotals);
+    for (size_t p = 0; p < PHASE_COUNT; p++) {
+        column(res["phases"][getPhaseName(static_cast<Phase>(p))], mPhases[p]);
+    }
+
+    // only the types of operations applied in the ledgers returned
+    auto &names = xdr::xdr_traits<OperationType>::enum_values();
+    for (size_t t = 0; t < mOpTypeCounts.size(); t++) {
+        bool applied = false;
+        for (size_t k = 0; k < n && !applied; k++) {
+            applied = mOpTypeCounts[t][(first + k) % CAPACITY] != 0;
+        }
+        if (applied) {
+            auto name = xdr::xdr_traits<OperationType>::enum_name(
+                    static_cast<OperationType>(names[t]));
+            auto &op = res["operations"][name];
+            column(op["count"], mOpTypeCounts[t]);
+            column(op["time"], mOpTypeTimes[t]);
+        }
+    }
+    return res;
+}
+}
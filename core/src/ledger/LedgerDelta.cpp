@@ -26,6 +26,33 @@ LedgerDelta::LedgerDelta(LedgerHeader &header, Database &db,
           mUpdateLastModified(updateLastModified) {
 }
 
+LedgerDelta::LedgerDelta(LedgerDelta const &other, bool)
+        : mOuterDelta(nullptr), mHeader(nullptr), mCurrentHeader(other.mCurrentHeader.mHeader),
+          mPreviousHeaderValue(other.mPreviousHeaderValue), mDelete(other.mDelete), mDb(other.mDb),
+          mUpdateLastModified(other.mUpdateLastModified) {
+    auto copyEntries = [](KeyEntryMap const &from, KeyEntryMap &to) {
+        for (auto const &e : from) {
+            to.emplace_hint(to.end(), e.first, e.second->copy());
+        }
+    };
+    copyEntries(other.mNew, mNew);
+    copyEntries(other.mMod, mMod);
+
+    // only the previous values of changed entries can be read
+    auto copyPrevious = [&](LedgerKey const &k) {
+        auto it = other.mPrevious.find(k);
+        if (it != other.mPrevious.end()) {
+            mPrevious.emplace(k, it->second->copy());
+        }
+    };
+    for (auto const &m : mMod) {
+        copyPrevious(m.first);
+    }
+    for (auto const &d : mDelete) {
+        copyPrevious(d);
+    }
+}
+
 LedgerDelta::~LedgerDelta() {
     if (mHeader) {
         rollback();
@@ -349,6 +376,11 @@ LedgerDelta::markMeters(Application &app) const {
     }
 }
 
+std::shared_ptr<LedgerDelta const>
+LedgerDelta::snapshot() const {
+    return std::shared_ptr<LedgerDelta const>(new LedgerDelta(*this, true));
+}
+
 template<typename IterType, typename ValueType>
 void
 LedgerDelta::Iterator<IterType, ValueType>::createValueIfNecessary() const {
@@ -19,8 +19,10 @@
 #include "history/HistoryManager.h"
 #include "invariant/InvariantDoesNotHold.h"
 #include "invariant/InvariantManager.h"
+#include "ledger/EntryOverlay.h"
 #include "ledger/LedgerDelta.h"
 #include "ledger/LedgerHeaderFrame.h"
+#include "transactions/TransactionFootprint.h"
 #include "application/Application.h"
 #include "application/Config.h"
 #include "overlay/OverlayManager.h"
@@ -36,7 +38,12 @@
 #include "xdrpp/printer.h"
 #include "xdrpp/types.h"
 
+#include <algorithm>
 #include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
 #include <sstream>
 #include <herder/Upgrades.h>
 
@@ -105,7 +112,16 @@ LedgerManagerImpl::LedgerManagerImpl(Application &app)
         : mApp(app),
           mTransactionApply(app.getMetrics().newTimer({"ledger", "transaction", "apply"})),
           mTransactionCount(app.getMetrics().newHistogram({"ledger", "transaction", "count"})),
+          mTransactionClusters(app.getMetrics().newHistogram({"ledger", "transaction", "clusters"})),
+          mTransactionLargestCluster(
+                  app.getMetrics().newHistogram({"ledger", "transaction", "largest-cluster"})),
+          mTransactionGlobal(app.getMetrics().newHistogram({"ledger", "transaction", "global"})),
+          mTransactionPrefetch(app.getMetrics().newMeter({"ledger", "transaction", "prefetch"}, "entry")),
+          mTransactionParallel(app.getMetrics().newMeter({"ledger", "transaction", "parallel"}, "transaction")),
+          mTransactionParallelFallback(
+                  app.getMetrics().newMeter({"ledger", "transaction", "parallel-fallback"}, "transaction")),
           mLedgerClose(app.getMetrics().newTimer({"ledger", "ledger", "close"})),
+          mLedgerHistoryStore(app.getMetrics().newTimer({"ledger", "history", "store"})),
           mLedgerAgeClosed(app.getMetrics().newTimer({"ledger", "age", "closed"})),
           mLedgerAge(app.getMetrics().newCounter({"ledger", "age", "current-seconds"})),
           mLedgerStateCurrent(app.getMetrics().newCounter({"ledger", "state", "current"})),
@@ -336,6 +352,11 @@ LedgerManagerImpl::getLastClosedLedgerNum() const {
     return mLastClosedLedger.header.ledgerSeq;
 }
 
+std::unordered_set<AccountID> const &
+LedgerManagerImpl::getLastClosedLedgerAccounts() const {
+    return mLastClosedLedgerAccounts;
+}
+
 uint32_t
 getCatchupCount(Application &app) {
     return app.getConfig().CATCHUP_COMPLETE
@@ -714,6 +735,7 @@ LedgerManagerImpl::closeLedger(LedgerCloseData const &ledgerData) {
     soci::transaction txscope(getDatabase().getSession());
 
     auto ledgerTime = mLedgerClose.timeScope();
+    mCloseTrace.beginLedger(mCurrentLedger->mHeader.ledgerSeq);
 
     auto const &sv = ledgerData.getValue();
     mCurrentLedger->mHeader.scpValue = sv;
@@ -725,13 +747,40 @@ LedgerManagerImpl::closeLedger(LedgerCloseData const &ledgerData) {
     // sorted such that sequence numbers are respected
     vector<TransactionFramePtr> txs = ledgerData.getTxSet()->sortForApply();
 
+    // history rows are written once all the transactions are applied
+    TransactionHistoryBuffer history(getDatabase(),
+                                     mCurrentLedger->mHeader.ledgerSeq);
+
+    // the entries of the transactions are loaded before fees change them
+    std::vector<TransactionFootprint> footprints;
+    if (!txs.empty()) {
+        LedgerCloseTrace::Span span(mCloseTrace, LedgerCloseTrace::PHASE_PREFETCH);
+        footprints.reserve(txs.size());
+        for (auto const &tx : txs) {
+            footprints.emplace_back(*tx);
+        }
+        prefetchTransactions(footprints);
+    }
+
     // first, charge fees
-    processFeesSeqNums(txs, ledgerDelta);
+    {
+        LedgerCloseTrace::Span span(mCloseTrace, LedgerCloseTrace::PHASE_FEES);
+        processFeesSeqNums(txs, ledgerDelta, history);
+    }
 
     TransactionResultSet txResultSet;
     txResultSet.results.reserve(txs.size());
 
-    applyTransactions(txs, ledgerDelta, txResultSet);
+    {
+        LedgerCloseTrace::Span span(mCloseTrace, LedgerCloseTrace::PHASE_APPLY);
+        applyTransactions(txs, footprints, ledgerDelta, txResultSet, history);
+    }
+
+    {
+        LedgerCloseTrace::Span span(mCloseTrace, LedgerCloseTrace::PHASE_HISTORY);
+        auto historyTime = mLedgerHistoryStore.timeScope();
+        history.flush();
+    }
 
     ledgerDelta.getHeader().txSetResultHash =
             sha256(xdr::xdr_to_opaque(txResultSet));
@@ -740,47 +789,63 @@ LedgerManagerImpl::closeLedger(LedgerCloseData const &ledgerData) {
     // this must be done after applying transactions as the txset
     // was validated before upgrades
     LedgerHeader headerBeforeUpgrades = getCurrentLedgerHeader();
-    for (size_t i = 0; i < sv.upgrades.size(); i++) {
-        LedgerUpgrade lupgrade;
-        try {
-            xdr::xdr_from_opaque(sv.upgrades[i], lupgrade);
-        }
-        catch (xdr::xdr_runtime_error &e) {
-            CLOG(FATAL, "Ledger") << "Unknown upgrade step at index " << i;
-            throw;
-        }
+    {
+        LedgerCloseTrace::Span span(mCloseTrace, LedgerCloseTrace::PHASE_UPGRADES);
+        for (size_t i = 0; i < sv.upgrades.size(); i++) {
+            LedgerUpgrade lupgrade;
+            try {
+                xdr::xdr_from_opaque(sv.upgrades[i], lupgrade);
+            }
+            catch (xdr::xdr_runtime_error &e) {
+                CLOG(FATAL, "Ledger") << "Unknown upgrade step at index " << i;
+                throw;
+            }
 
-        LedgerHeader previousHeader = getCurrentLedgerHeader();
-        try {
-            soci::transaction upgradeScope(getDatabase().getSession());
-            LedgerDelta upgradeDelta(ledgerDelta);
-            Upgrades::applyTo(lupgrade, *this, upgradeDelta);
-            // Note: Index from 1 rather than 0 to match the behavior of
-            // storeTransaction and storeTransactionFee.
-            Upgrades::storeUpgradeHistory(*this, lupgrade,
-                                          upgradeDelta.getChanges(),
-                                          static_cast<int>(i + 1));
-            upgradeDelta.commit();
-            upgradeScope.commit();
-        }
-        catch (std::runtime_error &e) {
-            CLOG(ERROR, "Ledger") << "Exception during upgrade: " << e.what();
-            getCurrentLedgerHeader() = previousHeader;
-        }
-        catch (...) {
-            CLOG(ERROR, "Ledger") << "Unknown exception during upgrade";
-            getCurrentLedgerHeader() = previousHeader;
+            LedgerHeader previousHeader = getCurrentLedgerHeader();
+            try {
+                soci::transaction upgradeScope(getDatabase().getSession());
+                LedgerDelta upgradeDelta(ledgerDelta);
+                Upgrades::applyTo(lupgrade, *this, upgradeDelta);
+                // Note: Index from 1 rather than 0 to match the behavior of
+                // storeTransaction and storeTransactionFee.
+                Upgrades::storeUpgradeHistory(*this, lupgrade,
+                                              upgradeDelta.getChanges(),
+                                              static_cast<int>(i + 1));
+                upgradeDelta.commit();
+                upgradeScope.commit();
+            }
+            catch (std::runtime_error &e) {
+                CLOG(ERROR, "Ledger") << "Exception during upgrade: " << e.what();
+                getCurrentLedgerHeader() = previousHeader;
+            }
+            catch (...) {
+                CLOG(ERROR, "Ledger") << "Unknown exception during upgrade";
+                getCurrentLedgerHeader() = previousHeader;
+            }
         }
-
     }
 
     // It is required to rollback the current LedgerHeader in order to satisfy
     // the consistency checks enforced by LedgerDelta::commit.
     getCurrentLedgerHeader() = headerBeforeUpgrades;
 
+    // invariants checked in the background may not lag further behind
+    {
+        LedgerCloseTrace::Span span(mCloseTrace, LedgerCloseTrace::PHASE_INVARIANTS);
+        mApp.getInvariantManager().checkOnLedgerCommit(
+                ledgerDelta.getHeader().ledgerSeq);
+    }
+
     ledgerDelta.commit();
     ledgerClosed(ledgerDelta);
 
+    auto &hm = mApp.getHistoryManager();
+    {
+        LedgerCloseTrace::Span span(mCloseTrace, LedgerCloseTrace::PHASE_CHECKPOINT);
+        hm.appendLedgerToCheckpoint(mLastClosedLedger, *ledgerData.getTxSet(),
+                                    txResultSet);
+    }
+
     // The next 4 steps happen in a relatively non-obvious, subtle order.
     // This is unfortunate and it would be nice if we could make it not
     // be so subtle, but for the time being this is where we are.
@@ -799,19 +864,32 @@ LedgerManagerImpl::closeLedger(LedgerCloseData const &ledgerData) {
     // 4. GC unreferenced buckets. Only do this once publishes are in progress.
 
     // step 1
-    auto &hm = mApp.getHistoryManager();
-    hm.maybeQueueHistoryCheckpoint();
+    {
+        LedgerCloseTrace::Span span(mCloseTrace, LedgerCloseTrace::PHASE_CHECKPOINT);
+        hm.maybeQueueHistoryCheckpoint();
+    }
 
     // step 2
-    mApp.getDatabase().clearPreparedStatementCache();
-    txscope.commit();
+    {
+        LedgerCloseTrace::Span span(mCloseTrace, LedgerCloseTrace::PHASE_COMMIT);
+        mApp.getDatabase().clearPreparedStatementCache();
+        txscope.commit();
+    }
 
     // step 3
-    hm.publishQueuedHistory();
-    hm.logAndUpdatePublishStatus();
+    {
+        LedgerCloseTrace::Span span(mCloseTrace, LedgerCloseTrace::PHASE_PUBLISH);
+        hm.publishQueuedHistory();
+        hm.logAndUpdatePublishStatus();
+    }
 
     // step 4
-    mApp.getBucketManager().forgetUnreferencedBuckets();
+    {
+        LedgerCloseTrace::Span span(mCloseTrace, LedgerCloseTrace::PHASE_BUCKETS);
+        mApp.getBucketManager().forgetUnreferencedBuckets();
+    }
+
+    mCloseTrace.endLedger(txs.size());
 }
 
 void
@@ -826,6 +904,11 @@ LedgerManagerImpl::deleteOldEntries(Database &db, uint32_t ledgerSeq, uint32_t c
     txscope.commit();
 }
 
+LedgerCloseTrace &
+LedgerManagerImpl::getCloseTrace() {
+    return mCloseTrace;
+}
+
 void
 LedgerManagerImpl::checkDbState() {
     std::unordered_map<AccountID, AccountFrame::pointer> aData =
@@ -896,7 +979,8 @@ LedgerManagerImpl::advanceLedgerPointers() {
 
 void
 LedgerManagerImpl::processFeesSeqNums(std::vector<TransactionFramePtr> &txs,
-                                      LedgerDelta &delta) {
+                                      LedgerDelta &delta,
+                                      TransactionHistoryBuffer &history) {
     CLOG(DEBUG, "Ledger") << "processing fees and sequence numbers";
     int index = 0;
     try {
@@ -904,7 +988,7 @@ LedgerManagerImpl::processFeesSeqNums(std::vector<TransactionFramePtr> &txs,
         for (auto tx : txs) {
             LedgerDelta thisTxDelta(delta);
             tx->processFeeSeqNum(thisTxDelta, *this);
-            tx->storeTransactionFee(*this, thisTxDelta.getChanges(), ++index);
+            tx->storeTransactionFee(history, thisTxDelta.getChanges(), ++index);
             thisTxDelta.commit();
         }
         sqlTx.commit();
@@ -916,13 +1000,36 @@ LedgerManagerImpl::processFeesSeqNums(std::vector<TransactionFramePtr> &txs,
     }
 }
 
+void
+LedgerManagerImpl::prefetchTransactions(std::vector<TransactionFootprint> const &footprints) {
+    auto clusters = TransactionFootprint::cluster(footprints);
+    size_t largest = 0;
+    for (auto const &c : clusters) {
+        largest = std::max(largest, c.size());
+    }
+    mTransactionClusters.update(static_cast<int64_t>(clusters.size()));
+    mTransactionLargestCluster.update(static_cast<int64_t>(largest));
+    mTransactionGlobal.update(std::count_if(footprints.begin(), footprints.end(),
+                                            [](TransactionFootprint const &f) { return f.isGlobal(); }));
+
+    // only saves queries, transactions load what is missing
+    try {
+        mTransactionPrefetch.mark(TransactionFootprint::prefetch(
+                footprints, getDatabase(), PREFETCH_MAX_ENTRIES, mApp.io_context()));
+    }
+    catch (std::exception &e) {
+        CLOG(WARNING, "Ledger") << "Could not prefetch transaction entries: " << e.what();
+    }
+}
+
 void
 LedgerManagerImpl::applyTransactions(std::vector<TransactionFramePtr> &txs,
+                                     std::vector<TransactionFootprint> const &footprints,
                                      LedgerDelta &ledgerDelta,
-                                     TransactionResultSet &txResultSet) {
+                                     TransactionResultSet &txResultSet,
+                                     TransactionHistoryBuffer &history) {
     CLOG(DEBUG, "Tx") << "applyTransactions: ledger = "
                       << mCurrentLedger->mHeader.ledgerSeq;
-    int index = 0;
 
     // Record tx count
     auto numTxs = txs.size();
@@ -930,30 +1037,209 @@ LedgerManagerImpl::applyTransactions(std::vector<TransactionFramePtr> &txs,
         mTransactionCount.update(static_cast<int64_t>(numTxs));
     }
 
-    for (auto tx : txs) {
-        auto txTime = mTransactionApply.timeScope();
-        LedgerDelta delta(ledgerDelta);
-        TransactionMeta tm(1);
-        try {
-            CLOG(DEBUG, "Tx")
-                    << " tx#" << index << " = " << hexAbbrev(tx->getFullHash())
-                    << " txseq=" << tx->getSeqNum() << " (@ "
-                    << mApp.getConfig().toShortString(tx->getSourceID()) << ")";
-            tx->apply(ledgerDelta, tm.v1(), mApp);
+    bool parallel = mApp.getConfig().PARALLEL_TX_APPLY;
+    size_t index = 0;
+    while (index < numTxs) {
+        // a global transaction is applied alone, the ones up to the next
+        // global transaction may be applied in parallel
+        auto end = index + 1;
+        if (parallel && !footprints[index].isGlobal()) {
+            while (end < numTxs && !footprints[end].isGlobal()) {
+                end++;
+            }
         }
-        catch (InvariantDoesNotHold &e) {
-            throw e;
+
+        std::vector<TransactionMeta> metas(end - index, TransactionMeta(1));
+        if (end - index < 2 ||
+            !applyClusters(txs, footprints, index, end, ledgerDelta, metas)) {
+            for (auto i = index; i < end; i++) {
+                applyTransaction(*txs[i], ledgerDelta, metas[i - index], i);
+            }
         }
-        catch (std::runtime_error &e) {
-            CLOG(ERROR, "Ledger") << "Exception during tx->apply: " << e.what();
-            tx->getResult().result.code(txINTERNAL_ERROR);
+        for (auto i = index; i < end; i++) {
+            txs[i]->storeTransaction(history, metas[i - index],
+                                     static_cast<int>(i + 1), txResultSet);
         }
-        catch (...) {
-            CLOG(ERROR, "Ledger") << "Unknown exception during tx->apply";
-            tx->getResult().result.code(txINTERNAL_ERROR);
+        index = end;
+    }
+}
+
+void
+LedgerManagerImpl::applyTransaction(TransactionFrame &tx, LedgerDelta &delta,
+                                    TransactionMeta &tm, size_t index) {
+    auto txTime = mTransactionApply.timeScope();
+    try {
+        CLOG(DEBUG, "Tx")
+                << " tx#" << index << " = " << hexAbbrev(tx.getFullHash())
+                << " txseq=" << tx.getSeqNum() << " (@ "
+                << mApp.getConfig().toShortString(tx.getSourceID()) << ")";
+        tx.apply(delta, tm.v1(), mApp);
+    }
+    catch (InvariantDoesNotHold &e) {
+        throw e;
+    }
+    catch (EntryOverlay::Miss &) {
+        throw;
+    }
+    catch (std::runtime_error &e) {
+        CLOG(ERROR, "Ledger") << "Exception during tx->apply: " << e.what();
+        tx.getResult().result.code(txINTERNAL_ERROR);
+    }
+    catch (...) {
+        CLOG(ERROR, "Ledger") << "Unknown exception during tx->apply";
+        tx.getResult().result.code(txINTERNAL_ERROR);
+    }
+}
+
+namespace {
+// a cluster applied on its own delta, with the entries of its footprint
+struct ClusterApply {
+    std::vector<size_t> mTxs;
+    LedgerDelta mDelta;
+    EntryOverlay mOverlay;
+
+    explicit ClusterApply(LedgerDelta &outer) : mDelta(outer) {
+    }
+};
+
+// clusters applied by whichever thread claims them first
+struct ClusterApplies {
+    std::vector<ClusterApply *> const mClusters;
+    std::function<void(ClusterApply &)> const mApply;
+
+    std::mutex mMutex;
+    std::condition_variable mDone;
+    size_t mNext{0};
+    size_t mRunning{0};
+    std::exception_ptr mError;
+
+    ClusterApplies(std::vector<ClusterApply *> clusters,
+                   std::function<void(ClusterApply &)> apply)
+            : mClusters(std::move(clusters)), mApply(std::move(apply)) {
+    }
+
+    // applies clusters until there are none left
+    void
+    run() {
+        std::unique_lock<std::mutex> lock(mMutex);
+        if (mNext == mClusters.size() || mError) {
+            return;
+        }
+        ++mRunning;
+        while (mNext < mClusters.size() && !mError) {
+            auto i = mNext++;
+            lock.unlock();
+            try {
+                mApply(*mClusters[i]);
+                lock.lock();
+            }
+            catch (...) {
+                lock.lock();
+                mError = std::current_exception();
+            }
         }
-        tx->storeTransaction(*this, tm, ++index, txResultSet);
+        --mRunning;
+        mDone.notify_all();
+    }
+
+    // waits for the clusters being applied by other threads
+    void
+    wait() {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mDone.wait(lock, [this]() { return mRunning == 0; });
     }
+};
+}
+
+bool
+LedgerManagerImpl::applyClusters(std::vector<TransactionFramePtr> &txs,
+                                 std::vector<TransactionFootprint> const &footprints,
+                                 size_t begin, size_t end,
+                                 LedgerDelta &ledgerDelta,
+                                 std::vector<TransactionMeta> &metas) {
+    std::vector<TransactionFootprint> run(footprints.begin() + begin,
+                                          footprints.begin() + end);
+    auto clusters = TransactionFootprint::cluster(run);
+    if (clusters.size() < 2) {
+        return false;
+    }
+
+    // the entries are loaded from the session, before any cluster is applied
+    auto &db = getDatabase();
+    std::vector<std::unique_ptr<ClusterApply>> applies;
+    for (auto const &cluster : clusters) {
+        applies.emplace_back(std::make_unique<ClusterApply>(ledgerDelta));
+        auto &c = *applies.back();
+        auto add = [&](LedgerKey const &key, bool writable) {
+            auto frame = EntryFrame::storeLoad(key, db);
+            c.mOverlay.add(key,
+                           frame ? std::make_shared<LedgerEntry const>(frame->mEntry)
+                                 : nullptr,
+                           writable);
+        };
+        for (auto i : cluster) {
+            c.mTxs.emplace_back(begin + i);
+            for (auto const &key : run[i].getWrites()) {
+                add(key, true);
+            }
+            for (auto const &key : run[i].getReads()) {
+                add(key, false);
+            }
+        }
+    }
+
+    std::vector<ClusterApply *> pending;
+    for (auto const &c : applies) {
+        pending.emplace_back(c.get());
+    }
+    // once wait() returns no thread calls this anymore, so it can refer to
+    // what is on this stack
+    auto shared = std::make_shared<ClusterApplies>(
+            std::move(pending), [&](ClusterApply &c) {
+                EntryOverlay::Scope scope(c.mOverlay);
+                try {
+                    for (auto i : c.mTxs) {
+                        applyTransaction(*txs[i], c.mDelta, metas[i - begin], i);
+                    }
+                }
+                catch (EntryOverlay::Miss &) {
+                    // the overlay is missed, the transactions are applied
+                    // again without it
+                }
+            });
+    // workers busy with something else when a task starts find nothing left
+    // to apply, so this thread never waits for them to be free
+    for (size_t i = 1; i < applies.size(); ++i) {
+        asio::post(mApp.io_context(), [shared]() { shared->run(); });
+    }
+    shared->run();
+    shared->wait();
+
+    // anything that went wrong, or a header changed by a cluster, is left to
+    // the transactions applied one after the other; the deltas of the
+    // clusters are rolled back as they go
+    bool applied = !shared->mError;
+    for (auto const &c : applies) {
+        applied = applied && !c->mOverlay.isMissed() &&
+                  c->mDelta.getHeader() == ledgerDelta.getHeader();
+    }
+    if (!applied) {
+        for (auto i = begin; i < end; i++) {
+            txs[i]->resetAppliedResults();
+        }
+        std::fill(metas.begin(), metas.end(), TransactionMeta(1));
+        mTransactionParallelFallback.mark(end - begin);
+        return false;
+    }
+
+    // the clusters don't share entries, the order they are committed in
+    // doesn't change the ledger
+    for (auto const &c : applies) {
+        c->mOverlay.write(ledgerDelta, db);
+        c->mDelta.commit();
+    }
+    mTransactionParallel.mark(end - begin);
+    return true;
 }
 
 void
@@ -984,12 +1270,32 @@ LedgerManagerImpl::storeCurrentLedger() {
 void
 LedgerManagerImpl::ledgerClosed(LedgerDelta const &delta) {
     delta.markMeters(mApp);
-    mApp.getBucketManager().addBatch(mApp, mCurrentLedger->mHeader.ledgerSeq,
-                                     delta.getLiveEntries(),
-                                     delta.getDeadEntries());
+    auto liveEntries = delta.getLiveEntries();
+    auto deadEntries = delta.getDeadEntries();
 
-    mApp.getBucketManager().snapshotLedger(mCurrentLedger->mHeader);
-    storeCurrentLedger();
+    mLastClosedLedgerAccounts.clear();
+    for (auto const &e : liveEntries) {
+        if (e.data.type() == ACCOUNT) {
+            mLastClosedLedgerAccounts.insert(e.data.account().accountID);
+        }
+    }
+    for (auto const &k : deadEntries) {
+        if (k.type() == ACCOUNT) {
+            mLastClosedLedgerAccounts.insert(k.account().accountID);
+        }
+    }
+
+    {
+        LedgerCloseTrace::Span span(mCloseTrace, LedgerCloseTrace::PHASE_BUCKETS);
+        mApp.getBucketManager().addBatch(mApp, mCurrentLedger->mHeader.ledgerSeq,
+                                         liveEntries, deadEntries);
+        mApp.getBucketManager().snapshotLedger(mCurrentLedger->mHeader);
+    }
+
+    {
+        LedgerCloseTrace::Span span(mCloseTrace, LedgerCloseTrace::PHASE_STORE);
+        storeCurrentLedger();
+    }
     advanceLedgerPointers();
 }
 
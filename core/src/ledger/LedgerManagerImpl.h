@@ -6,11 +6,13 @@
 #include "util/asio.h"
 
 #include "history/HistoryManager.h"
+#include "ledger/LedgerCloseTrace.h"
 #include "ledger/LedgerHeaderFrame.h"
 #include "ledger/LedgerManager.h"
 #include "ledger/SyncingLedgerChain.h"
 #include "application/PersistentState.h"
 #include "transactions/TransactionFrame.h"
+#include "transactions/TransactionHistoryBuffer.h"
 #include "util/Timer.h"
 #include "xdr/ledger.h"
 #include <string>
@@ -27,6 +29,8 @@ class Timer;
 class Counter;
 
 class Histogram;
+
+class Meter;
 }
 
 namespace vixal {
@@ -36,14 +40,29 @@ class Database;
 
 class LedgerDelta;
 
+class TransactionFootprint;
+
 class LedgerManagerImpl : public LedgerManager {
     LedgerHeaderHistoryEntry mLastClosedLedger;
     LedgerHeaderFrame::pointer mCurrentLedger;
+    std::unordered_set<AccountID> mLastClosedLedgerAccounts;
 
     Application &mApp;
     medida::Timer &mTransactionApply;
     medida::Histogram &mTransactionCount;
+    // clusters of transactions that don't conflict, in each ledger
+    medida::Histogram &mTransactionClusters;
+    medida::Histogram &mTransactionLargestCluster;
+    // transactions left out of the clusters, in each ledger
+    medida::Histogram &mTransactionGlobal;
+    medida::Meter &mTransactionPrefetch;
+    // transactions applied in parallel, and applied again one after the
+    // other when their clusters couldn't be
+    medida::Meter &mTransactionParallel;
+    medida::Meter &mTransactionParallelFallback;
     medida::Timer &mLedgerClose;
+    // part of mLedgerClose spent writing the transaction history
+    medida::Timer &mLedgerHistoryStore;
     medida::Timer &mLedgerAgeClosed;
     medida::Counter &mLedgerAge;
     medida::Counter &mLedgerStateCurrent;
@@ -53,6 +72,8 @@ class LedgerManagerImpl : public LedgerManager {
 
     medida::Counter &mSyncingLedgersSize;
 
+    LedgerCloseTrace mCloseTrace;
+
 
     SyncingLedgerChain mSyncingLedgers;
     uint32_t mCatchupTriggerLedger{0};
@@ -74,11 +95,33 @@ class LedgerManagerImpl : public LedgerManager {
                          LedgerHeaderHistoryEntry const &lastClosed);
 
     void processFeesSeqNums(std::vector<TransactionFramePtr> &txs,
-                            LedgerDelta &delta);
+                            LedgerDelta &delta,
+                            TransactionHistoryBuffer &history);
+
+    // loads the entries `txs` may use in the entry cache, half of it at most
+    // so that they are still there when transactions load them
+    static size_t const PREFETCH_MAX_ENTRIES = 2048;
+
+    void prefetchTransactions(std::vector<TransactionFootprint> const &footprints);
 
     void applyTransactions(std::vector<TransactionFramePtr> &txs,
+                           std::vector<TransactionFootprint> const &footprints,
                            LedgerDelta &ledgerDelta,
-                           TransactionResultSet &txResultSet);
+                           TransactionResultSet &txResultSet,
+                           TransactionHistoryBuffer &history);
+
+    void applyTransaction(TransactionFrame &tx, LedgerDelta &delta,
+                          TransactionMeta &tm, size_t index);
+
+    // applies the clusters of txs[begin, end), none of them global, in
+    // parallel on entry overlays, `metas` receiving the meta of each
+    // transaction. Returns false, having changed nothing, if a cluster
+    // couldn't be applied that way: the transactions must then be applied
+    // one after the other.
+    bool applyClusters(std::vector<TransactionFramePtr> &txs,
+                       std::vector<TransactionFootprint> const &footprints,
+                       size_t begin, size_t end, LedgerDelta &ledgerDelta,
+                       std::vector<TransactionMeta> &metas);
 
     void ledgerClosed(LedgerDelta const &delta);
 
@@ -118,6 +161,9 @@ public:
 
     uint32_t getLastClosedLedgerNum() const override;
 
+    std::unordered_set<AccountID> const &
+    getLastClosedLedgerAccounts() const override;
+
     int64_t getMinBalance(uint32_t ownerCount) const override;
 
     uint32_t getTxFee() const override;
@@ -158,5 +204,7 @@ public:
     void deleteOldEntries(Database &db, uint32_t ledgerSeq, uint32 count) override;
 
     void checkDbState() override;
+
+    LedgerCloseTrace &getCloseTrace() override;
 };
 }
@@ -317,6 +317,25 @@ OfferFrame::loadBestOffers(size_t numOffers, size_t offset,
     });
 }
 
+void
+OfferFrame::loadOffers(soci::session &sess, std::vector<uint64_t> const &offerIDs,
+                       LedgerEntryProcessor offerProcessor) {
+    if (offerIDs.empty()) {
+        return;
+    }
+    std::string inList;
+    for (auto id : offerIDs) {
+        if (!inList.empty()) {
+            inList += ",";
+        }
+        inList += std::to_string(id);
+    }
+    std::string sql = offerColumnSelector;
+    sql += " WHERE offerid IN (" + inList + ")";
+    auto prep = Database::prepareStatement(sess, sql);
+    loadOffers(prep, offerProcessor);
+}
+
 std::unordered_map<AccountID, std::vector<OfferFrame::pointer>>
 OfferFrame::loadAllOffers(Database &db) {
     std::unordered_map<AccountID, std::vector<OfferFrame::pointer>> retOffers;
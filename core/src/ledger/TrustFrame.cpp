@@ -6,6 +6,7 @@
 #include "crypto/SHA.h"
 #include "crypto/SecretKey.h"
 #include "database/Database.h"
+#include "ledger/EntryOverlay.h"
 
 #include "ledger/TrustFrame.h"
 #include "ledger/LedgerDelta.h"
@@ -225,6 +226,9 @@ TrustFrame::getMaxAmountReceive(LedgerManager &lm) const {
 
 bool
 TrustFrame::exists(Database &db, LedgerKey const &key) {
+    if (auto overlay = EntryOverlay::current()) {
+        return overlay->load(key) != nullptr;
+    }
     if (cachedEntryExists(key, db) && getCachedEntry(key, db) != nullptr) {
         return true;
     }
@@ -289,6 +293,9 @@ TrustFrame::storeDelete(LedgerDelta &delta, Database &db) const {
 
 void
 TrustFrame::storeDelete(LedgerDelta &delta, Database &db, LedgerKey const &key) {
+    if (storeDeleteInOverlay(delta, key)) {
+        return;
+    }
     flushCachedEntry(key, db);
 
     std::string actIDStrKey, issuerStrKey, assetCode;
@@ -313,6 +320,10 @@ TrustFrame::storeChange(LedgerDelta &delta, Database &db) {
 
     touch(delta);
 
+    if (storeInOverlay(delta, false)) {
+        return;
+    }
+
     std::string actIDStrKey, issuerStrKey, assetCode;
     getKeyFields(key, actIDStrKey, issuerStrKey, assetCode);
 
@@ -361,6 +372,10 @@ TrustFrame::storeAdd(LedgerDelta &delta, Database &db) {
 
     touch(delta);
 
+    if (storeInOverlay(delta, true)) {
+        return;
+    }
+
     std::string actIDStrKey, issuerStrKey, assetCode;
     unsigned int assetType = getKey().trustLine().asset.type();
     getKeyFields(getKey(), actIDStrKey, issuerStrKey, assetCode);
@@ -437,6 +452,14 @@ TrustFrame::loadTrustLine(AccountID const &accountID, Asset const &asset,
     key.type(TRUSTLINE);
     key.trustLine().accountID = accountID;
     key.trustLine().asset = asset;
+    if (auto overlay = EntryOverlay::current()) {
+        auto p = overlay->load(key);
+        pointer ret = p ? std::make_shared<TrustFrame>(*p) : nullptr;
+        if (delta && ret) {
+            delta->recordEntry(*ret);
+        }
+        return ret;
+    }
     if (cachedEntryExists(key, db)) {
         auto p = getCachedEntry(key, db);
         if (p) {
@@ -544,6 +567,8 @@ TrustFrame::loadLines(StatementContext &prep,
         if (buyingLiabilitiesInd == soci::i_ok) {
             tl.ext.v(1);
             tl.ext.v1().liabilities = liabilities;
+        } else {
+            tl.ext.v(0);
         }
 
         trustProcessor(le);
@@ -552,6 +577,19 @@ TrustFrame::loadLines(StatementContext &prep,
     }
 }
 
+void
+TrustFrame::loadLines(soci::session &sess,
+                      std::vector<std::string> const &actIDStrKeys,
+                      LedgerEntryProcessor trustProcessor) {
+    if (actIDStrKeys.empty()) {
+        return;
+    }
+    auto query = std::string(trustLineColumnSelector);
+    query += " WHERE accountid IN (" + Database::toInList(actIDStrKeys) + ")";
+    auto prep = Database::prepareStatement(sess, query);
+    loadLines(prep, trustProcessor);
+}
+
 void
 TrustFrame::loadLines(AccountID const &accountID,
                       std::vector<TrustFrame::pointer> &retLines, Database &db) {
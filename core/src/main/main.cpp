@@ -9,6 +9,7 @@
 #include "catchup/CatchupManager.h"
 #include "catchup/VerifyLedgerChainWork.h"
 #include "database/Database.h"
+#include "ledger/LedgerCloseTrace.h"
 #include "ledger/LedgerManager.h"
 #include "http/HttpClient.h"
 #include "historywork/GetHistoryArchiveStateWork.h"
@@ -23,6 +24,10 @@
 #include "util/Fs.h"
 #include "util/format.h"
 
+#include <algorithm>
+#include <chrono>
+#include <functional>
+
 #if !defined(AUTO_INITIALIZE_EASYLOGGINGPP)
 INITIALIZE_EASYLOGGINGPP
 #endif
@@ -58,6 +63,8 @@ enum opttag {
     OPT_NEWDB,
     OPT_NEWHIST,
     OPT_PRINTTXN,
+    OPT_REPLAY_ARCHIVE,
+    OPT_REPLAY_BENCHMARK,
     OPT_SEC2PUB,
     OPT_SIGNTXN,
     OPT_NETID,
@@ -89,6 +96,8 @@ static const struct option vixal_core_options[] = {
         {"inferquorum",                    optional_argument, nullptr, OPT_INFERQUORUM},
         {"offlineinfo",                    no_argument,       nullptr, OPT_OFFLINEINFO},
         {"output-file",                    required_argument, nullptr, OPT_OUTPUT_FILE},
+        {"replay-archive",                 required_argument, nullptr, OPT_REPLAY_ARCHIVE},
+        {"replay-benchmark",               required_argument, nullptr, OPT_REPLAY_BENCHMARK},
         {"report-last-history-checkpoint", no_argument,       nullptr, OPT_REPORT_LAST_HISTORY_CHECKPOINT},
         {"sec2pub",                        no_argument,       nullptr, OPT_SEC2PUB},
         {"ll",                             required_argument, nullptr, OPT_LOGLEVEL},
@@ -131,6 +140,12 @@ usage(int err = 1) {
                     "      --metric METRIC      Report metric METRIC on exit\n"
                     "      --newdb              Creates or restores the DB to the genesis ledger\n"
                     "      --newhist ARCH       Initialize the named history archive ARCH\n"
+                    "      --replay-benchmark FROM-TO\n"
+                    "                           Catch up to ledger FROM, then replay the ledgers up to TO from\n"
+                    "                           history and report the time spent applying them, then quit.\n"
+                    "                           Ledgers are applied to the configured database: use a scratch one\n"
+                    "      --replay-archive DIR Replay from the local history archive DIR instead of the\n"
+                    "                           configured ones\n"
                     "      --report-last-history-checkpoint\n"
                     "                           Report information about last checkpoint available in history archives\n"
                     "      --printtxn FILE      Pretty-print one transaction envelope, then quit\n"
@@ -208,8 +223,10 @@ checkInitialized(Application::pointer app) {
     return true;
 }
 
+// `onCrank` is called after each crank of the clock while catching up
 static int
-catchup(Config const &cfg, uint32_t to, uint32_t count, Json::Value &catchupInfo) {
+catchup(Config const &cfg, uint32_t to, uint32_t count, Json::Value &catchupInfo,
+        std::function<void(Application &)> const &onCrank = nullptr) {
     VirtualClock clock(VirtualClock::REAL_TIME);
     Application::pointer app = Application::create(clock, cfg, false);
 
@@ -271,6 +288,9 @@ catchup(Config const &cfg, uint32_t to, uint32_t count, Json::Value &catchupInfo
             case LedgerManager::LM_NUM_STATE:
                 abort();
         }
+        if (onCrank) {
+            onCrank(*app);
+        }
     }
     LOG(INFO) << "*";
     if (synced) {
@@ -307,14 +327,15 @@ catchupTo(Config const &cfg, uint32_t to, Json::Value &catchupInfo) {
     return catchup(cfg, to, std::numeric_limits<uint32_t>::max(), catchupInfo);
 }
 
+// `what` names the information in the logs: "catchup", "benchmark"...
 static void
-writeCatchupInfo(Json::Value const &catchupInfo, std::string const &outputFile) {
+writeInfo(Json::Value const &info, std::string const &what, std::string const &outputFile) {
     std::string filename = outputFile.empty() ? "-" : outputFile;
-    auto content = catchupInfo.toStyledString();
+    auto content = info.toStyledString();
 
     if (filename == "-") {
         LOG(INFO) << "*";
-        LOG(INFO) << "* Catchup info: " << content;
+        LOG(INFO) << "* " << what << " info: " << content;
         LOG(INFO) << "*";
     } else {
         std::ofstream out{};
@@ -323,11 +344,123 @@ writeCatchupInfo(Json::Value const &catchupInfo, std::string const &outputFile)
         out.close();
 
         LOG(INFO) << "*";
-        LOG(INFO) << "* Wrote catchup info to " << filename;
+        LOG(INFO) << "* Wrote " << what << " info to " << filename;
         LOG(INFO) << "*";
     }
 }
 
+// nearest rank percentiles of durations in microseconds
+static Json::Value
+getPercentiles(std::vector<uint64_t> values) {
+    Json::Value res;
+    if (values.empty()) {
+        return res;
+    }
+    std::sort(values.begin(), values.end());
+    for (auto p : {50, 90, 99}) {
+        auto rank = (values.size() * p + 99) / 100;
+        res["p" + std::to_string(p)] = Json::UInt64(values[std::max<size_t>(rank, 1) - 1]);
+    }
+    res["max"] = Json::UInt64(values.back());
+    return res;
+}
+
+static int
+replayBenchmark(Config cfg, std::string const &archiveDir, uint32_t from, uint32_t to,
+                Json::Value &benchmarkInfo) {
+    if (!archiveDir.empty()) {
+        HistoryArchiveConfiguration archive;
+        archive.mName = "replay";
+        archive.mLocalDir = archiveDir;
+        cfg.HISTORY.clear();
+        cfg.HISTORY[archive.mName] = archive;
+    }
+
+    // state at `from`, not measured
+    Json::Value catchupInfo;
+    auto result = catchupAt(cfg, from, catchupInfo);
+    if (result == 2) {
+        LOG(INFO) << "* Replaying from the last closed ledger";
+    } else if (result != 0) {
+        return result;
+    }
+
+    // ledgers are read from the close trace as they are applied, it holds
+    // far more ledgers than are closed in one crank
+    uint64_t seen = 0;
+    uint64_t lost = 0;
+    std::vector<uint32_t> ledgers;
+    uint64_t txs = 0;
+    uint64_t ops = 0;
+    std::vector<uint64_t> totals;
+    std::map<std::string, std::vector<uint64_t>> phases;
+    auto collect = [&](Application &app) {
+        auto &trace = app.getLedgerManager().getCloseTrace();
+        auto closed = trace.getLedgersClosed();
+        if (closed == seen) {
+            return;
+        }
+        if (closed - seen > LedgerCloseTrace::CAPACITY) {
+            lost += closed - seen - LedgerCloseTrace::CAPACITY;
+        }
+        auto info = trace.getJsonInfo(closed - seen);
+        seen = closed;
+        for (Json::ArrayIndex i = 0; i < info["ledger"].size(); i++) {
+            ledgers.push_back(info["ledger"][i].asUInt());
+            txs += info["txs"][i].asUInt64();
+            ops += info["ops"][i].asUInt64();
+            totals.push_back(info["total"][i].asUInt64());
+            for (auto const &name : info["phases"].getMemberNames()) {
+                phases[name].push_back(info["phases"][name][i].asUInt64());
+            }
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    result = catchup(cfg, to, std::numeric_limits<uint32_t>::max(), catchupInfo, collect);
+    auto wallTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start);
+    if (result != 0) {
+        return result;
+    }
+    if (lost != 0) {
+        LOG(WARNING) << "* " << lost << " ledgers closed too fast to be traced";
+    }
+    if (ledgers.empty()) {
+        LOG(INFO) << "* No ledger replayed";
+        return 0;
+    }
+
+    uint64_t applyMicros = 0;
+    for (auto t : totals) {
+        applyMicros += t;
+    }
+    auto applySeconds = std::max(applyMicros, uint64_t{1}) / 1e6;
+
+    benchmarkInfo["first"] = ledgers.front();
+    benchmarkInfo["last"] = ledgers.back();
+    benchmarkInfo["ledgers"] = Json::UInt64(ledgers.size());
+    benchmarkInfo["txs"] = Json::UInt64(txs);
+    benchmarkInfo["ops"] = Json::UInt64(ops);
+    // closeLedger only, downloading and verifying history is left out
+    benchmarkInfo["apply_seconds"] = applySeconds;
+    benchmarkInfo["wall_seconds"] = wallTime.count();
+    benchmarkInfo["ledgers_per_second"] = ledgers.size() / applySeconds;
+    benchmarkInfo["txs_per_second"] = txs / applySeconds;
+    benchmarkInfo["ops_per_second"] = ops / applySeconds;
+    benchmarkInfo["latency"]["total"] = getPercentiles(totals);
+    for (auto const &phase : phases) {
+        benchmarkInfo["latency"]["phases"][phase.first] = getPercentiles(phase.second);
+    }
+
+    LOG(INFO) << "*";
+    LOG(INFO) << "* Replayed " << ledgers.size() << " ledgers (" << ledgers.front() << "-"
+              << ledgers.back() << ") in " << applySeconds << "s: "
+              << ledgers.size() / applySeconds << " ledgers/s, " << txs / applySeconds
+              << " txs/s, " << ops / applySeconds << " ops/s";
+    LOG(INFO) << "*";
+    return 0;
+}
+
 static int
 reportLastHistoryCheckpoint(Config const &cfg, std::string const &outputFile) {
     VirtualClock clock(VirtualClock::REAL_TIME);
@@ -395,6 +528,25 @@ parseLedgerCount(std::string const &str) {
     return static_cast<uint32_t>(result);
 }
 
+// FROM-TO, FROM being before TO
+static std::pair<uint32_t, uint32_t>
+parseLedgerRange(std::string const &str) {
+    auto dash = str.find('-');
+    if (dash == std::string::npos) {
+        throw std::runtime_error(
+                fmt::format("{} is not a valid ledger range", str));
+    }
+    auto from = parseLedger(str.substr(0, dash));
+    auto to = parseLedger(str.substr(dash + 1));
+    if (from == CatchupConfiguration::CURRENT ||
+        (to != CatchupConfiguration::CURRENT && to <= from)) {
+        throw std::runtime_error(
+                fmt::format("{} is not a valid ledger range", str));
+    }
+
+    return std::make_pair(from, to);
+}
+
 static void
 setForceSCPFlag(Config const &cfg, bool isOn) {
     VirtualClock clock;
@@ -458,12 +610,12 @@ inferQuorumAndWrite(Config const &cfg) {
     std::cout << iq.toString(cfg) << std::endl;
 }
 
-static void
+static int
 checkQuorumIntersection(Config const &cfg) {
     VirtualClock clock;
     Application::pointer app = Application::create(clock, cfg, false);
     InferredQuorum iq = app->getHistoryManager().inferQuorum();
-    iq.checkQuorumIntersection(cfg);
+    return iq.checkQuorumIntersection(cfg) ? 0 : 1;
 }
 
 static void
@@ -587,6 +739,10 @@ main(int argc, char *const *argv) {
     auto doReportLastHistoryCheckpoint = false;
     std::string outputFile;
     std::string loadXdrBucket;
+    bool doReplayBenchmark = false;
+    uint32_t replayFrom = 0;
+    uint32_t replayTo = 0;
+    std::string replayArchive;
     std::vector<std::string> newHistories;
     std::vector<std::string> metrics;
 
@@ -690,6 +846,13 @@ main(int argc, char *const *argv) {
             case OPT_REPORT_LAST_HISTORY_CHECKPOINT:
                 doReportLastHistoryCheckpoint = true;
                 break;
+            case OPT_REPLAY_ARCHIVE:
+                replayArchive = optarg;
+                break;
+            case OPT_REPLAY_BENCHMARK:
+                doReplayBenchmark = true;
+                std::tie(replayFrom, replayTo) = parseLedgerRange(optarg);
+                break;
 /*
             case OPT_TEST: {
                 rest.push_back(*argv);
@@ -739,7 +902,7 @@ main(int argc, char *const *argv) {
         if (forceSCP || newDB || getOfflineInfo || !loadXdrBucket.empty() ||
             inferQuorum || graphQuorum || checkQuorum || doCatchupAt ||
             doCatchupComplete || doCatchupRecent || doCatchupTo ||
-            doReportLastHistoryCheckpoint) {
+            doReportLastHistoryCheckpoint || doReplayBenchmark) {
 
             auto result = 0;
             setNoListen(cfg);
@@ -771,7 +934,15 @@ main(int argc, char *const *argv) {
                 app->gracefulStop();
                 while (app->getClock().crank(true));
                 if (!catchupInfo.isNull()) {
-                    writeCatchupInfo(catchupInfo, outputFile);
+                    writeInfo(catchupInfo, "catchup", outputFile);
+                }
+            }
+            if ((result == 0) && doReplayBenchmark) {
+                Json::Value benchmarkInfo;
+                result = replayBenchmark(cfg, replayArchive, replayFrom, replayTo,
+                                         benchmarkInfo);
+                if (!benchmarkInfo.isNull()) {
+                    writeInfo(benchmarkInfo, "benchmark", outputFile);
                 }
             }
             if ((result == 0) && forceSCP) {
@@ -790,7 +961,7 @@ main(int argc, char *const *argv) {
                 inferQuorumAndWrite(cfg);
             }
             if ((result == 0) && checkQuorum) {
-                checkQuorumIntersection(cfg);
+                result = checkQuorumIntersection(cfg);
             }
             if ((result == 0) && graphQuorum) {
                 writeQuorumGraph(cfg, outputFile);
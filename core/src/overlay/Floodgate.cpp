@@ -21,36 +21,149 @@
 #include "medida/counter.h"
 #include "medida/metrics_registry.h"
 
+#include <algorithm>
+
 namespace vixal {
 
+bool
+Floodgate::PeerBitmap::test(size_t slot) const {
+    if (slot < 64) {
+        return (mInline >> slot) & 1;
+    }
+    size_t word = (slot - 64) / 64;
+    if (word >= mOverflow.size()) {
+        return false;
+    }
+    return (mOverflow[word] >> ((slot - 64) % 64)) & 1;
+}
 
-Floodgate::FloodRecord::FloodRecord(VixalMessage const &msg, uint32_t ledger,
-                                    Peer::pointer peer)
-        : mLedgerSeq(ledger), mMessage(msg) {
-    if (peer) {
-        mPeersTold.insert(peer);
+void
+Floodgate::PeerBitmap::set(size_t slot) {
+    if (slot < 64) {
+        mInline |= uint64_t(1) << slot;
+        return;
     }
+    size_t word = (slot - 64) / 64;
+    if (word >= mOverflow.size()) {
+        mOverflow.resize(word + 1, 0);
+    }
+    mOverflow[word] |= uint64_t(1) << ((slot - 64) % 64);
+}
+
+void
+Floodgate::PeerBitmap::clear() {
+    mInline = 0;
+    mOverflow.clear();
+}
+
+size_t
+Floodgate::PeerBitmap::capacity() const {
+    return 64 * (mOverflow.size() + 1);
 }
 
 Floodgate::Floodgate(Application &app)
-        : mApp(app),
+        : mRecordCount(0), mApp(app),
           mFloodMapSize(app.getMetrics().newCounter({"overlay", "memory", "flood-map"})),
+          mPeerSlotsSize(app.getMetrics().newCounter({"overlay", "memory", "flood-peer-slots"})),
           mSendFromBroadcast(app.getMetrics().newMeter(
                   {"overlay", "message", "send-from-broadcast"}, "message")), mShuttingDown(false) {
 }
 
-// remove old flood records
+Floodgate::PeerBitmap *
+Floodgate::findRecord(Hash const &h) {
+    // most lookups are for recent messages
+    for (auto it = mGenerations.rbegin(); it != mGenerations.rend(); ++it) {
+        auto record = it->second.find(h);
+        if (record != it->second.end()) {
+            return &record->second;
+        }
+    }
+    return nullptr;
+}
+
+Floodgate::PeerBitmap &
+Floodgate::getOrCreateRecord(Hash const &h, bool &isNew) {
+    auto record = findRecord(h);
+    isNew = (record == nullptr);
+    if (isNew) {
+        auto &generation = mGenerations[mApp.getHerder().getCurrentLedgerSeq()];
+        record = &generation[h];
+        mRecordCount++;
+        mFloodMapSize.set_count(mRecordCount);
+    }
+    return *record;
+}
+
+size_t
+Floodgate::getPeerSlot(Peer::pointer const &peer) {
+    auto it = mSlotByPeer.find(peer.get());
+    if (it != mSlotByPeer.end()) {
+        if (!mPeerSlots[it->second].mPeer.expired()) {
+            return it->second;
+        }
+        // the address was reused by a new peer, the old slot may still be
+        // referenced by live records
+        retireSlot(it->second);
+        mSlotByPeer.erase(it);
+    }
+
+    size_t slot;
+    if (!mFreeSlots.empty()) {
+        slot = mFreeSlots.back();
+        mFreeSlots.pop_back();
+    } else {
+        slot = mPeerSlots.size();
+        mPeerSlots.emplace_back();
+        mPeerSlotsSize.set_count(mPeerSlots.size());
+    }
+    mPeerSlots[slot].mPeer = peer;
+    mPeerSlots[slot].mRetiredAt = 0;
+    mSlotByPeer[peer.get()] = slot;
+    return slot;
+}
+
 void
-Floodgate::clearBelow(uint32_t currentLedger) {
-    for (auto it = mFloodMap.cbegin(); it != mFloodMap.cend();) {
-        // give one ledger of leeway
-        if (it->second->mLedgerSeq + 10 < currentLedger) {
-            mFloodMap.erase(it++);
+Floodgate::retireSlot(size_t slot) {
+    mPeerSlots[slot].mPeer.reset();
+    // never 0, so that it can't be confused with an active slot
+    mPeerSlots[slot].mRetiredAt =
+            std::max<uint32_t>(mApp.getHerder().getCurrentLedgerSeq(), 1);
+    mRetiredSlots.push_back(slot);
+}
+
+void
+Floodgate::recycleSlots() {
+    for (auto it = mSlotByPeer.begin(); it != mSlotByPeer.end();) {
+        if (mPeerSlots[it->second].mPeer.expired()) {
+            retireSlot(it->second);
+            it = mSlotByPeer.erase(it);
         } else {
             ++it;
         }
     }
-    mFloodMapSize.set_count(mFloodMap.size());
+
+    // a retired slot can only be set in records created at or before the
+    // ledger it was retired at; once those generations are gone, it's free
+    auto oldest = mGenerations.empty() ? UINT32_MAX : mGenerations.begin()->first;
+    auto freeable = std::partition(mRetiredSlots.begin(), mRetiredSlots.end(),
+                                   [&](size_t slot) {
+                                       return mPeerSlots[slot].mRetiredAt >= oldest;
+                                   });
+    mFreeSlots.insert(mFreeSlots.end(), freeable, mRetiredSlots.end());
+    mRetiredSlots.erase(freeable, mRetiredSlots.end());
+}
+
+// remove old flood records
+void
+Floodgate::clearBelow(uint32_t currentLedger) {
+    // give ten ledgers of leeway
+    while (!mGenerations.empty() &&
+           mGenerations.begin()->first + 10 < currentLedger) {
+        mRecordCount -= mGenerations.begin()->second.size();
+        mGenerations.erase(mGenerations.begin());
+    }
+    mFloodMapSize.set_count(mRecordCount);
+    recycleSlots();
 }
 
 bool
@@ -59,58 +172,63 @@ Floodgate::addRecord(VixalMessage const &msg, Peer::pointer peer) {
         return false;
     }
     Hash index = sha256(xdr::xdr_to_opaque(msg));
-    auto result = mFloodMap.find(index);
-    if (result == mFloodMap.end()) { // we have never seen this message
-        mFloodMap[index] = std::make_shared<FloodRecord>(
-                msg, mApp.getHerder().getCurrentLedgerSeq(), peer);
-        mFloodMapSize.set_count(mFloodMap.size());
-        return true;
-    } else {
-        result->second->mPeersTold.insert(peer);
-        return false;
+    bool isNew;
+    auto &record = getOrCreateRecord(index, isNew);
+    if (peer) {
+        record.set(getPeerSlot(peer));
     }
+    return isNew;
 }
 
 // send message to anyone you haven't gotten it from
-void
+size_t
 Floodgate::broadcast(VixalMessage const &msg, bool force) {
     if (mShuttingDown) {
-        return;
+        return 0;
     }
     Hash index = sha256(xdr::xdr_to_opaque(msg));
     CLOG(TRACE, "Overlay") << "broadcast " << hexAbbrev(index);
 
-    auto result = mFloodMap.find(index);
-    if (result == mFloodMap.end() || force) { // no one has sent us this message
-        FloodRecord::pointer record = std::make_shared<FloodRecord>(
-                msg, mApp.getHerder().getCurrentLedgerSeq(), Peer::pointer());
-        result = mFloodMap.insert(std::make_pair(index, record)).first;
-        mFloodMapSize.set_count(mFloodMap.size());
+    bool isNew;
+    auto &peersTold = getOrCreateRecord(index, isNew);
+    if (force) {
+        // start over as if no one had the message
+        peersTold.clear();
     }
-    // send it to people that haven't sent it to us
-    std::set<Peer::pointer> &peersTold = result->second->mPeersTold;
 
     // make a copy, in case peers gets modified
     auto peers = mApp.getOverlayManager().getAuthenticatedPeers();
 
+    size_t told = 0;
     for (auto peer : peers) {
         assert(peer.second->isAuthenticated());
-        if (peersTold.find(peer.second) == peersTold.end()) {
+        auto slot = getPeerSlot(peer.second);
+        if (!peersTold.test(slot)) {
             mSendFromBroadcast.mark();
             peer.second->sendMessage(msg);
-            peersTold.insert(peer.second);
+            peersTold.set(slot);
+            told++;
         }
     }
     CLOG(TRACE, "Overlay") << "broadcast " << hexAbbrev(index) << " told "
-                           << peersTold.size();
+                           << told;
+    return told;
 }
 
 std::set<Peer::pointer>
 Floodgate::getPeersKnows(Hash const &h) {
     std::set<Peer::pointer> res;
-    auto record = mFloodMap.find(h);
-    if (record != mFloodMap.end()) {
-        res = record->second->mPeersTold;
+    auto record = findRecord(h);
+    if (record) {
+        auto capacity = std::min(record->capacity(), mPeerSlots.size());
+        for (size_t slot = 0; slot < capacity; ++slot) {
+            if (record->test(slot)) {
+                auto peer = mPeerSlots[slot].mPeer.lock();
+                if (peer) {
+                    res.insert(peer);
+                }
+            }
+        }
     }
     return res;
 }
@@ -118,6 +236,11 @@ Floodgate::getPeersKnows(Hash const &h) {
 void
 Floodgate::shutdown() {
     mShuttingDown = true;
-    mFloodMap.clear();
+    mGenerations.clear();
+    mRecordCount = 0;
+    mPeerSlots.clear();
+    mSlotByPeer.clear();
+    mRetiredSlots.clear();
+    mFreeSlots.clear();
 }
 }
@@ -58,7 +58,10 @@ OverlayManagerImpl::OverlayManagerImpl(Application &app)
           mPendingPeersSize(app.getMetrics().newCounter({"overlay", "memory", "pending-peers"})),
           mAuthenticatedPeersSize(app.getMetrics().newCounter({"overlay", "memory", "authenticated-peers"})),
           mTimer(app.getClock()),
-          mFloodGate(app) {
+          mFloodGate(app),
+          mTxIngestQueue(std::make_shared<TxIngestQueue>(app)),
+          mSCPIngestQueue(std::make_shared<SCPIngestQueue>(app)),
+          mPeerManager(app) {
 }
 
 OverlayManagerImpl::~OverlayManagerImpl() = default;
@@ -100,7 +103,7 @@ OverlayManagerImpl::connectTo(PeerRecord &pr) {
     mConnectionsAttempted.mark();
     if (!getConnectedPeer(pr.getAddress())) {
         pr.backOff(mApp.getClock());
-        pr.storePeerRecord(mApp.getDatabase());
+        mPeerManager.store(pr);
 
         if (getPendingPeersCount() < mApp.getConfig().MAX_PENDING_CONNECTIONS) {
             addPendingPeer(TCPPeer::initiate(mApp, pr.getAddress()));
@@ -125,9 +128,9 @@ OverlayManagerImpl::storePeerList(std::vector<std::string> const &list,
             pr.setPreferred(preferred);
             if (resetBackOff) {
                 pr.resetBackOff(mApp.getClock());
-                pr.storePeerRecord(mApp.getDatabase());
+                mPeerManager.store(pr);
             } else {
-                pr.insertIfNew(mApp.getDatabase());
+                mPeerManager.insertIfNew(pr);
             }
         }
         catch (std::runtime_error &) {
@@ -164,7 +167,7 @@ OverlayManagerImpl::getPreferredPeersFromConfig() {
     for (auto &pp : mPreferredPeers) {
         auto address = PeerBareAddress::resolve(pp, mApp);
         if (!getConnectedPeer(address)) {
-            auto pr = PeerRecord::loadPeerRecord(mApp.getDatabase(), address);
+            auto pr = mPeerManager.load(address);
             if (pr && pr->mNextAttempt <= mApp.getClock().now()) {
                 peers.emplace_back(*pr);
             }
@@ -179,12 +182,9 @@ OverlayManagerImpl::getPeersToConnectTo(int maxNum) {
     // don't connect to too many peers at once
     maxNum = std::min(maxNum, 50);
 
-    // batch is how many peers to load from the database every time
-    const int batchSize = std::max(50, maxNum);
-
     std::vector<PeerRecord> peers;
-    PeerRecord::loadPeerRecords(
-            mApp.getDatabase(), batchSize, mApp.getClock().now(),
+    mPeerManager.loadPeerRecords(
+            mApp.getClock().now(),
             [&](PeerRecord const& pr) {
                 // skip peers that we're already
                 // connected/connecting to
@@ -234,7 +234,7 @@ OverlayManagerImpl::tick() {
 
 
     if (getAuthenticatedPeersCount() < mApp.getConfig().TARGET_PEER_CONNECTIONS) {
-        // load best candidates from the database,
+        // load best candidates from the peer table,
         // when PREFERRED_PEER_ONLY is set and we connect to a non
         // preferred_peer we just end up dropping & backing off
         // it during handshake (this allows for preferred_peers
@@ -245,6 +245,9 @@ OverlayManagerImpl::tick() {
         connectToMorePeers(peers);
     }
 
+    // persist the back off changes made since the last tick
+    mPeerManager.flush();
+
     mTimer.expires_after(std::chrono::seconds(mApp.getConfig().PEER_AUTHENTICATION_TIMEOUT + 1));
     mTimer.async_wait([this]() {
         this->tick();
@@ -432,10 +435,22 @@ OverlayManagerImpl::recvFloodedMsg(VixalMessage const &msg,
     mFloodGate.addRecord(msg, peer);
 }
 
-void
+size_t
 OverlayManagerImpl::broadcastMessage(VixalMessage const &msg, bool force) {
     mMessagesBroadcast.mark();
-    mFloodGate.broadcast(msg, force);
+    return mFloodGate.broadcast(msg, force);
+}
+
+void
+OverlayManagerImpl::recvTransaction(VixalMessage const &msg,
+                                    Peer::pointer peer) {
+    mTxIngestQueue->enqueue(msg, peer);
+}
+
+void
+OverlayManagerImpl::recvSCPMessage(VixalMessage const &msg,
+                                   Peer::pointer peer) {
+    mSCPIngestQueue->enqueue(msg, peer);
 }
 
 void
@@ -458,6 +473,11 @@ OverlayManagerImpl::getLoadManager() {
     return mLoad;
 }
 
+PeerManager &
+OverlayManagerImpl::getPeerManager() {
+    return mPeerManager;
+}
+
 void
 OverlayManagerImpl::shutdown() {
     if (mShuttingDown) {
@@ -466,6 +486,8 @@ OverlayManagerImpl::shutdown() {
     mShuttingDown = true;
     mDoor.close();
     mFloodGate.shutdown();
+    mTxIngestQueue->shutdown();
+    mSCPIngestQueue->shutdown();
     auto pendingPeersToStop = mPendingPeers;
     for (auto &p : pendingPeersToStop) {
         p->drop(ERR_MISC, "peer shutdown");
@@ -474,6 +496,7 @@ OverlayManagerImpl::shutdown() {
     for (auto &p : authenticatedPeersToStop) {
         p.second->drop(ERR_MISC, "peer shutdown");
     }
+    mPeerManager.flush();
 }
 
 bool
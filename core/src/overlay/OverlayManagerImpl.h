@@ -8,9 +8,12 @@
 #include "overlay/Peer.h"
 #include "overlay/PeerAuth.h"
 #include "overlay/PeerDoor.h"
+#include "overlay/PeerManager.h"
 #include "overlay/PeerRecord.h"
 #include "overlay/Floodgate.h"
 #include "overlay/ItemFetcher.h"
+#include "overlay/SCPIngestQueue.h"
+#include "overlay/TxIngestQueue.h"
 #include "overlay/OverlayManager.h"
 #include "herder/TxSetFrame.h"
 #include "xdr/xdr.h"
@@ -64,6 +67,9 @@ protected:
     friend class OverlayManagerTests;
 
     Floodgate mFloodGate;
+    std::shared_ptr<TxIngestQueue> mTxIngestQueue;
+    std::shared_ptr<SCPIngestQueue> mSCPIngestQueue;
+    PeerManager mPeerManager;
 
 public:
     explicit OverlayManagerImpl(Application &app);
@@ -74,7 +80,11 @@ public:
 
     void recvFloodedMsg(VixalMessage const &msg, Peer::pointer peer) override;
 
-    void broadcastMessage(VixalMessage const &msg, bool force) override;
+    size_t broadcastMessage(VixalMessage const &msg, bool force) override;
+
+    void recvTransaction(VixalMessage const &msg, Peer::pointer peer) override;
+
+    void recvSCPMessage(VixalMessage const &msg, Peer::pointer peer) override;
 
     void connectTo(std::string const &addr) override;
 
@@ -112,6 +122,8 @@ public:
 
     LoadManager &getLoadManager() override;
 
+    PeerManager &getPeerManager() override;
+
     void start() override;
 
     void shutdown() override;
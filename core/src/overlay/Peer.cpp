@@ -14,6 +14,7 @@
 #include "overlay/LoadManager.h"
 #include "overlay/OverlayManager.h"
 #include "overlay/PeerAuth.h"
+#include "overlay/PeerManager.h"
 #include "overlay/PeerRecord.h"
 #include "util/Logging.h"
 #include "util/XDROperators.h"
@@ -294,17 +295,17 @@ Peer::sendPeers() {
 
     // send top peers we know about
     vector<PeerRecord> peerList;
-    PeerRecord::loadPeerRecords(mApp.getDatabase(), 50, mApp.getClock().now(),
-                                [&](PeerRecord const& pr) {
-                                    bool r = peerList.size() < maxPeerCount;
-                                    if (r) {
-                                        if (!pr.getAddress().isPrivate() &&
-                                                pr.getAddress() != mAddress) {
-                                            peerList.emplace_back(pr);
-                                        }
-                                    }
-                                    return r;
-                                });
+    mApp.getOverlayManager().getPeerManager().loadPeerRecords(
+            mApp.getClock().now(), [&](PeerRecord const& pr) {
+                bool r = peerList.size() < maxPeerCount;
+                if (r) {
+                    if (!pr.getAddress().isPrivate() &&
+                        pr.getAddress() != mAddress) {
+                        peerList.emplace_back(pr);
+                    }
+                }
+                return r;
+            });
     newMsg.peers().reserve(peerList.size());
     for (auto const &pr : peerList) {
         PeerAddress pa;
@@ -616,24 +617,8 @@ Peer::recvTxSet(VixalMessage const &msg) {
 
 void
 Peer::recvTransaction(VixalMessage const &msg) {
-    TransactionFramePtr transaction = TransactionFrame::makeTransactionFromWire(
-            mApp.getNetworkID(), msg.transaction());
-    if (transaction) {
-        // add it to our current set
-        // and make sure it is valid
-        auto recvRes = mApp.getHerder().recvTransaction(transaction);
-
-        if (recvRes == Herder::TX_STATUS_PENDING ||
-            recvRes == Herder::TX_STATUS_DUPLICATE) {
-            // record that this peer sent us this transaction
-            mApp.getOverlayManager().recvFloodedMsg(msg, shared_from_this());
-
-            if (recvRes == Herder::TX_STATUS_PENDING) {
-                // if it's a new transaction, broadcast it
-                mApp.getOverlayManager().broadcastMessage(msg, false);
-            }
-        }
-    }
+    // validated off the main thread, then handed to the herder
+    mApp.getOverlayManager().recvTransaction(msg, shared_from_this());
 }
 
 void
@@ -659,14 +644,11 @@ Peer::recvSCPQuorumSet(VixalMessage const &msg) {
 
 void
 Peer::recvSCPMessage(VixalMessage const &msg) {
-    SCPEnvelope const &envelope = msg.envelope();
     if (Logging::logTrace("Overlay"))
         CLOG(TRACE, "Overlay")
                 << "recvSCPMessage node: "
                 << mApp.getConfig().toShortString(msg.envelope().statement.nodeID);
 
-    mApp.getOverlayManager().recvFloodedMsg(msg, shared_from_this());
-
     auto type = msg.envelope().statement.pledges.type();
     auto t = (type == SCP_ST_PREPARE
               ? mRecvSCPPrepareTimer.timeScope()
@@ -676,7 +658,8 @@ Peer::recvSCPMessage(VixalMessage const &msg) {
                     ? mRecvSCPExternalizeTimer.timeScope()
                     : (mRecvSCPNominateTimer.timeScope()))));
 
-    mApp.getHerder().recvSCPEnvelope(envelope);
+    // signature checked off the main thread, then handed to the herder
+    mApp.getOverlayManager().recvSCPMessage(msg, shared_from_this());
 }
 
 void
@@ -723,7 +706,8 @@ Peer::noteHandshakeSuccessInPeerRecord() {
         return;
     }
 
-    auto pr = PeerRecord::loadPeerRecord(mApp.getDatabase(), getAddress());
+    auto &peerManager = mApp.getOverlayManager().getPeerManager();
+    auto pr = peerManager.load(getAddress());
     if (pr) {
         pr->setPreferred(mApp.getOverlayManager().isPreferred(this));
         pr->resetBackOff(mApp.getClock());
@@ -733,7 +717,7 @@ Peer::noteHandshakeSuccessInPeerRecord() {
     CLOG(INFO, "Overlay") << "successful handshake with "
                           << mApp.getConfig().toShortString(mPeerID) << "@"
                           << pr->toString();
-    pr->storePeerRecord(mApp.getDatabase());
+    peerManager.store(*pr);
 }
 
 void
@@ -937,7 +921,7 @@ Peer::recvPeers(VixalMessage const &msg) {
             // don't use peer.numFailures here as we may have better luck
             // (and we don't want to poison our failure count)
             PeerRecord pr{address, defaultNextAttempt, 0};
-            pr.insertIfNew(mApp.getDatabase());
+            mApp.getOverlayManager().getPeerManager().insertIfNew(pr);
         }
     }
 }
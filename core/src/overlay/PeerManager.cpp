@@ -0,0 +1,137 @@
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "overlay/PeerManager.h"
+
+#include "application/Application.h"
+
+#include "util/Logging.h"
+
+#include "medida/counter.h"
+#include "medida/metrics_registry.h"
+#include "medida/timer.h"
+
+namespace vixal {
+
+using namespace soci;
+
+PeerManager::PeerManager(Application &app)
+        : mApp(app), mLoaded(false),
+          mPeersSize(app.getMetrics().newCounter({"overlay", "memory", "known-peers"})),
+          mFlushTimer(app.getMetrics().newTimer({"overlay", "peers", "flush"})) {
+}
+
+void
+PeerManager::ensureLoaded() {
+    if (mLoaded) {
+        return;
+    }
+    mLoaded = true;
+
+    try {
+        PeerRecord::loadAllPeerRecords(mApp.getDatabase(),
+                                       [this](PeerRecord const &pr) {
+                                           put(pr);
+                                       });
+    }
+    catch (soci_error &err) {
+        LOG(ERROR) << "loadPeers Error: " << err.what();
+    }
+    CLOG(DEBUG, "Overlay") << "Loaded " << mPeers.size() << " peer records";
+    mPeersSize.set_count(mPeers.size());
+}
+
+PeerManager::IndexKey
+PeerManager::indexKey(PeerRecord const &pr) {
+    return std::make_tuple(pr.mNextAttempt, pr.mNumFailures, pr.toString());
+}
+
+void
+PeerManager::put(PeerRecord const &pr) {
+    auto key = pr.toString();
+    auto it = mPeers.find(key);
+    if (it != mPeers.end()) {
+        mByNextAttempt.erase(indexKey(it->second));
+        it->second = pr;
+    } else {
+        mPeers.emplace(key, pr);
+    }
+    mByNextAttempt.insert(indexKey(pr));
+}
+
+nonstd::optional<PeerRecord>
+PeerManager::load(PeerBareAddress const &address) {
+    ensureLoaded();
+
+    auto it = mPeers.find(address.toString());
+    if (it == mPeers.end()) {
+        return nonstd::nullopt;
+    }
+    return nonstd::make_optional<PeerRecord>(it->second);
+}
+
+bool
+PeerManager::insertIfNew(PeerRecord const &pr) {
+    ensureLoaded();
+
+    if (mPeers.find(pr.toString()) != mPeers.end()) {
+        return false;
+    }
+    store(pr);
+    return true;
+}
+
+void
+PeerManager::store(PeerRecord const &pr) {
+    ensureLoaded();
+
+    put(pr);
+    mDirty.insert(pr.toString());
+    mPeersSize.set_count(mPeers.size());
+}
+
+void
+PeerManager::loadPeerRecords(VirtualClock::time_point nextAttemptCutoff,
+                             std::function<bool(PeerRecord const &pr)> pred) {
+    ensureLoaded();
+
+    for (auto const &key : mByNextAttempt) {
+        if (std::get<0>(key) > nextAttemptCutoff) {
+            break;
+        }
+        if (!pred(mPeers.at(std::get<2>(key)))) {
+            break;
+        }
+    }
+}
+
+void
+PeerManager::flush() {
+    if (mDirty.empty()) {
+        return;
+    }
+
+    std::vector<PeerRecord> records;
+    records.reserve(mDirty.size());
+    for (auto const &key : mDirty) {
+        records.emplace_back(mPeers.at(key));
+    }
+
+    try {
+        auto timer = mFlushTimer.timeScope();
+        PeerRecord::storePeerRecords(mApp.getDatabase(), records);
+        mDirty.clear();
+    }
+    catch (soci_error &err) {
+        // keep the records dirty, next flush will try again
+        LOG(ERROR) << "storePeers Error: " << err.what();
+    }
+}
+
+size_t
+PeerManager::size() {
+    ensureLoaded();
+    return mPeers.size();
+}
+}
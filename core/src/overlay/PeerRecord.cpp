@@ -102,41 +102,15 @@ PeerRecord::loadPeerRecord(Database& db, PeerBareAddress const& address) {
 }
 
 void
-PeerRecord::loadPeerRecords(Database &db, int batchSize,
-                            VirtualClock::time_point nextAttemptCutoff,
-                            std::function<bool(PeerRecord const &pr)> pred) {
-    try {
-        int offset = 0;
-        bool lastRes;
-        do {
-            tm nextAttemptMax = VirtualClock::pointToTm(nextAttemptCutoff);
-
-            std::string sql = loadPeerRecordSelector;
-            sql += "WHERE nextattempt <= :nextattempt ORDER BY nextattempt "
-                    "ASC, numfailures ASC LIMIT :max OFFSET :o";
-
-            auto prep = db.getPreparedStatement(sql);
-            auto &st = prep.statement();
-
-            st.exchange(use(nextAttemptMax));
-            st.exchange(use(batchSize));
-            st.exchange(use(offset));
-
-            lastRes = false;
-
-            loadPeerRecords(db, prep, [&](PeerRecord const &pr) {
-                offset++;
-                lastRes = pred(pr);
-                return lastRes;
-            });
-        } while (lastRes);
-    }
-    catch (soci_error &err) {
-        LOG(ERROR) << "loadPeers Error: " << err.what();
-    }
+PeerRecord::loadAllPeerRecords(Database &db,
+                               std::function<void(PeerRecord const &pr)> f) {
+    auto prep = db.getPreparedStatement(loadPeerRecordSelector);
+    loadPeerRecords(db, prep, [&](PeerRecord const &pr) {
+        f(pr);
+        return true;
+    });
 }
 
-
 bool
 PeerRecord::isPreferred() const {
     return mIsPreferred;
@@ -179,33 +153,63 @@ PeerRecord::insertIfNew(Database &db) {
 }
 
 void
-PeerRecord::storePeerRecord(Database &db) {
-    if (!insertIfNew(db)) {
-        auto tm = VirtualClock::pointToTm(mNextAttempt);
-        auto prep = db.getPreparedStatement("UPDATE peers SET "
-                                                    "nextattempt = :v1, "
-                                                    "numfailures = :v2, "
-                                                    "flags = :v3 "
-                                                    "WHERE ip = :v4 AND port = :v5");
-        auto &st = prep.statement();
-        st.exchange(use(tm));
-        st.exchange(use(mNumFailures));
-        int flags = (mIsPreferred ? PEER_RECORD_FLAGS_PREFERRED : 0);
-        st.exchange(use(flags));
-        auto ip = mAddress.getIP();
-        st.exchange(use(ip));
-        int port = mAddress.getPort();
-        st.exchange(use(port));
-        st.define_and_bind();
-        {
-            auto timer = db.getUpdateTimer("peer");
-            st.execute(true);
-            if (st.get_affected_rows() != 1) {
-                throw runtime_error("PeerRecord::storePeerRecord: failed on " +
-                                    toString());
-            }
-        }
+PeerRecord::storePeerRecord(Database &db) const {
+    auto tm = VirtualClock::pointToTm(mNextAttempt);
+    auto ip = mAddress.getIP();
+    int port = mAddress.getPort();
+    int flags = (mIsPreferred ? PEER_RECORD_FLAGS_PREFERRED : 0);
+    uint32 numFailures = mNumFailures;
+
+    // most stores are for known peers, so try to update first
+    auto prep = db.getPreparedStatement("UPDATE peers SET "
+                                                "nextattempt = :v1, "
+                                                "numfailures = :v2, "
+                                                "flags = :v3 "
+                                                "WHERE ip = :v4 AND port = :v5");
+    auto &st = prep.statement();
+    st.exchange(use(tm));
+    st.exchange(use(numFailures));
+    st.exchange(use(flags));
+    st.exchange(use(ip));
+    st.exchange(use(port));
+    st.define_and_bind();
+    {
+        auto timer = db.getUpdateTimer("peer");
+        st.execute(true);
+    }
+    if (st.get_affected_rows() == 1) {
+        return;
+    }
+
+    auto insertPrep = db.getPreparedStatement(
+            "INSERT INTO peers "
+                    "( ip,  port, nextattempt, numfailures, flags) VALUES "
+                    "(:v1, :v2,  :v3,         :v4,          :v5)");
+    auto &insertSt = insertPrep.statement();
+    insertSt.exchange(use(ip));
+    insertSt.exchange(use(port));
+    insertSt.exchange(use(tm));
+    insertSt.exchange(use(numFailures));
+    insertSt.exchange(use(flags));
+    insertSt.define_and_bind();
+    {
+        auto timer = db.getInsertTimer("peer");
+        insertSt.execute(true);
+    }
+    if (insertSt.get_affected_rows() != 1) {
+        throw runtime_error("PeerRecord::storePeerRecord: failed on " +
+                            toString());
+    }
+}
+
+void
+PeerRecord::storePeerRecords(Database &db,
+                             std::vector<PeerRecord> const &records) {
+    soci::transaction sqlTx(db.getSession());
+    for (auto const &pr : records) {
+        pr.storePeerRecord(db);
     }
+    sqlTx.commit();
 }
 
 void
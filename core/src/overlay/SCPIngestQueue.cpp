@@ -0,0 +1,163 @@
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/asio.h"
+#include "overlay/SCPIngestQueue.h"
+
+#include "application/Application.h"
+
+#include "crypto/SecretKey.h"
+
+#include "herder/Herder.h"
+
+#include "overlay/OverlayManager.h"
+
+#include "util/Logging.h"
+
+#include "xdrpp/marshal.h"
+
+#include "medida/counter.h"
+#include "medida/meter.h"
+#include "medida/metrics_registry.h"
+#include "medida/timer.h"
+
+namespace vixal {
+
+size_t const SCPIngestQueue::MAX_BATCH_SIZE = 256;
+
+SCPIngestQueue::SCPIngestQueue(Application &app)
+        : mApp(app), mNextTicket(0), mNextDelivery(0), mSize(0),
+          mQueueSize(app.getMetrics().newCounter({"overlay", "memory", "scp-ingest-queue"})),
+          mVerifyTimer(app.getMetrics().newTimer({"overlay", "scp-ingest", "verify-batch"})),
+          mInvalidSig(app.getMetrics().newMeter({"overlay", "scp-ingest", "invalid-sig"}, "envelope")),
+          mShuttingDown(false) {
+}
+
+void
+SCPIngestQueue::enqueue(VixalMessage const &msg, Peer::pointer peer) {
+    if (mShuttingDown) {
+        return;
+    }
+
+    auto item = std::make_shared<Item>();
+    item->mMessage = msg;
+    item->mPeer = peer;
+    mBatch.emplace_back(std::move(item));
+    ++mSize;
+    mQueueSize.set_count(mSize);
+
+    if (mBatch.size() >= MAX_BATCH_SIZE) {
+        flush();
+    } else if (mBatch.size() == 1) {
+        // envelopes read from the network in the meantime join the batch
+        std::weak_ptr<SCPIngestQueue> weak = shared_from_this();
+        asio::post(mApp.getClock().io_context(), [weak]() {
+            auto self = weak.lock();
+            if (self) {
+                self->flush();
+            }
+        });
+    }
+}
+
+void
+SCPIngestQueue::flush() {
+    if (mShuttingDown || mBatch.empty()) {
+        return;
+    }
+
+    auto batch = std::make_shared<Batch>();
+    batch->swap(mBatch);
+    auto ticket = mNextTicket++;
+
+    // same lifetime considerations as in TxIngestQueue::enqueue
+    std::weak_ptr<SCPIngestQueue> weak = shared_from_this();
+    Hash const &networkID = mApp.getNetworkID();
+    VirtualClock &clock = mApp.getClock();
+    medida::Timer &verifyTimer = mVerifyTimer;
+    asio::post(mApp.io_context(), [&networkID, &clock, &verifyTimer, weak, ticket, batch]() {
+        {
+            auto timer = verifyTimer.timeScope();
+            std::vector<xdr::opaque_vec<>> bins;
+            bins.reserve(batch->size());
+            std::vector<PubKeyUtils::VerifySigRequest> requests;
+            requests.reserve(batch->size());
+            for (auto const &item : *batch) {
+                auto const &envelope = item->mMessage.envelope();
+                bins.emplace_back(xdr::xdr_to_opaque(networkID, ENVELOPE_TYPE_SCP,
+                                                     envelope.statement));
+                requests.emplace_back(envelope.statement.nodeID,
+                                      envelope.signature, bins.back());
+            }
+            auto results = PubKeyUtils::verifySigs(requests);
+            for (size_t i = 0; i < batch->size(); ++i) {
+                (*batch)[i]->mValid = results[i];
+            }
+        }
+        asio::post(clock.io_context(), [weak, ticket, batch]() {
+            auto self = weak.lock();
+            if (self) {
+                self->verified(ticket, std::move(*batch));
+            }
+        });
+    });
+}
+
+void
+SCPIngestQueue::verified(uint64_t ticket, Batch batch) {
+    if (mShuttingDown) {
+        return;
+    }
+
+    mVerified.emplace(ticket, std::move(batch));
+    for (auto it = mVerified.begin();
+         it != mVerified.end() && it->first == mNextDelivery;
+         it = mVerified.erase(it)) {
+        ++mNextDelivery;
+        for (auto const &item : it->second) {
+            --mSize;
+            deliver(*item);
+            if (mShuttingDown) {
+                return;
+            }
+        }
+    }
+    mQueueSize.set_count(mSize);
+}
+
+void
+SCPIngestQueue::deliver(Item const &item) {
+    if (mApp.getOverlayManager().isShuttingDown()) {
+        return;
+    }
+
+    if (!item.mValid) {
+        mInvalidSig.mark();
+        CLOG(DEBUG, "Overlay") << "dropping SCP envelope with a bad signature";
+        return;
+    }
+
+    // the peer may have been dropped while we were verifying, the envelope
+    // is still worth having but there is no peer to record it came from
+    auto peer = item.mPeer.lock();
+    if (peer && peer->isAuthenticated()) {
+        mApp.getOverlayManager().recvFloodedMsg(item.mMessage, peer);
+    }
+    mApp.getHerder().recvSCPEnvelope(item.mMessage.envelope());
+}
+
+size_t
+SCPIngestQueue::size() const {
+    return mSize;
+}
+
+void
+SCPIngestQueue::shutdown() {
+    mShuttingDown = true;
+    mBatch.clear();
+    mVerified.clear();
+    mSize = 0;
+    mQueueSize.set_count(0);
+}
+}
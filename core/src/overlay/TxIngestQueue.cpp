@@ -0,0 +1,120 @@
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/asio.h"
+#include "overlay/TxIngestQueue.h"
+
+#include "application/Application.h"
+
+#include "herder/Herder.h"
+
+#include "overlay/OverlayManager.h"
+
+#include "util/Logging.h"
+
+#include "medida/counter.h"
+#include "medida/metrics_registry.h"
+#include "medida/timer.h"
+
+namespace vixal {
+
+TxIngestQueue::TxIngestQueue(Application &app)
+        : mApp(app), mNextTicket(0), mNextDelivery(0),
+          mQueueSize(app.getMetrics().newCounter({"overlay", "memory", "tx-ingest-queue"})),
+          mPreverifyTimer(app.getMetrics().newTimer({"overlay", "tx-ingest", "preverify"})),
+          mShuttingDown(false) {
+}
+
+void
+TxIngestQueue::enqueue(VixalMessage const &msg, Peer::pointer peer) {
+    if (mShuttingDown) {
+        return;
+    }
+
+    auto item = std::make_shared<Item>();
+    item->mMessage = msg;
+    item->mPeer = peer;
+
+    auto ticket = mNextTicket++;
+    mQueueSize.set_count(size());
+
+    // workers are joined before the Application goes away, so they can safely
+    // reference it; the way back to the main thread goes through a weak
+    // pointer as the clock may outlive us
+    std::weak_ptr<TxIngestQueue> weak = shared_from_this();
+    Hash const &networkID = mApp.getNetworkID();
+    VirtualClock &clock = mApp.getClock();
+    medida::Timer &preverifyTimer = mPreverifyTimer;
+    asio::post(mApp.io_context(), [&networkID, &clock, &preverifyTimer, weak, ticket, item]() {
+        {
+            auto timer = preverifyTimer.timeScope();
+            item->mTransaction = TransactionFrame::makeTransactionFromWire(
+                    networkID, item->mMessage.transaction());
+            item->mTransaction->preverifySignatures();
+        }
+        asio::post(clock.io_context(), [weak, ticket, item]() {
+            auto self = weak.lock();
+            if (self) {
+                self->verified(ticket, item);
+            }
+        });
+    });
+}
+
+void
+TxIngestQueue::verified(uint64_t ticket, std::shared_ptr<Item> item) {
+    if (mShuttingDown) {
+        return;
+    }
+
+    mVerified.emplace(ticket, std::move(item));
+    for (auto it = mVerified.begin();
+         it != mVerified.end() && it->first == mNextDelivery;
+         it = mVerified.erase(it)) {
+        ++mNextDelivery;
+        deliver(*it->second);
+        if (mShuttingDown) {
+            return;
+        }
+    }
+    mQueueSize.set_count(size());
+}
+
+void
+TxIngestQueue::deliver(Item const &item) {
+    auto peer = item.mPeer.lock();
+    // the peer may have been dropped while we were verifying
+    if (!peer || !peer->isAuthenticated() ||
+        mApp.getOverlayManager().isShuttingDown()) {
+        return;
+    }
+
+    // add it to our current set
+    // and make sure it is valid
+    auto recvRes = mApp.getHerder().recvTransaction(item.mTransaction);
+
+    if (recvRes == Herder::TX_STATUS_PENDING ||
+        recvRes == Herder::TX_STATUS_DUPLICATE) {
+        // record that this peer sent us this transaction
+        mApp.getOverlayManager().recvFloodedMsg(item.mMessage, peer);
+
+        if (recvRes == Herder::TX_STATUS_PENDING) {
+            // if it's a new transaction, broadcast it
+            mApp.getOverlayManager().broadcastMessage(item.mMessage, false);
+        }
+    }
+}
+
+size_t
+TxIngestQueue::size() const {
+    return static_cast<size_t>(mNextTicket - mNextDelivery);
+}
+
+void
+TxIngestQueue::shutdown() {
+    mShuttingDown = true;
+    mVerified.clear();
+    mQueueSize.set_count(0);
+}
+}
@@ -21,8 +21,10 @@
 
 #include "medida/counter.h"
 #include "medida/metrics_registry.h"
+#include "medida/timer.h"
 
 #include <algorithm>
+#include <chrono>
 #include <functional>
 #include <iterator>
 #include <mutex>
@@ -60,6 +62,8 @@ public:
     std::shared_ptr<asio::error_code> mOuterEc;
     std::string mCmdLine;
     std::string mOutFile;
+    ProcessClass mClass;
+    std::chrono::steady_clock::time_point mQueuedAt;
     bool mRunning{false};
 #ifdef _WIN32
     asio::windows::object_handle mProcessHandle;
@@ -70,11 +74,13 @@ public:
     Impl(std::shared_ptr<RealTimer> outerTimer,
          std::shared_ptr<asio::error_code> outerEc,
          std::string const &cmdLine, std::string outFile,
-         std::weak_ptr<ProcessManagerImpl> pm)
+         ProcessClass processClass, std::weak_ptr<ProcessManagerImpl> pm)
             : mOuterTimer(std::move(outerTimer)),
               mOuterEc(std::move(outerEc)),
               mCmdLine(cmdLine),
-              mOutFile(std::move(outFile))
+              mOutFile(std::move(outFile)),
+              mClass(processClass),
+              mQueuedAt(std::chrono::steady_clock::now())
 #ifdef _WIN32
             , mProcessHandle(outerTimer->get_io_context())
 #endif
@@ -130,10 +136,12 @@ ProcessManagerImpl::shutdown() {
 
         // Cancel all pending.
         std::lock_guard<std::recursive_mutex> guard(mImplsMutex);
-        for (auto &pending : mPendingImpls) {
-            pending->cancel(ec);
+        for (auto &pendingByClass : mPendingImpls) {
+            for (auto &pending : pendingByClass) {
+                pending->cancel(ec);
+            }
+            pendingByClass.clear();
         }
-        mPendingImpls.clear();
 
         // Cancel all running.
         for (auto &pair : mImpls) {
@@ -146,6 +154,7 @@ ProcessManagerImpl::shutdown() {
 #endif
         }
         mImpls.clear();
+        mRunningByClass.fill(0);
         gNumProcessesActive = 0;
 #ifndef _WIN32
         mSigChild.cancel(ec);
@@ -162,6 +171,7 @@ ProcessManagerImpl::ProcessManagerImpl(Application& app)
     , io_context_(app.getClock().io_context())
     , mSigChild(io_context_)
 {
+    initProcessClasses(app);
 }
 
 void
@@ -176,6 +186,12 @@ ProcessManagerImpl::handleSignalWait()
     // No-op on windows, uses waitable object handles
 }
 
+void
+ProcessManagerImpl::spawn(ProcessExitEvent::Impl& impl)
+{
+    impl.run();
+}
+
 void
 ProcessExitEvent::Impl::run()
 {
@@ -315,10 +331,55 @@ ProcessManagerImpl::ProcessManagerImpl(Application &app)
         : mMaxProcesses(static_cast<int64_t>(app.getConfig().MAX_CONCURRENT_SUBPROCESSES)),
           mIoContext(app.getClock().io_context()),
           mSigChild(mIoContext, SIGCHLD) {
+    initProcessClasses(app);
     std::lock_guard<std::recursive_mutex> guard(mImplsMutex);
     startSignalWait();
 }
 
+namespace {
+// Running children of every ProcessManagerImpl of the process, by pid. A
+// child is spawned and registered under the lock, and children are reaped
+// under it, so every child reaped is known or isn't one of ours.
+std::mutex gChildrenMutex;
+std::map<int, std::weak_ptr<ProcessManagerImpl>> gChildren;
+}
+
+void
+ProcessManagerImpl::spawn(ProcessExitEvent::Impl &impl) {
+    std::lock_guard<std::mutex> guard(gChildrenMutex);
+    impl.run();
+    gChildren[impl.getProcessId()] =
+            std::static_pointer_cast<ProcessManagerImpl>(shared_from_this());
+}
+
+void
+ProcessManagerImpl::reapChildren() {
+    std::lock_guard<std::mutex> guard(gChildrenMutex);
+    int pid;
+    int status = 0;
+    size_t reaped = 0;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        ++reaped;
+        auto child = gChildren.find(pid);
+        if (child == gChildren.end()) {
+            CLOG(DEBUG, "Process") << "reaped unknown child process " << pid;
+            continue;
+        }
+        auto owner = child->second.lock();
+        gChildren.erase(child);
+        if (owner) {
+            // each instance handles its processes on its own thread
+            asio::post(owner->mIoContext, [owner, pid, status]() {
+                owner->handleProcessTermination(pid, status);
+            });
+        }
+    }
+    if (reaped > 0) {
+        CLOG(DEBUG, "Process") << "found " << reaped
+                               << " child processes that terminated";
+    }
+}
+
 void
 ProcessManagerImpl::startSignalWait() {
     std::lock_guard<std::recursive_mutex> guard(mImplsMutex);
@@ -331,29 +392,10 @@ ProcessManagerImpl::handleSignalWait() {
     if (isShutdown()) {
         return;
     }
-    // Store tuples (pid, status)
-    std::vector<std::tuple<int, int>> signaledChildren;
-    std::lock_guard<std::recursive_mutex> guard(mImplsMutex);
-    for (auto const &implPair : mImpls) {
-        const int pid = implPair.first;
-        int status = 0;
-        // If we find the child for which we received this SIGCHLD signal,
-        // store the pid and status
-        if (waitpid(pid, &status, WNOHANG) > 0) {
-            signaledChildren.push_back(std::make_tuple(pid, status));
-        }
-    }
-
-    if (!signaledChildren.empty()) {
-        CLOG(DEBUG, "Process") << "found " << signaledChildren.size()
-                               << " child processes that terminated";
-        // Now go all over all (pid, status) and handle them
-        for (auto const &pidStatus : signaledChildren) {
-            const int pid = std::get<0>(pidStatus);
-            const int status = std::get<1>(pidStatus);
-            handleProcessTermination(pid, status);
-        }
-    }
+    // SIGCHLD is delivered to every instance, the first one to get it reaps
+    // the children of all of them with a single waitpid(-1) loop rather
+    // than polling each running process
+    reapChildren();
     startSignalWait();
 }
 
@@ -412,6 +454,7 @@ ProcessManagerImpl::handleProcessTermination(int pid, int status) {
     }
 
     --gNumProcessesActive;
+    --mRunningByClass[impl->mClass];
     mImpls.erase(pair);
 
     // Fire off any new processes we've made room for before we
@@ -494,15 +537,16 @@ ProcessExitEvent::Impl::run() {
 #endif
 
 ProcessExitEvent
-ProcessManagerImpl::runProcess(std::string const &cmdLine, std::string outFile) {
+ProcessManagerImpl::runProcess(std::string const &cmdLine, std::string outFile,
+                               ProcessClass processClass) {
     std::lock_guard<std::recursive_mutex> guard(mImplsMutex);
     ProcessExitEvent pe(mIoContext);
     std::shared_ptr<ProcessManagerImpl> self =
             std::static_pointer_cast<ProcessManagerImpl>(shared_from_this());
     std::weak_ptr<ProcessManagerImpl> weakSelf(self);
     pe.mImpl = std::make_shared<ProcessExitEvent::Impl>(
-            pe.mTimer, pe.mEc, cmdLine, outFile, weakSelf);
-    mPendingImpls.push_back(pe.mImpl);
+            pe.mTimer, pe.mEc, cmdLine, outFile, processClass, weakSelf);
+    mPendingImpls[processClass].push_back(pe.mImpl);
 
     maybeRunPendingProcesses();
     return pe;
@@ -514,15 +558,19 @@ ProcessManagerImpl::maybeRunPendingProcesses() {
         return;
     }
     std::lock_guard<std::recursive_mutex> guard(mImplsMutex);
-    while (!mPendingImpls.empty() && gNumProcessesActive < mMaxProcesses) {
-        auto i = mPendingImpls.front();
-        mPendingImpls.pop_front();
+    while (gNumProcessesActive < mMaxProcesses) {
+        auto i = popPendingProcess();
+        if (!i) {
+            break;
+        }
+        mWaitTimers[i->mClass]->update(std::chrono::steady_clock::now() - i->mQueuedAt);
         try {
             CLOG(DEBUG, "process") << "Running: " << i->mCmdLine;
 
-            i->run();
+            spawn(*i);
             mImpls[i->getProcessId()] = i;
             ++gNumProcessesActive;
+            ++mRunningByClass[i->mClass];
         }
         catch (std::runtime_error &e) {
             i->cancel(std::make_error_code(std::errc::io_error));
@@ -532,6 +580,43 @@ ProcessManagerImpl::maybeRunPendingProcesses() {
     }
 }
 
+std::shared_ptr<ProcessExitEvent::Impl>
+ProcessManagerImpl::popPendingProcess() {
+    // processes running in each class and all the classes below it
+    std::array<int64_t, PROCESS_CLASS_COUNT> runningFrom;
+    int64_t running = 0;
+    for (size_t c = PROCESS_CLASS_COUNT; c-- > 0;) {
+        running += mRunningByClass[c];
+        runningFrom[c] = running;
+    }
+
+    for (size_t c = 0; c < PROCESS_CLASS_COUNT; c++) {
+        auto &pending = mPendingImpls[c];
+        if (!pending.empty() && runningFrom[c] < getQuota(static_cast<ProcessClass>(c))) {
+            auto i = pending.front();
+            pending.pop_front();
+            return i;
+        }
+    }
+    return nullptr;
+}
+
+int64_t
+ProcessManagerImpl::getQuota(ProcessClass processClass) const {
+    // slots this class shares with the classes below it: one is left free
+    // for each class of higher priority
+    return std::max<int64_t>(1, mMaxProcesses - processClass);
+}
+
+void
+ProcessManagerImpl::initProcessClasses(Application &app) {
+    static char const *const names[PROCESS_CLASS_COUNT] = {"publish", "catchup", "repair", "other"};
+    mRunningByClass.fill(0);
+    for (size_t c = 0; c < PROCESS_CLASS_COUNT; c++) {
+        mWaitTimers[c] = &app.getMetrics().newTimer({"process", "wait", names[c]});
+    }
+}
+
 ProcessExitEvent::ProcessExitEvent(asio::io_context &io_context)
         : mTimer(std::make_shared<RealTimer>(io_context)), mImpl(nullptr), mEc(std::make_shared<asio::error_code>()) {
     mTimer->expires_after(std::chrono::system_clock::duration::max());
@@ -5,6 +5,7 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "process/ProcessManager.h"
+#include <array>
 #include <atomic>
 #include <deque>
 #include <mutex>
@@ -13,6 +14,8 @@
 
 namespace medida {
 class Counter;
+
+class Timer;
 }
 
 namespace vixal {
@@ -33,11 +36,30 @@ class ProcessManagerImpl : public ProcessManager {
     int64_t mMaxProcesses;
     asio::io_context &mIoContext;
 
-    std::deque<std::shared_ptr<ProcessExitEvent::Impl>> mPendingImpls;
+    // queued processes and running processes, by class
+    std::array<std::deque<std::shared_ptr<ProcessExitEvent::Impl>>, PROCESS_CLASS_COUNT> mPendingImpls;
+    std::array<int64_t, PROCESS_CLASS_COUNT> mRunningByClass;
+    std::array<medida::Timer *, PROCESS_CLASS_COUNT> mWaitTimers;
     std::deque<std::shared_ptr<ProcessExitEvent::Impl>> mKillableImpls;
 
     void maybeRunPendingProcesses();
 
+    // the next process to run: the first of the highest class under its
+    // quota, nullptr if there is none. A class is under its quota when it and
+    // the classes below it run fewer processes than getQuota
+    std::shared_ptr<ProcessExitEvent::Impl> popPendingProcess();
+
+    int64_t getQuota(ProcessClass processClass) const;
+
+    // starts the process, so that its exit is seen by reapChildren
+    void spawn(ProcessExitEvent::Impl &impl);
+
+    // reaps every child of the process that exited, and hands each one to the
+    // instance that started it
+    static void reapChildren();
+
+    void initProcessClasses(Application &app);
+
     // These are only used on POSIX, but they're harmless here.
     asio::signal_set mSigChild;
 
@@ -54,7 +76,8 @@ class ProcessManagerImpl : public ProcessManager {
 public:
     explicit ProcessManagerImpl(Application &app);
 
-    ProcessExitEvent runProcess(std::string const &cmdLine, std::string outFile) override;
+    ProcessExitEvent runProcess(std::string const &cmdLine, std::string outFile,
+                                ProcessClass processClass) override;
 
     size_t getNumRunningProcesses() override;
 
@@ -15,6 +15,7 @@
 #include "util/types.h"
 
 #include "xdrpp/marshal.h"
+#include <algorithm>
 
 
 namespace vixal {
@@ -23,6 +24,21 @@ using namespace std::placeholders;
 // max number of transitions that can occur from processing one message
 static const int MAX_ADVANCE_SLOT_RECURSION = 50;
 
+namespace {
+void
+adjustCount(std::map<uint32, uint32> &counts, uint32 counter, bool add) {
+    if (add) {
+        counts[counter]++;
+    } else {
+        auto it = counts.find(counter);
+        dbgAssert(it != counts.end());
+        if (--it->second == 0) {
+            counts.erase(it);
+        }
+    }
+}
+}
+
 BallotProtocol::BallotProtocol(Slot &slot)
         : mSlot(slot),
           mHeardFromQuorum(false),
@@ -107,11 +123,78 @@ BallotProtocol::recordEnvelope(SCPEnvelope const &env) {
     if (oldp == mLatestEnvelopes.end()) {
         mLatestEnvelopes.insert(std::make_pair(st.nodeID, env));
     } else {
+        indexStatement(oldp->second.statement, false);
         oldp->second = env;
     }
+    indexStatement(st, true);
     mSlot.recordStatement(env.statement);
 }
 
+void
+BallotProtocol::indexStatement(SCPStatement const &st, bool add) {
+    auto const &pl = st.pledges;
+    std::vector<Value const *> touched;
+    auto getIndex = [&](Value const &value) -> ValueIndex & {
+        touched.push_back(&value);
+        return mValueIndex[value];
+    };
+
+    switch (pl.type()) {
+        case SCP_ST_PREPARE: {
+            auto const &p = pl.prepare();
+            auto &index = getIndex(p.ballot.value);
+            adjustCount(index.mPrepareBallots, p.ballot.counter, add);
+            if (p.nC) {
+                adjustCount(index.mCommitBoundaries, p.nC, add);
+                adjustCount(index.mCommitBoundaries, p.nH, add);
+            }
+            // p and p' may be for other values
+            if (p.prepared) {
+                adjustCount(getIndex(p.prepared->value).mPrepareBallots,
+                            p.prepared->counter, add);
+            }
+            if (p.preparedPrime) {
+                adjustCount(getIndex(p.preparedPrime->value).mPrepareBallots,
+                            p.preparedPrime->counter, add);
+            }
+            adjustCount(mBallotCounters, p.ballot.counter, add);
+        }
+            break;
+        case SCP_ST_CONFIRM: {
+            auto const &c = pl.confirm();
+            auto &index = getIndex(c.ballot.value);
+            adjustCount(index.mConfirmPrepared, c.nPrepared, add);
+            index.mCommitting += add ? 1 : -1;
+            adjustCount(index.mCommitBoundaries, c.nCommit, add);
+            adjustCount(index.mCommitBoundaries, c.nH, add);
+            adjustCount(mBallotCounters, c.ballot.counter, add);
+        }
+            break;
+        case SCP_ST_EXTERNALIZE: {
+            auto const &e = pl.externalize();
+            auto &index = getIndex(e.commit.value);
+            index.mCommitting += add ? 1 : -1;
+            adjustCount(index.mCommitBoundaries, e.commit.counter, add);
+            adjustCount(index.mCommitBoundaries, e.nH, add);
+            adjustCount(index.mCommitBoundaries, UINT32_MAX, add);
+            adjustCount(mBallotCounters, UINT32_MAX, add);
+        }
+            break;
+        default:
+            dbgAbort();
+    }
+
+    for (auto value : touched) {
+        auto it = mValueIndex.find(*value);
+        if (it != mValueIndex.end() && it->second.mPrepareBallots.empty() &&
+            it->second.mConfirmPrepared.empty() &&
+            it->second.mCommitting == 0 &&
+            it->second.mCommitBoundaries.empty()) {
+            mValueIndex.erase(it);
+        }
+    }
+}
+
 SCP::EnvelopeState
 BallotProtocol::processEnvelope(SCPEnvelope const &envelope, bool self) {
     SCP::EnvelopeState res = SCP::EnvelopeState::INVALID;
@@ -582,45 +665,25 @@ BallotProtocol::getPrepareCandidates(SCPStatement const &hint) {
 
         auto const &val = topVote.value;
 
-        // find candidates that may have been prepared
-        for (auto const &e : mLatestEnvelopes) {
-            SCPStatement const &st = e.second.statement;
-            switch (st.pledges.type()) {
-                case SCP_ST_PREPARE: {
-                    auto const &prep = st.pledges.prepare();
-                    if (areBallotsLessAndCompatible(prep.ballot, topVote)) {
-                        candidates.insert(prep.ballot);
-                    }
-                    if (prep.prepared &&
-                        areBallotsLessAndCompatible(*prep.prepared, topVote)) {
-                        candidates.insert(*prep.prepared);
-                    }
-                    if (prep.preparedPrime &&
-                        areBallotsLessAndCompatible(*prep.preparedPrime, topVote)) {
-                        candidates.insert(*prep.preparedPrime);
-                    }
-                }
-                    break;
-                case SCP_ST_CONFIRM: {
-                    auto const &con = st.pledges.confirm();
-                    if (areBallotsCompatible(topVote, con.ballot)) {
-                        candidates.insert(topVote);
-                        if (con.nPrepared < topVote.counter) {
-                            candidates.insert(SCPBallot(con.nPrepared, val));
-                        }
-                    }
-                }
-                    break;
-                case SCP_ST_EXTERNALIZE: {
-                    auto const &ext = st.pledges.externalize();
-                    if (areBallotsCompatible(topVote, ext.commit)) {
-                        candidates.insert(topVote);
-                    }
-                }
-                    break;
-                default:
-                    abort();
-            }
+        // find candidates that may have been prepared: ballots of PREPARE
+        // statements below topVote, topVote itself if it is compatible with
+        // a CONFIRM or EXTERNALIZE statement and the nPrepared of CONFIRM
+        // statements below it
+        auto it = mValueIndex.find(val);
+        if (it == mValueIndex.end()) {
+            continue;
+        }
+        auto const &index = it->second;
+        auto end = index.mPrepareBallots.upper_bound(topVote.counter);
+        for (auto b = index.mPrepareBallots.begin(); b != end; ++b) {
+            candidates.insert(SCPBallot(b->first, val));
+        }
+        if (index.mCommitting != 0) {
+            candidates.insert(topVote);
+        }
+        end = index.mConfirmPrepared.lower_bound(topVote.counter);
+        for (auto n = index.mConfirmPrepared.begin(); n != end; ++n) {
+            candidates.insert(SCPBallot(n->first, val));
         }
     }
 
@@ -864,11 +927,11 @@ BallotProtocol::setPreparedConfirmed(SCPBallot const &newC,
 
 void
 BallotProtocol::findExtendedInterval(Interval &candidate,
-                                     std::set<uint32> const &boundaries,
+                                     CounterCounts const &boundaries,
                                      std::function<bool(Interval const &)> pred) {
     // iterate through interesting boundaries, starting from the top
     for (auto it = boundaries.rbegin(); it != boundaries.rend(); it++) {
-        uint32 b = *it;
+        uint32 b = it->first;
 
         Interval cur;
         if (candidate.first == 0) {
@@ -891,44 +954,11 @@ BallotProtocol::findExtendedInterval(Interval &candidate,
     }
 }
 
-std::set<uint32>
-BallotProtocol::getCommitBoundariesFromStatements(SCPBallot const &ballot) {
-    std::set<uint32> res;
-    for (auto const &env : mLatestEnvelopes) {
-        auto const &pl = env.second.statement.pledges;
-        switch (pl.type()) {
-            case SCP_ST_PREPARE: {
-                auto const &p = pl.prepare();
-                if (areBallotsCompatible(ballot, p.ballot)) {
-                    if (p.nC) {
-                        res.emplace(p.nC);
-                        res.emplace(p.nH);
-                    }
-                }
-            }
-                break;
-            case SCP_ST_CONFIRM: {
-                auto const &c = pl.confirm();
-                if (areBallotsCompatible(ballot, c.ballot)) {
-                    res.emplace(c.nCommit);
-                    res.emplace(c.nH);
-                }
-            }
-                break;
-            case SCP_ST_EXTERNALIZE: {
-                auto const &e = pl.externalize();
-                if (areBallotsCompatible(ballot, e.commit)) {
-                    res.emplace(e.commit.counter);
-                    res.emplace(e.nH);
-                    res.emplace(UINT32_MAX);
-                }
-            }
-                break;
-            default:
-                dbgAbort();
-        }
-    }
-    return res;
+BallotProtocol::CounterCounts const &
+BallotProtocol::getCommitBoundariesFromStatements(SCPBallot const &ballot) const {
+    static CounterCounts const none;
+    auto it = mValueIndex.find(ballot.value);
+    return it == mValueIndex.end() ? none : it->second.mCommitBoundaries;
 }
 
 bool
@@ -1009,7 +1039,7 @@ BallotProtocol::attemptAcceptCommit(SCPStatement const &hint) {
     };
 
     // build the boundaries to scan
-    std::set<uint32> boundaries = getCommitBoundariesFromStatements(ballot);
+    auto const &boundaries = getCommitBoundariesFromStatements(ballot);
 
     if (boundaries.empty()) {
         return false;
@@ -1075,34 +1105,21 @@ BallotProtocol::setAcceptCommit(SCPBallot const &c, SCPBallot const &h) {
 bool
 BallotProtocol::attemptBump() {
     if (mPhase == SCP_PHASE_PREPARE || mPhase == SCP_PHASE_CONFIRM) {
-        // find all counters
-        std::set<uint32> allCounters;
-        for (auto const &e : mLatestEnvelopes) {
-            auto const &st = e.second.statement;
-            switch (st.pledges.type()) {
-                case SCP_ST_PREPARE: {
-                    auto const &p = st.pledges.prepare();
-                    allCounters.insert(p.ballot.counter);
-                }
-                    break;
-                case SCP_ST_CONFIRM: {
-                    auto const &c = st.pledges.confirm();
-                    allCounters.insert(c.ballot.counter);
-                }
-                    break;
-                case SCP_ST_EXTERNALIZE: {
-                    allCounters.insert(UINT32_MAX);
-                }
-                    break;
-                default:
-                    abort();
-            };
-        }
         uint32 targetCounter = mCurrentBallot ? mCurrentBallot->counter : 0;
 
+        // find all counters
         // uses 0 as a way to track if a v-blocking set is at a higher counter
         // if so, we move to that smallest counter
-        allCounters.insert(targetCounter);
+        std::vector<uint32> allCounters;
+        allCounters.reserve(mBallotCounters.size() + 1);
+        for (auto const &c : mBallotCounters) {
+            allCounters.push_back(c.first);
+        }
+        auto pos = std::lower_bound(allCounters.begin(), allCounters.end(),
+                                    targetCounter);
+        if (pos == allCounters.end() || *pos != targetCounter) {
+            allCounters.insert(pos, targetCounter);
+        }
 
         // go through the counters, find the smallest not v-blocking
         for (auto it = allCounters.begin(); it != allCounters.end(); it++) {
@@ -1111,8 +1128,8 @@ BallotProtocol::attemptBump() {
                 break;
             }
 
-            bool vBlocking = LocalNode::isVBlocking(
-                    getLocalNode()->getQuorumSet(), mLatestEnvelopes,
+            bool vBlocking = getLocalNode()->isVBlocking(
+                    mLatestEnvelopes,
                     [&](SCPStatement const &st) {
                         bool res;
                         auto const &pl = st.pledges;
@@ -1182,7 +1199,7 @@ BallotProtocol::attemptConfirmCommit(SCPStatement const &hint) {
         return false;
     }
 
-    std::set<uint32> boundaries = getCommitBoundariesFromStatements(ballot);
+    auto const &boundaries = getCommitBoundariesFromStatements(ballot);
     Interval candidate;
 
     auto pred = [&ballot, this](Interval const &cur) -> bool {
@@ -1716,8 +1733,8 @@ BallotProtocol::checkHeardFromQuorum() {
     // therefore the local node will not flip flop between "seen" and "not seen"
     // for a given counter on the local node
     if (mCurrentBallot) {
-        if (LocalNode::isQuorum(
-                getLocalNode()->getQuorumSet(), mLatestEnvelopes,
+        if (getLocalNode()->isQuorum(
+                mLatestEnvelopes,
                 std::bind(&Slot::getQuorumSetFromStatement, &mSlot, _1),
                 [&](SCPStatement const &st) {
                     bool res;
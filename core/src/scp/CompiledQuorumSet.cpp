@@ -0,0 +1,253 @@
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "scp/CompiledQuorumSet.h"
+
+#include "util/XDROperators.h"
+
+#include <algorithm>
+#include <deque>
+
+namespace vixal {
+
+void
+NodeBitSet::set(size_t i) {
+    if (i / 64 >= mBits.size()) {
+        mBits.resize(i / 64 + 1, 0);
+    }
+    mBits[i / 64] |= uint64_t(1) << (i % 64);
+}
+
+void
+NodeBitSet::unset(size_t i) {
+    if (i / 64 < mBits.size()) {
+        mBits[i / 64] &= ~(uint64_t(1) << (i % 64));
+    }
+}
+
+bool
+NodeBitSet::test(size_t i) const {
+    return i / 64 < mBits.size() && (mBits[i / 64] & (uint64_t(1) << (i % 64))) != 0;
+}
+
+bool
+NodeBitSet::empty() const {
+    for (auto w : mBits) {
+        if (w != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t
+NodeBitSet::count() const {
+    size_t res = 0;
+    for (auto w : mBits) {
+        res += __builtin_popcountll(w);
+    }
+    return res;
+}
+
+bool
+NodeBitSet::isSubsetOf(NodeBitSet const &other) const {
+    for (size_t i = 0; i < mBits.size(); ++i) {
+        auto o = i < other.mBits.size() ? other.mBits[i] : 0;
+        if ((mBits[i] & ~o) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t
+NodeBitSet::next(size_t i) const {
+    for (size_t w = i / 64; w < mBits.size(); ++w) {
+        auto bits = mBits[w];
+        if (w == i / 64) {
+            bits &= ~uint64_t(0) << (i % 64);
+        }
+        if (bits != 0) {
+            return w * 64 + __builtin_ctzll(bits);
+        }
+    }
+    return npos;
+}
+
+NodeBitSet &
+NodeBitSet::operator|=(NodeBitSet const &other) {
+    if (other.mBits.size() > mBits.size()) {
+        mBits.resize(other.mBits.size(), 0);
+    }
+    for (size_t i = 0; i < other.mBits.size(); ++i) {
+        mBits[i] |= other.mBits[i];
+    }
+    return *this;
+}
+
+NodeBitSet &
+NodeBitSet::operator&=(NodeBitSet const &other) {
+    for (size_t i = 0; i < mBits.size(); ++i) {
+        mBits[i] &= i < other.mBits.size() ? other.mBits[i] : 0;
+    }
+    return *this;
+}
+
+NodeBitSet &
+NodeBitSet::operator-=(NodeBitSet const &other) {
+    auto n = std::min(mBits.size(), other.mBits.size());
+    for (size_t i = 0; i < n; ++i) {
+        mBits[i] &= ~other.mBits[i];
+    }
+    return *this;
+}
+
+bool
+NodeBitSet::operator==(NodeBitSet const &other) const {
+    return isSubsetOf(other) && other.isSubsetOf(*this);
+}
+
+size_t
+NodeBitSet::countCommon(NodeBitSet const &other) const {
+    size_t res = 0;
+    auto n = std::min(mBits.size(), other.mBits.size());
+    for (size_t i = 0; i < n; ++i) {
+        res += __builtin_popcountll(mBits[i] & other.mBits[i]);
+    }
+    return res;
+}
+
+size_t
+NodeIndex::intern(NodeID const &node) {
+    auto res = mIndices.emplace(node, mNodes.size());
+    if (res.second) {
+        mNodes.push_back(node);
+    }
+    return res.first->second;
+}
+
+NodeID const &
+NodeIndex::getNode(size_t i) const {
+    return mNodes.at(i);
+}
+
+size_t
+NodeIndex::size() const {
+    return mIndices.size();
+}
+
+CompiledQuorumSet::CompiledQuorumSet(SCPQuorumSet const &qSet, NodeIndex &index) {
+    std::deque<SCPQuorumSet const *> pending{&qSet};
+    while (!pending.empty()) {
+        auto const &q = *pending.front();
+        pending.pop_front();
+
+        Level level;
+        level.mThreshold = q.threshold;
+        level.mSize = q.validators.size() + q.innerSets.size();
+        for (auto const &v : q.validators) {
+            auto i = index.intern(v);
+            if (level.mValidators.test(i)) {
+                level.mDuplicates.push_back(i);
+            } else {
+                level.mValidators.set(i);
+            }
+        }
+        // children are numbered after everything already queued
+        level.mFirstInner = mLevels.size() + 1 + pending.size();
+        level.mInnerCount = q.innerSets.size();
+        for (auto const &inner : q.innerSets) {
+            pending.push_back(&inner);
+        }
+        mLevels.emplace_back(std::move(level));
+    }
+
+    // a node listed in several places may be counted more than once below,
+    // the only safe bound is then one node
+    NodeBitSet all;
+    size_t listed = 0;
+    for (auto const &level : mLevels) {
+        all |= level.mValidators;
+        listed += level.mValidators.count() + level.mDuplicates.size();
+    }
+    std::vector<size_t> minSize(mLevels.size());
+    for (size_t l = mLevels.size(); l-- > 0;) {
+        auto const &level = mLevels[l];
+        std::vector<size_t> costs(level.mValidators.count() + level.mDuplicates.size(), 1);
+        for (size_t i = 0; i < level.mInnerCount; ++i) {
+            costs.push_back(minSize[level.mFirstInner + i]);
+        }
+        std::sort(costs.begin(), costs.end());
+        if (level.mThreshold == 0 || level.mThreshold > costs.size() ||
+            costs[level.mThreshold - 1] == SIZE_MAX) {
+            minSize[l] = SIZE_MAX;
+            continue;
+        }
+        minSize[l] = 0;
+        for (size_t i = 0; i < level.mThreshold; ++i) {
+            minSize[l] += costs[i];
+        }
+    }
+    mMinSliceSize = minSize[0];
+    if (listed != all.count() && mMinSliceSize != SIZE_MAX) {
+        mMinSliceSize = 1;
+    }
+}
+
+size_t
+CompiledQuorumSet::getMinSliceSize() const {
+    return mMinSliceSize;
+}
+
+size_t
+CompiledQuorumSet::countIn(Level const &level, NodeBitSet const &nodes) const {
+    auto res = level.mValidators.countCommon(nodes);
+    for (auto i : level.mDuplicates) {
+        if (nodes.test(i)) {
+            res++;
+        }
+    }
+    return res;
+}
+
+bool
+CompiledQuorumSet::isQuorumSlice(NodeBitSet const &nodes) const {
+    // inner sets come after their parent, so going backwards every level
+    // finds the result of its inner sets already computed
+    std::vector<bool> satisfied(mLevels.size());
+    for (size_t l = mLevels.size(); l-- > 0;) {
+        auto const &level = mLevels[l];
+        auto count = countIn(level, nodes);
+        for (size_t i = 0; i < level.mInnerCount; ++i) {
+            if (satisfied[level.mFirstInner + i]) {
+                count++;
+            }
+        }
+        // a threshold of 0 is never met
+        satisfied[l] = level.mThreshold != 0 && count >= level.mThreshold;
+    }
+    return satisfied[0];
+}
+
+bool
+CompiledQuorumSet::isVBlocking(NodeBitSet const &nodes) const {
+    std::vector<bool> blocked(mLevels.size());
+    for (size_t l = mLevels.size(); l-- > 0;) {
+        auto const &level = mLevels[l];
+        // There is no v-blocking set for {\empty}
+        if (level.mThreshold == 0) {
+            blocked[l] = false;
+            continue;
+        }
+        auto count = countIn(level, nodes);
+        for (size_t i = 0; i < level.mInnerCount; ++i) {
+            if (blocked[level.mFirstInner + i]) {
+                count++;
+            }
+        }
+        blocked[l] = count != 0 && count + level.mThreshold >= 1 + level.mSize;
+    }
+    return blocked[0];
+}
+}
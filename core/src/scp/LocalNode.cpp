@@ -22,10 +22,12 @@ namespace vixal {
 
 LocalNode::LocalNode(NodeID const &nodeID, bool isValidator,
                      SCPQuorumSet const &qSet, SCP *scp)
-        : mNodeID(nodeID), mIsValidator(isValidator), mQSet(qSet), mSCP(scp) {
+        : mNodeID(nodeID), mIsValidator(isValidator), mQSet(qSet), mSCP(scp),
+          mCompiledQSets(1000) {
 
     normalizeQSet(mQSet);
     mQSetHash = sha256(xdr::xdr_to_opaque(mQSet));
+    mCompiledQSet = std::make_unique<CompiledQuorumSet>(mQSet, mNodeIndex);
 
     CLOG(INFO, "SCP") << "LocalNode::LocalNode"
                       << "@" << KeyUtils::toShortString(mNodeID)
@@ -47,6 +49,7 @@ void
 LocalNode::updateQuorumSet(SCPQuorumSet const &qSet) {
     mQSetHash = sha256(xdr::xdr_to_opaque(qSet));
     mQSet = qSet;
+    mCompiledQSet = std::make_unique<CompiledQuorumSet>(mQSet, mNodeIndex);
 }
 
 SCPQuorumSet const &
@@ -113,122 +116,102 @@ LocalNode::getNodeWeight(NodeID const &nodeID, SCPQuorumSet const &qset) {
     return 0;
 }
 
-bool
-LocalNode::isQuorumSliceInternal(SCPQuorumSet const &qset,
-                                 std::vector<NodeID> const &nodeSet) {
-    uint32 thresholdLeft = qset.threshold;
-    for (auto const &validator : qset.validators) {
-        auto it = std::find(nodeSet.begin(), nodeSet.end(), validator);
-        if (it != nodeSet.end()) {
-            thresholdLeft--;
-            if (thresholdLeft <= 0) {
-                return true;
-            }
-        }
+std::shared_ptr<CompiledQuorumSet>
+LocalNode::getCompiledQuorumSet(SCPQuorumSetPtr const &qSet) {
+    if (mCompiledQSets.exists(qSet.get())) {
+        return mCompiledQSets.get(qSet.get()).second;
+    }
+    auto res = std::make_shared<CompiledQuorumSet>(*qSet, mNodeIndex);
+    // quorum sets made up for the call (singletons used after externalize)
+    // are only referenced by the caller, keeping them would just evict
+    // useful entries
+    if (qSet.use_count() > 1) {
+        mCompiledQSets.put(qSet.get(), std::make_pair(qSet, res));
     }
+    return res;
+}
 
-    for (auto const &inner : qset.innerSets) {
-        if (isQuorumSliceInternal(inner, nodeSet)) {
-            thresholdLeft--;
-            if (thresholdLeft <= 0) {
-                return true;
-            }
-        }
+static NodeBitSet
+toNodeBitSet(std::vector<NodeID> const &nodeSet, NodeIndex &index) {
+    NodeBitSet res;
+    for (auto const &n : nodeSet) {
+        res.set(index.intern(n));
     }
-    return false;
+    return res;
 }
 
 bool
 LocalNode::isQuorumSlice(SCPQuorumSet const &qSet, std::vector<NodeID> const &nodeSet) {
     CLOG(TRACE, "SCP") << "LocalNode::isQuorumSlice" << " nodeSet.size: " << nodeSet.size();
 
-    return isQuorumSliceInternal(qSet, nodeSet);
-}
-
-// called recursively
-bool
-LocalNode::isVBlockingInternal(SCPQuorumSet const &qset, std::vector<NodeID> const &nodeSet) {
-    // There is no v-blocking set for {\empty}
-    if (qset.threshold == 0) {
-        return false;
-    }
-
-    auto leftTillBlock =
-            (int) ((1 + qset.validators.size() + qset.innerSets.size()) -
-                   qset.threshold);
-
-    for (auto const &validator : qset.validators) {
-        auto it = std::find(nodeSet.begin(), nodeSet.end(), validator);
-        if (it != nodeSet.end()) {
-            leftTillBlock--;
-            if (leftTillBlock <= 0) {
-                return true;
-            }
-        }
-    }
-    for (auto const &inner : qset.innerSets) {
-        if (isVBlockingInternal(inner, nodeSet)) {
-            leftTillBlock--;
-            if (leftTillBlock <= 0) {
-                return true;
-            }
-        }
-    }
-
-    return false;
+    NodeIndex index;
+    CompiledQuorumSet compiled(qSet, index);
+    return compiled.isQuorumSlice(toNodeBitSet(nodeSet, index));
 }
 
 bool
 LocalNode::isVBlocking(SCPQuorumSet const &qSet, std::vector<NodeID> const &nodeSet) {
     CLOG(TRACE, "SCP") << "LocalNode::isVBlocking" << " nodeSet.size: " << nodeSet.size();
 
-    return isVBlockingInternal(qSet, nodeSet);
+    NodeIndex index;
+    CompiledQuorumSet compiled(qSet, index);
+    return compiled.isVBlocking(toNodeBitSet(nodeSet, index));
 }
 
 bool
-LocalNode::isVBlocking(SCPQuorumSet const &qSet,
-                       std::map<NodeID, SCPEnvelope> const &map,
+LocalNode::isVBlocking(std::map<NodeID, SCPEnvelope> const &map,
                        std::function<bool(SCPStatement const &)> const &filter) {
-    std::vector<NodeID> pNodes;
+    NodeBitSet nodes;
     for (auto const &it : map) {
         if (filter(it.second.statement)) {
-            pNodes.push_back(it.first);
+            nodes.set(mNodeIndex.intern(it.first));
         }
     }
 
-    return isVBlocking(qSet, pNodes);
+    return mCompiledQSet->isVBlocking(nodes);
 }
 
 bool
-LocalNode::isQuorum(SCPQuorumSet const &qSet, std::map<NodeID, SCPEnvelope> const &map,
+LocalNode::isQuorum(std::map<NodeID, SCPEnvelope> const &map,
                     std::function<SCPQuorumSetPtr(SCPStatement const &)> const &qfun,
                     std::function<bool(SCPStatement const &)> const &filter) {
-    std::vector<NodeID> pNodes;
+    struct Candidate {
+        size_t mIndex;
+        std::shared_ptr<CompiledQuorumSet> mQSet;
+    };
+
+    NodeBitSet nodes;
+    std::vector<Candidate> candidates;
     for (auto const &it : map) {
-        if (filter(it.second.statement)) {
-            pNodes.push_back(it.first);
+        if (!filter(it.second.statement)) {
+            continue;
+        }
+        // a node whose quorum set is unknown can never be part of the quorum
+        auto qSetPtr = qfun(it.second.statement);
+        if (qSetPtr) {
+            auto index = mNodeIndex.intern(it.first);
+            nodes.set(index);
+            candidates.push_back({index, getCompiledQuorumSet(qSetPtr)});
         }
     }
 
-    size_t count = 0;
+    // remove the nodes that don't have a slice in the set until none is left
+    // to remove; the result doesn't depend on the removal order
+    bool changed;
     do {
-        count = pNodes.size();
-        std::vector<NodeID> fNodes(pNodes.size());
-        auto quorumFilter = [&](NodeID nodeID) -> bool {
-            auto qSetPtr = qfun(map.find(nodeID)->second.statement);
-            if (qSetPtr) {
-                return isQuorumSlice(*qSetPtr, pNodes);
+        changed = false;
+        for (auto it = candidates.begin(); it != candidates.end();) {
+            if (it->mQSet->isQuorumSlice(nodes)) {
+                ++it;
             } else {
-                return false;
+                nodes.unset(it->mIndex);
+                it = candidates.erase(it);
+                changed = true;
             }
-        };
-        auto it = std::copy_if(pNodes.begin(), pNodes.end(), fNodes.begin(),
-                               quorumFilter);
-        fNodes.resize(std::distance(fNodes.begin(), it));
-        pNodes = fNodes;
-    } while (count != pNodes.size());
-
-    return isQuorumSlice(qSet, pNodes);
+        }
+    } while (changed);
+
+    return mCompiledQSet->isQuorumSlice(nodes);
 }
 
 std::vector<NodeID>
@@ -0,0 +1,270 @@
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "scp/QuorumIntersectionChecker.h"
+
+#include <algorithm>
+
+namespace vixal {
+
+namespace {
+void
+addValidators(SCPQuorumSet const &qSet, NodeIndex &index, NodeBitSet &nodes) {
+    for (auto const &v : qSet.validators) {
+        nodes.set(index.intern(v));
+    }
+    for (auto const &inner : qSet.innerSets) {
+        addValidators(inner, index, nodes);
+    }
+}
+}
+
+QuorumIntersectionChecker::QuorumIntersectionChecker(QuorumMap const &qmap)
+        : mComponentSize(0), mMinimalQuorumsChecked(0) {
+    std::vector<std::pair<size_t, std::unique_ptr<CompiledQuorumSet>>> compiled;
+    std::vector<std::pair<size_t, NodeBitSet>> successors;
+    for (auto const &q : qmap) {
+        auto i = mIndex.intern(q.first);
+        if (!q.second) {
+            continue;
+        }
+        mKnown.set(i);
+        compiled.emplace_back(i, std::make_unique<CompiledQuorumSet>(*q.second, mIndex));
+        NodeBitSet validators;
+        addValidators(*q.second, mIndex, validators);
+        successors.emplace_back(i, std::move(validators));
+    }
+
+    // validators seen while compiling were interned too
+    mQSets.resize(mIndex.size());
+    mSuccessors.resize(mIndex.size());
+    for (auto &c : compiled) {
+        mQSets[c.first] = std::move(c.second);
+    }
+    for (auto &s : successors) {
+        mSuccessors[s.first] = std::move(s.second);
+    }
+}
+
+std::vector<NodeBitSet>
+QuorumIntersectionChecker::getStronglyConnectedComponents() const {
+    // Tarjan's algorithm, with an explicit stack as networks can be deep;
+    // nodes without a quorum set have no edges and are left out
+    auto const npos = NodeBitSet::npos;
+    auto n = mIndex.size();
+    std::vector<size_t> index(n, npos);
+    std::vector<size_t> lowLink(n, 0);
+    std::vector<bool> onStack(n, false);
+    std::vector<size_t> stack;
+    size_t nextIndex = 0;
+    std::vector<NodeBitSet> res;
+
+    struct Frame {
+        size_t mNode;
+        // next successor to look at
+        size_t mNext;
+    };
+
+    auto visit = [&](size_t v, std::vector<Frame> &frames) {
+        index[v] = lowLink[v] = nextIndex++;
+        stack.push_back(v);
+        onStack[v] = true;
+        frames.push_back({v, 0});
+    };
+
+    for (auto root = mKnown.next(0); root != npos; root = mKnown.next(root + 1)) {
+        if (index[root] != npos) {
+            continue;
+        }
+        std::vector<Frame> frames;
+        visit(root, frames);
+        while (!frames.empty()) {
+            auto v = frames.back().mNode;
+            auto w = mSuccessors[v].next(frames.back().mNext);
+            while (w != npos && !mKnown.test(w)) {
+                w = mSuccessors[v].next(w + 1);
+            }
+            if (w != npos) {
+                frames.back().mNext = w + 1;
+                if (index[w] == npos) {
+                    visit(w, frames);
+                } else if (onStack[w]) {
+                    lowLink[v] = std::min(lowLink[v], index[w]);
+                }
+                continue;
+            }
+
+            frames.pop_back();
+            if (!frames.empty()) {
+                auto u = frames.back().mNode;
+                lowLink[u] = std::min(lowLink[u], lowLink[v]);
+            }
+            if (lowLink[v] == index[v]) {
+                NodeBitSet scc;
+                size_t x;
+                do {
+                    x = stack.back();
+                    stack.pop_back();
+                    onStack[x] = false;
+                    scc.set(x);
+                } while (x != v);
+                res.emplace_back(std::move(scc));
+            }
+        }
+    }
+    return res;
+}
+
+NodeBitSet
+QuorumIntersectionChecker::contractToMaximalQuorum(NodeBitSet nodes) const {
+    bool changed;
+    do {
+        changed = false;
+        for (auto i = nodes.next(0); i != NodeBitSet::npos; i = nodes.next(i + 1)) {
+            if (!mQSets[i] || !mQSets[i]->isQuorumSlice(nodes)) {
+                nodes.unset(i);
+                changed = true;
+            }
+        }
+    } while (changed);
+    return nodes;
+}
+
+bool
+QuorumIntersectionChecker::isMinimalQuorum(NodeBitSet const &quorum) const {
+    for (auto i = quorum.next(0); i != NodeBitSet::npos; i = quorum.next(i + 1)) {
+        auto smaller = quorum;
+        smaller.unset(i);
+        if (!contractToMaximalQuorum(smaller).empty()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool
+QuorumIntersectionChecker::findSplit(NodeBitSet const &committed, NodeBitSet remaining) {
+    auto const npos = NodeBitSet::npos;
+    // of two disjoint quorums, one is at most half of the component
+    auto maxSize = mComponentSize / 2;
+    if (committed.count() > maxSize) {
+        return false;
+    }
+    for (auto i = committed.next(0); i != npos; i = committed.next(i + 1)) {
+        if (mQSets[i]->getMinSliceSize() > maxSize) {
+            return false;
+        }
+    }
+
+    // the complement of any quorum containing `committed` is in there
+    auto complement = mComponent;
+    complement -= committed;
+
+    auto inCommitted = contractToMaximalQuorum(committed);
+    if (!inCommitted.empty()) {
+        // quorums built from here contain this one, so the only minimal
+        // quorum among them is `committed` itself
+        if (inCommitted == committed && isMinimalQuorum(committed)) {
+            ++mMinimalQuorumsChecked;
+            auto disjoint = contractToMaximalQuorum(complement);
+            if (!disjoint.empty()) {
+                mSplit = std::make_pair(committed, disjoint);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    if (contractToMaximalQuorum(complement).empty()) {
+        return false;
+    }
+
+    auto candidates = committed;
+    candidates |= remaining;
+    auto maxQuorum = contractToMaximalQuorum(candidates);
+    if (!committed.isSubsetOf(maxQuorum)) {
+        return false;
+    }
+    remaining = maxQuorum;
+    remaining -= committed;
+    if (remaining.empty()) {
+        return false;
+    }
+
+    // a quorum containing `committed` needs some of the nodes they list
+    NodeBitSet perimeter;
+    for (auto i = committed.next(0); i != npos; i = committed.next(i + 1)) {
+        perimeter |= mSuccessors[i];
+    }
+    perimeter &= remaining;
+    auto const &pickFrom = perimeter.empty() ? remaining : perimeter;
+    auto split = npos;
+    for (auto i = pickFrom.next(0); i != npos; i = pickFrom.next(i + 1)) {
+        if (split == npos || mInDegree[i] > mInDegree[split]) {
+            split = i;
+        }
+    }
+
+    remaining.unset(split);
+    auto withSplit = committed;
+    withSplit.set(split);
+    return findSplit(withSplit, remaining) || findSplit(committed, remaining);
+}
+
+bool
+QuorumIntersectionChecker::networkEnjoysQuorumIntersection() {
+    mMinimalQuorumsChecked = 0;
+    mSplit = std::make_pair(NodeBitSet(), NodeBitSet());
+
+    std::vector<NodeBitSet> withQuorum;
+    for (auto &scc : getStronglyConnectedComponents()) {
+        auto quorum = contractToMaximalQuorum(scc);
+        if (!quorum.empty()) {
+            mComponent = std::move(scc);
+            withQuorum.emplace_back(std::move(quorum));
+        }
+    }
+    if (withQuorum.size() > 1) {
+        mSplit = std::make_pair(withQuorum[0], withQuorum[1]);
+        return false;
+    }
+    if (withQuorum.empty()) {
+        return true;
+    }
+
+    mComponentSize = mComponent.count();
+    mInDegree.assign(mIndex.size(), 0);
+    for (auto i = mComponent.next(0); i != NodeBitSet::npos; i = mComponent.next(i + 1)) {
+        for (auto j = mSuccessors[i].next(0); j != NodeBitSet::npos; j = mSuccessors[i].next(j + 1)) {
+            mInDegree[j]++;
+        }
+    }
+
+    return !findSplit(NodeBitSet(), withQuorum[0]);
+}
+
+std::vector<NodeID>
+QuorumIntersectionChecker::toNodeIDs(NodeBitSet const &nodes) const {
+    std::vector<NodeID> res;
+    for (auto i = nodes.next(0); i != NodeBitSet::npos; i = nodes.next(i + 1)) {
+        res.emplace_back(mIndex.getNode(i));
+    }
+    return res;
+}
+
+std::pair<std::vector<NodeID>, std::vector<NodeID>>
+QuorumIntersectionChecker::getPotentialSplit() const {
+    return std::make_pair(toNodeIDs(mSplit.first), toNodeIDs(mSplit.second));
+}
+
+size_t
+QuorumIntersectionChecker::getNodeCount() const {
+    return mKnown.count();
+}
+
+size_t
+QuorumIntersectionChecker::getMinimalQuorumsChecked() const {
+    return mMinimalQuorumsChecked;
+}
+}
@@ -281,7 +281,7 @@ Slot::federatedAccept(StatementPredicate voted, StatementPredicate accepted,
                       std::map<NodeID, SCPEnvelope> const &envs) {
     // Checks if the nodes that claimed to accept the statement form a
     // v-blocking set
-    if (LocalNode::isVBlocking(getLocalNode()->getQuorumSet(), envs, accepted)) {
+    if (getLocalNode()->isVBlocking(envs, accepted)) {
         return true;
     }
 
@@ -293,9 +293,8 @@ Slot::federatedAccept(StatementPredicate voted, StatementPredicate accepted,
         return res;
     };
 
-    if (LocalNode::isQuorum(
-            getLocalNode()->getQuorumSet(), envs,
-            std::bind(&Slot::getQuorumSetFromStatement, this, _1),
+    if (getLocalNode()->isQuorum(
+            envs, std::bind(&Slot::getQuorumSetFromStatement, this, _1),
             ratifyFilter)) {
         return true;
     }
@@ -306,9 +305,8 @@ Slot::federatedAccept(StatementPredicate voted, StatementPredicate accepted,
 bool
 Slot::federatedRatify(StatementPredicate voted,
                       std::map<NodeID, SCPEnvelope> const &envs) {
-    return LocalNode::isQuorum(
-            getLocalNode()->getQuorumSet(), envs,
-            std::bind(&Slot::getQuorumSetFromStatement, this, _1), voted);
+    return getLocalNode()->isQuorum(
+            envs, std::bind(&Slot::getQuorumSetFromStatement, this, _1), voted);
 }
 
 std::shared_ptr<LocalNode>
@@ -0,0 +1,429 @@
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "transactions/TransactionFootprint.h"
+#include "bucket/LedgerCmp.h"
+#include "crypto/KeyUtils.h"
+#include "crypto/SecretKey.h"
+#include "database/Database.h"
+#include "ledger/AccountFrame.h"
+#include "ledger/TrustFrame.h"
+#include "transactions/TransactionFrame.h"
+#include "util/types.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <set>
+
+namespace vixal {
+
+namespace {
+size_t const BATCH_SIZE = 256;
+
+LedgerKey
+accountKey(AccountID const &account) {
+    LedgerKey key(ACCOUNT);
+    key.account().accountID = account;
+    return key;
+}
+
+LedgerKey
+trustLineKey(AccountID const &account, Asset const &asset) {
+    LedgerKey key(TRUSTLINE);
+    key.trustLine().accountID = account;
+    key.trustLine().asset = asset;
+    return key;
+}
+
+LedgerKey
+dataKey(AccountID const &account, string64 const &name) {
+    LedgerKey key(DATA);
+    key.data().accountID = account;
+    key.data().dataName = name;
+    return key;
+}
+
+void
+sortAndRemoveDuplicates(std::vector<LedgerKey> &keys) {
+    LedgerEntryIdCmp cmp;
+    std::sort(keys.begin(), keys.end(), cmp);
+    keys.erase(std::unique(keys.begin(), keys.end(),
+                           [&cmp](LedgerKey const &a, LedgerKey const &b) {
+                               return !cmp(a, b) && !cmp(b, a);
+                           }),
+               keys.end());
+}
+
+// accounts and trust lines of `keys` found in the database
+std::vector<LedgerEntry>
+loadBatch(soci::session &sess, std::vector<LedgerKey> const &keys) {
+    std::set<LedgerKey, LedgerEntryIdCmp> trustLines;
+    std::vector<std::string> accounts;
+    std::vector<std::string> trustLineOwners;
+    for (auto const &k : keys) {
+        if (k.type() == ACCOUNT) {
+            accounts.emplace_back(KeyUtils::toStrKey(k.account().accountID));
+        } else {
+            trustLines.insert(k);
+            auto owner = KeyUtils::toStrKey(k.trustLine().accountID);
+            if (trustLineOwners.empty() || trustLineOwners.back() != owner) {
+                trustLineOwners.emplace_back(std::move(owner));
+            }
+        }
+    }
+
+    std::vector<LedgerEntry> res;
+    AccountFrame::loadAccounts(sess, accounts, [&res](LedgerEntry const &le) {
+        res.emplace_back(le);
+    });
+    // every trust line of the owners is loaded, only those asked for are kept
+    TrustFrame::loadLines(sess, trustLineOwners,
+                          [&res, &trustLines](LedgerEntry const &le) {
+                              if (trustLines.count(LedgerEntryKey(le)) != 0) {
+                                  res.emplace_back(le);
+                              }
+                          });
+    return res;
+}
+
+// batches loaded by whichever thread claims them first
+struct BatchLoads {
+    std::vector<std::vector<LedgerKey>> const mBatches;
+    std::vector<std::vector<LedgerEntry>> mLoaded;
+
+    std::mutex mMutex;
+    std::condition_variable mDone;
+    size_t mNext{0};
+    size_t mRunning{0};
+    std::exception_ptr mError;
+
+    explicit BatchLoads(std::vector<std::vector<LedgerKey>> batches)
+            : mBatches(std::move(batches)), mLoaded(mBatches.size()) {
+    }
+
+    bool
+    hasBatchesLeft() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mNext < mBatches.size() && !mError;
+    }
+
+    // loads batches on `sess` until there are none left
+    void
+    run(soci::session &sess) {
+        std::unique_lock<std::mutex> lock(mMutex);
+        if (mNext == mBatches.size() || mError) {
+            return;
+        }
+        ++mRunning;
+        while (mNext < mBatches.size() && !mError) {
+            auto i = mNext++;
+            lock.unlock();
+            try {
+                auto entries = loadBatch(sess, mBatches[i]);
+                lock.lock();
+                mLoaded[i] = std::move(entries);
+            }
+            catch (...) {
+                lock.lock();
+                mError = std::current_exception();
+            }
+        }
+        --mRunning;
+        mDone.notify_all();
+    }
+
+    // waits for the batches being loaded by other threads
+    void
+    wait() {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mDone.wait(lock, [this]() { return mRunning == 0; });
+        if (mError) {
+            std::rethrow_exception(mError);
+        }
+    }
+};
+}
+
+TransactionFootprint::TransactionFootprint(TransactionFrame const &tx)
+        : mGlobal(false) {
+    auto const &source = tx.getSourceID();
+    // fee and sequence number
+    addWrite(accountKey(source));
+    for (auto const &op : tx.getEnvelope().tx.operations) {
+        addOperation(op.sourceAccount ? *op.sourceAccount : source, op);
+    }
+
+    sortAndRemoveDuplicates(mReads);
+    sortAndRemoveDuplicates(mWrites);
+    LedgerEntryIdCmp cmp;
+    mReads.erase(std::remove_if(mReads.begin(), mReads.end(),
+                                [&](LedgerKey const &k) {
+                                    return std::binary_search(mWrites.begin(), mWrites.end(), k, cmp);
+                                }),
+                 mReads.end());
+}
+
+void
+TransactionFootprint::addRead(LedgerKey const &key) {
+    mReads.emplace_back(key);
+}
+
+void
+TransactionFootprint::addWrite(LedgerKey const &key) {
+    mWrites.emplace_back(key);
+}
+
+void
+TransactionFootprint::addOperation(AccountID const &source, Operation const &op) {
+    addWrite(accountKey(source));
+
+    // the trust line of `owner` for `asset`, unless it is the issuer
+    auto addAsset = [this](AccountID const &owner, Asset const &asset) {
+        if (asset.type() == ASSET_TYPE_NATIVE) {
+            return;
+        }
+        auto issuer = getIssuer(asset);
+        addRead(accountKey(issuer));
+        if (!(owner == issuer)) {
+            addWrite(trustLineKey(owner, asset));
+        }
+    };
+
+    // the balance of `destination` in `asset`
+    auto addDestination = [&](AccountID const &destination, Asset const &asset) {
+        if (asset.type() == ASSET_TYPE_NATIVE) {
+            addWrite(accountKey(destination));
+        } else {
+            addRead(accountKey(destination));
+            addAsset(destination, asset);
+        }
+    };
+
+    auto const &body = op.body;
+    switch (body.type()) {
+        case CREATE_ACCOUNT:
+            addWrite(accountKey(body.createAccountOp().destination));
+            break;
+        case PAYMENT: {
+            auto const &payment = body.paymentOp();
+            addAsset(source, payment.asset);
+            addDestination(payment.destination, payment.asset);
+            break;
+        }
+        case PATH_PAYMENT: {
+            auto const &payment = body.pathPaymentOp();
+            addAsset(source, payment.sendAsset);
+            addDestination(payment.destination, payment.destAsset);
+            mGlobal = true;
+            break;
+        }
+        case MANAGE_OFFER:
+            addAsset(source, body.manageOfferOp().selling);
+            addAsset(source, body.manageOfferOp().buying);
+            mGlobal = true;
+            break;
+        case CREATE_PASSIVE_OFFER:
+            addAsset(source, body.createPassiveOfferOp().selling);
+            addAsset(source, body.createPassiveOfferOp().buying);
+            mGlobal = true;
+            break;
+        case SET_OPTIONS:
+            if (body.setOptionsOp().inflationDest) {
+                addRead(accountKey(*body.setOptionsOp().inflationDest));
+            }
+            break;
+        case CHANGE_TRUST:
+            addAsset(source, body.changeTrustOp().line);
+            break;
+        case ALLOW_TRUST: {
+            auto const &allow = body.allowTrustOp();
+            Asset asset;
+            if (allow.asset.type() == ASSET_TYPE_CREDIT_ALPHANUM4) {
+                asset.type(ASSET_TYPE_CREDIT_ALPHANUM4);
+                asset.alphaNum4().assetCode = allow.asset.assetCode4();
+                asset.alphaNum4().issuer = source;
+            } else if (allow.asset.type() == ASSET_TYPE_CREDIT_ALPHANUM12) {
+                asset.type(ASSET_TYPE_CREDIT_ALPHANUM12);
+                asset.alphaNum12().assetCode = allow.asset.assetCode12();
+                asset.alphaNum12().issuer = source;
+            } else {
+                // invalid, fails before loading anything
+                break;
+            }
+            addWrite(trustLineKey(allow.trustor, asset));
+            // revoking deletes the offers of the trustor
+            if (!allow.authorize) {
+                mGlobal = true;
+            }
+            break;
+        }
+        case ACCOUNT_MERGE:
+            addWrite(accountKey(body.destination()));
+            break;
+        case INFLATION:
+            mGlobal = true;
+            break;
+        case MANAGE_DATA:
+            addWrite(dataKey(source, body.manageDataOp().dataName));
+            break;
+        case BUMP_SEQUENCE:
+            break;
+        default:
+            mGlobal = true;
+            break;
+    }
+}
+
+std::vector<LedgerKey> const &
+TransactionFootprint::getReads() const {
+    return mReads;
+}
+
+std::vector<LedgerKey> const &
+TransactionFootprint::getWrites() const {
+    return mWrites;
+}
+
+bool
+TransactionFootprint::isGlobal() const {
+    return mGlobal;
+}
+
+std::vector<std::vector<size_t>>
+TransactionFootprint::cluster(std::vector<TransactionFootprint> const &footprints) {
+    auto n = footprints.size();
+
+    // union-find, the root of a cluster being its first transaction
+    std::vector<size_t> parent(n);
+    std::iota(parent.begin(), parent.end(), 0);
+    auto find = [&parent](size_t i) {
+        while (parent[i] != i) {
+            parent[i] = parent[parent[i]];
+            i = parent[i];
+        }
+        return i;
+    };
+    auto unite = [&](size_t a, size_t b) {
+        a = find(a);
+        b = find(b);
+        if (a < b) {
+            parent[b] = a;
+        } else if (b < a) {
+            parent[a] = b;
+        }
+    };
+
+    // a key written by a transaction joins it with every transaction reading
+    // or writing the key
+    struct Users {
+        std::vector<size_t> mWriters;
+        std::vector<size_t> mReaders;
+    };
+    std::map<LedgerKey, Users, LedgerEntryIdCmp> users;
+    for (size_t i = 0; i < n; i++) {
+        if (footprints[i].isGlobal()) {
+            continue;
+        }
+        for (auto const &k : footprints[i].getWrites()) {
+            users[k].mWriters.emplace_back(i);
+        }
+        for (auto const &k : footprints[i].getReads()) {
+            users[k].mReaders.emplace_back(i);
+        }
+    }
+    for (auto const &u : users) {
+        auto const &writers = u.second.mWriters;
+        if (writers.empty()) {
+            continue;
+        }
+        for (auto w : writers) {
+            unite(writers.front(), w);
+        }
+        for (auto r : u.second.mReaders) {
+            unite(writers.front(), r);
+        }
+    }
+
+    std::vector<std::vector<size_t>> res;
+    std::vector<size_t> clusterOf(n);
+    for (size_t i = 0; i < n; i++) {
+        if (footprints[i].isGlobal()) {
+            continue;
+        }
+        auto root = find(i);
+        if (root == i) {
+            clusterOf[i] = res.size();
+            res.emplace_back();
+        }
+        res[clusterOf[root]].emplace_back(i);
+    }
+    return res;
+}
+
+size_t
+TransactionFootprint::prefetch(std::vector<TransactionFootprint> const &footprints,
+                               Database &db, size_t maxEntries,
+                               asio::io_context &workers) {
+    std::set<LedgerKey, LedgerEntryIdCmp> keys;
+    for (auto const &f : footprints) {
+        for (auto const *list : {&f.getWrites(), &f.getReads()}) {
+            for (auto const &k : *list) {
+                if (keys.size() < maxEntries &&
+                    (k.type() == ACCOUNT || k.type() == TRUSTLINE) &&
+                    !EntryFrame::cachedEntryExists(k, db)) {
+                    keys.insert(k);
+                }
+            }
+        }
+    }
+    if (keys.empty()) {
+        return 0;
+    }
+
+    // keys are sorted by type then account, so are the batches
+    std::vector<std::vector<LedgerKey>> batches;
+    for (auto const &k : keys) {
+        if (batches.empty() || batches.back().size() == BATCH_SIZE) {
+            batches.emplace_back();
+            batches.back().reserve(BATCH_SIZE);
+        }
+        batches.back().emplace_back(k);
+    }
+
+    auto loads = std::make_shared<BatchLoads>(std::move(batches));
+    if (db.canUsePool()) {
+        // workers busy with something else when a task starts find nothing
+        // left to load, so the calling thread never waits for them to be free
+        auto &pool = db.getPool();
+        for (size_t i = 1; i < loads->mBatches.size(); ++i) {
+            asio::post(workers, [loads, &pool]() {
+                if (loads->hasBatchesLeft()) {
+                    soci::session sess(pool);
+                    loads->run(sess);
+                }
+            });
+        }
+    }
+    loads->run(db.getSession());
+    loads->wait();
+
+    // entries not found are cached as missing, like single loads do
+    std::map<LedgerKey, LedgerEntry const *, LedgerEntryIdCmp> found;
+    for (auto const &entries : loads->mLoaded) {
+        for (auto const &le : entries) {
+            found.emplace(LedgerEntryKey(le), &le);
+        }
+    }
+    for (auto const &k : keys) {
+        auto it = found.find(k);
+        EntryFrame::putCachedEntry(
+                k, it == found.end() ? nullptr : std::make_shared<LedgerEntry const>(*it->second), db);
+    }
+    return keys.size();
+}
+}
@@ -7,12 +7,14 @@
 #include "transactions/OperationFrame.h"
 #include "crypto/Hex.h"
 #include "crypto/SHA.h"
+#include "crypto/SecretKey.h"
 #include "crypto/SignerKey.h"
 
 #include "database/Database.h"
 #include "database/DatabaseUtils.h"
 
 #include "herder/TxSetFrame.h"
+#include "ledger/EntryOverlay.h"
 #include "ledger/LedgerDelta.h"
 #include "application/Application.h"
 
@@ -20,6 +22,7 @@
 
 #include "transactions/SignatureChecker.h"
 #include "transactions/SignatureUtils.h"
+#include "transactions/TransactionHistoryBuffer.h"
 
 #include "util/Algoritm.h"
 #include "util/Logging.h"
@@ -30,6 +33,7 @@
 #include "medida/meter.h"
 #include "medida/metrics_registry.h"
 
+#include <chrono>
 #include <numeric>
 
 namespace vixal {
@@ -40,6 +44,8 @@ TransactionFramePtr
 TransactionFrame::makeTransactionFromWire(Hash const &networkID,
                                           TransactionEnvelope const &msg) {
     TransactionFramePtr res = make_shared<TransactionFrame>(networkID, msg);
+    // envelopes from the wire are not modified, encode them once up front
+    res->getEnvelopeXDR();
     return res;
 }
 
@@ -51,11 +57,20 @@ TransactionFrame::TransactionFrame(Hash const &networkID,
 Hash const &
 TransactionFrame::getFullHash() const {
     if (isZero(mFullHash)) {
-        mFullHash = sha256(xdr::xdr_to_opaque(mEnvelope));
+        mFullHash = sha256(getEnvelopeXDR());
     }
     return (mFullHash);
 }
 
+xdr::opaque_vec<> const &
+TransactionFrame::getEnvelopeXDR() const {
+    if (!mEnvelopeXDR) {
+        mEnvelopeXDR = std::make_shared<xdr::opaque_vec<> const>(
+                xdr::xdr_to_opaque(mEnvelope));
+    }
+    return *mEnvelopeXDR;
+}
+
 Hash const &
 TransactionFrame::getContentsHash() const {
     if (isZero(mContentsHash)) {
@@ -69,6 +84,8 @@ TransactionFrame::clearCached() {
     Hash zero{};
     mContentsHash = zero;
     mFullHash = zero;
+    mEnvelopeXDR.reset();
+    mMessage.reset();
 }
 
 TransactionResultPair
@@ -120,6 +137,9 @@ TransactionFrame::addSignature(SecretKey const &secretKey) {
 void
 TransactionFrame::addSignature(DecoratedSignature const &signature) {
     mEnvelope.signatures.push_back(signature);
+    mFullHash = Hash{};
+    mEnvelopeXDR.reset();
+    mMessage.reset();
 }
 
 bool
@@ -445,6 +465,48 @@ TransactionFrame::checkValid(Application &app, SequenceNumber current) {
     return res;
 }
 
+void
+TransactionFrame::addPreverifiableSignatures(
+        std::vector<PubKeyUtils::VerifySigRequest> &batch) const {
+    getFullHash();
+    auto const &contentsHash = getContentsHash();
+
+    std::vector<AccountID const *> keys{&getSourceID()};
+    for (auto const &op : mEnvelope.tx.operations) {
+        if (op.sourceAccount &&
+            std::none_of(keys.begin(), keys.end(), [&](AccountID const *k) {
+                return *k == *op.sourceAccount;
+            })) {
+            keys.push_back(op.sourceAccount.get());
+        }
+    }
+
+    for (auto const &sig : mEnvelope.signatures) {
+        for (auto key : keys) {
+            if (SignatureUtils::doesHintMatch(key->ed25519(), sig.hint)) {
+                batch.emplace_back(*key, sig.signature, contentsHash);
+            }
+        }
+    }
+}
+
+void
+TransactionFrame::preverifySignatures() const {
+    std::vector<PubKeyUtils::VerifySigRequest> batch;
+    addPreverifiableSignatures(batch);
+    PubKeyUtils::verifySigs(batch);
+}
+
+void
+TransactionFrame::preverifySignatures(
+        std::vector<TransactionFramePtr> const &txs) {
+    std::vector<PubKeyUtils::VerifySigRequest> batch;
+    for (auto const &tx : txs) {
+        tx->addPreverifiableSignatures(batch);
+    }
+    PubKeyUtils::verifySigs(batch);
+}
+
 void
 TransactionFrame::markResultFailed() {
     // changing "code" causes the xdr struct to be deleted/re-created
@@ -471,6 +533,13 @@ TransactionFrame::apply(LedgerDelta &delta, Application &app) {
     return apply(delta, tm.v1(), app);
 }
 
+void
+TransactionFrame::resetAppliedResults() {
+    auto fee = getResult().feeCharged;
+    resetResults();
+    getResult().feeCharged = fee;
+}
+
 bool
 TransactionFrame::applyOperations(SignatureChecker &signatureChecker,
                                   LedgerDelta &delta, TransactionMetaV1 &meta,
@@ -480,23 +549,30 @@ TransactionFrame::applyOperations(SignatureChecker &signatureChecker,
 
     {
         // shield outer scope of any side effects by using
-        // a sql transaction for ledger state and LedgerDelta
-        soci::transaction sqlTx(app.getDatabase().getSession());
+        // a sql transaction (or one of the current overlay) for ledger state
+        // and LedgerDelta
+        EntryTransaction sqlTx(app.getDatabase());
         LedgerDelta thisTxOpsDelta(delta);
 
         auto &opTimer = app.getMetrics().newTimer({"transaction", "op", "apply"});
+        auto &closeTrace = app.getLedgerManager().getCloseTrace();
 
-        for (auto &op : mOperations) {
+        for (size_t i = 0; i < mOperations.size(); i++) {
+            auto &op = mOperations[i];
             auto time = opTimer.timeScope();
             LedgerDelta opDelta(thisTxOpsDelta);
+            auto start = std::chrono::steady_clock::now();
             bool txRes = op->apply(signatureChecker, opDelta, app);
+            closeTrace.addOperation(op->getOperation().body.type(),
+                                    std::chrono::steady_clock::now() - start);
 
             if (!txRes) {
                 errorEncountered = true;
             }
             if (!errorEncountered) {
                 app.getInvariantManager().checkOnOperationApply(
-                        op->getOperation(), op->getResult(), opDelta);
+                        op->getOperation(), op->getResult(), opDelta,
+                        getFullHash(), i);
             }
             meta.operations.emplace_back(opDelta.getChanges());
             opDelta.commit();
@@ -556,91 +632,33 @@ TransactionFrame::apply(LedgerDelta &delta, TransactionMetaV1 &meta,
     return valid && applyOperations(signatureChecker, delta, meta, app);
 }
 
-VixalMessage
+VixalMessage const &
 TransactionFrame::toVixalMessage() const {
-    VixalMessage msg;
-    msg.type(TRANSACTION);
-    msg.transaction() = mEnvelope;
-    return msg;
+    if (!mMessage) {
+        auto msg = std::make_shared<VixalMessage>();
+        msg->type(TRANSACTION);
+        msg->transaction() = mEnvelope;
+        mMessage = msg;
+    }
+    return *mMessage;
 }
 
 void
-TransactionFrame::storeTransaction(LedgerManager &ledgerManager,
+TransactionFrame::storeTransaction(TransactionHistoryBuffer &history,
                                    TransactionMeta &tm, int txindex,
                                    TransactionResultSet &resultSet) const {
-    auto txBytes(xdr::xdr_to_opaque(mEnvelope));
-
     resultSet.results.emplace_back(getResultPair());
-    auto txResultBytes(xdr::xdr_to_opaque(resultSet.results.back()));
-
-    std::string txBody;
-    txBody = decoder::encode_b64(txBytes);
-
-    std::string txResult;
-    txResult = decoder::encode_b64(txResultBytes);
-
-    xdr::opaque_vec<> txMeta(xdr::xdr_to_opaque(tm));
-
-    std::string meta;
-    meta = decoder::encode_b64(txMeta);
-
-    string txIDString(binToHex(getContentsHash()));
-
-    auto &db = ledgerManager.getDatabase();
-    auto prep = db.getPreparedStatement(
-            "INSERT INTO txhistory "
-            "( txid, ledgerseq, txindex,  txbody, txresult, txmeta) VALUES "
-            "(:id,  :seq,      :txindex, :txb,   :txres,   :meta)");
-
-    auto &st = prep.statement();
-    st.exchange(soci::use(txIDString));
-    st.exchange(soci::use(ledgerManager.getCurrentLedgerHeader().ledgerSeq));
-    st.exchange(soci::use(txindex));
-    st.exchange(soci::use(txBody));
-    st.exchange(soci::use(txResult));
-    st.exchange(soci::use(meta));
-    st.define_and_bind();
-    {
-        auto timer = db.getInsertTimer("txhistory");
-        st.execute(true);
-    }
-
-    if (st.get_affected_rows() != 1) {
-        throw std::runtime_error("Could not update data in SQL");
-    }
+    history.addTransaction(getContentsHash(), txindex, getEnvelopeXDR(),
+                           xdr::xdr_to_opaque(resultSet.results.back()),
+                           xdr::xdr_to_opaque(tm));
 }
 
 void
-TransactionFrame::storeTransactionFee(LedgerManager &ledgerManager,
+TransactionFrame::storeTransactionFee(TransactionHistoryBuffer &history,
                                       LedgerEntryChanges const &changes,
                                       int txindex) const {
-    xdr::opaque_vec<> txChanges(xdr::xdr_to_opaque(changes));
-
-    std::string txChanges64;
-    txChanges64 = decoder::encode_b64(txChanges);
-
-    string txIDString(binToHex(getContentsHash()));
-
-    auto &db = ledgerManager.getDatabase();
-    auto prep = db.getPreparedStatement(
-            "INSERT INTO txfeehistory "
-            "( txid, ledgerseq, txindex,  txchanges) VALUES "
-            "(:id,  :seq,      :txindex, :txchanges)");
-
-    auto &st = prep.statement();
-    st.exchange(soci::use(txIDString));
-    st.exchange(soci::use(ledgerManager.getCurrentLedgerHeader().ledgerSeq));
-    st.exchange(soci::use(txindex));
-    st.exchange(soci::use(txChanges64));
-    st.define_and_bind();
-    {
-        auto timer = db.getInsertTimer("txfeehistory");
-        st.execute(true);
-    }
-
-    if (st.get_affected_rows() != 1) {
-        throw std::runtime_error("Could not update data in SQL");
-    }
+    history.addTransactionFee(getContentsHash(), txindex,
+                              xdr::xdr_to_opaque(changes));
 }
 
 static void
@@ -667,19 +685,18 @@ saveTransactionHelper(Database &db, soci::session &sess, uint32 ledgerSeq,
 TransactionResultSet
 TransactionFrame::getTransactionHistoryResults(Database &db, uint32 ledgerSeq) {
     TransactionResultSet res;
-    std::string txresult64;
+    BlobValue txresult(db, db.getSession());
     auto prep =
             db.getPreparedStatement("SELECT txresult FROM txhistory "
                                     "WHERE ledgerseq = :lseq ORDER BY txindex ASC");
     auto &st = prep.statement();
 
     st.exchange(soci::use(ledgerSeq));
-    st.exchange(soci::into(txresult64));
+    txresult.into(st);
     st.define_and_bind();
     st.execute(true);
     while (st.got_data()) {
-        std::vector<uint8_t> result;
-        decoder::decode_b64(txresult64, result);
+        auto result = txresult.get();
 
         res.results.emplace_back();
         TransactionResultPair &p = res.results.back();
@@ -695,19 +712,18 @@ TransactionFrame::getTransactionHistoryResults(Database &db, uint32 ledgerSeq) {
 std::vector<LedgerEntryChanges>
 TransactionFrame::getTransactionFeeMeta(Database &db, uint32 ledgerSeq) {
     std::vector<LedgerEntryChanges> res;
-    std::string changes64;
+    BlobValue changes(db, db.getSession());
     auto prep =
             db.getPreparedStatement("SELECT txchanges FROM txfeehistory "
                                     "WHERE ledgerseq = :lseq ORDER BY txindex ASC");
     auto &st = prep.statement();
 
-    st.exchange(soci::into(changes64));
+    changes.into(st);
     st.exchange(soci::use(ledgerSeq));
     st.define_and_bind();
     st.execute(true);
     while (st.got_data()) {
-        std::vector<uint8_t> changesRaw;
-        decoder::decode_b64(changes64, changesRaw);
+        auto changesRaw = changes.get();
 
         xdr::xdr_get g1(&changesRaw.front(), &changesRaw.back() + 1);
         res.emplace_back();
@@ -728,7 +744,7 @@ TransactionFrame::copyTransactionsToStream(Hash const &networkID, Database &db,
     using namespace soci;
 
     auto timer = db.getSelectTimer("txhistory");
-    std::string txBody, txResult, txMeta;
+    BlobValue txBody(db, sess), txResult(db, sess);
     uint32_t begin = ledgerSeq, end = ledgerSeq + ledgerCount;
     size_t n = 0;
 
@@ -736,11 +752,17 @@ TransactionFrame::copyTransactionsToStream(Hash const &networkID, Database &db,
     uint32_t curLedgerSeq;
 
     assert(begin <= end);
-    statement st =
-            (sess.prepare << "SELECT ledgerseq, txbody, txresult FROM txhistory "
-                             "WHERE ledgerseq >= :begin AND ledgerseq < :end ORDER "
-                             "BY ledgerseq ASC, txindex ASC", into(curLedgerSeq),
-                    into(txBody), into(txResult), use(begin), use(end));
+    auto prep = Database::prepareStatement(
+            sess, "SELECT ledgerseq, txbody, txresult FROM txhistory "
+                  "WHERE ledgerseq >= :begin AND ledgerseq < :end ORDER "
+                  "BY ledgerseq ASC, txindex ASC");
+    auto &st = prep.statement();
+    st.exchange(into(curLedgerSeq));
+    txBody.into(st);
+    txResult.into(st);
+    st.exchange(use(begin));
+    st.exchange(use(end));
+    st.define_and_bind();
 
     Hash h;
     TxSetFrame txSet(h); // we're setting the hash later
@@ -761,11 +783,8 @@ TransactionFrame::copyTransactionsToStream(Hash const &networkID, Database &db,
             lastLedgerSeq = curLedgerSeq;
         }
 
-        std::vector<uint8_t> body;
-        decoder::decode_b64(txBody, body);
-
-        std::vector<uint8_t> result;
-        decoder::decode_b64(txResult, result);
+        auto body = txBody.get();
+        auto result = txResult.get();
 
         xdr::xdr_get g1(&body.front(), &body.back() + 1);
         xdr_argpack_archive(g1, tx);
@@ -792,30 +811,161 @@ TransactionFrame::copyTransactionsToStream(Hash const &networkID, Database &db,
     return n;
 }
 
-void
-TransactionFrame::dropAll(Database &db) {
-    db.getSession() << "DROP TABLE IF EXISTS txhistory";
-
-    db.getSession() << "DROP TABLE IF EXISTS txfeehistory";
-
-    db.getSession() << "CREATE TABLE txhistory ("
+static void
+createTxHistory(Database &db, std::string const &table) {
+    db.getSession() << "CREATE TABLE " + table + " ("
                        "txid        CHARACTER(64) NOT NULL,"
                        "ledgerseq   INT NOT NULL CHECK (ledgerseq >= 0),"
                        "txindex     INT NOT NULL,"
-                       "txbody      TEXT NOT NULL,"
-                       "txresult    TEXT NOT NULL,"
-                       "txmeta      TEXT NOT NULL,"
+                       "txbody      " + db.getBlobType() + " NOT NULL,"
+                       "txresult    " + db.getBlobType() + " NOT NULL,"
+                       "txmeta      " + db.getBlobType() + " NOT NULL,"
                        "PRIMARY KEY (ledgerseq, txindex)"
                        ")";
-    db.getSession() << "CREATE INDEX histbyseq ON txhistory (ledgerseq);";
+}
 
-    db.getSession() << "CREATE TABLE txfeehistory ("
+static void
+createTxFeeHistory(Database &db, std::string const &table) {
+    db.getSession() << "CREATE TABLE " + table + " ("
                        "txid        CHARACTER(64) NOT NULL,"
                        "ledgerseq   INT NOT NULL CHECK (ledgerseq >= 0),"
                        "txindex     INT NOT NULL,"
-                       "txchanges   TEXT NOT NULL,"
+                       "txchanges   " + db.getBlobType() + " NOT NULL,"
                        "PRIMARY KEY (ledgerseq, txindex)"
                        ")";
+}
+
+// rows read at once by convertHistoryToBlobs
+static size_t const CONVERSION_BATCH_SIZE = 1000;
+
+// replaces `table`, whose `columns` hold base64 text, by a table made by
+// `create` holding their bytes, copying the rows in batches
+static void
+convertToBlobs(Database &db, std::string const &table,
+               std::vector<std::string> const &columns,
+               void (*create)(Database &, std::string const &)) {
+    auto &sess = db.getSession();
+    auto converted = table + "_blob";
+    sess << "DROP TABLE IF EXISTS " + converted;
+    create(db, converted);
+
+    std::string names = "txid, ledgerseq, txindex";
+    std::string params = ":id, :seq, :txindex";
+    for (auto const &c : columns) {
+        names += ", " + c;
+        params += ", :" + c;
+    }
+
+    std::string txID;
+    uint32_t ledgerSeq;
+    int txIndex;
+    std::vector<std::string> values(columns.size());
+    std::vector<std::unique_ptr<BlobValue>> blobs;
+    for (size_t i = 0; i < columns.size(); i++) {
+        blobs.emplace_back(std::make_unique<BlobValue>(db, sess));
+    }
+    // rows are read after the last one copied, in primary key order
+    uint32_t lastSeq = 0;
+    int lastIndex = -1;
+
+    // statements are closed before the table is dropped, as SQLite
+    // doesn't drop tables with open cursors
+    {
+        auto selPrep = Database::prepareStatement(
+                sess, "SELECT " + names + " FROM " + table +
+                      " WHERE ledgerseq > :s1 OR (ledgerseq = :s2 AND txindex > "
+                      ":i) ORDER BY ledgerseq ASC, txindex ASC LIMIT " +
+                      std::to_string(CONVERSION_BATCH_SIZE));
+        auto &sel = selPrep.statement();
+        sel.exchange(soci::into(txID));
+        sel.exchange(soci::into(ledgerSeq));
+        sel.exchange(soci::into(txIndex));
+        for (auto &v : values) {
+            sel.exchange(soci::into(v));
+        }
+        sel.exchange(soci::use(lastSeq));
+        sel.exchange(soci::use(lastSeq));
+        sel.exchange(soci::use(lastIndex));
+        sel.define_and_bind();
+
+        auto insPrep = Database::prepareStatement(
+                sess, "INSERT INTO " + converted + " (" + names + ") VALUES (" +
+                      params + ")");
+        auto &ins = insPrep.statement();
+        ins.exchange(soci::use(txID));
+        ins.exchange(soci::use(ledgerSeq));
+        ins.exchange(soci::use(txIndex));
+        for (auto &b : blobs) {
+            b->use(ins);
+        }
+        ins.define_and_bind();
+
+        struct Row {
+            std::string mTxID;
+            uint32_t mLedgerSeq;
+            int mTxIndex;
+            std::vector<std::string> mValues;
+        };
+
+        size_t total = 0;
+        for (;;) {
+            std::vector<Row> rows;
+            sel.execute(true);
+            while (sel.got_data()) {
+                rows.push_back({txID, ledgerSeq, txIndex, values});
+                sel.fetch();
+            }
+            if (rows.empty()) {
+                break;
+            }
+
+            for (auto const &r : rows) {
+                txID = r.mTxID;
+                ledgerSeq = r.mLedgerSeq;
+                txIndex = r.mTxIndex;
+                for (size_t i = 0; i < blobs.size(); i++) {
+                    std::vector<uint8_t> bin;
+                    decoder::decode_b64(r.mValues[i], bin);
+                    blobs[i]->set(bin);
+                }
+                ins.execute(true);
+                if (ins.get_affected_rows() != 1) {
+                    throw std::runtime_error("Could not update data in SQL");
+                }
+            }
+
+            lastSeq = rows.back().mLedgerSeq;
+            lastIndex = rows.back().mTxIndex;
+            total += rows.size();
+            CLOG(INFO, "Database") << "Converted " << total << " rows of "
+                                   << table;
+        }
+    }
+
+    sess << "DROP TABLE " + table;
+    sess << "ALTER TABLE " + converted + " RENAME TO " + table;
+}
+
+void
+TransactionFrame::convertHistoryToBlobs(Database &db) {
+    convertToBlobs(db, "txhistory", {"txbody", "txresult", "txmeta"},
+                   createTxHistory);
+    db.getSession() << "CREATE INDEX histbyseq ON txhistory (ledgerseq);";
+
+    convertToBlobs(db, "txfeehistory", {"txchanges"}, createTxFeeHistory);
+    db.getSession() << "CREATE INDEX histfeebyseq ON txfeehistory (ledgerseq);";
+}
+
+void
+TransactionFrame::dropAll(Database &db) {
+    db.getSession() << "DROP TABLE IF EXISTS txhistory";
+
+    db.getSession() << "DROP TABLE IF EXISTS txfeehistory";
+
+    createTxHistory(db, "txhistory");
+    db.getSession() << "CREATE INDEX histbyseq ON txhistory (ledgerseq);";
+
+    createTxFeeHistory(db, "txfeehistory");
     db.getSession() << "CREATE INDEX histfeebyseq ON txfeehistory (ledgerseq);";
 }
 
@@ -0,0 +1,101 @@
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "transactions/TransactionHistoryBuffer.h"
+#include "crypto/Hex.h"
+#include "database/Database.h"
+
+namespace vixal {
+
+// SQLite's default limit of bound parameters in a statement, which bounds
+// the number of rows inserted at once
+static size_t const MAX_PARAMETERS = 999;
+
+TransactionHistoryBuffer::TransactionHistoryBuffer(Database &db,
+                                                   uint32 ledgerSeq)
+        : mDatabase(db), mLedgerSeq(ledgerSeq) {
+}
+
+void
+TransactionHistoryBuffer::addTransaction(Hash const &contentsHash, int txindex,
+                                         ByteSlice const &body,
+                                         ByteSlice const &result,
+                                         ByteSlice const &meta) {
+    mTransactions.push_back({binToHex(contentsHash), txindex,
+                             {{body.begin(), body.end()},
+                              {result.begin(), result.end()},
+                              {meta.begin(), meta.end()}}});
+}
+
+void
+TransactionHistoryBuffer::addTransactionFee(Hash const &contentsHash,
+                                            int txindex,
+                                            ByteSlice const &changes) {
+    mFees.push_back({binToHex(contentsHash), txindex,
+                     {{changes.begin(), changes.end()}}});
+}
+
+size_t
+TransactionHistoryBuffer::size() const {
+    return mTransactions.size() + mFees.size();
+}
+
+void
+TransactionHistoryBuffer::flush() {
+    insert("txhistory", {"txbody", "txresult", "txmeta"}, mTransactions);
+    insert("txfeehistory", {"txchanges"}, mFees);
+}
+
+void
+TransactionHistoryBuffer::insert(std::string const &table,
+                                 std::vector<std::string> const &columns,
+                                 std::vector<Row> &rows) {
+    std::string names = "txid, ledgerseq, txindex";
+    for (auto const &c : columns) {
+        names += ", " + c;
+    }
+
+    // integers are inlined, only the strings are bound
+    auto perStatement = MAX_PARAMETERS / (columns.size() + 1);
+    for (size_t begin = 0; begin < rows.size(); begin += perStatement) {
+        auto end = std::min(rows.size(), begin + perStatement);
+
+        std::string sql = "INSERT INTO " + table + " (" + names + ") VALUES ";
+        for (auto i = begin; i < end; i++) {
+            auto n = std::to_string(i - begin);
+            sql += i == begin ? "(" : ", (";
+            sql += ":id" + n + ", " + std::to_string(mLedgerSeq) + ", " +
+                   std::to_string(rows[i].mTxIndex);
+            for (size_t c = 0; c < columns.size(); c++) {
+                sql += ", :v" + n + "_" + std::to_string(c);
+            }
+            sql += ")";
+        }
+
+        // bound values outlive the statement
+        auto &sess = mDatabase.getSession();
+        std::vector<std::unique_ptr<BlobValue>> blobs;
+        auto prep = Database::prepareStatement(sess, sql);
+        auto &st = prep.statement();
+        for (auto i = begin; i < end; i++) {
+            st.exchange(soci::use(rows[i].mTxID));
+            for (auto const &b : rows[i].mBlobs) {
+                blobs.emplace_back(std::make_unique<BlobValue>(mDatabase, sess));
+                blobs.back()->set(b);
+                blobs.back()->use(st);
+            }
+        }
+        st.define_and_bind();
+        {
+            auto timer = mDatabase.getInsertTimer(table);
+            st.execute(true);
+        }
+
+        if (st.get_affected_rows() != static_cast<long long>(end - begin)) {
+            throw std::runtime_error("Could not update data in SQL");
+        }
+    }
+    rows.clear();
+}
+}
@@ -37,6 +37,12 @@ Work::getUniqueName() const {
     return mUniqueName;
 }
 
+ProcessClass
+Work::getProcessClass() const {
+    auto parent = std::dynamic_pointer_cast<Work>(mParent.lock());
+    return parent ? parent->getProcessClass() : PROCESS_OTHER;
+}
+
 std::string
 Work::getStatus() const {
     switch (mState) {
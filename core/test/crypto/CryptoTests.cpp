@@ -12,9 +12,12 @@
 #include "util/Logging.h"
 #include "util/basen.h"
 #include <autocheck/autocheck.hpp>
+#include <atomic>
+#include <chrono>
 #include <map>
 #include <regex>
 #include <sodium.h>
+#include <thread>
 
 using namespace vixal;
 
@@ -139,6 +142,45 @@ TEST_CASE("sign tests", "[crypto]") {
     CHECK(!PubKeyUtils::verifySig(pk, sig, msg));
 }
 
+TEST_CASE("batch verify tests", "[crypto]") {
+    std::vector<SecretKey> keys;
+    std::vector<PublicKey> pubs;
+    std::vector<std::string> msgs;
+    std::vector<Signature> sigs;
+    for (int i = 0; i < 10; ++i) {
+        keys.emplace_back(SecretKey::random());
+        pubs.emplace_back(keys.back().getPublicKey());
+        msgs.emplace_back("hello " + std::to_string(i));
+        sigs.emplace_back(keys.back().sign(msgs.back()));
+    }
+    // a bad signature, a signature by the wrong key and a truncated one
+    sigs[2][4] ^= 1;
+    sigs[5] = keys[6].sign(msgs[5]);
+    sigs[8].resize(32);
+
+    auto check = [&]() {
+        std::vector<PubKeyUtils::VerifySigRequest> batch;
+        for (size_t i = 0; i < keys.size(); ++i) {
+            batch.emplace_back(pubs[i], sigs[i], msgs[i]);
+        }
+        auto results = PubKeyUtils::verifySigs(batch);
+        REQUIRE(results.size() == keys.size());
+        for (size_t i = 0; i < keys.size(); ++i) {
+            CHECK(results[i] == (i != 2 && i != 5 && i != 8));
+            CHECK(results[i] == PubKeyUtils::verifySig(pubs[i], sigs[i], msgs[i]));
+        }
+    };
+
+    SECTION("cold cache") {
+        PubKeyUtils::clearVerifySigCache();
+        check();
+    }
+    SECTION("warm cache") {
+        check();
+        check();
+    }
+}
+
 struct SignVerifyTestcase {
     SecretKey key;
     PublicKey pub;
@@ -186,6 +228,125 @@ TEST_CASE("sign and verify benchmarking", "[crypto-bench][bench][!hide]") {
     }
 }
 
+TEST_CASE("batch verify benchmarking", "[crypto-bench][bench][!hide]") {
+    // small enough for the second pass to be served by the cache
+    size_t n = 50000;
+    size_t batchSize = 1000;
+    std::vector<SignVerifyTestcase> cases;
+    for (size_t i = 0; i < n; ++i) {
+        cases.push_back(SignVerifyTestcase::create());
+        cases.back().sign();
+    }
+
+    auto run = [&](std::string const &name,
+                   std::function<void(size_t, size_t)> verifyRange) {
+        PubKeyUtils::clearVerifySigCache();
+        for (int pass = 0; pass < 2; ++pass) {
+            auto start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < n; i += batchSize) {
+                verifyRange(i, std::min(n, i + batchSize));
+            }
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - start);
+            LOG(INFO) << name << (pass == 0 ? " (cold cache): " : " (warm cache): ")
+                      << n << " verifications in " << elapsed.count() << "ms";
+        }
+    };
+
+    LOG(INFO) << "Benchmarking " << n << " verifications, single vs batches of "
+              << batchSize;
+    run("single", [&](size_t from, size_t to) {
+        for (size_t i = from; i < to; ++i) {
+            cases[i].verify();
+        }
+    });
+    run("batch", [&](size_t from, size_t to) {
+        std::vector<PubKeyUtils::VerifySigRequest> batch;
+        for (size_t i = from; i < to; ++i) {
+            batch.emplace_back(cases[i].pub, cases[i].sig, cases[i].msg);
+        }
+        for (auto ok : PubKeyUtils::verifySigs(batch)) {
+            CHECK(ok);
+        }
+    });
+}
+
+TEST_CASE("verify cache counts", "[crypto]") {
+    auto total = [](std::vector<PubKeyUtils::VerifySigCacheCounts> const &counts) {
+        PubKeyUtils::VerifySigCacheCounts res{0, 0};
+        for (auto const &c : counts) {
+            res.mHits += c.mHits;
+            res.mMisses += c.mMisses;
+        }
+        return res;
+    };
+
+    PubKeyUtils::clearVerifySigCache();
+    auto tc = SignVerifyTestcase::create();
+    tc.sign();
+
+    PubKeyUtils::takeVerifySigCacheCounts();
+    auto before = total(PubKeyUtils::getVerifySigCacheCounts());
+    tc.verify();
+    tc.verify();
+    tc.verify();
+    auto after = total(PubKeyUtils::getVerifySigCacheCounts());
+    REQUIRE(after.mMisses - before.mMisses == 1);
+    REQUIRE(after.mHits - before.mHits == 2);
+
+    // each hit and miss is taken once, whoever asks
+    auto taken = PubKeyUtils::takeVerifySigCacheCounts();
+    REQUIRE(taken.mMisses == 1);
+    REQUIRE(taken.mHits == 2);
+    taken = PubKeyUtils::takeVerifySigCacheCounts();
+    REQUIRE(taken.mMisses == 0);
+    REQUIRE(taken.mHits == 0);
+}
+
+TEST_CASE("verify cache contention benchmarking",
+          "[crypto-bench][bench][!hide]") {
+    // fits in the cache, so that threads only measure lookups
+    size_t n = 20000;
+    size_t rounds = 20;
+    std::vector<SignVerifyTestcase> cases;
+    for (size_t i = 0; i < n; ++i) {
+        cases.push_back(SignVerifyTestcase::create());
+        cases.back().sign();
+    }
+    PubKeyUtils::clearVerifySigCache();
+    for (auto &c : cases) {
+        c.verify();
+    }
+
+    unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned nThreads = 1; nThreads <= maxThreads; nThreads *= 2) {
+        std::atomic<size_t> failures{0};
+        std::vector<std::thread> threads;
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned t = 0; t < nThreads; ++t) {
+            threads.emplace_back([&, t]() {
+                for (size_t r = 0; r < rounds; ++r) {
+                    // threads start apart to not walk the same shards together
+                    for (size_t i = 0; i < n; ++i) {
+                        auto &c = cases[(i + t * n / nThreads) % n];
+                        if (!PubKeyUtils::verifySig(c.pub, c.sig, c.msg)) {
+                            ++failures;
+                        }
+                    }
+                }
+            });
+        }
+        for (auto &t : threads) {
+            t.join();
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start);
+        REQUIRE(failures == 0);
+        LOG(INFO) << nThreads << " threads: " << nThreads * n * rounds
+                  << " cached verifications in " << elapsed.count() << "ms";
+    }
+}
+
 TEST_CASE("StrKey tests", "[crypto]") {
     std::regex b32("^([A-Z2-7])+$");
     std::regex b32Pad("^([A-Z2-7])+(=|===|====|======)?$");
@@ -4,15 +4,21 @@
 
 #include "util/asio.h"
 #include "crypto/Hex.h"
+#include "crypto/SHA.h"
 #include "database/Database.h"
 #include "catch.hpp"
 #include "application/Application.h"
 #include "application/Config.h"
 #include "test/test.h"
 #include "test/TestUtils.h"
+#include "transactions/TransactionFrame.h"
+#include "transactions/TransactionHistoryBuffer.h"
+#include "util/Decoder.h"
 #include "util/Logging.h"
 #include "util/Timer.h"
 #include "util/TmpDir.h"
+#include "xdrpp/marshal.h"
+#include <algorithm>
 #include <random>
 
 using namespace vixal;
@@ -308,3 +314,190 @@ TEST_CASE("schema test", "[db]") {
     auto av = db.getAppSchemaVersion();
     REQUIRE(dbv == av);
 }
+
+// result of the `i`th transaction of `ledger`, for rows of the history tables
+static TransactionResultPair
+resultFor(uint32_t ledger, int i) {
+    TransactionResultPair p;
+    p.transactionHash =
+            sha256(std::to_string(ledger) + "/" + std::to_string(i));
+    p.result.feeCharged = i;
+    p.result.result.code(txSUCCESS);
+    return p;
+}
+
+TEST_CASE("blob round trip", "[db]") {
+    Config const &cfg = getTestConfig(0, Config::TESTDB_IN_MEMORY_SQLITE);
+
+    VirtualClock clock;
+    Application::pointer app = createTestApplication(clock, cfg);
+    auto &db = app->getDatabase();
+    auto &session = db.getSession();
+
+    session << "DROP TABLE IF EXISTS blobtest";
+    session << "CREATE TABLE blobtest (x " + db.getBlobType() + ")";
+
+    std::vector<uint8_t> bin{0, 1, 0, '\'', 0xff, '\\', 0};
+    {
+        BlobValue in(db, session);
+        in.set(bin);
+        auto prep = Database::prepareStatement(
+                session, "INSERT INTO blobtest (x) VALUES (:x)");
+        auto &st = prep.statement();
+        in.use(st);
+        st.define_and_bind();
+        st.execute(true);
+    }
+
+    BlobValue out(db, session);
+    auto prep = Database::prepareStatement(session, "SELECT x FROM blobtest");
+    auto &st = prep.statement();
+    out.into(st);
+    st.define_and_bind();
+    st.execute(true);
+    REQUIRE(st.got_data());
+    REQUIRE(out.get() == bin);
+}
+
+TEST_CASE("txhistory rows keep NUL bytes", "[db]") {
+    Config const &cfg = getTestConfig(0, Config::TESTDB_IN_MEMORY_SQLITE);
+
+    VirtualClock clock;
+    Application::pointer app = createTestApplication(clock, cfg);
+    auto &db = app->getDatabase();
+
+    // XDR of small integers is mostly NUL bytes
+    auto p = resultFor(1000, 1);
+    auto result = xdr::xdr_to_opaque(p);
+    REQUIRE(std::count(result.begin(), result.end(), 0) > 0);
+    std::vector<uint8_t> body{0, 0, 0, 1, 0};
+
+    TransactionHistoryBuffer history(db, 1000);
+    history.addTransaction(p.transactionHash, 1, body, result, body);
+    history.flush();
+
+    BlobValue txBody(db, db.getSession());
+    auto prep = db.getPreparedStatement(
+            "SELECT txbody FROM txhistory WHERE ledgerseq = 1000");
+    auto &st = prep.statement();
+    txBody.into(st);
+    st.define_and_bind();
+    st.execute(true);
+    REQUIRE(st.got_data());
+    REQUIRE(txBody.get() == body);
+
+    auto res = TransactionFrame::getTransactionHistoryResults(db, 1000);
+    REQUIRE(res.results.size() == 1);
+    REQUIRE(res.results[0] == p);
+}
+
+TEST_CASE("history tables upgrade to blobs", "[db]") {
+    Config const &cfg = getTestConfig(0, Config::TESTDB_IN_MEMORY_SQLITE);
+
+    VirtualClock clock;
+    Application::pointer app = createTestApplication(clock, cfg);
+    auto &db = app->getDatabase();
+    auto &session = db.getSession();
+
+    // the history tables before schema version 8
+    session << "DROP TABLE txhistory";
+    session << "DROP TABLE txfeehistory";
+    session << "CREATE TABLE txhistory ("
+               "txid        CHARACTER(64) NOT NULL,"
+               "ledgerseq   INT NOT NULL CHECK (ledgerseq >= 0),"
+               "txindex     INT NOT NULL,"
+               "txbody      TEXT NOT NULL,"
+               "txresult    TEXT NOT NULL,"
+               "txmeta      TEXT NOT NULL,"
+               "PRIMARY KEY (ledgerseq, txindex)"
+               ")";
+    session << "CREATE INDEX histbyseq ON txhistory (ledgerseq);";
+    session << "CREATE TABLE txfeehistory ("
+               "txid        CHARACTER(64) NOT NULL,"
+               "ledgerseq   INT NOT NULL CHECK (ledgerseq >= 0),"
+               "txindex     INT NOT NULL,"
+               "txchanges   TEXT NOT NULL,"
+               "PRIMARY KEY (ledgerseq, txindex)"
+               ")";
+    session << "CREATE INDEX histfeebyseq ON txfeehistory (ledgerseq);";
+
+    // more rows than converted in one batch
+    uint32_t const ledgers = 30;
+    int const txPerLedger = 50;
+    {
+        soci::transaction tx(session);
+        for (uint32_t ledger = 1; ledger <= ledgers; ledger++) {
+            for (int i = 0; i < txPerLedger; i++) {
+                auto p = resultFor(ledger, i);
+                std::string txID = binToHex(p.transactionHash);
+                std::string result =
+                        decoder::encode_b64(xdr::xdr_to_opaque(p));
+                std::string changes = decoder::encode_b64(
+                        xdr::xdr_to_opaque(LedgerEntryChanges{}));
+                session << "INSERT INTO txhistory (txid, ledgerseq, txindex, "
+                           "txbody, txresult, txmeta) VALUES (:id, :seq, "
+                           ":txindex, :txb, :txres, :meta)",
+                        soci::use(txID), soci::use(ledger), soci::use(i),
+                        soci::use(result), soci::use(result),
+                        soci::use(result);
+                session << "INSERT INTO txfeehistory (txid, ledgerseq, "
+                           "txindex, txchanges) VALUES (:id, :seq, :txindex, "
+                           ":txchanges)",
+                        soci::use(txID), soci::use(ledger), soci::use(i),
+                        soci::use(changes);
+            }
+        }
+        tx.commit();
+    }
+
+    db.putSchemaVersion(7);
+    db.upgradeToCurrentSchema();
+    REQUIRE(db.getDBSchemaVersion() == 8);
+
+    for (uint32_t ledger = 1; ledger <= ledgers; ledger++) {
+        auto res = TransactionFrame::getTransactionHistoryResults(db, ledger);
+        REQUIRE(res.results.size() == txPerLedger);
+        for (int i = 0; i < txPerLedger; i++) {
+            REQUIRE(res.results[i] == resultFor(ledger, i));
+        }
+        auto fees = TransactionFrame::getTransactionFeeMeta(db, ledger);
+        REQUIRE(fees.size() == txPerLedger);
+    }
+}
+
+TEST_CASE("history rows written in bulk", "[db]") {
+    Config const &cfg = getTestConfig(0, Config::TESTDB_IN_MEMORY_SQLITE);
+
+    VirtualClock clock;
+    Application::pointer app = createTestApplication(clock, cfg);
+    auto &db = app->getDatabase();
+
+    uint32_t const ledgerSeq = 1000;
+
+    // more rows than fit in one statement
+    int const n = 600;
+    TransactionHistoryBuffer history(db, ledgerSeq);
+    for (int i = 1; i <= n; i++) {
+        auto p = resultFor(ledgerSeq, i);
+        auto result = xdr::xdr_to_opaque(p);
+        history.addTransaction(p.transactionHash, i, result, result, result);
+        history.addTransactionFee(p.transactionHash, i,
+                                  xdr::xdr_to_opaque(LedgerEntryChanges{}));
+    }
+    REQUIRE(history.size() == 2 * n);
+    history.flush();
+    REQUIRE(history.size() == 0);
+
+    auto res = TransactionFrame::getTransactionHistoryResults(db, ledgerSeq);
+    REQUIRE(res.results.size() == n);
+    for (int i = 1; i <= n; i++) {
+        REQUIRE(res.results[i - 1] == resultFor(ledgerSeq, i));
+    }
+    auto fees = TransactionFrame::getTransactionFeeMeta(db, ledgerSeq);
+    REQUIRE(fees.size() == n);
+
+    // nothing buffered, nothing written
+    history.flush();
+    REQUIRE(TransactionFrame::getTransactionFeeMeta(db, ledgerSeq).size() ==
+            n);
+}
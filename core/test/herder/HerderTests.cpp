@@ -21,7 +21,12 @@
 #include "overlay/OverlayManager.h"
 #include "test/TxTests.h"
 
+#include "medida/counter.h"
+#include "medida/metrics_registry.h"
 #include "xdrpp/marshal.h"
+#include "util/format.h"
+#include <chrono>
+#include <thread>
 
 using namespace vixal;
 using namespace vixal::txtest;
@@ -278,6 +283,26 @@ TEST_CASE("txset", "[herder]") {
             REQUIRE(txSet->checkValid(*app));
         }
     }
+    SECTION("encoding and apply order are computed once") {
+        auto const &tx = transactions[0][0];
+        REQUIRE(tx->getEnvelopeXDR() == xdr::xdr_to_opaque(tx->getEnvelope()));
+        REQUIRE(tx->getFullHash() == sha256(xdr::xdr_to_opaque(tx->getEnvelope())));
+        REQUIRE(&tx->toVixalMessage() == &tx->toVixalMessage());
+        REQUIRE(tx->toVixalMessage().transaction() == tx->getEnvelope());
+
+        auto order = txSet->sortForApply();
+        REQUIRE(order.size() == nbAccounts * nbTransactions);
+        REQUIRE(txSet->sortForApply() == order);
+
+        TransactionSet xdrSet;
+        txSet->toXDR(xdrSet);
+        TxSetFrame fromWire(app->getNetworkID(), xdrSet);
+        REQUIRE(fromWire.getContentsHash() == txSet->getContentsHash());
+        REQUIRE(fromWire.sortForApply().size() == order.size());
+
+        txSet->add(accounts[0].tx({payment(root, paymentAmount)}));
+        REQUIRE(txSet->sortForApply().size() == order.size() + 1);
+    }
     SECTION("invalid tx") {
         SECTION("no user") {
             txSet->add(accounts[0].tx({payment(root, paymentAmount)}));
@@ -1045,3 +1070,306 @@ TEST_CASE("In quorum filtering", "[herder]") {
     });
 }
 
+
+TEST_CASE("transaction queue", "[herder][transactionqueue]") {
+    VirtualClock clock;
+    Application::pointer app = createTestApplication(clock, getTestConfig());
+    app->start();
+
+    auto root = TestAccount::createRoot(*app);
+    auto const balance = app->getLedgerManager().getMinBalance(0) * 10;
+    auto a1 = root.create("A", balance);
+    auto b1 = root.create("B", balance);
+    closeLedgerOn(*app, 2, 1, 1, 2016);
+
+    TransactionQueue queue(*app);
+    auto tx1 = a1.tx({payment(root, 100)});
+    auto tx2 = a1.tx({payment(root, 100)});
+    auto txB = b1.tx({payment(root, 100)});
+
+    SECTION("chains") {
+        REQUIRE(queue.tryAdd(tx1) == Herder::TX_STATUS_PENDING);
+        REQUIRE(queue.tryAdd(tx1) == Herder::TX_STATUS_DUPLICATE);
+        REQUIRE(queue.tryAdd(tx2) == Herder::TX_STATUS_PENDING);
+        REQUIRE(queue.tryAdd(txB) == Herder::TX_STATUS_PENDING);
+        REQUIRE(queue.size() == 3);
+        REQUIRE(queue.getMaxSeq(a1.getPublicKey()) == tx2->getSeqNum());
+
+        auto txSet = queue.toTxSet(
+                app->getLedgerManager().getLastClosedLedgerHeader().hash);
+        REQUIRE(txSet->size() == 3);
+        REQUIRE(txSet->checkValid(*app));
+    }
+
+    SECTION("gap in sequence numbers") {
+        REQUIRE(queue.tryAdd(tx2) == Herder::TX_STATUS_ERROR);
+        REQUIRE(queue.size() == 0);
+    }
+
+    SECTION("applied transactions are removed") {
+        REQUIRE(queue.tryAdd(tx1) == Herder::TX_STATUS_PENDING);
+        REQUIRE(queue.tryAdd(tx2) == Herder::TX_STATUS_PENDING);
+        REQUIRE(queue.tryAdd(txB) == Herder::TX_STATUS_PENDING);
+
+        closeLedgerOn(*app, 3, 1, 1, 2016, {tx1, txB});
+        queue.ledgerClosed({tx1, txB});
+        REQUIRE(queue.size() == 1);
+        REQUIRE(queue.getMaxSeq(a1.getPublicKey()) == tx2->getSeqNum());
+        REQUIRE(queue.getMaxSeq(b1.getPublicKey()) == 0);
+        REQUIRE(queue.countByAge()[1] == 1);
+    }
+
+    SECTION("transactions invalidated by the ledger are removed") {
+        REQUIRE(queue.tryAdd(tx1) == Herder::TX_STATUS_PENDING);
+        REQUIRE(queue.tryAdd(tx2) == Herder::TX_STATUS_PENDING);
+
+        // another transaction uses the sequence number of tx1
+        auto other = a1.tx({payment(root, 200)}, tx1->getSeqNum());
+        closeLedgerOn(*app, 3, 1, 1, 2016, {other});
+        queue.ledgerClosed({});
+        REQUIRE(queue.size() == 1);
+        REQUIRE(queue.getMaxSeq(a1.getPublicKey()) == tx2->getSeqNum());
+    }
+
+    SECTION("surge pricing takes the accounts paying the most") {
+        app->getLedgerManager().getCurrentLedgerHeader().maxTxSetSize = 2;
+        auto txB2 = b1.tx({payment(root, 100)});
+        txB->getEnvelope().tx.fee = txB->getEnvelope().tx.fee * 2;
+        txB2->getEnvelope().tx.fee = txB2->getEnvelope().tx.fee * 3;
+        REQUIRE(queue.tryAdd(tx1) == Herder::TX_STATUS_PENDING);
+        REQUIRE(queue.tryAdd(tx2) == Herder::TX_STATUS_PENDING);
+        REQUIRE(queue.tryAdd(txB) == Herder::TX_STATUS_PENDING);
+        REQUIRE(queue.tryAdd(txB2) == Herder::TX_STATUS_PENDING);
+
+        auto txSet = queue.toTxSet(
+                app->getLedgerManager().getLastClosedLedgerHeader().hash);
+        REQUIRE(txSet->size() == 2);
+        for (auto const &tx : txSet->mTransactions) {
+            REQUIRE(tx->getSourceID() == b1.getPublicKey());
+        }
+    }
+
+    SECTION("old transactions are dropped") {
+        REQUIRE(queue.tryAdd(tx1) == Herder::TX_STATUS_PENDING);
+        REQUIRE(queue.tryAdd(tx2) == Herder::TX_STATUS_PENDING);
+        for (uint32 i = 1; i < TransactionQueue::AGE_LIMIT; i++) {
+            queue.ledgerClosed({});
+            REQUIRE(queue.size() == 2);
+        }
+        queue.ledgerClosed({});
+        REQUIRE(queue.size() == 0);
+    }
+}
+
+TEST_CASE("transaction queue limits", "[herder][transactionqueue]") {
+    Config cfg(getTestConfig());
+    cfg.PENDING_TX_MAX_OPS = 2;
+    cfg.PENDING_TX_MAX_PER_ACCOUNT = 2;
+    VirtualClock clock;
+    Application::pointer app = createTestApplication(clock, cfg);
+    app->start();
+
+    auto root = TestAccount::createRoot(*app);
+    auto const balance = app->getLedgerManager().getMinBalance(0) * 10;
+    auto a1 = root.create("A", balance);
+    auto b1 = root.create("B", balance);
+    closeLedgerOn(*app, 2, 1, 1, 2016);
+
+    TransactionQueue queue(*app);
+    auto tx1 = a1.tx({payment(root, 100)});
+    auto tx2 = a1.tx({payment(root, 100)});
+    REQUIRE(queue.tryAdd(tx1) == Herder::TX_STATUS_PENDING);
+    REQUIRE(queue.tryAdd(tx2) == Herder::TX_STATUS_PENDING);
+    REQUIRE(queue.getBytes() > 0);
+
+    SECTION("per account limit") {
+        auto tx3 = a1.tx({payment(root, 100)});
+        REQUIRE(queue.tryAdd(tx3) == Herder::TX_STATUS_TRY_AGAIN_LATER);
+        REQUIRE(queue.size() == 2);
+    }
+
+    SECTION("full queue rejects transactions that don't pay more") {
+        auto txB = b1.tx({payment(root, 100)});
+        REQUIRE(queue.tryAdd(txB) == Herder::TX_STATUS_TRY_AGAIN_LATER);
+        REQUIRE(queue.size() == 2);
+    }
+
+    SECTION("full queue evicts the cheapest chains") {
+        auto txB = b1.tx({payment(root, 100)});
+        txB->getEnvelope().tx.fee = txB->getEnvelope().tx.fee * 2;
+        REQUIRE(queue.tryAdd(txB) == Herder::TX_STATUS_PENDING);
+        REQUIRE(queue.size() == 1);
+        REQUIRE(queue.getMaxSeq(a1.getPublicKey()) == 0);
+        REQUIRE(queue.getMaxSeq(b1.getPublicKey()) == txB->getSeqNum());
+        REQUIRE(queue.getBytes() == xdr::xdr_size(txB->getEnvelope()));
+    }
+
+    SECTION("a cheap chain can't evict chains paying more than it") {
+        TransactionQueue other(*app);
+        auto txB = b1.tx({payment(root, 100)});
+        txB->getEnvelope().tx.fee = txB->getEnvelope().tx.fee * 2;
+        tx2->getEnvelope().tx.fee = tx2->getEnvelope().tx.fee * 4;
+        REQUIRE(other.tryAdd(tx1) == Herder::TX_STATUS_PENDING);
+        REQUIRE(other.tryAdd(txB) == Herder::TX_STATUS_PENDING);
+
+        // tx2 pays more than txB, but the chain of A is still ranked by tx1
+        REQUIRE(other.tryAdd(tx2) == Herder::TX_STATUS_TRY_AGAIN_LATER);
+        REQUIRE(other.size() == 2);
+        REQUIRE(other.getMaxSeq(a1.getPublicKey()) == tx1->getSeqNum());
+        REQUIRE(other.getMaxSeq(b1.getPublicKey()) == txB->getSeqNum());
+    }
+}
+
+TEST_CASE("pending transactions rebroadcast", "[herder][transactionqueue]") {
+    auto networkID = sha256(getTestConfig().NETWORK_PASSPHRASE);
+    auto simulation =
+            std::make_shared<Simulation>(Simulation::OVER_LOOPBACK, networkID);
+
+    auto validatorKey = SecretKey::fromSeed(sha256("validator"));
+    auto listenerKey = SecretKey::fromSeed(sha256("listener"));
+
+    SCPQuorumSet qSet;
+    qSet.threshold = 1;
+    qSet.validators.push_back(validatorKey.getPublicKey());
+
+    auto validator = simulation->addNode(validatorKey, qSet);
+    auto listener = simulation->addNode(listenerKey, qSet);
+    simulation->addPendingConnection(validatorKey.getPublicKey(),
+                                     listenerKey.getPublicKey());
+    simulation->startAllNodes();
+    simulation->crankUntil(
+            [&]() { return simulation->haveAllExternalized(3, 1); },
+            std::chrono::seconds(20), false);
+
+    // only the listener knows about these, the validator hears about them
+    // when the listener rebroadcasts its pending transactions
+    auto root = TestAccount::createRoot(*listener);
+    auto const minBalance = listener->getLedgerManager().getMinBalance(0);
+    std::vector<TransactionFramePtr> txs;
+    for (int i = 0; i < 20; i++) {
+        auto dest = getAccount(fmt::format("A{}", i).c_str());
+        auto tx = root.tx({createAccount(dest.getPublicKey(), minBalance)});
+        REQUIRE(listener->getHerder().recvTransaction(tx) ==
+                Herder::TX_STATUS_PENDING);
+        txs.push_back(tx);
+    }
+
+    auto rootID = root.getPublicKey();
+    auto &validatorHerder = validator->getHerder();
+    auto validatorRoot = TestAccount::createRoot(*validator);
+    REQUIRE(validatorHerder.getMaxSeqInPendingTxs(rootID) == 0);
+
+    // the first tick after the listener closes a ledger only sends a batch
+    simulation->crankUntil(
+            [&]() { return validatorHerder.getMaxSeqInPendingTxs(rootID) != 0; },
+            std::chrono::seconds(10), false);
+    REQUIRE(validatorHerder.getMaxSeqInPendingTxs(rootID) <
+            txs.back()->getSeqNum());
+    auto rebroadcastLedger =
+            listener->getLedgerManager().getLastClosedLedgerNum();
+
+    // the rest follows on the next ticks
+    simulation->crankUntil(
+            [&]() {
+                return validatorHerder.getMaxSeqInPendingTxs(rootID) ==
+                               txs.back()->getSeqNum() ||
+                       validatorRoot.loadSequenceNumber() ==
+                               txs.back()->getSeqNum();
+            },
+            std::chrono::seconds(10), false);
+
+    // bytes rebroadcast are reported when the next ledger closes
+    simulation->crankUntil(
+            [&]() {
+                return listener->getLedgerManager().getLastClosedLedgerNum() >
+                       rebroadcastLedger;
+            },
+            std::chrono::seconds(10), false);
+    auto &bytes = listener->getMetrics().newCounter(
+            {"herder", "pending-txs", "rebroadcast-bytes"});
+    REQUIRE(bytes.count() >= static_cast<int64_t>(xdr::xdr_argpack_size(
+                                     txs[0]->toVixalMessage())));
+
+    simulation->stopAllNodes();
+}
+
+TEST_CASE("transaction queue surge pricing benchmarking",
+          "[herder-bench][bench][!hide]") {
+    size_t const accounts = 1000;
+    size_t const txsPerAccount = 100;
+    uint32 const maxTxSetSize = 1000;
+
+    VirtualClock clock;
+    Application::pointer app = createTestApplication(clock, getTestConfig());
+    app->start();
+    app->getLedgerManager().getCurrentLedgerHeader().maxTxSetSize =
+            maxTxSetSize;
+
+    auto root = TestAccount::createRoot(*app);
+    auto const balance = app->getLedgerManager().getMinBalance(0) * 100;
+    std::vector<TransactionFramePtr> txs;
+    for (size_t i = 0; i < accounts; i++) {
+        auto account = root.create(fmt::format("bench-{}", i), balance);
+        for (size_t j = 0; j < txsPerAccount; j++) {
+            auto tx = account.tx({payment(root, 100)});
+            tx->getEnvelope().tx.fee =
+                    tx->getEnvelope().tx.fee * static_cast<uint32>(1 + i % 7);
+            txs.emplace_back(tx);
+        }
+    }
+
+    TransactionQueue queue(*app);
+    auto start = std::chrono::steady_clock::now();
+    {
+        soci::transaction sqltx(app->getDatabase().getSession());
+        for (auto const &tx : txs) {
+            REQUIRE(queue.tryAdd(tx) == Herder::TX_STATUS_PENDING);
+        }
+    }
+    auto added = std::chrono::steady_clock::now();
+
+    auto const &lcl = app->getLedgerManager().getLastClosedLedgerHeader();
+    auto fromQueue = queue.toTxSet(lcl.hash);
+    auto selected = std::chrono::steady_clock::now();
+
+    TxSetFrame txSet(lcl.hash);
+    for (auto const &tx : txs) {
+        txSet.add(tx);
+    }
+    auto filterStart = std::chrono::steady_clock::now();
+    txSet.surgePricingFilter(app->getLedgerManager());
+    auto filtered = std::chrono::steady_clock::now();
+
+    REQUIRE(fromQueue->size() == maxTxSetSize);
+    REQUIRE(txSet.size() == maxTxSetSize);
+
+    auto ms = [](std::chrono::steady_clock::duration d) {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(d)
+                .count();
+    };
+    LOG(INFO) << txs.size() << " pending transactions: added in "
+              << ms(added - start) << "ms, queue selection in "
+              << ms(selected - added) << "ms, surgePricingFilter in "
+              << ms(filtered - filterStart) << "ms";
+}
+
+TEST_CASE("quorum intersection is checked in the background", "[herder][quorum]") {
+    VirtualClock clock;
+    Application::pointer app = createTestApplication(clock, getTestConfig());
+    app->start();
+    auto &herder = app->getHerder();
+
+    // the first request only starts a check
+    auto info = herder.getJsonQuorumIntersectionInfo();
+    REQUIRE(info["intersection"].asString() == "unknown");
+
+    // later ones get the last result, while starting another check
+    auto start = std::chrono::steady_clock::now();
+    while (herder.getJsonQuorumIntersectionInfo()["intersection"].isString()) {
+        REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::seconds(10));
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    info = herder.getJsonQuorumIntersectionInfo();
+    REQUIRE(info["intersection"].asBool());
+    REQUIRE(info["node_count"].asUInt64() == 1);
+}
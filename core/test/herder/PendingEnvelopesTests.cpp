@@ -181,6 +181,33 @@ TEST_CASE("PendingEnvelopes::recvSCPEnvelope", "[herder]") {
                 Herder::ENVELOPE_STATUS_PROCESSED);
     }
 
+    SECTION("envelopes are forgotten with their slot") {
+        pendingEnvelopes.addSCPQuorumSet(saneQSetHash, saneQSet);
+        pendingEnvelopes.addTxSet(p.second->getContentsHash(), 0, p.second);
+        auto &held = app->getMetrics().newCounter(
+                {"scp", "memory", "held-envelopes"});
+        auto &ready = app->getMetrics().newCounter(
+                {"scp", "memory", "pending-envelopes"});
+
+        REQUIRE(pendingEnvelopes.recvSCPEnvelope(saneEnvelope) ==
+                Herder::ENVELOPE_STATUS_READY);
+        // processed and ready
+        REQUIRE(held.count() == 2);
+        REQUIRE(ready.count() == 1);
+
+        SCPEnvelope popped;
+        REQUIRE(pendingEnvelopes.pop(saneEnvelope.statement.slotIndex, popped));
+        REQUIRE(held.count() == 1);
+        REQUIRE(ready.count() == 0);
+
+        pendingEnvelopes.eraseBelow(lcl.header.ledgerSeq + 2);
+        REQUIRE(held.count() == 0);
+        REQUIRE(pendingEnvelopes.recvSCPEnvelope(saneEnvelope) ==
+                Herder::ENVELOPE_STATUS_READY);
+        REQUIRE(held.count() == 2);
+        REQUIRE(ready.count() == 1);
+    }
+
     SECTION("return DISCARDED when receiving envelope with too big quorum set") {
         REQUIRE(pendingEnvelopes.recvSCPEnvelope(bigEnvelope) ==
                 Herder::ENVELOPE_STATUS_FETCHING);
@@ -7,16 +7,23 @@
 #include "bucket/BucketManager.h"
 #include "catchup/CatchupConfiguration.h"
 #include "catchup/CatchupWork.h"
+#include "crypto/Hex.h"
+#include "crypto/Random.h"
+#include "database/Database.h"
 #include "../catchup/CatchupWorkTests.h"
 #include "herder/LedgerCloseData.h"
+#include "history/HistoryArchiveBackend.h"
 #include "history/HistoryArchiveManager.h"
 #include "history/HistoryTestsUtils.h"
+#include "http/HttpClient.h"
 #include "historywork/GetHistoryArchiveStateWork.h"
 #include "historywork/GunzipFileWork.h"
 #include "historywork/GzipFileWork.h"
 #include "historywork/PutHistoryArchiveStateWork.h"
 #include "ledger/CheckpointRange.h"
 #include "ledger/LedgerManager.h"
+#include "medida/meter.h"
+#include "medida/metrics_registry.h"
 #include "catch.hpp"
 #include "application/ExternalQueue.h"
 #include "application/PersistentState.h"
@@ -25,11 +32,17 @@
 #include "test/TestUtils.h"
 #include "test/TxTests.h"
 #include "test/test.h"
+#include "transactions/TransactionFrame.h"
 #include "util/Fs.h"
+#include "util/TmpDir.h"
+#include "util/XDRStream.h"
 #include "work/WorkManager.h"
 
 #include <util/format.h>
 #include <xdrpp/autocheck.h>
+#include <atomic>
+#include <fstream>
+#include <thread>
 
 using namespace vixal;
 using namespace historytestutils;
@@ -494,6 +507,333 @@ TEST_CASE("Publish/catchup via s3", "[!hide][s3]") {
             Config::TESTDB_IN_MEMORY_SQLITE, "s3");
 }
 
+namespace {
+class StreamingHistoryConfigurator : public TmpDirHistoryConfigurator {
+public:
+    Config &
+    configure(Config &cfg, bool writable) const override {
+        cfg.HISTORY_STREAMING_PUBLISH = true;
+        return TmpDirHistoryConfigurator::configure(cfg, writable);
+    }
+};
+}
+
+TEST_CASE("History publish written as ledgers close",
+          "[history][historycatchup]") {
+    CatchupSimulation catchupSimulation{
+            std::make_shared<StreamingHistoryConfigurator>()};
+
+    catchupSimulation.generateAndPublishInitialHistory(3);
+
+    // the first checkpoint starts with the genesis ledger, which isn't closed
+    auto &streamed = catchupSimulation.getApp().getMetrics().newMeter(
+            {"history", "publish", "streamed"}, "event");
+    REQUIRE(streamed.count() == 2);
+
+    auto app2 = catchupSimulation.catchupNewApplication(
+            catchupSimulation.getApp().getLedgerManager().getCurrentLedgerHeader().ledgerSeq,
+            std::numeric_limits<uint32_t>::max(), false,
+            Config::TESTDB_IN_MEMORY_SQLITE, "streamed");
+}
+
+namespace {
+// serves the files of a directory over HTTP/1.1 from its own thread, keeping
+// connections open, with the body sent in chunks if asked to, or never
+// answering when stalled
+class ArchiveHttpServer {
+    struct Connection : std::enable_shared_from_this<Connection> {
+        ArchiveHttpServer &mServer;
+        asio::ip::tcp::socket mSocket;
+        asio::streambuf mRequest;
+        std::string mReply;
+
+        Connection(ArchiveHttpServer &server)
+                : mServer(server), mSocket(server.mIoContext) {
+        }
+
+        void
+        read() {
+            auto self = shared_from_this();
+            asio::async_read_until(
+                    mSocket, mRequest, "\r\n\r\n",
+                    [self](asio::error_code ec, size_t) {
+                        if (ec) {
+                            return;
+                        }
+                        std::istream in(&self->mRequest);
+                        std::string method, path, line;
+                        in >> method >> path;
+                        while (std::getline(in, line) && line != "\r") {
+                        }
+                        if (self->mServer.mStalled) {
+                            // keeps the connection open without replying
+                            self->mServer.mStalledConnections.push_back(self);
+                            return;
+                        }
+                        self->mReply = self->mServer.reply(path);
+                        asio::async_write(self->mSocket, asio::buffer(self->mReply),
+                                          [self](asio::error_code ec, size_t) {
+                                              if (!ec) {
+                                                  self->read();
+                                              }
+                                          });
+                    });
+        }
+    };
+
+    std::string const mRoot;
+    asio::io_context mIoContext;
+    asio::ip::tcp::acceptor mAcceptor;
+    std::thread mThread;
+    std::atomic<size_t> mConnections{0};
+    std::atomic<size_t> mRequests{0};
+    std::atomic<bool> mChunked{false};
+    std::atomic<bool> mStalled{false};
+    std::vector<std::shared_ptr<Connection>> mStalledConnections;
+
+    void
+    accept() {
+        auto conn = std::make_shared<Connection>(*this);
+        mAcceptor.async_accept(conn->mSocket, [this, conn](asio::error_code ec) {
+            if (ec) {
+                return;
+            }
+            ++mConnections;
+            conn->read();
+            accept();
+        });
+    }
+
+    std::string
+    reply(std::string const &path) {
+        ++mRequests;
+        std::ifstream in(mRoot + path, std::ifstream::binary);
+        if (!in) {
+            return "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+        }
+        std::string body{std::istreambuf_iterator<char>(in),
+                         std::istreambuf_iterator<char>()};
+        if (!mChunked) {
+            return "HTTP/1.1 200 OK\r\nContent-Length: " +
+                   std::to_string(body.size()) + "\r\n\r\n" + body;
+        }
+        std::string res = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n";
+        for (size_t i = 0; i < body.size(); i += 1000) {
+            auto chunk = body.substr(i, 1000);
+            std::ostringstream size;
+            size << std::hex << chunk.size();
+            res += size.str() + "\r\n" + chunk + "\r\n";
+        }
+        return res + "0\r\n\r\n";
+    }
+
+public:
+    explicit ArchiveHttpServer(std::string const &root)
+            : mRoot(root), mAcceptor(mIoContext, asio::ip::tcp::endpoint(
+                    asio::ip::make_address("127.0.0.1"), 0)) {
+        accept();
+        mThread = std::thread([this]() { mIoContext.run(); });
+    }
+
+    ~ArchiveHttpServer() {
+        mIoContext.stop();
+        mThread.join();
+    }
+
+    std::string
+    getUrl() const {
+        return "http://127.0.0.1:" + std::to_string(getPort());
+    }
+
+    unsigned short
+    getPort() const {
+        return mAcceptor.local_endpoint().port();
+    }
+
+    size_t
+    getConnections() const {
+        return mConnections;
+    }
+
+    size_t
+    getRequests() const {
+        return mRequests;
+    }
+
+    void
+    setChunked(bool chunked) {
+        mChunked = chunked;
+    }
+
+    void
+    setStalled(bool stalled) {
+        mStalled = stalled;
+    }
+};
+
+// publishes to the archive directory in process, and catches up from it over
+// http
+class InProcessHistoryConfigurator : public TmpDirHistoryConfigurator {
+    std::unique_ptr<ArchiveHttpServer> mServer;
+
+public:
+    InProcessHistoryConfigurator()
+            : mServer(std::make_unique<ArchiveHttpServer>(getArchiveDirName())) {
+    }
+
+    Config &
+    configure(Config &cfg, bool writable) const override {
+        if (writable) {
+            cfg.HISTORY["test"] = HistoryArchiveConfiguration{
+                    "test", "", "", "", getArchiveDirName(), ""};
+        } else {
+            cfg.HISTORY["test"] = HistoryArchiveConfiguration{
+                    "test", "", "", "", "", mServer->getUrl()};
+        }
+        return cfg;
+    }
+
+    ArchiveHttpServer &
+    getServer() const {
+        return *mServer;
+    }
+};
+}
+
+TEST_CASE("http history archive backend", "[history]") {
+    TmpDirManager tdm("http-backend-" + binToHex(randomBytes(8)));
+    auto dir = tdm.tmpDir("archive");
+    std::string content;
+    for (int i = 0; i < 5000; i++) {
+        content += std::to_string(i);
+    }
+    {
+        std::ofstream out(dir.getName() + "/file.txt", std::ofstream::binary);
+        out << content;
+    }
+
+    ArchiveHttpServer server(dir.getName());
+    auto backend = HistoryArchiveBackend::create(HistoryArchiveConfiguration{
+            "test", "", "", "", "", server.getUrl() + "/"});
+    REQUIRE(backend);
+    REQUIRE(!backend->canPut());
+    auto local = dir.getName() + "/local.txt";
+
+    auto check = [&]() {
+        REQUIRE(backend->getFile("file.txt", local));
+        std::ifstream in(local, std::ifstream::binary);
+        std::string got{std::istreambuf_iterator<char>(in),
+                        std::istreambuf_iterator<char>()};
+        REQUIRE(got == content);
+    };
+
+    SECTION("files are fetched over one connection") {
+        for (int i = 0; i < 3; i++) {
+            check();
+        }
+        REQUIRE(server.getRequests() == 3);
+        REQUIRE(server.getConnections() == 1);
+    }
+
+    SECTION("chunked responses") {
+        server.setChunked(true);
+        check();
+        check();
+        REQUIRE(server.getConnections() == 1);
+    }
+
+    SECTION("missing files fail") {
+        REQUIRE(!backend->getFile("missing.txt", local));
+        REQUIRE(!fs::exists(local));
+        check();
+    }
+
+    SECTION("requests to a stalled server time out") {
+        HttpKeepAliveClient client("127.0.0.1", server.getPort(), 1,
+                                   std::chrono::milliseconds(200));
+        server.setStalled(true);
+        auto start = std::chrono::steady_clock::now();
+        REQUIRE(client.getToFile("/file.txt", local) != 200);
+        REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+
+        server.setStalled(false);
+        REQUIRE(client.getToFile("/file.txt", local) == 200);
+        REQUIRE(client.getConnectionsOpened() == 2);
+    }
+}
+
+TEST_CASE("History catchup with in-process archive backends",
+          "[history][historycatchup]") {
+    auto configurator = std::make_shared<InProcessHistoryConfigurator>();
+    CatchupSimulation catchupSimulation{configurator};
+
+    catchupSimulation.generateAndPublishInitialHistory(3);
+    REQUIRE(configurator->getServer().getRequests() == 0);
+
+    auto app2 = catchupSimulation.catchupNewApplication(
+            catchupSimulation.getApp().getLedgerManager().getCurrentLedgerHeader().ledgerSeq,
+            std::numeric_limits<uint32_t>::max(), false,
+            Config::TESTDB_IN_MEMORY_SQLITE, "http");
+
+    // connections are kept open from one file to the next
+    auto &server = configurator->getServer();
+    REQUIRE(server.getConnections() < server.getRequests());
+}
+
+TEST_CASE("History publish benchmarking", "[history][bench][!hide]") {
+    // size of the stored history and time to stream it out per checkpoint;
+    // base64 sizes are those of the TEXT columns used before schema 8
+    CatchupSimulation catchupSimulation{};
+    size_t const checkpoints = 10;
+    catchupSimulation.generateAndPublishInitialHistory(checkpoints);
+
+    auto &app = catchupSimulation.getApp();
+    auto &db = app.getDatabase();
+    auto &sess = db.getSession();
+
+    size_t rows = 0, bytes = 0, base64Bytes = 0;
+    {
+        BlobValue body(db, sess), result(db, sess), meta(db, sess);
+        auto prep = db.getPreparedStatement(
+                "SELECT txbody, txresult, txmeta FROM txhistory");
+        auto &st = prep.statement();
+        body.into(st);
+        result.into(st);
+        meta.into(st);
+        st.define_and_bind();
+        st.execute(true);
+        while (st.got_data()) {
+            for (auto blob : {&body, &result, &meta}) {
+                auto size = blob->get().size();
+                bytes += size;
+                base64Bytes += (size + 2) / 3 * 4;
+            }
+            ++rows;
+            st.fetch();
+        }
+    }
+
+    auto freq = app.getHistoryManager().getCheckpointFrequency();
+    auto dir = app.getTmpDirManager().tmpDir("bench");
+    std::chrono::microseconds elapsed{0};
+    for (uint32_t c = 0; c < checkpoints; c++) {
+        XDROutputFileStream txOut, txResultOut;
+        txOut.open(dir.getName() + "/tx.xdr");
+        txResultOut.open(dir.getName() + "/res.xdr");
+        auto start = std::chrono::steady_clock::now();
+        TransactionFrame::copyTransactionsToStream(app.getNetworkID(), db,
+                                                   sess, c * freq, freq, txOut,
+                                                   txResultOut);
+        elapsed += std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start);
+    }
+
+    LOG(INFO) << rows << " transactions stored in " << bytes << " bytes ("
+              << base64Bytes << " as base64), "
+              << elapsed.count() / checkpoints
+              << "us to stream out a checkpoint";
+}
+
 TEST_CASE("persist publish queue", "[history]") {
     Config cfg(getTestConfig(0, Config::TESTDB_ON_DISK_SQLITE));
     cfg.MAX_CONCURRENT_SUBPROCESSES = 0;
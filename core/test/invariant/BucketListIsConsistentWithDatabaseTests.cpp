@@ -479,6 +479,31 @@ TEST_CASE("BucketListIsConsistentWithDatabase succeed",
             applyBucketsAndCrankUntilDone(appGenerate, appApply, ledgerSeq));
 }
 
+TEST_CASE("BucketListIsConsistentWithDatabase succeed over several batches",
+          "[invariant][bucketlistconsistent]") {
+    // buckets with more entries of a type than a batch compared at once,
+    // compared in parallel when the database has a pool
+    auto test = [](Config::TestDbMode mode) {
+        std::default_random_engine gen;
+        VirtualClock clock;
+        Application::pointer appGenerate =
+                createTestApplication(clock, getTestConfig(0, mode));
+        Application::pointer appApply =
+                createTestApplication(clock, getTestConfig(1, mode));
+        uint32_t ledgerSeq = generateLedgers(
+                appGenerate, 2, 100, 50, generateValidEntryFrames, 10,
+                std::bind(deleteRandomLedgerEntries, _1, _2, std::ref(gen)));
+        REQUIRE_NOTHROW(applyBucketsAndCrankUntilDone(appGenerate, appApply,
+                                                      ledgerSeq));
+    };
+    SECTION("sqlite in memory") {
+        test(Config::TESTDB_IN_MEMORY_SQLITE);
+    }
+    SECTION("sqlite on disk") {
+        test(Config::TESTDB_ON_DISK_SQLITE);
+    }
+}
+
 TEST_CASE("BucketListIsConsistentWithDatabase empty ledgers",
           "[invariant][bucketlistconsistent]") {
     VirtualClock clock;
@@ -24,8 +24,9 @@ namespace InvariantTests {
 
 class TestInvariant : public Invariant {
 public:
-    TestInvariant(int id, bool shouldFail)
-            : Invariant(true), mInvariantID(id), mShouldFail(shouldFail) {
+    TestInvariant(int id, bool shouldFail, bool background = false)
+            : Invariant(true), mInvariantID(id), mShouldFail(shouldFail),
+              mBackground(background) {
     }
 
     // if id < 0, generate prefix that will match any invariant
@@ -59,9 +60,15 @@ public:
     }
 
 
+    bool
+    canCheckInBackground() const override {
+        return mBackground;
+    }
+
 private:
     int mInvariantID;
     bool mShouldFail;
+    bool mBackground;
 };
 }
 
@@ -193,4 +200,39 @@ TEST_CASE("onOperationApply fail/succeed", "[invariant]") {
     }
 }
 
+TEST_CASE("onOperationApply in the background", "[invariant]") {
+    VirtualClock clock;
+    Config cfg = getTestConfig();
+    cfg.INVARIANT_CHECKS_ASYNC = true;
+    cfg.INVARIANT_CHECKS_MAX_LAG = 0;
+    Application::pointer app = createTestApplication(clock, cfg);
+    auto &im = app->getInvariantManager();
+
+    OperationResult res;
+    LedgerHeader lh(app->getLedgerManager().getCurrentLedgerHeader());
+    LedgerDelta ld(lh, app->getDatabase());
+    auto ledger = ld.getHeader().ledgerSeq;
+
+    SECTION("Fail") {
+        im.registerInvariant<TestInvariant>(0, true, true);
+        im.enableInvariant(TestInvariant::toString(0, true));
+        // reported when the ledger is committed
+        REQUIRE_NOTHROW(im.checkOnOperationApply({}, res, ld));
+        REQUIRE_THROWS_AS(im.checkOnLedgerCommit(ledger), InvariantDoesNotHold);
+        REQUIRE_NOTHROW(im.checkOnLedgerCommit(ledger));
+    }
+    SECTION("Succeed") {
+        im.registerInvariant<TestInvariant>(0, false, true);
+        im.enableInvariant(TestInvariant::toString(0, false));
+        REQUIRE_NOTHROW(im.checkOnOperationApply({}, res, ld));
+        REQUIRE_NOTHROW(im.checkOnLedgerCommit(ledger));
+    }
+    SECTION("Invariants that can't are checked right away") {
+        im.registerInvariant<TestInvariant>(0, true);
+        im.enableInvariant(TestInvariant::toString(0, true));
+        REQUIRE_THROWS_AS(im.checkOnOperationApply({}, res, ld),
+                          InvariantDoesNotHold);
+    }
+}
+
 
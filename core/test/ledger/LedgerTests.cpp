@@ -7,19 +7,25 @@
 #include "ledger/LedgerTestUtils.h"
 #include "ledger/AccountFrame.h"
 #include "ledger/EntryFrame.h"
+#include "ledger/LedgerCloseTrace.h"
 #include "ledger/LedgerDelta.h"
+#include "ledger/LedgerManager.h"
 
 #include "application/Application.h"
 #include "application/Config.h"
 #include "test/test.h"
+#include "test/TestAccount.h"
+#include "test/TxTests.h"
 #include "test/TestUtils.h"
 #include "util/Logging.h"
 #include "util/Timer.h"
 #include "util/types.h"
 #include "catch.hpp"
+#include <json/json.h>
 #include <xdrpp/autocheck.h>
 
 using namespace vixal;
+using namespace vixal::txtest;
 
 TEST_CASE("Ledger entry db lifecycle", "[ledger]") {
     Config cfg(getTestConfig());
@@ -155,3 +161,68 @@ TEST_CASE("cannot close ledger with unsupported ledger version", "[ledger]") {
             app->getLedgerManager(), Config::CURRENT_LEDGER_PROTOCOL_VERSION + 1);
     REQUIRE_THROWS_AS(applyEmptyLedger(), std::runtime_error);
 }
+
+TEST_CASE("ledger close trace", "[ledger][closetrace]") {
+    SECTION("ring") {
+        LedgerCloseTrace trace;
+        auto n = LedgerCloseTrace::CAPACITY + 5;
+        for (uint32_t i = 1; i <= n; i++) {
+            trace.beginLedger(i);
+            {
+                LedgerCloseTrace::Span span(trace, LedgerCloseTrace::PHASE_APPLY);
+                trace.addOperation(PAYMENT, std::chrono::microseconds(i));
+            }
+            trace.endLedger(1);
+        }
+        // outside of a ledger
+        trace.addOperation(PAYMENT, std::chrono::seconds(1));
+        REQUIRE(trace.size() == LedgerCloseTrace::CAPACITY);
+
+        auto all = trace.getJsonInfo(n);
+        REQUIRE(all["ledger"].size() == LedgerCloseTrace::CAPACITY);
+        REQUIRE(all["ledger"][0].asUInt() == 6);
+        REQUIRE(all["phases"]["apply"].size() == LedgerCloseTrace::CAPACITY);
+
+        auto last = trace.getJsonInfo(2);
+        REQUIRE(last["ledger"].size() == 2);
+        REQUIRE(last["ledger"][0].asUInt() == n - 1);
+        REQUIRE(last["ledger"][1].asUInt() == n);
+        REQUIRE(last["ops"][1].asUInt() == 1);
+        REQUIRE(last["operations"]["PAYMENT"]["count"][1].asUInt() == 1);
+        REQUIRE(last["operations"]["PAYMENT"]["time"][1].asUInt64() == n);
+        REQUIRE(!last["operations"].isMember("CREATE_ACCOUNT"));
+    }
+
+    SECTION("closing ledgers") {
+        VirtualClock clock;
+        Application::pointer app = createTestApplication(clock, getTestConfig());
+        app->start();
+
+        auto root = TestAccount::createRoot(*app);
+        auto minBalance = app->getLedgerManager().getMinBalance(0);
+        auto tx = root.tx({createAccount(getAccount("a").getPublicKey(), minBalance),
+                           createAccount(getAccount("b").getPublicKey(), minBalance)});
+        closeLedgerOn(*app, 2, 1, 1, 2016, {tx});
+        closeLedgerOn(*app, 3, 2, 1, 2016);
+
+        auto info = app->getLedgerManager().getCloseTrace().getJsonInfo(10);
+        REQUIRE(info["ledger"].size() == 2);
+        REQUIRE(info["ledger"][0].asUInt() == 2);
+        REQUIRE(info["ledger"][1].asUInt() == 3);
+        REQUIRE(info["txs"][0].asUInt() == 1);
+        REQUIRE(info["txs"][1].asUInt() == 0);
+        REQUIRE(info["ops"][0].asUInt() == 2);
+        REQUIRE(info["phases"]["store"].size() == 2);
+        REQUIRE(info["operations"]["CREATE_ACCOUNT"]["count"][0].asUInt() == 2);
+        REQUIRE(info["operations"]["CREATE_ACCOUNT"]["count"][1].asUInt() == 0);
+
+        // the phases add up to at most the whole close
+        for (Json::ArrayIndex i = 0; i < 2; i++) {
+            uint64_t phases = 0;
+            for (auto const &name : info["phases"].getMemberNames()) {
+                phases += info["phases"][name][i].asUInt64();
+            }
+            REQUIRE(phases <= info["total"][i].asUInt64());
+        }
+    }
+}
@@ -8,6 +8,8 @@
 
 #include "database/Database.h"
 #include "catch.hpp"
+#include "crypto/SHA.h"
+#include "herder/Herder.h"
 #include "overlay/OverlayManager.h"
 #include "../src/overlay/OverlayManagerImpl.h"
 #include "test/TestAccount.h"
@@ -16,6 +18,7 @@
 #include "test/TestUtils.h"
 #include "transactions/TransactionFrame.h"
 #include "util/Timer.h"
+#include "xdrpp/marshal.h"
 #include <soci/soci.h>
 
 using namespace vixal;
@@ -60,7 +63,7 @@ public:
     connectTo(PeerRecord &pr) override {
         if (!getConnectedPeer(pr.getAddress())) {
             pr.backOff(mApp.getClock());
-            pr.storePeerRecord(mApp.getDatabase());
+            getPeerManager().store(pr);
 
             auto peerStub = std::make_shared<PeerStub>(mApp, pr.getAddress());
             addPendingPeer(peerStub);
@@ -112,6 +115,7 @@ protected:
         OverlayManagerStub &pm = app->getOverlayManager();
 
         pm.storePeerList(fourPeers, false, false);
+        pm.getPeerManager().flush();
 
         rowset<row> rs = app->getDatabase().getSession().prepare
                 << "SELECT ip,port FROM peers ORDER BY nextattempt";
@@ -153,16 +157,149 @@ protected:
                 pm.recvFloodedMsg(AtoC, p.second);
             }
         }
-        pm.broadcastMessage(AtoC, false);
+        REQUIRE(pm.broadcastMessage(AtoC, false) == 4);
         vector<int> expected{1, 1, 0, 1, 1};
         REQUIRE(sentCounts(pm) == expected);
-        pm.broadcastMessage(AtoC, false);
+        REQUIRE(pm.broadcastMessage(AtoC, false) == 0);
         REQUIRE(sentCounts(pm) == expected);
         VixalMessage CtoD = c.tx({payment(d, 10)})->toVixalMessage();
-        pm.broadcastMessage(CtoD, false);
+        REQUIRE(pm.broadcastMessage(CtoD, false) == 5);
         vector<int> expectedFinal{2, 2, 1, 2, 2};
         REQUIRE(sentCounts(pm) == expectedFinal);
     }
+
+    void
+    test_forcedBroadcast() {
+        OverlayManagerStub &pm = app->getOverlayManager();
+
+        pm.storePeerList(fourPeers, false, false);
+        pm.storePeerList(threePeers, false, false);
+        pm.tick();
+        REQUIRE(pm.mAuthenticatedPeers.size() == 5);
+        auto a = TestAccount{*app, getAccount("a")};
+        auto b = TestAccount{*app, getAccount("b")};
+
+        VixalMessage AtoB = a.tx({payment(b, 10)})->toVixalMessage();
+        pm.recvFloodedMsg(AtoB, pm.mAuthenticatedPeers.begin()->second);
+        REQUIRE(pm.broadcastMessage(AtoB, false) == 4);
+        REQUIRE(pm.broadcastMessage(AtoB, false) == 0);
+
+        // peers already told, and the one it came from, get it again
+        REQUIRE(pm.broadcastMessage(AtoB, true) == 5);
+        vector<int> expected{1, 2, 2, 2, 2};
+        REQUIRE(sentCounts(pm) == expected);
+        REQUIRE(pm.broadcastMessage(AtoB, false) == 0);
+    }
+
+    void
+    test_floodRecordsExpire() {
+        OverlayManagerStub &pm = app->getOverlayManager();
+
+        pm.storePeerList(fourPeers, false, false);
+        pm.storePeerList(threePeers, false, false);
+        pm.tick();
+        REQUIRE(pm.mAuthenticatedPeers.size() == 5);
+        auto a = TestAccount{*app, getAccount("a")};
+        auto b = TestAccount{*app, getAccount("b")};
+
+        VixalMessage AtoB = a.tx({payment(b, 10)})->toVixalMessage();
+        Hash h = sha256(xdr::xdr_to_opaque(AtoB));
+        REQUIRE(pm.getPeersKnows(h).empty());
+
+        pm.broadcastMessage(AtoB, false);
+        REQUIRE(pm.getPeersKnows(h).size() == 5);
+
+        auto ledger = app->getHerder().getCurrentLedgerSeq();
+        pm.ledgerClosed(ledger + 10);
+        REQUIRE(pm.getPeersKnows(h).size() == 5);
+
+        // the whole generation is dropped, so the message floods again
+        pm.ledgerClosed(ledger + 11);
+        REQUIRE(pm.getPeersKnows(h).empty());
+        pm.broadcastMessage(AtoB, false);
+        vector<int> expected{2, 2, 2, 2, 2};
+        REQUIRE(sentCounts(pm) == expected);
+    }
+
+    void
+    test_recvTransaction() {
+        OverlayManagerStub &pm = app->getOverlayManager();
+
+        pm.storePeerList(fourPeers, false, false);
+        pm.tick();
+        REQUIRE(pm.mAuthenticatedPeers.size() == 4);
+        auto root = TestAccount::createRoot(*app);
+        auto a = TestAccount{*app, getAccount("a")};
+
+        // enough transactions from one account that workers are likely to
+        // complete out of order
+        std::vector<TransactionFramePtr> txs;
+        for (int i = 0; i < 20; i++) {
+            txs.emplace_back(root.tx({payment(a, 10)}));
+        }
+        auto sender = pm.mAuthenticatedPeers.begin()->second;
+        for (auto const &tx : txs) {
+            pm.recvTransaction(tx->toVixalMessage(), sender);
+        }
+        REQUIRE(app->getHerder().getMaxSeqInPendingTxs(root) == 0);
+
+        while (pm.mTxIngestQueue->size() != 0) {
+            clock.crank(false);
+        }
+
+        // all were accepted, so none was handed to the herder out of order
+        REQUIRE(app->getHerder().getMaxSeqInPendingTxs(root) ==
+                txs.back()->getSeqNum());
+        // flooded to everybody but the sender
+        vector<int> expected;
+        for (auto p : pm.mAuthenticatedPeers) {
+            expected.push_back(p.second == sender ? 0 : 20);
+        }
+        REQUIRE(sentCounts(pm) == expected);
+    }
+
+    void
+    test_recvSCPMessage() {
+        OverlayManagerStub &pm = app->getOverlayManager();
+
+        pm.storePeerList(fourPeers, false, false);
+        pm.tick();
+        REQUIRE(pm.mAuthenticatedPeers.size() == 4);
+        auto sender = pm.mAuthenticatedPeers.begin()->second;
+
+        // envelopes for a slot the herder ignores, only the flood gate
+        // records which ones made it through
+        std::vector<VixalMessage> msgs;
+        for (int i = 0; i < 10; i++) {
+            auto key = SecretKey::random();
+            VixalMessage msg;
+            msg.type(SCP_MESSAGE);
+            auto &envelope = msg.envelope();
+            envelope.statement.nodeID = key.getPublicKey();
+            envelope.statement.slotIndex = 0;
+            envelope.signature = key.sign(xdr::xdr_to_opaque(
+                    app->getNetworkID(), ENVELOPE_TYPE_SCP, envelope.statement));
+            if (i % 3 == 0) {
+                envelope.signature[0] ^= 1;
+            }
+            msgs.emplace_back(msg);
+        }
+        for (auto const &msg : msgs) {
+            pm.recvSCPMessage(msg, sender);
+        }
+        for (auto const &msg : msgs) {
+            REQUIRE(pm.getPeersKnows(sha256(xdr::xdr_to_opaque(msg))).empty());
+        }
+
+        while (pm.mSCPIngestQueue->size() != 0) {
+            clock.crank(false);
+        }
+
+        for (size_t i = 0; i < msgs.size(); i++) {
+            auto knows = pm.getPeersKnows(sha256(xdr::xdr_to_opaque(msgs[i])));
+            REQUIRE(knows.size() == (i % 3 == 0 ? 0 : 1));
+        }
+    }
 };
 
 TEST_CASE_METHOD(OverlayManagerTests, "addPeerList() adds", "[overlay]") {
@@ -173,4 +310,20 @@ TEST_CASE_METHOD(OverlayManagerTests, "broadcast() broadcasts", "[overlay]") {
     test_broadcast();
 }
 
+TEST_CASE_METHOD(OverlayManagerTests, "forced broadcast reaches peers already told", "[overlay][flood]") {
+    test_forcedBroadcast();
+}
+
+TEST_CASE_METHOD(OverlayManagerTests, "flood records expire by generation", "[overlay][flood]") {
+    test_floodRecordsExpire();
+}
+
+TEST_CASE_METHOD(OverlayManagerTests, "transactions from peers are verified in the background", "[overlay]") {
+    test_recvTransaction();
+}
+
+TEST_CASE_METHOD(OverlayManagerTests, "SCP envelopes from peers are verified in the background", "[overlay]") {
+    test_recvSCPMessage();
+}
+
 }
@@ -3,6 +3,8 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "overlay/PeerRecord.h"
+#include "overlay/OverlayManager.h"
+#include "overlay/PeerManager.h"
 #include "overlay/PeerBareAddress.h"
 #include "database/Database.h"
 #include "catch.hpp"
@@ -67,6 +69,59 @@ TEST_CASE("toXdr", "[overlay][PeerRecord]") {
     }
 }
 
+TEST_CASE("peer manager", "[overlay][PeerRecord]") {
+    VirtualClock clock;
+    Application::pointer app = createTestApplication(clock, getTestConfig());
+    auto &db = app->getDatabase();
+    auto &pm = app->getOverlayManager().getPeerManager();
+    auto now = clock.now();
+
+    PeerRecord a(PeerBareAddress{"1.2.3.4", 15}, now + chrono::seconds(10));
+    PeerRecord b(PeerBareAddress{"1.2.3.5", 15}, now, 2);
+    PeerRecord c(PeerBareAddress{"1.2.3.6", 15}, now, 1);
+    PeerRecord d(PeerBareAddress{"1.2.3.7", 15}, now + chrono::seconds(100));
+    for (auto const &pr : {a, b, c, d}) {
+        REQUIRE(pm.insertIfNew(pr));
+    }
+    REQUIRE(!pm.insertIfNew(a));
+    REQUIRE(pm.size() == 4);
+
+    SECTION("candidates are ordered by next attempt and failures") {
+        std::vector<PeerRecord> peers;
+        pm.loadPeerRecords(now + chrono::seconds(10), [&](PeerRecord const &pr) {
+            peers.push_back(pr);
+            return true;
+        });
+        REQUIRE(peers == (std::vector<PeerRecord>{c, b, a}));
+
+        b.mNextAttempt = now + chrono::seconds(20);
+        pm.store(b);
+        peers.clear();
+        pm.loadPeerRecords(now + chrono::seconds(20), [&](PeerRecord const &pr) {
+            peers.push_back(pr);
+            return peers.size() < 2;
+        });
+        REQUIRE(peers == (std::vector<PeerRecord>{c, a}));
+    }
+
+    SECTION("changes are written on flush") {
+        REQUIRE(!PeerRecord::loadPeerRecord(db, a.getAddress()));
+        pm.flush();
+        REQUIRE(*PeerRecord::loadPeerRecord(db, a.getAddress()) == a);
+        REQUIRE(*PeerRecord::loadPeerRecord(db, d.getAddress()) == d);
+
+        b.mNumFailures = 5;
+        pm.store(b);
+        REQUIRE(PeerRecord::loadPeerRecord(db, b.getAddress())->mNumFailures == 2);
+        pm.flush();
+        REQUIRE(*PeerRecord::loadPeerRecord(db, b.getAddress()) == b);
+
+        PeerManager reloaded(*app);
+        REQUIRE(reloaded.size() == 4);
+        REQUIRE(*reloaded.load(b.getAddress()) == b);
+    }
+}
+
 TEST_CASE("private addresses", "[overlay][PeerRecord]") {
     PeerBareAddress pa("1.2.3.4", 15);
     CHECK(!pa.isPrivate());
@@ -12,6 +12,9 @@
 #include "util/Fs.h"
 #include "util/format.h"
 
+#include "medida/metrics_registry.h"
+#include "medida/timer.h"
+
 #include <chrono>
 #include <future>
 #include <thread>
@@ -142,6 +145,97 @@ TEST_CASE("subprocess storm", "[process]") {
     }
 }
 
+TEST_CASE("subprocess priorities", "[process]") {
+    VirtualClock clock;
+    Config cfg = getTestConfig();
+    cfg.MAX_CONCURRENT_SUBPROCESSES = 1;
+    Application::pointer appPtr = createTestApplication(clock, cfg);
+    Application &app = *appPtr;
+    auto &pm = app.getProcessManager();
+
+    std::vector<ProcessClass> completed;
+    for (auto processClass : {PROCESS_OTHER, PROCESS_REPAIR, PROCESS_OTHER,
+                              PROCESS_CATCHUP, PROCESS_PUBLISH}) {
+        auto evt = pm.runProcess("sleep 0", "", processClass);
+        evt.async_wait([&completed, processClass](asio::error_code ec) {
+            completed.push_back(processClass);
+        });
+    }
+
+    while (completed.size() < 5 && !clock.io_context().stopped()) {
+        clock.crank(true);
+    }
+
+    // the first one ran right away, the others highest class first
+    std::vector<ProcessClass> expected = {PROCESS_OTHER, PROCESS_PUBLISH,
+                                          PROCESS_CATCHUP, PROCESS_REPAIR,
+                                          PROCESS_OTHER};
+    REQUIRE(completed == expected);
+
+    auto &publishWait = app.getMetrics().newTimer({"process", "wait", "publish"});
+    auto &otherWait = app.getMetrics().newTimer({"process", "wait", "other"});
+    REQUIRE(publishWait.count() == 1);
+    REQUIRE(otherWait.count() == 2);
+}
+
+TEST_CASE("subprocess quotas", "[process]") {
+    VirtualClock clock;
+    Config cfg = getTestConfig();
+    cfg.MAX_CONCURRENT_SUBPROCESSES = 4;
+    Application::pointer appPtr = createTestApplication(clock, cfg);
+    Application &app = *appPtr;
+    auto &pm = app.getProcessManager();
+
+    size_t completed = 0;
+    auto run = [&](ProcessClass processClass) {
+        auto evt = pm.runProcess("sleep 0", "", processClass);
+        evt.async_wait([&completed](asio::error_code ec) { ++completed; });
+    };
+
+    // catchup leaves a slot for publishing
+    for (int i = 0; i < 4; i++) {
+        run(PROCESS_CATCHUP);
+    }
+    REQUIRE(pm.getNumRunningProcesses() == 3);
+    run(PROCESS_PUBLISH);
+    REQUIRE(pm.getNumRunningProcesses() == 4);
+
+    while (completed < 5 && !clock.io_context().stopped()) {
+        clock.crank(true);
+    }
+    REQUIRE(completed == 5);
+}
+
+TEST_CASE("subprocess quotas with mixed classes", "[process]") {
+    VirtualClock clock;
+    Config cfg = getTestConfig();
+    cfg.MAX_CONCURRENT_SUBPROCESSES = 4;
+    Application::pointer appPtr = createTestApplication(clock, cfg);
+    Application &app = *appPtr;
+    auto &pm = app.getProcessManager();
+
+    size_t completed = 0;
+    auto run = [&](ProcessClass processClass) {
+        auto evt = pm.runProcess("sleep 0", "", processClass);
+        evt.async_wait([&completed](asio::error_code ec) { ++completed; });
+    };
+
+    // lower classes count against the quota of the classes above them, so
+    // together they still leave a slot for publishing
+    for (auto processClass : {PROCESS_OTHER, PROCESS_OTHER, PROCESS_REPAIR,
+                              PROCESS_REPAIR, PROCESS_CATCHUP, PROCESS_CATCHUP}) {
+        run(processClass);
+    }
+    REQUIRE(pm.getNumRunningProcesses() == 3);
+    run(PROCESS_PUBLISH);
+    REQUIRE(pm.getNumRunningProcesses() == 4);
+
+    while (completed < 7 && !clock.io_context().stopped()) {
+        clock.crank(true);
+    }
+    REQUIRE(completed == 7);
+}
+
 TEST_CASE("shutdown while process running", "[process]") {
     VirtualClock clock;
     auto const& cfg1 = getTestConfig(0);
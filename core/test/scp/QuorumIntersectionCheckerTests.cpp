@@ -0,0 +1,176 @@
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "crypto/SHA.h"
+#include "crypto/SecretKey.h"
+#include "catch.hpp"
+#include "scp/QuorumIntersectionChecker.h"
+#include "util/Logging.h"
+#include "xdr/scp.h"
+#include <algorithm>
+#include <chrono>
+
+namespace vixal {
+
+namespace {
+std::vector<PublicKey>
+makeKeys(size_t n) {
+    std::vector<PublicKey> keys;
+    for (size_t i = 0; i < n; i++) {
+        auto hash = sha256("NODE_SEED_" + std::to_string(i));
+        keys.push_back(SecretKey::fromSeed(hash).getPublicKey());
+    }
+    return keys;
+}
+
+SCPQuorumSetPtr
+makeQSet(uint32 threshold, std::vector<PublicKey> const &validators) {
+    auto qSet = std::make_shared<SCPQuorumSet>();
+    qSet->threshold = threshold;
+    for (auto const &v : validators) {
+        qSet->validators.push_back(v);
+    }
+    return qSet;
+}
+
+// `orgs` organizations of `orgSize` nodes, every node requiring
+// `innerThreshold` nodes of `threshold` organizations
+SCPQuorumSetPtr
+makeOrgsQSet(std::vector<PublicKey> const &keys, size_t orgs, size_t orgSize,
+             uint32 innerThreshold, uint32 threshold) {
+    auto qSet = std::make_shared<SCPQuorumSet>();
+    qSet->threshold = threshold;
+    for (size_t o = 0; o < orgs; o++) {
+        auto org = makeQSet(innerThreshold,
+                            std::vector<PublicKey>(keys.begin() + o * orgSize,
+                                                   keys.begin() + (o + 1) * orgSize));
+        qSet->innerSets.push_back(*org);
+    }
+    return qSet;
+}
+}
+
+TEST_CASE("quorum intersection", "[scp][quorumintersection]") {
+    auto keys = makeKeys(20);
+
+    SECTION("3 of 4 nodes intersect") {
+        std::vector<PublicKey> nodes(keys.begin(), keys.begin() + 4);
+        QuorumIntersectionChecker::QuorumMap qmap;
+        for (auto const &n : nodes) {
+            qmap[n] = makeQSet(3, nodes);
+        }
+        QuorumIntersectionChecker checker(qmap);
+        REQUIRE(checker.networkEnjoysQuorumIntersection());
+        REQUIRE(checker.getNodeCount() == 4);
+    }
+
+    SECTION("2 of 4 nodes split") {
+        std::vector<PublicKey> nodes(keys.begin(), keys.begin() + 4);
+        QuorumIntersectionChecker::QuorumMap qmap;
+        for (auto const &n : nodes) {
+            qmap[n] = makeQSet(2, nodes);
+        }
+        QuorumIntersectionChecker checker(qmap);
+        REQUIRE(!checker.networkEnjoysQuorumIntersection());
+        auto split = checker.getPotentialSplit();
+        REQUIRE(split.first.size() == 2);
+        REQUIRE(split.second.size() == 2);
+        for (auto const &n : split.first) {
+            REQUIRE(std::find(split.second.begin(), split.second.end(), n) ==
+                    split.second.end());
+        }
+    }
+
+    SECTION("two disconnected groups split") {
+        std::vector<PublicKey> left(keys.begin(), keys.begin() + 3);
+        std::vector<PublicKey> right(keys.begin() + 3, keys.begin() + 6);
+        QuorumIntersectionChecker::QuorumMap qmap;
+        for (auto const &n : left) {
+            qmap[n] = makeQSet(2, left);
+        }
+        for (auto const &n : right) {
+            qmap[n] = makeQSet(2, right);
+        }
+        QuorumIntersectionChecker checker(qmap);
+        REQUIRE(!checker.networkEnjoysQuorumIntersection());
+        auto split = checker.getPotentialSplit();
+        REQUIRE(split.first.size() == 3);
+        REQUIRE(split.second.size() == 3);
+    }
+
+    SECTION("nodes without qset can't make a quorum") {
+        std::vector<PublicKey> nodes(keys.begin(), keys.begin() + 4);
+        QuorumIntersectionChecker::QuorumMap qmap;
+        qmap[nodes[0]] = makeQSet(2, nodes);
+        qmap[nodes[1]] = makeQSet(2, nodes);
+        qmap[nodes[2]] = nullptr;
+        qmap[nodes[3]] = nullptr;
+        QuorumIntersectionChecker checker(qmap);
+        REQUIRE(checker.networkEnjoysQuorumIntersection());
+        REQUIRE(checker.getNodeCount() == 2);
+    }
+
+    SECTION("organizations") {
+        // 6 organizations of 3 nodes, 2 nodes needed in each organization
+        QuorumIntersectionChecker::QuorumMap qmap;
+        SECTION("4 of 6 intersect") {
+            auto qSet = makeOrgsQSet(keys, 6, 3, 2, 4);
+            for (size_t i = 0; i < 18; i++) {
+                qmap[keys[i]] = qSet;
+            }
+            QuorumIntersectionChecker checker(qmap);
+            REQUIRE(checker.networkEnjoysQuorumIntersection());
+        }
+        SECTION("3 of 6 split") {
+            auto qSet = makeOrgsQSet(keys, 6, 3, 2, 3);
+            for (size_t i = 0; i < 18; i++) {
+                qmap[keys[i]] = qSet;
+            }
+            QuorumIntersectionChecker checker(qmap);
+            REQUIRE(!checker.networkEnjoysQuorumIntersection());
+            auto split = checker.getPotentialSplit();
+            REQUIRE(split.first.size() == 6);
+            REQUIRE(split.second.size() >= 6);
+        }
+        SECTION("watchers don't change the answer") {
+            auto qSet = makeOrgsQSet(keys, 6, 3, 2, 4);
+            for (size_t i = 0; i < 20; i++) {
+                qmap[keys[i]] = qSet;
+            }
+            QuorumIntersectionChecker checker(qmap);
+            REQUIRE(checker.networkEnjoysQuorumIntersection());
+            REQUIRE(checker.getNodeCount() == 20);
+        }
+    }
+}
+
+TEST_CASE("quorum intersection benchmarking",
+          "[scp-bench][quorumintersection][bench][!hide]") {
+    // 7 organizations of 3 nodes and a few hundred nodes watching them
+    size_t const orgs = 7;
+    size_t const orgSize = 3;
+    size_t const watchers = 300;
+    auto keys = makeKeys(orgs * orgSize + watchers);
+
+    for (uint32 threshold : {3, 5}) {
+        auto qSet = makeOrgsQSet(keys, orgs, orgSize, 2, threshold);
+        QuorumIntersectionChecker::QuorumMap qmap;
+        for (auto const &k : keys) {
+            qmap[k] = qSet;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        QuorumIntersectionChecker checker(qmap);
+        auto res = checker.networkEnjoysQuorumIntersection();
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start);
+        REQUIRE(res == (threshold == 5));
+        LOG(INFO) << threshold << " of " << orgs << " organizations, "
+                  << keys.size() << " nodes: " << (res ? "intersect" : "split")
+                  << " in " << elapsed.count() << "ms, "
+                  << checker.getMinimalQuorumsChecked()
+                  << " minimal quorums checked";
+    }
+}
+}
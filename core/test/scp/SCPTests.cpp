@@ -377,6 +377,78 @@ TEST_CASE("vblocking and quorum", "[scp]") {
     REQUIRE(LocalNode::isVBlocking(qSet, nodeSet) == true);
 }
 
+TEST_CASE("vblocking and quorum with inner sets", "[scp]") {
+    SIMULATION_CREATE_NODE(0);
+    SIMULATION_CREATE_NODE(1);
+    SIMULATION_CREATE_NODE(2);
+    SIMULATION_CREATE_NODE(3);
+    SIMULATION_CREATE_NODE(4);
+    SIMULATION_CREATE_NODE(5);
+
+    auto makeQSet = [](uint32 threshold, std::vector<NodeID> const &validators) {
+        SCPQuorumSet res;
+        res.threshold = threshold;
+        res.validators.insert(res.validators.end(), validators.begin(),
+                              validators.end());
+        return res;
+    };
+
+    // {2, v0, {2, v1, v2, v3}, {1, v4, v5}}
+    SCPQuorumSet qSet = makeQSet(2, {v0NodeID});
+    qSet.innerSets.push_back(makeQSet(2, {v1NodeID, v2NodeID, v3NodeID}));
+    qSet.innerSets.push_back(makeQSet(1, {v4NodeID, v5NodeID}));
+
+    SECTION("slices and v-blocking sets") {
+        REQUIRE(LocalNode::isQuorumSlice(qSet, {v0NodeID, v4NodeID}));
+        REQUIRE(!LocalNode::isQuorumSlice(qSet, {v1NodeID, v2NodeID}));
+        REQUIRE(LocalNode::isQuorumSlice(qSet, {v1NodeID, v2NodeID, v5NodeID}));
+
+        REQUIRE(!LocalNode::isVBlocking(qSet, {v0NodeID}));
+        REQUIRE(LocalNode::isVBlocking(qSet, {v0NodeID, v1NodeID, v2NodeID}));
+        REQUIRE(!LocalNode::isVBlocking(qSet, {v4NodeID, v5NodeID}));
+        REQUIRE(LocalNode::isVBlocking(
+                qSet, {v4NodeID, v5NodeID, v2NodeID, v3NodeID}));
+    }
+
+    SECTION("transitive quorum") {
+        LocalNode localNode(v0NodeID, true, qSet, nullptr);
+
+        std::map<NodeID, SCPQuorumSetPtr> qSets;
+        qSets[v0NodeID] = std::make_shared<SCPQuorumSet>(makeQSet(1, {v4NodeID}));
+        qSets[v4NodeID] = std::make_shared<SCPQuorumSet>(makeQSet(1, {v0NodeID}));
+        qSets[v1NodeID] = std::make_shared<SCPQuorumSet>(makeQSet(2, {v1NodeID, v2NodeID}));
+        qSets[v2NodeID] = qSets[v1NodeID];
+        qSets[v3NodeID] = std::make_shared<SCPQuorumSet>(makeQSet(1, {v3NodeID}));
+        qSets[v5NodeID] = std::make_shared<SCPQuorumSet>(makeQSet(1, {v3NodeID}));
+        auto qfun = [&](SCPStatement const &st) {
+            return qSets[st.nodeID];
+        };
+        auto makeEnvelopes = [](std::vector<NodeID> const &nodes) {
+            std::map<NodeID, SCPEnvelope> res;
+            for (auto const &n : nodes) {
+                res[n].statement.nodeID = n;
+            }
+            return res;
+        };
+
+        REQUIRE(localNode.isQuorum(makeEnvelopes({v0NodeID, v4NodeID}), qfun));
+        // v5 needs v3, without it v1 and v2 are not enough
+        REQUIRE(!localNode.isQuorum(
+                makeEnvelopes({v1NodeID, v2NodeID, v5NodeID}), qfun));
+        auto envs = makeEnvelopes({v1NodeID, v2NodeID, v3NodeID, v5NodeID});
+        REQUIRE(localNode.isQuorum(envs, qfun));
+        REQUIRE(!localNode.isQuorum(envs, qfun, [&](SCPStatement const &st) {
+            return !(st.nodeID == v3NodeID);
+        }));
+        REQUIRE(!localNode.isVBlocking(envs));
+        auto blocking = makeEnvelopes({v0NodeID, v1NodeID, v2NodeID});
+        REQUIRE(localNode.isVBlocking(blocking));
+        REQUIRE(!localNode.isVBlocking(blocking, [&](SCPStatement const &st) {
+            return !(st.nodeID == v0NodeID);
+        }));
+    }
+}
+
 TEST_CASE("v-blocking distance", "[scp]") {
     SIMULATION_CREATE_NODE(0);
     SIMULATION_CREATE_NODE(1);
@@ -24,7 +24,9 @@
 #include "util/Math.h"
 #include "util/format.h"
 #include "util/types.h"
+#include "scp/LocalNode.h"
 #include "xdrpp/autocheck.h"
+#include <chrono>
 #include <sstream>
 
 using namespace vixal;
@@ -614,3 +616,78 @@ TEST_CASE("Bucket-list entries vs. write throughput", "[scalability][!hide]") {
         }
     }
 }
+
+TEST_CASE("quorum evaluation benchmarking", "[scp-bench][bench][!hide]") {
+    Hash networkID = sha256(getTestConfig().NETWORK_PASSPHRASE);
+    Simulation::Mode mode = Simulation::OVER_LOOPBACK;
+    size_t const iterations = 1000;
+
+    // splits the validators in groups of 10, 2/3 of each needed
+    auto tiered = [](SCPQuorumSet const &qSet) {
+        SCPQuorumSet res;
+        for (size_t i = 0; i < qSet.validators.size(); i += 10) {
+            SCPQuorumSet inner;
+            for (size_t j = i; j < std::min(i + 10, qSet.validators.size()); ++j) {
+                inner.validators.push_back(qSet.validators[j]);
+            }
+            inner.threshold = static_cast<uint32>(
+                    (inner.validators.size() * 2 + 2) / 3);
+            res.innerSets.push_back(inner);
+        }
+        res.threshold = static_cast<uint32>((res.innerSets.size() * 2 + 2) / 3);
+        return res;
+    };
+
+    auto run = [&](std::string const &name, Simulation::pointer sim) {
+        std::map<NodeID, SCPQuorumSetPtr> qSets;
+        std::map<NodeID, SCPEnvelope> envs;
+        for (auto const &node : sim->getNodes()) {
+            auto id = node->getConfig().NODE_SEED.getPublicKey();
+            qSets[id] = std::make_shared<SCPQuorumSet>(node->getConfig().QUORUM_SET);
+            envs[id].statement.nodeID = id;
+        }
+        auto qfun = [&](SCPStatement const &st) {
+            return qSets[st.nodeID];
+        };
+        // a third of the nodes, about what it takes to block
+        size_t i = 0;
+        std::set<NodeID> third;
+        for (auto const &e : envs) {
+            if (i++ % 3 == 0) {
+                third.insert(e.first);
+            }
+        }
+        auto inThird = [&](SCPStatement const &st) {
+            return third.find(st.nodeID) != third.end();
+        };
+
+        auto const &localID = envs.begin()->first;
+        LocalNode localNode(localID, true, *qSets[localID], nullptr);
+
+        bool res = true;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t n = 0; n < iterations; ++n) {
+            res = localNode.isQuorum(envs, qfun) && res;
+        }
+        auto quorumTime = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start);
+        REQUIRE(res);
+
+        start = std::chrono::steady_clock::now();
+        for (size_t n = 0; n < iterations; ++n) {
+            localNode.isVBlocking(envs, inThird);
+        }
+        auto vBlockingTime = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start);
+
+        LOG(INFO) << name << " (" << envs.size() << " nodes): isQuorum "
+                  << quorumTime.count() / iterations << "us, isVBlocking "
+                  << vBlockingTime.count() / iterations << "us";
+    };
+
+    run("core", Topologies::separate(120, 0.67, mode, networkID));
+    run("tiered core", Topologies::separate(120, 0.67, mode, networkID,
+                                            nullptr, tiered));
+    run("core with outer nodes",
+        Topologies::hierarchicalQuorumSimplified(100, 30, mode, networkID));
+}
@@ -0,0 +1,304 @@
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "database/Database.h"
+#include "catch.hpp"
+#include "application/Application.h"
+#include "application/Config.h"
+#include "ledger/AccountFrame.h"
+#include "ledger/LedgerManager.h"
+#include "ledger/TrustFrame.h"
+#include "test/TestAccount.h"
+#include "test/TestUtils.h"
+#include "test/TxTests.h"
+#include "test/test.h"
+#include "transactions/TransactionFootprint.h"
+#include "util/Timer.h"
+#include "util/format.h"
+
+#include "medida/meter.h"
+#include "medida/metrics_registry.h"
+
+using namespace vixal;
+using namespace vixal::txtest;
+
+namespace {
+std::vector<std::vector<size_t>>
+cluster(std::vector<TransactionFramePtr> const &txs) {
+    std::vector<TransactionFootprint> footprints;
+    for (auto const &tx : txs) {
+        footprints.emplace_back(*tx);
+    }
+    return TransactionFootprint::cluster(footprints);
+}
+
+LedgerKey
+accountKey(PublicKey const &account) {
+    LedgerKey key(ACCOUNT);
+    key.account().accountID = account;
+    return key;
+}
+
+LedgerKey
+trustLineKey(PublicKey const &account, Asset const &asset) {
+    LedgerKey key(TRUSTLINE);
+    key.trustLine().accountID = account;
+    key.trustLine().asset = asset;
+    return key;
+}
+
+// what closing a ledger of mixed transactions left in the history
+struct MixedLedger {
+    Hash mHash;
+    std::vector<std::vector<uint8_t>> mResults;
+    std::vector<std::vector<uint8_t>> mMetas;
+    int64_t mParallel;
+    int64_t mFallback;
+};
+
+MixedLedger
+closeMixedLedger(Config const &cfg) {
+    VirtualClock clock;
+    auto app = createTestApplication(clock, cfg);
+    app->start();
+
+    auto root = TestAccount::createRoot(*app);
+    auto balance = app->getLedgerManager().getMinBalance(2) + 100000;
+    std::vector<TestAccount> accounts;
+    for (auto name : {"A", "B", "C", "D", "E", "F", "G", "H", "I", "J"}) {
+        accounts.emplace_back(root.create(name, balance));
+    }
+    auto &a = accounts[0], &b = accounts[1], &c = accounts[2], &d = accounts[3],
+         &e = accounts[4], &f = accounts[5], &g = accounts[6], &h = accounts[7],
+         &i = accounts[8], &j = accounts[9];
+    auto gateway = root.create("gateway", balance);
+    auto usd = gateway.asset("USD");
+    for (auto *t : {&a, &c, &d}) {
+        t->changeTrust(usd, 1000);
+    }
+    gateway.pay(c, usd, 100);
+    DataValue value;
+    value.push_back(1);
+    h.manageData("x", &value);
+
+    auto seq = app->getLedgerManager().getLedgerNum();
+    closeLedgerOn(*app, seq, 2, 1, 2016,
+                  {a.tx({payment(b, 10)}), c.tx({payment(d, usd, 10)}),
+                   e.tx({payment(f, 10)}), e.tx({payment(g, 20)}),
+                   h.tx({manageData("x", nullptr), manageData("y", &value)}),
+                   i.tx({setOptions(setHomeDomain("example.com"))}),
+                   j.tx({payment(i, 10 * balance)}),
+                   gateway.tx({manageOffer(0, usd, makeNativeAsset(), Price{1, 1}, 10)}),
+                   b.tx({changeTrust(usd, 1000)}), f.tx({accountMerge(g)}),
+                   d.tx({payment(c, usd, 5)}), g.tx({payment(e, 10)})});
+
+    MixedLedger res;
+    res.mHash = app->getLedgerManager().getLastClosedLedgerHeader().hash;
+    auto &db = app->getDatabase();
+    BlobValue result(db, db.getSession());
+    BlobValue meta(db, db.getSession());
+    auto prep = db.getPreparedStatement("SELECT txresult, txmeta FROM txhistory "
+                                        "WHERE ledgerseq = :lseq ORDER BY txindex ASC");
+    auto &st = prep.statement();
+    st.exchange(soci::use(seq));
+    result.into(st);
+    meta.into(st);
+    st.define_and_bind();
+    st.execute(true);
+    while (st.got_data()) {
+        res.mResults.emplace_back(result.get());
+        res.mMetas.emplace_back(meta.get());
+        st.fetch();
+    }
+    res.mParallel = app->getMetrics()
+                            .newMeter({"ledger", "transaction", "parallel"}, "transaction")
+                            .count();
+    res.mFallback = app->getMetrics()
+                            .newMeter({"ledger", "transaction", "parallel-fallback"}, "transaction")
+                            .count();
+    return res;
+}
+}
+
+TEST_CASE("transaction footprints", "[tx][footprint]") {
+    Config const &cfg = getTestConfig();
+
+    VirtualClock clock;
+    auto app = createTestApplication(clock, cfg);
+    app->start();
+
+    auto root = TestAccount::createRoot(*app);
+    auto balance = app->getLedgerManager().getMinBalance(2) + 100000;
+    auto a = root.create("A", balance);
+    auto b = root.create("B", balance);
+    auto c = root.create("C", balance);
+    auto d = root.create("D", balance);
+    auto gateway = root.create("gateway", balance);
+    auto usd = gateway.asset("USD");
+
+    typedef std::vector<std::vector<size_t>> Clusters;
+
+    SECTION("disjoint payments") {
+        auto res = cluster({a.tx({payment(b, 10)}), c.tx({payment(d, 10)})});
+        REQUIRE(res == Clusters{{0}, {1}});
+    }
+
+    SECTION("payments sharing an account") {
+        auto res = cluster({a.tx({payment(b, 10)}), c.tx({payment(d, 10)}),
+                            d.tx({payment(a, 10)})});
+        REQUIRE(res == Clusters{{0, 1, 2}});
+    }
+
+    SECTION("clusters are ordered by first transaction") {
+        auto res = cluster({a.tx({payment(b, 10)}), c.tx({payment(d, 10)}),
+                            b.tx({payment(gateway, 10)})});
+        REQUIRE(res == Clusters{{0, 2}, {1}});
+    }
+
+    SECTION("credit payments only read the issuer") {
+        TransactionFootprint footprint(*a.tx({payment(b, usd, 10)}));
+        REQUIRE(footprint.getWrites().size() == 3);
+        REQUIRE(footprint.getReads().size() == 2);
+        REQUIRE(!footprint.isGlobal());
+
+        auto res = cluster({a.tx({payment(b, usd, 10)}), c.tx({payment(d, usd, 10)})});
+        REQUIRE(res == Clusters{{0}, {1}});
+    }
+
+    SECTION("paying the issuer conflicts with its asset") {
+        auto res = cluster({a.tx({payment(b, usd, 10)}), c.tx({payment(gateway, 10)})});
+        REQUIRE(res == Clusters{{0, 1}});
+    }
+
+    SECTION("operation source accounts") {
+        auto res = cluster({a.tx({b.op(payment(c, 10))}), d.tx({payment(b, 10)})});
+        REQUIRE(res == Clusters{{0, 1}});
+    }
+
+    SECTION("offers are left out of clusters") {
+        auto offer = c.tx({manageOffer(0, usd, makeNativeAsset(), Price{1, 1}, 10)});
+        REQUIRE(TransactionFootprint(*offer).isGlobal());
+        auto res = cluster({a.tx({payment(b, 10)}), offer, d.tx({payment(gateway, 10)}),
+                            b.tx({payment(a, 10)})});
+        REQUIRE(res == Clusters{{0, 3}, {2}});
+    }
+
+    SECTION("revoking trust is global") {
+        REQUIRE(!TransactionFootprint(*gateway.tx({allowTrust(a, usd, true)})).isGlobal());
+        REQUIRE(TransactionFootprint(*gateway.tx({allowTrust(a, usd, false)})).isGlobal());
+    }
+
+    SECTION("prefetch") {
+        a.changeTrust(usd, 1000);
+        b.changeTrust(usd, 1000);
+        auto e = getAccount("E");
+
+        auto &db = app->getDatabase();
+        std::vector<TransactionFootprint> footprints;
+        footprints.emplace_back(*a.tx({payment(b, usd, 10), createAccount(e.getPublicKey(), balance)}));
+
+        db.getEntryCache().clear();
+        SECTION("entries are cached like single loads do") {
+            // a, b, e, gateway and 2 trust lines
+            REQUIRE(TransactionFootprint::prefetch(footprints, db, 100, app->io_context()) == 6);
+
+            REQUIRE(EntryFrame::cachedEntryExists(accountKey(e.getPublicKey()), db));
+            REQUIRE(!EntryFrame::getCachedEntry(accountKey(e.getPublicKey()), db));
+
+            auto key = accountKey(a.getPublicKey());
+            auto cached = EntryFrame::getCachedEntry(key, db);
+            REQUIRE(cached);
+            EntryFrame::flushCachedEntry(key, db);
+            REQUIRE(AccountFrame::loadAccount(a.getPublicKey(), db)->mEntry == *cached);
+
+            key = trustLineKey(b.getPublicKey(), usd);
+            cached = EntryFrame::getCachedEntry(key, db);
+            REQUIRE(cached);
+            EntryFrame::flushCachedEntry(key, db);
+            REQUIRE(TrustFrame::loadTrustLine(b.getPublicKey(), usd, db)->mEntry == *cached);
+
+            // nothing left to load
+            REQUIRE(TransactionFootprint::prefetch(footprints, db, 100, app->io_context()) == 0);
+        }
+        SECTION("limit") {
+            REQUIRE(TransactionFootprint::prefetch(footprints, db, 2, app->io_context()) == 2);
+        }
+    }
+}
+
+TEST_CASE("transaction footprint prefetch on pooled sessions", "[tx][footprint]") {
+    Config const &cfg = getTestConfig(0, Config::TESTDB_ON_DISK_SQLITE);
+
+    VirtualClock clock;
+    auto app = createTestApplication(clock, cfg);
+    app->start();
+
+    auto &db = app->getDatabase();
+    REQUIRE(db.canUsePool());
+
+    auto root = TestAccount::createRoot(*app);
+    auto balance = app->getLedgerManager().getMinBalance(0) + 100000;
+    auto a = root.create("A", balance);
+
+    // more than one batch of missing accounts, plus the source
+    std::vector<TransactionFootprint> footprints;
+    std::vector<PublicKey> missing;
+    for (int t = 0; t < 3; t++) {
+        std::vector<Operation> ops;
+        for (int i = 0; i < 100; i++) {
+            missing.emplace_back(getAccount(fmt::format("missing-{}-{}", t, i).c_str()).getPublicKey());
+            ops.emplace_back(createAccount(missing.back(), balance));
+        }
+        footprints.emplace_back(*a.tx(ops));
+    }
+
+    db.getEntryCache().clear();
+    REQUIRE(TransactionFootprint::prefetch(footprints, db, 1000, app->io_context()) == 301);
+
+    for (auto const &k : missing) {
+        REQUIRE(EntryFrame::cachedEntryExists(accountKey(k), db));
+        REQUIRE(!EntryFrame::getCachedEntry(accountKey(k), db));
+    }
+    auto key = accountKey(a.getPublicKey());
+    auto cached = EntryFrame::getCachedEntry(key, db);
+    REQUIRE(cached);
+    EntryFrame::flushCachedEntry(key, db);
+    REQUIRE(AccountFrame::loadAccount(a.getPublicKey(), db)->mEntry == *cached);
+}
+
+TEST_CASE("parallel transaction apply", "[tx][footprint]") {
+    Config sequentialCfg = getTestConfig(0);
+    Config parallelCfg = getTestConfig(1);
+    parallelCfg.PARALLEL_TX_APPLY = true;
+
+    SECTION("matches applying one after the other") {
+        // checking the cache against the database needs the session
+        sequentialCfg.INVARIANT_CHECKS = {"(?!CacheIsConsistentWithDatabase).*"};
+        parallelCfg.INVARIANT_CHECKS = sequentialCfg.INVARIANT_CHECKS;
+
+        auto sequential = closeMixedLedger(sequentialCfg);
+        auto parallel = closeMixedLedger(parallelCfg);
+        REQUIRE(sequential.mParallel == 0);
+        REQUIRE(parallel.mParallel > 0);
+        REQUIRE(parallel.mFallback == 0);
+
+        REQUIRE(sequential.mResults.size() == 12);
+        REQUIRE(parallel.mResults == sequential.mResults);
+        REQUIRE(parallel.mMetas == sequential.mMetas);
+        REQUIRE(parallel.mHash == sequential.mHash);
+    }
+
+    SECTION("falls back to applying one after the other") {
+        // every invariant is checked, checking the cache against the database
+        // misses the overlays
+        auto sequential = closeMixedLedger(sequentialCfg);
+        auto parallel = closeMixedLedger(parallelCfg);
+        REQUIRE(parallel.mParallel == 0);
+        REQUIRE(parallel.mFallback > 0);
+
+        REQUIRE(parallel.mResults == sequential.mResults);
+        REQUIRE(parallel.mMetas == sequential.mMetas);
+        REQUIRE(parallel.mHash == sequential.mHash);
+    }
+}